@@ -0,0 +1,378 @@
+#include "Buffer.h"
+#include "Channel.h"
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <future>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+#include <dlfcn.h>
+#include <stdlib.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+// 热点原语的微基准：Buffer的append/扩容/readFd/retrieveAsString，多个生产者线程queueInLoop，
+// EPollPoller::updateChannel的增删改。输入都是固定的，除了时间之外每个基准还报告两个计数器：
+//   allocs    平均每次迭代的operator new次数（在本程序里替换全局的operator new，库里的分配也算在内）
+//   syscalls  平均每次迭代的read/readv/write/writev/epoll_ctl/epoll_wait次数（在本程序里拦截这几个libc函数）
+// 用PauseTiming准备数据的基准（MakeSpaceCompact、ReadFd、RetrieveAsString）带着几百纳秒的计时开销，只适合前后对比
+// 修改这几个类时附上改动前后的结果，例如：
+//   microbench --benchmark_filter=Buffer --benchmark_repetitions=5 --benchmark_format=json
+
+static std::atomic<uint64_t> g_allocations{0};
+static std::atomic<uint64_t> g_syscalls{0};
+
+void* operator new(size_t size)
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    void* p = malloc(size == 0 ? 1 : size);
+    if(p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+// 拦截libmymuduo.so里的系统调用（可执行文件导出同名符号，动态链接时优先于libc），计数之后转给libc
+template <typename Fn>
+static Fn realFunction(const char* name)
+{
+    return reinterpret_cast<Fn>(dlsym(RTLD_NEXT, name));
+}
+
+extern "C"
+{
+
+ssize_t read(int fd, void* data, size_t len)
+{
+    static auto real = realFunction<ssize_t (*)(int, void*, size_t)>("read");
+    g_syscalls.fetch_add(1, std::memory_order_relaxed);
+    return real(fd, data, len);
+}
+
+ssize_t readv(int fd, const struct iovec* iov, int iovcnt)
+{
+    static auto real = realFunction<ssize_t (*)(int, const struct iovec*, int)>("readv");
+    g_syscalls.fetch_add(1, std::memory_order_relaxed);
+    return real(fd, iov, iovcnt);
+}
+
+ssize_t write(int fd, const void* data, size_t len)
+{
+    static auto real = realFunction<ssize_t (*)(int, const void*, size_t)>("write");
+    g_syscalls.fetch_add(1, std::memory_order_relaxed);
+    return real(fd, data, len);
+}
+
+ssize_t writev(int fd, const struct iovec* iov, int iovcnt)
+{
+    static auto real = realFunction<ssize_t (*)(int, const struct iovec*, int)>("writev");
+    g_syscalls.fetch_add(1, std::memory_order_relaxed);
+    return real(fd, iov, iovcnt);
+}
+
+int epoll_ctl(int epfd, int op, int fd, struct epoll_event* event)
+{
+    static auto real = realFunction<int (*)(int, int, int, struct epoll_event*)>("epoll_ctl");
+    g_syscalls.fetch_add(1, std::memory_order_relaxed);
+    return real(epfd, op, fd, event);
+}
+
+int epoll_wait(int epfd, struct epoll_event* events, int maxevents, int timeout)
+{
+    static auto real = realFunction<int (*)(int, struct epoll_event*, int, int)>("epoll_wait");
+    g_syscalls.fetch_add(1, std::memory_order_relaxed);
+    return real(epfd, events, maxevents, timeout);
+}
+
+}
+
+// 在基准的计时循环前后各取一次全局计数，差值按迭代次数平均
+// 计数是全进程的，多线程基准只在thread 0上统计，其他线程和loop线程的调用也算在内
+class OpCounters
+{
+public:
+    explicit OpCounters(benchmark::State& state)
+        :state_(state),
+        enabled_(state.thread_index() == 0),
+        allocations_(g_allocations.load(std::memory_order_relaxed)),
+        syscalls_(g_syscalls.load(std::memory_order_relaxed))
+    {
+    }
+
+    ~OpCounters()
+    {
+        if(enabled_)
+        {
+            state_.counters["allocs"] = benchmark::Counter(
+                static_cast<double>(g_allocations.load(std::memory_order_relaxed) - allocations_), benchmark::Counter::kAvgIterations);
+            state_.counters["syscalls"] = benchmark::Counter(
+                static_cast<double>(g_syscalls.load(std::memory_order_relaxed) - syscalls_), benchmark::Counter::kAvgIterations);
+        }
+    }
+
+private:
+    benchmark::State& state_;
+    bool enabled_;
+    uint64_t allocations_;
+    uint64_t syscalls_;
+};
+
+// 不经过上面拦截的write，给基准准备数据用
+static void rawWrite(int fd, const char* data, size_t len)
+{
+    while(len > 0)
+    {
+        ssize_t n = ::syscall(SYS_write, fd, data, len);
+        if(n <= 0)
+        {
+            abort();
+        }
+        data += n;
+        len -= n;
+    }
+}
+
+// 固定的输入：0~255循环
+static std::string makeInput(size_t len)
+{
+    std::string input(len, '\0');
+    for(size_t i = 0; i < len; i++)
+    {
+        input[i] = static_cast<char>(i);
+    }
+    return input;
+}
+
+// append之后整体取走，缓冲区一直够用，测的是拷贝本身
+static void BM_BufferAppend(benchmark::State& state)
+{
+    const std::string input = makeInput(state.range(0));
+    Buffer buffer;
+    buffer.append(input);
+    buffer.retrieveAll();
+    OpCounters counters(state);
+    for(auto _ : state)
+    {
+        buffer.append(input.data(), input.size());
+        benchmark::DoNotOptimize(buffer.peek());
+        buffer.retrieveAll();
+    }
+    state.SetBytesProcessed(state.iterations() * input.size());
+}
+BENCHMARK(BM_BufferAppend)->RangeMultiplier(4)->Range(16, 64 * 1024);
+
+// 新建的Buffer（kInitialSize）里连续append，直到放下range(0)字节，每次超出可写空间都要扩容
+static void BM_BufferMakeSpaceGrow(benchmark::State& state)
+{
+    const std::string chunk = makeInput(512);
+    const size_t total = state.range(0);
+    OpCounters counters(state);
+    for(auto _ : state)
+    {
+        Buffer buffer;
+        for(size_t n = 0; n < total; n += chunk.size())
+        {
+            buffer.append(chunk);
+        }
+        benchmark::DoNotOptimize(buffer.peek());
+    }
+    state.SetBytesProcessed(state.iterations() * total);
+}
+BENCHMARK(BM_BufferMakeSpaceGrow)->RangeMultiplier(8)->Range(4 * 1024, 1024 * 1024);
+
+// 前面取走了大半，剩下range(0)字节可读，append时makeSpace把可读数据挪回头部而不扩容
+static void BM_BufferMakeSpaceCompact(benchmark::State& state)
+{
+    const size_t readable = state.range(0);
+    const size_t capacity = 4 * readable;
+    const std::string fill = makeInput(capacity);
+    const std::string tail = makeInput(readable + 1);
+    Buffer buffer(capacity);
+    OpCounters counters(state);
+    for(auto _ : state)
+    {
+        state.PauseTiming();
+        buffer.retrieveAll();
+        buffer.append(fill);
+        buffer.retrieve(capacity - readable);
+        state.ResumeTiming();
+        buffer.append(tail);   //可写空间只剩0，挪动readable字节之后放得下
+        benchmark::DoNotOptimize(buffer.peek());
+    }
+    state.SetBytesProcessed(state.iterations() * readable);
+}
+BENCHMARK(BM_BufferMakeSpaceCompact)->RangeMultiplier(8)->Range(64, 256 * 1024);
+
+// socketpair的对端先写好range(0)字节（不计时），再用readFd读完；超过可写空间的部分走栈上的extrabuf
+// 每次读完retrieveAll，缓冲区扩容之后保持大小
+static void BM_BufferReadFd(benchmark::State& state)
+{
+    const std::string input = makeInput(state.range(0));
+    int fds[2];
+    if(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+    {
+        state.SkipWithError("socketpair failed");
+        return;
+    }
+    int sockBuffer = 4 * 1024 * 1024;
+    ::setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &sockBuffer, sizeof sockBuffer);
+    ::setsockopt(fds[1], SOL_SOCKET, SO_RCVBUF, &sockBuffer, sizeof sockBuffer);
+    Buffer buffer;
+    OpCounters counters(state);
+    for(auto _ : state)
+    {
+        state.PauseTiming();
+        rawWrite(fds[0], input.data(), input.size());
+        state.ResumeTiming();
+        size_t received = 0;
+        while(received < input.size())
+        {
+            int saveErrno = 0;
+            ssize_t n = buffer.readFd(fds[1], &saveErrno);
+            if(n <= 0)
+            {
+                state.SkipWithError("readFd failed");
+                break;
+            }
+            received += n;
+        }
+        buffer.retrieveAll();
+    }
+    state.SetBytesProcessed(state.iterations() * input.size());
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+BENCHMARK(BM_BufferReadFd)->RangeMultiplier(8)->Range(64, 256 * 1024);
+
+// 从缓冲区中取出range(0)字节构造string，超过SSO的长度要分配一次
+static void BM_BufferRetrieveAsString(benchmark::State& state)
+{
+    const std::string input = makeInput(state.range(0));
+    Buffer buffer;
+    OpCounters counters(state);
+    for(auto _ : state)
+    {
+        state.PauseTiming();
+        buffer.append(input);
+        state.ResumeTiming();
+        std::string out = buffer.retrieveAsString(input.size());
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetBytesProcessed(state.iterations() * input.size());
+}
+BENCHMARK(BM_BufferRetrieveAsString)->RangeMultiplier(8)->Range(8, 64 * 1024);
+
+// 所有queueInLoop基准共用的消费者loop线程
+static EventLoop* consumerLoop()
+{
+    static EventLoopThread* thread = new EventLoopThread(EventLoopThread::ThreadInitCallBack(), "microbench");
+    static EventLoop* loop = thread->startLoop();
+    return loop;
+}
+
+// 等消费者loop把之前排进去的任务都执行完
+static void drainLoop(EventLoop* loop)
+{
+    std::promise<void> done;
+    loop->queueInLoop([&done]() { done.set_value(); });
+    done.get_future().wait();
+}
+
+// 每个基准线程是一个生产者，往同一个loop里排空任务，测的是加锁入队加上必要时wakeup的开销
+static void BM_QueueInLoop(benchmark::State& state)
+{
+    EventLoop* loop = consumerLoop();
+    static std::atomic<uint64_t> executed{0};
+    OpCounters counters(state);
+    for(auto _ : state)
+    {
+        loop->queueInLoop([]() { executed.fetch_add(1, std::memory_order_relaxed); });
+    }
+    if(state.thread_index() == 0)
+    {
+        drainLoop(loop);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_QueueInLoop)->ThreadRange(1, 8)->UseRealTime();
+
+// updateChannel/removeChannel要在loop线程中调用，这里在主线程上建一个不运行的loop
+static EventLoop* pollerLoop()
+{
+    static EventLoop* loop = new EventLoop;
+    return loop;
+}
+
+// range(0)个已经注册了读事件的eventfd，轮流打开再关闭写事件，每次迭代两次EPOLL_CTL_MOD
+static void BM_PollerModify(benchmark::State& state)
+{
+    EventLoop* loop = pollerLoop();
+    std::vector<std::unique_ptr<Channel>> channels;
+    for(int64_t i = 0; i < state.range(0); i++)
+    {
+        channels.emplace_back(new Channel(loop, ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)));
+        channels.back()->enableReading();
+    }
+    size_t next = 0;
+    OpCounters counters(state);
+    for(auto _ : state)
+    {
+        Channel* channel = channels[next].get();
+        channel->enableWritting();
+        channel->disableWritting();
+        next = next + 1 == channels.size() ? 0 : next + 1;
+    }
+    state.SetItemsProcessed(state.iterations() * 2);
+    for(auto& channel : channels)
+    {
+        channel->disableAll();
+        channel->remove();
+        ::close(channel->fd());
+    }
+}
+BENCHMARK(BM_PollerModify)->Arg(1)->Arg(64)->Arg(4096);
+
+// 已经有range(0)个channel时，一个channel反复注册、注销、从poller中删除
+static void BM_PollerAddRemove(benchmark::State& state)
+{
+    EventLoop* loop = pollerLoop();
+    std::vector<std::unique_ptr<Channel>> channels;
+    for(int64_t i = 0; i < state.range(0); i++)
+    {
+        channels.emplace_back(new Channel(loop, ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)));
+        channels.back()->enableReading();
+    }
+    int fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    Channel channel(loop, fd);
+    OpCounters counters(state);
+    for(auto _ : state)
+    {
+        channel.enableReading();
+        channel.disableAll();
+        channel.remove();
+    }
+    state.SetItemsProcessed(state.iterations());
+    ::close(fd);
+    for(auto& c : channels)
+    {
+        c->disableAll();
+        c->remove();
+        ::close(c->fd());
+    }
+}
+BENCHMARK(BM_PollerAddRemove)->Arg(0)->Arg(64)->Arg(4096);
+
+BENCHMARK_MAIN();
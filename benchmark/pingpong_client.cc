@@ -0,0 +1,283 @@
+#include "TcpClient.h"
+#include "EventLoop.h"
+#include "EventLoopThreadPool.h"
+#include "Histogram.h"
+#include "Logger.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// ping-pong压测的客户端：threads个loop线程上一共sessions条连接，每条连接上始终只有一个blockSize字节的消息，
+// 整条消息回来之后记一次往返时延再发下一条。预热warmup秒之后开始统计，统计seconds秒
+// 结果一行一条记录输出到-o指定的文件（默认stdout，和日志混在一起时按行首的'{'或者csv的列数过滤）
+// 吞吐是单方向的（收到的回显字节数），时延单位微秒，分位数的相对误差见Histogram
+// 用法：pingpong_client [-a ip] [-p port] [-t threads] [-b blockSize] [-c sessions]
+//                       [-d seconds] [-w warmup] [-f json|csv] [-H] [-o file]
+
+struct BenchOptions
+{
+    std::string ip = "127.0.0.1";
+    uint16_t port = 9981;
+    int threads = 1;
+    int blockSize = 16;
+    int sessions = 1;
+    double seconds = 5.0;
+    double warmup = 1.0;
+    bool csv = false;
+    bool csvHeader = false;     //只输出csv的表头
+    std::string output;
+};
+
+// 每个loop线程一份，只有这个loop线程写
+struct LoopStats
+{
+    Histogram latencyUs;
+    std::atomic<uint64_t> messages{0};
+};
+
+class PingPongClient;
+
+class Session : noncopyable
+{
+public:
+    Session(PingPongClient* owner, EventLoop* loop, LoopStats* stats, const InetAddress& addr, const std::string& name);
+
+    void start() { client_.connect(); }
+
+private:
+    void onConnection(const TcpConnectionPtr& conn);
+    void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp receiveTime);
+    void sendBlock(const TcpConnectionPtr& conn);
+
+    PingPongClient* owner_;
+    LoopStats* stats_;
+    TcpClient client_;
+    int64_t sendTimeUs_;
+};
+
+class PingPongClient : noncopyable
+{
+public:
+    PingPongClient(EventLoop* loop, const BenchOptions& options)
+        :loop_(loop),
+        options_(options),
+        pool_(loop, "PingPongClient"),
+        payload_(std::make_shared<const std::string>(options.blockSize, 'x')),
+        measuring_(false),
+        connected_(0),
+        startUs_(0)
+    {
+        pool_.setThreadNum(options.threads);
+    }
+
+    void start()
+    {
+        pool_.start();
+        // threads为0时所有连接都在baseLoop上
+        std::vector<EventLoop*> loops = pool_.getAllLoops();
+        for(size_t i = 0; i < loops.size(); i++)
+        {
+            stats_.emplace_back(new LoopStats);
+        }
+        InetAddress addr(options_.port, options_.ip);
+        for(int i = 0; i < options_.sessions; i++)
+        {
+            char name[32];
+            snprintf(name, sizeof name, "pingpong%d", i);
+            size_t index = i % loops.size();
+            sessions_.emplace_back(new Session(this, loops[index], stats_[index].get(), addr, name));
+        }
+        for(auto& session : sessions_)
+        {
+            session->start();
+        }
+        loop_->runAfter(options_.warmup, [this]() {
+            startUs_ = Timestamp::now().microSecondsSinceEpoch();
+            measuring_.store(true, std::memory_order_relaxed);
+        });
+        loop_->runAfter(options_.warmup + options_.seconds, std::bind(&PingPongClient::finish, this));
+    }
+
+    const SharedPayload& payload() const { return payload_; }
+    int blockSize() const { return options_.blockSize; }
+    bool measuring() const { return measuring_.load(std::memory_order_relaxed); }
+    void onConnected() { connected_.fetch_add(1, std::memory_order_relaxed); }
+
+private:
+    void finish()
+    {
+        measuring_.store(false, std::memory_order_relaxed);
+        double elapsed = static_cast<double>(Timestamp::now().microSecondsSinceEpoch() - startUs_) / Timestamp::kMicroSecondsPerSecond;
+        HistogramSnapshot latency;
+        uint64_t messages = 0;
+        for(auto& stats : stats_)
+        {
+            latency.merge(stats->latencyUs.snapshot());
+            messages += stats->messages.load(std::memory_order_relaxed);
+        }
+        uint64_t bytes = messages * options_.blockSize;
+        double mibPerSecond = elapsed > 0 ? bytes / elapsed / 1024 / 1024 : 0.0;
+        double messagesPerSecond = elapsed > 0 ? messages / elapsed : 0.0;
+
+        FILE* out = stdout;
+        if(!options_.output.empty())
+        {
+            out = fopen(options_.output.c_str(), "a");
+            if(out == nullptr)
+            {
+                LOG_ERROR("pingpong_client: cannot open %s \n", options_.output.c_str());
+                out = stdout;
+            }
+        }
+        if(options_.csv)
+        {
+            fprintf(out, "pingpong,%d,%d,%d,%d,%.3f,%lu,%lu,%.3f,%.1f,%ld,%ld,%ld,%ld,%ld,%.1f\n",
+                    options_.blockSize, options_.sessions, connected_.load(), options_.threads, elapsed,
+                    messages, bytes, mibPerSecond, messagesPerSecond,
+                    latency.percentile(0.5), latency.percentile(0.9), latency.percentile(0.99),
+                    latency.percentile(0.999), latency.max, latency.mean());
+        }
+        else
+        {
+            fprintf(out, "{\"bench\":\"pingpong\",\"block_size\":%d,\"sessions\":%d,\"connected\":%d,\"threads\":%d,"
+                    "\"seconds\":%.3f,\"messages\":%lu,\"bytes\":%lu,\"mib_per_s\":%.3f,\"msgs_per_s\":%.1f,"
+                    "\"latency_us\":{\"p50\":%ld,\"p90\":%ld,\"p99\":%ld,\"p999\":%ld,\"max\":%ld,\"mean\":%.1f}}\n",
+                    options_.blockSize, options_.sessions, connected_.load(), options_.threads, elapsed,
+                    messages, bytes, mibPerSecond, messagesPerSecond,
+                    latency.percentile(0.5), latency.percentile(0.9), latency.percentile(0.99),
+                    latency.percentile(0.999), latency.max, latency.mean());
+        }
+        fflush(out);
+        if(out != stdout)
+        {
+            fclose(out);
+        }
+        // 压测结束直接退出进程，不等几百条连接在各自的loop里逐个关闭
+        fflush(stdout);
+        _exit(connected_.load() == options_.sessions ? 0 : 2);
+    }
+
+    EventLoop* loop_;
+    BenchOptions options_;
+    EventLoopThreadPool pool_;
+    SharedPayload payload_;
+    std::atomic<bool> measuring_;
+    std::atomic<int> connected_;
+    int64_t startUs_;
+    std::vector<std::unique_ptr<LoopStats>> stats_;
+    std::vector<std::unique_ptr<Session>> sessions_;
+};
+
+Session::Session(PingPongClient* owner, EventLoop* loop, LoopStats* stats, const InetAddress& addr, const std::string& name)
+    :owner_(owner),
+    stats_(stats),
+    client_(loop, addr, name),
+    sendTimeUs_(0)
+{
+    client_.setConnectionCallback(std::bind(&Session::onConnection, this, std::placeholders::_1));
+    client_.setMessageCallback(std::bind(&Session::onMessage, this,
+                                std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+}
+
+void Session::onConnection(const TcpConnectionPtr& conn)
+{
+    if(conn->connected())
+    {
+        conn->setTcpNoDelay(true);
+        owner_->onConnected();
+        sendBlock(conn);
+    }
+}
+
+void Session::onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+{
+    // 一次只有一条消息在路上，回显凑够一整条才算一次往返
+    size_t blockSize = owner_->blockSize();
+    if(buf->readableBytes() < blockSize)
+    {
+        return;
+    }
+    buf->retrieve(blockSize);
+    if(owner_->measuring())
+    {
+        stats_->latencyUs.record(Timestamp::now().microSecondsSinceEpoch() - sendTimeUs_);
+        stats_->messages.store(stats_->messages.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+    sendBlock(conn);
+}
+
+void Session::sendBlock(const TcpConnectionPtr& conn)
+{
+    sendTimeUs_ = Timestamp::now().microSecondsSinceEpoch();
+    conn->send(owner_->payload());
+}
+
+static void usage(const char* prog)
+{
+    fprintf(stderr, "usage: %s [-a ip] [-p port] [-t threads] [-b blockSize] [-c sessions] "
+                    "[-d seconds] [-w warmup] [-f json|csv] [-H] [-o file]\n", prog);
+    exit(1);
+}
+
+static void printCsvHeader(FILE* out)
+{
+    fprintf(out, "bench,block_size,sessions,connected,threads,seconds,messages,bytes,mib_per_s,msgs_per_s,"
+                 "p50_us,p90_us,p99_us,p999_us,max_us,mean_us\n");
+}
+
+int main(int argc, char** argv)
+{
+    BenchOptions options;
+    int opt;
+    while((opt = getopt(argc, argv, "a:p:t:b:c:d:w:f:Ho:h")) != -1)
+    {
+        switch(opt)
+        {
+            case 'a': options.ip = optarg; break;
+            case 'p': options.port = static_cast<uint16_t>(atoi(optarg)); break;
+            case 't': options.threads = atoi(optarg); break;
+            case 'b': options.blockSize = atoi(optarg); break;
+            case 'c': options.sessions = atoi(optarg); break;
+            case 'd': options.seconds = atof(optarg); break;
+            case 'w': options.warmup = atof(optarg); break;
+            case 'f': options.csv = strcmp(optarg, "csv") == 0; break;
+            case 'H': options.csvHeader = true; break;
+            case 'o': options.output = optarg; break;
+            default: usage(argv[0]);
+        }
+    }
+    if(options.csvHeader)
+    {
+        FILE* out = options.output.empty() ? stdout : fopen(options.output.c_str(), "a");
+        if(out == nullptr)
+        {
+            perror("fopen");
+            return 1;
+        }
+        printCsvHeader(out);
+        if(out != stdout)
+        {
+            fclose(out);
+        }
+        return 0;
+    }
+    if(options.blockSize <= 0 || options.sessions <= 0 || options.threads < 0)
+    {
+        usage(argv[0]);
+    }
+
+    // 对端关闭之后还在写，不能被SIGPIPE杀掉
+    ::signal(SIGPIPE, SIG_IGN);
+    EventLoop loop;
+    PingPongClient client(&loop, options);
+    client.start();
+    loop.loop();
+    return 0;
+}
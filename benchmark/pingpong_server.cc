@@ -0,0 +1,55 @@
+#include "TcpServer.h"
+#include "Logger.h"
+
+#include <string>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// ping-pong压测的服务端：多个subLoop，收到什么原样回什么，配合pingpong_client使用
+// 用法：pingpong_server [-a ip] [-p port] [-t threads]，一直运行到被杀掉
+
+static void usage(const char* prog)
+{
+    fprintf(stderr, "usage: %s [-a ip] [-p port] [-t threads]\n", prog);
+    exit(1);
+}
+
+int main(int argc, char** argv)
+{
+    std::string ip = "127.0.0.1";
+    uint16_t port = 9981;
+    int threads = 1;
+
+    int opt;
+    while((opt = getopt(argc, argv, "a:p:t:h")) != -1)
+    {
+        switch(opt)
+        {
+            case 'a': ip = optarg; break;
+            case 'p': port = static_cast<uint16_t>(atoi(optarg)); break;
+            case 't': threads = atoi(optarg); break;
+            default: usage(argv[0]);
+        }
+    }
+
+    // 客户端压测结束时直接退出，对端关闭之后还在写，不能被SIGPIPE杀掉
+    ::signal(SIGPIPE, SIG_IGN);
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(port, ip), "PingPongServer");
+    server.setConnectionCallback([](const TcpConnectionPtr& conn) {
+        if(conn->connected())
+        {
+            conn->setTcpNoDelay(true);
+        }
+    });
+    server.setMessageCallback([](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+        conn->send(buf);
+    });
+    server.setThreadNum(threads);
+    server.start();
+    LOG_INFO("pingpong_server listening on %s:%d with %d threads \n", ip.c_str(), port, threads);
+    loop.loop();
+    return 0;
+}
@@ -0,0 +1,49 @@
+#!/bin/bash
+
+# 在回环地址上扫一遍ping-pong压测：消息大小 × 连接数 × 线程数（服务端和客户端用同样的线程数）
+# 每组参数一行结果追加到OUT（默认json lines，FORMAT=csv时输出csv并先写表头）
+# 参数都可以用环境变量覆盖，例如：
+#   SIZES="16 4096" CONNECTIONS="1 100" THREADS="1 4" DURATION=3 ./pingpong_sweep.sh
+# 和pingpong_server、pingpong_client放在同一个目录（cmake会拷贝到build/benchmark下）
+
+set -e
+
+BIN_DIR=${BIN_DIR:-$(cd `dirname $0` && pwd)}
+SIZES=${SIZES:-"16 64 256 1024 4096 16384 65536 262144 1048576"}
+CONNECTIONS=${CONNECTIONS:-"1 10 100 1000"}
+THREADS=${THREADS:-"1 2 4"}
+DURATION=${DURATION:-5}
+WARMUP=${WARMUP:-1}
+PORT=${PORT:-9981}
+FORMAT=${FORMAT:-json}
+OUT=${OUT:-pingpong-`date +%Y%m%d-%H%M%S`.$FORMAT}
+
+# 1000条连接需要足够的文件描述符
+ulimit -n 65536 2>/dev/null || true
+
+if [ "$FORMAT" = "csv" ]; then
+    $BIN_DIR/pingpong_client -H -o $OUT
+fi
+
+for threads in $THREADS
+do
+    $BIN_DIR/pingpong_server -p $PORT -t $threads > /dev/null &
+    server=$!
+    trap "kill $server 2>/dev/null" EXIT
+    sleep 0.5
+
+    for connections in $CONNECTIONS
+    do
+        for size in $SIZES
+        do
+            echo "threads=$threads connections=$connections size=$size" >&2
+            $BIN_DIR/pingpong_client -p $PORT -t $threads -c $connections -b $size \
+                -d $DURATION -w $WARMUP -f $FORMAT -o $OUT > /dev/null || true
+        done
+    done
+
+    kill $server
+    wait $server 2>/dev/null || true
+done
+
+echo "results in $OUT" >&2
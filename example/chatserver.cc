@@ -0,0 +1,53 @@
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/Logger.h>
+
+#include <string>
+#include <stdlib.h>
+
+// 聊天室：每个客户端发来的一行转发给其他所有人，用TcpServer::broadcast，
+// 一条消息只保存一份，每个subLoop只投递一个任务，不按连接拷贝
+// 用法：chatserver [ioThreads]
+// 测试：开几个终端 telnet 127.0.0.1 8900
+
+class ChatServer
+{
+public:
+    ChatServer(EventLoop* loop, const InetAddress& addr, int ioThreads)
+        :server_(loop, addr, "ChatServer")
+    {
+        server_.setConnectionCallback([this](const TcpConnectionPtr& conn) {
+            std::string line = conn->peerAddress().toIpPort() + (conn->connected() ? " joined\r\n" : " left\r\n");
+            server_.broadcast(std::move(line));
+        });
+        server_.setMessageCallback(std::bind(&ChatServer::onMessage, this,
+                                    std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+        server_.setThreadNum(ioThreads);
+    }
+
+    void start() { server_.start(); }
+
+private:
+    void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+    {
+        while(const char* crlf = buf->findCRLF())
+        {
+            std::string line = conn->peerAddress().toIpPort() + ": " + std::string(buf->peek(), crlf + 2);
+            buf->retrieve(crlf + 2 - buf->peek());
+            // 不发回给自己
+            TcpConnection* sender = conn.get();
+            server_.broadcast(std::move(line), [sender](const TcpConnectionPtr& c) { return c.get() != sender; });
+        }
+    }
+
+    TcpServer server_;
+};
+
+int main(int argc, char** argv)
+{
+    int ioThreads = argc > 1 ? atoi(argv[1]) : 4;
+    EventLoop loop;
+    ChatServer server(&loop, InetAddress(8900), ioThreads);
+    server.start();
+    loop.loop();
+    return 0;
+}
@@ -0,0 +1,178 @@
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/TcpClient.h>
+#include <mymuduo/CompressionContext.h>
+#include <mymuduo/Logger.h>
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <stdio.h>
+#include <stdlib.h>
+
+// 压缩层的乒乓压测：消息是一条定长的行情json，依次比较不压缩、level 1、level 6、level 6 + 预置字典
+// 每条连接上始终有batch条消息在来回传，统计客户端压缩前后的字节数
+// 用法：compressbench [connections] [batch] [seconds] [serverThreads]
+
+static const char* const kDictionary =
+    "{\"type\":\"quote\",\"symbol\":\"\",\"bid\":\"\",\"ask\":\"\",\"bidSize\":,\"askSize\":,\"ts\":}\n"
+    "AAPL MSFT GOOG AMZN NVDA META TSLA ";
+
+static const char* const kSymbols[] = { "AAPL", "MSFT", "GOOG", "AMZN", "NVDA", "META", "TSLA" };
+
+// 生成第seq条消息，长度固定，方便客户端按长度切分
+static std::string makeQuote(int64_t seq)
+{
+    char buf[160];
+    int n = snprintf(buf, sizeof buf,
+            "{\"type\":\"quote\",\"symbol\":\"%s\",\"bid\":\"%08.2f\",\"ask\":\"%08.2f\",\"bidSize\":%06d,\"askSize\":%06d,\"ts\":%016lld}\n",
+            kSymbols[seq % 7], 100 + (seq % 997) * 0.37, 100.01 + (seq % 997) * 0.37,
+            static_cast<int>(seq * 7919 % 1000000), static_cast<int>(seq * 104729 % 1000000),
+            static_cast<long long>(1700000000000000LL + seq));
+    return std::string(buf, n);
+}
+
+class CompressBench
+{
+public:
+    CompressBench(EventLoop* loop, const InetAddress& addr, const CompressionContextPtr& ctx,
+                int connections, int batch, int serverThreads)
+        :server_(loop, addr, "CompressServer"),
+        messageBytes_(makeQuote(0).size()),
+        batch_(batch),
+        messages_(0),
+        plainBytes_(0),
+        wireBytes_(0)
+    {
+        server_.setMessageCallback([](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+            conn->send(buf);
+        });
+        server_.setThreadNum(serverThreads);
+        if(ctx)
+        {
+            server_.setCompressionContext(ctx);
+        }
+        for(int i = 0; i < connections; i++)
+        {
+            char name[32];
+            snprintf(name, sizeof name, "client%d", i);
+            TcpClient* client = new TcpClient(loop, addr, name);
+            if(ctx)
+            {
+                client->setCompressionContext(ctx);
+            }
+            client->setConnectionCallback([this](const TcpConnectionPtr& conn) {
+                if(conn->connected())
+                {
+                    conn->setTcpNoDelay(true);
+                    sendBatch(conn);
+                }
+                else if(conn->compressionStats())
+                {
+                    plainBytes_ += conn->compressionStats()->plainBytesSent;
+                    wireBytes_ += conn->compressionStats()->compressedBytesSent;
+                }
+            });
+            client->setMessageCallback(std::bind(&CompressBench::onMessage, this,
+                                        std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+            clients_.emplace_back(client);
+        }
+    }
+
+    void start()
+    {
+        server_.start();
+        for(auto& client : clients_)
+        {
+            client->connect();
+        }
+    }
+
+    // 在loop线程中调用，汇总还连着的客户端的统计
+    void collect()
+    {
+        for(auto& client : clients_)
+        {
+            TcpConnectionPtr conn = client->connection();
+            if(conn && conn->compressionStats())
+            {
+                plainBytes_ += conn->compressionStats()->plainBytesSent;
+                wireBytes_ += conn->compressionStats()->compressedBytesSent;
+            }
+        }
+    }
+
+    int64_t messages() const { return messages_; }
+    int64_t plainBytes() const { return plainBytes_; }
+    int64_t wireBytes() const { return wireBytes_; }
+
+private:
+    void sendBatch(const TcpConnectionPtr& conn)
+    {
+        // 一批消息攒在一起send，压缩层一次sync flush
+        static thread_local Buffer output;
+        for(int i = 0; i < batch_; i++)
+        {
+            output.append(makeQuote(seq_++));
+        }
+        conn->send(&output);
+    }
+
+    void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+    {
+        size_t batchBytes = messageBytes_ * batch_;
+        while(buf->readableBytes() >= batchBytes)
+        {
+            buf->retrieve(batchBytes);
+            messages_ += batch_;
+            sendBatch(conn);
+        }
+    }
+
+    TcpServer server_;
+    size_t messageBytes_;
+    int batch_;
+    int64_t seq_ = 0;
+    int64_t messages_;
+    int64_t plainBytes_;
+    int64_t wireBytes_;
+    std::vector<std::unique_ptr<TcpClient>> clients_;
+};
+
+static void run(const char* label, uint16_t port, const CompressionContextPtr& ctx,
+                int connections, int batch, double seconds, int serverThreads)
+{
+    EventLoop loop;
+    CompressBench bench(&loop, InetAddress(port), ctx, connections, batch, serverThreads);
+    bench.start();
+    Timestamp start(Timestamp::now());
+    loop.runAfter(seconds, [&]() {
+        double elapsed = timeDifference(Timestamp::now(), start);
+        bench.collect();
+        double ratio = bench.plainBytes() > 0 ? static_cast<double>(bench.wireBytes()) / bench.plainBytes() : 1.0;
+        printf("mode=%-10s connections=%d batch=%d msgs/s=%.0f wire/plain=%.3f\n",
+                label, connections, batch, bench.messages() / elapsed, ratio);
+        fflush(stdout);
+        loop.quit();
+    });
+    loop.loop();
+}
+
+int main(int argc, char** argv)
+{
+    int connections = argc > 1 ? atoi(argv[1]) : 16;
+    int batch = argc > 2 ? atoi(argv[2]) : 1;
+    double seconds = argc > 3 ? atof(argv[3]) : 3.0;
+    int serverThreads = argc > 4 ? atoi(argv[4]) : 2;
+
+    CompressionOptions fast;
+    fast.level = 1;
+    CompressionOptions normal;
+    CompressionOptions withDict;
+    withDict.dictionary = kDictionary;
+
+    run("none", 8200, nullptr, connections, batch, seconds, serverThreads);
+    run("level1", 8201, CompressionContext::create(fast), connections, batch, seconds, serverThreads);
+    run("level6", 8202, CompressionContext::create(normal), connections, batch, seconds, serverThreads);
+    run("level6+dict", 8203, CompressionContext::create(withDict), connections, batch, seconds, serverThreads);
+    return 0;
+}
@@ -0,0 +1,71 @@
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/Coroutine.h>
+#include <mymuduo/Logger.h>
+
+#include <string>
+#include <stdlib.h>
+
+// 协程写的行协议服务器，每条连接一个协程，没有手写的状态机：
+//   PING\r\n            -> +PONG\r\n
+//   PUT <n>\r\n<n字节>   -> +OK <n个字节的校验和>\r\n
+//   SLEEP <ms>\r\n      -> 等待ms毫秒之后 +AWAKE\r\n
+//   QUIT\r\n            -> 关闭连接
+// 连接空闲30秒自动关闭
+// 测试：printf 'PING\r\nPUT 5\r\nhelloSLEEP 100\r\nQUIT\r\n' | nc 127.0.0.1 8500
+
+static const double kIdleSeconds = 30.0;
+
+static Task<> session(CoConnectionPtr c)
+{
+    while(auto line = co_await c->readUntil("\r\n", kIdleSeconds, 4096))
+    {
+        std::string_view cmd = line->substr(0, line->size() - 2);
+        if(cmd == "PING")
+        {
+            co_await c->write("+PONG\r\n");
+        }
+        else if(cmd.substr(0, 4) == "PUT ")
+        {
+            size_t n = strtoul(std::string(cmd.substr(4)).c_str(), nullptr, 10);
+            auto body = co_await c->readExactly(n, kIdleSeconds);
+            if(!body)
+            {
+                break;
+            }
+            unsigned sum = 0;
+            for(char ch : *body)
+            {
+                sum = sum * 31 + static_cast<unsigned char>(ch);
+            }
+            co_await c->write("+OK " + std::to_string(sum) + "\r\n");
+        }
+        else if(cmd.substr(0, 6) == "SLEEP ")
+        {
+            co_await c->sleep(atoi(std::string(cmd.substr(6)).c_str()) / 1000.0);
+            co_await c->write("+AWAKE\r\n");
+        }
+        else if(cmd == "QUIT")
+        {
+            break;
+        }
+        else
+        {
+            co_await c->write("-ERR unknown command\r\n");
+        }
+    }
+    if(c->timedOut())
+    {
+        LOG_INFO("%s idle timeout \n", c->connection()->peerAddress().toIpPort().c_str());
+    }
+}
+
+int main()
+{
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(8500), "CoroutineServer");
+    CoConnection::serve(&server, session);
+    server.setThreadNum(2);
+    server.start();
+    loop.loop();
+    return 0;
+}
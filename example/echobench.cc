@@ -0,0 +1,110 @@
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/TcpClient.h>
+#include <mymuduo/Logger.h>
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// echo乒乓压测，依次比较回环TCP（IPv4/IPv6）和unix domain socket（文件路径/抽象命名空间）
+// 每种地址起一个echo服务器（serverThreads个subLoop），主loop上用connections条连接，
+// 每条连接上始终有一个messageBytes字节的消息在来回传
+// 用法：echobench [connections] [messageBytes] [seconds] [serverThreads]
+
+class EchoBench
+{
+public:
+    EchoBench(EventLoop* loop, const InetAddress& addr, int connections, int messageBytes, int serverThreads)
+        :server_(loop, addr, "EchoServer"),
+        message_(messageBytes, 'x'),
+        bytes_(0),
+        messages_(0)
+    {
+        server_.setMessageCallback([](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+            conn->send(buf);
+        });
+        server_.setThreadNum(serverThreads);
+        for(int i = 0; i < connections; i++)
+        {
+            char name[32];
+            snprintf(name, sizeof name, "client%d", i);
+            TcpClient* client = new TcpClient(loop, addr, name);
+            client->setConnectionCallback([this](const TcpConnectionPtr& conn) {
+                if(conn->connected())
+                {
+                    conn->setTcpNoDelay(true);
+                    conn->send(message_);
+                }
+            });
+            client->setMessageCallback(std::bind(&EchoBench::onMessage, this,
+                                        std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+            clients_.emplace_back(client);
+        }
+    }
+
+    void start()
+    {
+        server_.start();
+        for(auto& client : clients_)
+        {
+            client->connect();
+        }
+    }
+
+    int64_t bytes() const { return bytes_; }
+    int64_t messages() const { return messages_; }
+
+private:
+    // 收满一个完整的消息再发下一个
+    void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+    {
+        while(buf->readableBytes() >= message_.size())
+        {
+            buf->retrieve(message_.size());
+            bytes_ += message_.size();
+            ++messages_;
+            conn->send(message_);
+        }
+    }
+
+    TcpServer server_;
+    std::string message_;
+    int64_t bytes_;
+    int64_t messages_;
+    std::vector<std::unique_ptr<TcpClient>> clients_;
+};
+
+static void run(const char* label, const InetAddress& addr, int connections, int messageBytes, double seconds, int serverThreads)
+{
+    EventLoop loop;
+    EchoBench bench(&loop, addr, connections, messageBytes, serverThreads);
+    bench.start();
+    Timestamp start(Timestamp::now());
+    loop.runAfter(seconds, [&]() {
+        double elapsed = timeDifference(Timestamp::now(), start);
+        printf("transport=%-8s address=%-20s connections=%d message=%d msgs/s=%.0f MiB/s=%.1f\n",
+                label, addr.toIpPort().c_str(), connections, messageBytes,
+                bench.messages() / elapsed, bench.bytes() / elapsed / (1024 * 1024));
+        fflush(stdout);
+        loop.quit();
+    });
+    loop.loop();
+}
+
+int main(int argc, char** argv)
+{
+    int connections = argc > 1 ? atoi(argv[1]) : 16;
+    int messageBytes = argc > 2 ? atoi(argv[2]) : 64;
+    double seconds = argc > 3 ? atof(argv[3]) : 3.0;
+    int serverThreads = argc > 4 ? atoi(argv[4]) : 2;
+
+    run("tcp", InetAddress(8100), connections, messageBytes, seconds, serverThreads);
+    run("tcp6", InetAddress(8101, "::1"), connections, messageBytes, seconds, serverThreads);
+    run("unix", InetAddress::fromUnixPath("/tmp/mymuduo-echobench.sock"), connections, messageBytes, seconds, serverThreads);
+    run("abstract", InetAddress::fromUnixPath("@mymuduo-echobench"), connections, messageBytes, seconds, serverThreads);
+
+    return 0;
+}
@@ -0,0 +1,142 @@
+#include <mymuduo/HttpServer.h>
+#include <mymuduo/HttpRequest.h>
+#include <mymuduo/HttpResponse.h>
+#include <mymuduo/TcpClient.h>
+#include <mymuduo/Logger.h>
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// http压测：同一个进程里起HttpServer（serverThreads个subLoop），
+// 主loop上用connections条长连接在回环地址上压测，每条连接同时有pipeline个请求在路上
+// 用法：httpbench [connections] [pipeline] [seconds] [serverThreads]
+
+static const char kRequest[] = "GET /hello HTTP/1.1\r\nHost: localhost\r\n\r\n";
+
+void onRequest(const HttpRequest& req, HttpResponse* resp)
+{
+    resp->setStatusCode(HttpResponse::k200Ok);
+    resp->setStatusMessage("OK");
+    resp->setContentType("text/plain");
+    resp->setBody("hello, world!\n");
+}
+
+class LoadGenerator
+{
+public:
+    LoadGenerator(EventLoop* loop, const InetAddress& addr, int connections, int pipeline)
+        :loop_(loop),
+        pipeline_(pipeline),
+        responses_(0)
+    {
+        for(int i = 0; i < connections; i++)
+        {
+            char name[32];
+            snprintf(name, sizeof name, "client%d", i);
+            TcpClient* client = new TcpClient(loop, addr, name);
+            client->setConnectionCallback(std::bind(&LoadGenerator::onConnection, this, std::placeholders::_1));
+            client->setMessageCallback(std::bind(&LoadGenerator::onMessage, this,
+                                        std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+            clients_.emplace_back(client);
+        }
+    }
+
+    void start()
+    {
+        for(auto& client : clients_)
+        {
+            client->connect();
+        }
+    }
+
+    int64_t responses() const { return responses_; }
+
+private:
+    void onConnection(const TcpConnectionPtr& conn)
+    {
+        if(conn->connected())
+        {
+            std::string requests;
+            for(int i = 0; i < pipeline_; i++)
+            {
+                requests.append(kRequest, sizeof kRequest - 1);
+            }
+            conn->send(requests);
+        }
+    }
+
+    // 只解析Content-Length，够压测用了
+    void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+    {
+        int completed = 0;
+        while(true)
+        {
+            const char* begin = buf->peek();
+            const char* end = begin + buf->readableBytes();
+            const char* headerEnd = static_cast<const char*>(memmem(begin, end - begin, "\r\n\r\n", 4));
+            if(headerEnd == nullptr)
+            {
+                break;
+            }
+            const char* length = static_cast<const char*>(memmem(begin, headerEnd - begin, "Content-Length: ", 16));
+            size_t bodyLen = length ? strtoul(length + 16, nullptr, 10) : 0;
+            size_t total = headerEnd + 4 - begin + bodyLen;
+            if(buf->readableBytes() < total)
+            {
+                break;
+            }
+            buf->retrieve(total);
+            ++completed;
+        }
+        responses_ += completed;
+
+        std::string requests;
+        for(int i = 0; i < completed; i++)
+        {
+            requests.append(kRequest, sizeof kRequest - 1);
+        }
+        if(!requests.empty())
+        {
+            conn->send(requests);
+        }
+    }
+
+    EventLoop* loop_;
+    int pipeline_;
+    int64_t responses_;
+    std::vector<std::unique_ptr<TcpClient>> clients_;
+};
+
+int main(int argc, char** argv)
+{
+    int connections = argc > 1 ? atoi(argv[1]) : 16;
+    int pipeline = argc > 2 ? atoi(argv[2]) : 8;
+    double seconds = argc > 3 ? atof(argv[3]) : 5.0;
+    int serverThreads = argc > 4 ? atoi(argv[4]) : 2;
+
+    EventLoop loop;
+    InetAddress addr(8080);
+    HttpServer server(&loop, addr, "HttpBench");
+    server.setHttpCallback(onRequest);
+    server.setThreadNum(serverThreads);
+    server.start();
+
+    LoadGenerator generator(&loop, addr, connections, pipeline);
+    generator.start();
+
+    Timestamp start(Timestamp::now());
+    loop.runAfter(seconds, [&]() {
+        double elapsed = timeDifference(Timestamp::now(), start);
+        printf("connections=%d pipeline=%d serverThreads=%d requests=%ld seconds=%.2f qps=%.0f\n",
+                connections, pipeline, serverThreads, generator.responses(), elapsed,
+                generator.responses() / elapsed);
+        loop.quit();
+    });
+    loop.loop();
+
+    return 0;
+}
@@ -0,0 +1,45 @@
+#include <mymuduo/HttpServer.h>
+#include <mymuduo/HttpRequest.h>
+#include <mymuduo/HttpResponse.h>
+#include <mymuduo/Logger.h>
+
+#include <string>
+#include <stdlib.h>
+
+// 简单的http服务器：/hello 返回固定内容，/echo 把请求体原样返回
+void onRequest(const HttpRequest& req, HttpResponse* resp)
+{
+    if(req.path() == "/hello")
+    {
+        resp->setStatusCode(HttpResponse::k200Ok);
+        resp->setStatusMessage("OK");
+        resp->setContentType("text/plain");
+        resp->setBody("hello, world!\n");
+    }
+    else if(req.path() == "/echo")
+    {
+        resp->setStatusCode(HttpResponse::k200Ok);
+        resp->setStatusMessage("OK");
+        resp->setContentType("application/octet-stream");
+        resp->setBody(std::string(req.body()));
+    }
+    else
+    {
+        resp->setStatusCode(HttpResponse::k404NotFound);
+        resp->setStatusMessage("Not Found");
+        resp->setCloseConnection(true);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int numThreads = argc > 1 ? atoi(argv[1]) : 0;
+    EventLoop loop;
+    HttpServer server(&loop, InetAddress(8000), "HttpServer");
+    server.setHttpCallback(onRequest);
+    server.setThreadNum(numThreads);
+    server.start();
+    loop.loop();
+
+    return 0;
+}
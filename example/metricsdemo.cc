@@ -0,0 +1,25 @@
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/MetricsServer.h>
+#include <mymuduo/Logger.h>
+
+#include <stdlib.h>
+
+// 回显服务器 + 指标出口：业务监听8950，指标在127.0.0.1:9100/metrics，Prometheus直接抓这个地址
+// 用法：metricsdemo [ioThreads]
+// 测试：curl -s 127.0.0.1:9100/metrics | grep mymuduo_loop_read_bytes_total
+
+int main(int argc, char** argv)
+{
+    int ioThreads = argc > 1 ? atoi(argv[1]) : 2;
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(8950, "0.0.0.0"), "EchoServer");
+    server.setMessageCallback([](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) { conn->send(buf); });
+    server.setThreadNum(ioThreads);
+    server.start();
+
+    MetricsServer metrics(&loop, InetAddress(9100), "MetricsServer");
+    metrics.start();
+
+    loop.loop();
+    return 0;
+}
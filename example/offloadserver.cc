@@ -0,0 +1,92 @@
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/ThreadPool.h>
+#include <mymuduo/Logger.h>
+
+#include <string>
+#include <stdlib.h>
+
+// 把耗CPU的工作从IO线程挪到计算线程池：
+//   HASH <rounds> <data>\r\n  -> 对data做rounds轮FNV-1a，回复 +<结果>\r\n
+// 每条连接一个SerialExecutor，同一条连接上的请求按顺序计算、按顺序回复，不同连接并行计算；
+// 计算结果批量送回连接所在的loop，IO线程只负责收发
+// 用法：offloadserver [ioThreads] [computeThreads]
+// 测试：printf 'HASH 1000000 a\r\nHASH 1 b\r\n' | nc 127.0.0.1 8700
+
+static uint64_t fnvRounds(const std::string& data, long rounds)
+{
+    uint64_t h = 1469598103934665603ULL;
+    for(long r = 0; r < rounds; r++)
+    {
+        for(char ch : data)
+        {
+            h ^= static_cast<unsigned char>(ch);
+            h *= 1099511628211ULL;
+        }
+    }
+    return h;
+}
+
+class OffloadServer
+{
+public:
+    OffloadServer(EventLoop* loop, const InetAddress& addr, int ioThreads, int computeThreads)
+        :server_(loop, addr, "OffloadServer")
+    {
+        pool_.setThreadNum(computeThreads);
+        pool_.start();
+        server_.setConnectionCallback([this](const TcpConnectionPtr& conn) {
+            if(conn->connected())
+            {
+                conn->setContext(std::make_shared<SerialExecutor>(&pool_, conn));
+            }
+        });
+        server_.setMessageCallback(std::bind(&OffloadServer::onMessage, this,
+                                    std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+        // 退休的subLoop销毁之前删掉它的结果队列
+        server_.setLoopRetiredCallback([this](EventLoop* loop) { pool_.removeLoop(loop); });
+        server_.setThreadNum(ioThreads);
+    }
+
+    void start() { server_.start(); }
+
+private:
+    void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+    {
+        const SerialExecutorPtr& executor = std::any_cast<const SerialExecutorPtr&>(conn->getContext());
+        while(const char* crlf = buf->findCRLF())
+        {
+            std::string line(buf->peek(), crlf);
+            buf->retrieve(crlf + 2 - buf->peek());
+            if(line.compare(0, 5, "HASH ") != 0)
+            {
+                // 之前的请求还在计算时，错误回复也要排队，保证回复的顺序
+                executor->submit([]() {}, [conn]() { conn->send("-ERR unknown command\r\n"); });
+                continue;
+            }
+            char* end = nullptr;
+            long rounds = strtol(line.c_str() + 5, &end, 10);
+            std::string data(*end == ' ' ? end + 1 : end);
+            executor->submit([data, rounds]() { return fnvRounds(data, rounds); },
+                            [conn](uint64_t h) {
+                                if(conn->connected())
+                                {
+                                    conn->send("+" + std::to_string(h) + "\r\n");
+                                }
+                            });
+        }
+    }
+
+    ThreadPool pool_;   //比server_先构造后析构，析构时等计算完成
+    TcpServer server_;
+};
+
+int main(int argc, char** argv)
+{
+    int ioThreads = argc > 1 ? atoi(argv[1]) : 2;
+    int computeThreads = argc > 2 ? atoi(argv[2]) : 4;
+    EventLoop loop;
+    OffloadServer server(&loop, InetAddress(8700), ioThreads, computeThreads);
+    server.start();
+    loop.loop();
+    return 0;
+}
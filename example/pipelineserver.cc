@@ -0,0 +1,167 @@
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/Pipeline.h>
+#include <mymuduo/Logger.h>
+
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// 用Pipeline搭的一个简单kv服务器，三个阶段：
+//   LineCodec       Buffer* -> 一行（string_view，指向输入缓冲区）         出站：string_view -> 加\r\n
+//   CommandDecoder  一行 -> Command（几个string_view，还是不拷贝）         出站：Reply直接编码进输出缓冲区
+//   KvHandler       处理Command，写回Reply
+//   SET k v / GET k / DEL k / QUIT
+// 测试：printf 'SET a 1\r\nGET a\r\nDEL a\r\nGET a\r\nQUIT\r\n' | nc 127.0.0.1 8600
+
+struct Command
+{
+    std::string_view op;
+    std::string_view key;
+    std::string_view value;
+};
+
+struct Reply
+{
+    bool ok;
+    std::string_view value;
+};
+
+class KvStore
+{
+public:
+    void set(std::string_view key, std::string_view value)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        map_[std::string(key)] = std::string(value);
+    }
+
+    bool get(std::string_view key, std::string* value)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = map_.find(std::string(key));
+        if(it == map_.end())
+        {
+            return false;
+        }
+        *value = it->second;
+        return true;
+    }
+
+    bool del(std::string_view key)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return map_.erase(std::string(key)) > 0;
+    }
+
+private:
+    std::mutex mutex_;
+    std::unordered_map<std::string, std::string> map_;
+};
+
+class CommandDecoder
+{
+public:
+    template<typename Ctx>
+    void onRead(Ctx& ctx, std::string_view line)
+    {
+        Command cmd;
+        cmd.op = next(&line);
+        cmd.key = next(&line);
+        cmd.value = line;
+        ctx.fireRead(cmd);
+    }
+
+    // 不经过LineCodec，直接写进链头的输出缓冲区
+    template<typename Ctx>
+    void onWrite(Ctx& ctx, const Reply& reply)
+    {
+        Buffer* out = ctx.outputBuffer();
+        if(reply.ok)
+        {
+            out->append("+", 1);
+            out->append(reply.value.data(), reply.value.size());
+        }
+        else
+        {
+            out->append("-", 1);
+            out->append(reply.value.data(), reply.value.size());
+        }
+        out->append("\r\n", 2);
+    }
+
+private:
+    static std::string_view next(std::string_view* line)
+    {
+        size_t space = line->find(' ');
+        std::string_view word = line->substr(0, space);
+        line->remove_prefix(space == std::string_view::npos ? line->size() : space + 1);
+        return word;
+    }
+};
+
+class KvHandler
+{
+public:
+    explicit KvHandler(KvStore* store) : store_(store) {}
+
+    template<typename Ctx>
+    void onConnected(Ctx& ctx)
+    {
+        ctx.write(std::string_view("+READY"));
+    }
+
+    template<typename Ctx>
+    void onRead(Ctx& ctx, const Command& cmd)
+    {
+        if(cmd.op == "SET" && !cmd.key.empty())
+        {
+            store_->set(cmd.key, cmd.value);
+            ctx.write(Reply{true, "OK"});
+        }
+        else if(cmd.op == "GET" && !cmd.key.empty())
+        {
+            if(store_->get(cmd.key, &value_))
+            {
+                ctx.write(Reply{true, value_});
+            }
+            else
+            {
+                ctx.write(Reply{false, "NOTFOUND"});
+            }
+        }
+        else if(cmd.op == "DEL" && !cmd.key.empty())
+        {
+            ctx.write(store_->del(cmd.key) ? Reply{true, "OK"} : Reply{false, "NOTFOUND"});
+        }
+        else if(cmd.op == "QUIT")
+        {
+            ctx.flush();
+            ctx.connection()->shutdown();
+        }
+        else
+        {
+            ctx.write(Reply{false, "ERR unknown command"});
+        }
+    }
+
+private:
+    KvStore* store_;
+    std::string value_;     //GET的结果，Reply只持有视图
+};
+
+using KvPipeline = Pipeline<LineCodec, CommandDecoder, KvHandler>;
+
+int main()
+{
+    EventLoop loop;
+    KvStore store;
+    TcpServer server(&loop, InetAddress(8600), "PipelineServer");
+    installPipeline<KvPipeline>(&server, [&store](const TcpConnectionPtr& conn) {
+        return std::make_shared<KvPipeline>(conn, LineCodec(4096), CommandDecoder(), KvHandler(&store));
+    });
+    server.setThreadNum(2);
+    server.start();
+    loop.loop();
+    return 0;
+}
@@ -0,0 +1,153 @@
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/TcpClient.h>
+#include <mymuduo/Logger.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+
+// 连接迁移的演示：服务器2个subLoop，轮询分配连接，偶数号连接是重连接（不停地回显、每条消息还要算一会儿），
+// 奇数号连接基本空闲，于是所有重连接都落在同一个loop上。打开自动均衡之后，重连接会被逐步迁移到另一个loop
+// 客户端校验回显的每一个字节，迁移过程中数据不能丢也不能乱
+// 用法：rebalancedemo [connections] [seconds] [rebalance(0/1)]
+
+static const size_t kMessageBytes = 4096;
+
+// 每条消息都要做的一点计算，让loop真的忙起来
+static void burnCpu(const Buffer* buf)
+{
+    volatile unsigned sum = 0;
+    for(int round = 0; round < 8; round++)
+    {
+        for(size_t i = 0; i < buf->readableBytes(); i++)
+        {
+            sum = sum * 31 + static_cast<unsigned char>(buf->peek()[i]);
+        }
+    }
+}
+
+class RebalanceDemo
+{
+public:
+    RebalanceDemo(EventLoop* loop, const InetAddress& addr, int connections, bool rebalance)
+        :server_(loop, addr, "RebalanceServer"),
+        errors_(0),
+        echoedBytes_(0)
+    {
+        server_.setThreadNum(2);
+        if(rebalance)
+        {
+            server_.setRebalance(0.5, 0.2);
+        }
+        server_.setConnectionMigratedCallback([](const TcpConnectionPtr& conn) {
+            LOG_INFO("%s migrated to loop %p \n", conn->name().c_str(), conn->getLoop());
+        });
+        server_.setMessageCallback([](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+            burnCpu(buf);
+            conn->send(buf);
+        });
+        for(int i = 0; i < connections; i++)
+        {
+            char name[32];
+            snprintf(name, sizeof name, "client%d", i);
+            TcpClient* client = new TcpClient(loop, addr, name);
+            bool heavy = i % 2 == 0;
+            client->setConnectionCallback([this, heavy](const TcpConnectionPtr& conn) {
+                if(conn->connected())
+                {
+                    conn->setContext(std::make_shared<ClientState>());
+                    if(heavy)
+                    {
+                        sendMessage(conn);
+                    }
+                }
+            });
+            client->setMessageCallback(std::bind(&RebalanceDemo::onMessage, this,
+                                        std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+            clients_.emplace_back(client);
+        }
+    }
+
+    void start()
+    {
+        server_.start();
+        for(auto& client : clients_)
+        {
+            client->connect();
+        }
+    }
+
+    int64_t errors() const { return errors_; }
+    int64_t echoedBytes() const { return echoedBytes_; }
+    int64_t migrations() const { return server_.numMigrations(); }
+
+private:
+    // 客户端发出去的第seq个字节是seq % 251，回显回来逐字节校验
+    struct ClientState
+    {
+        uint64_t sent = 0;
+        uint64_t received = 0;
+    };
+    using ClientStatePtr = std::shared_ptr<ClientState>;
+
+    void sendMessage(const TcpConnectionPtr& conn)
+    {
+        ClientStatePtr state = std::any_cast<ClientStatePtr>(conn->getContext());
+        std::string message(kMessageBytes, '\0');
+        for(size_t i = 0; i < kMessageBytes; i++)
+        {
+            message[i] = static_cast<char>((state->sent + i) % 251);
+        }
+        state->sent += kMessageBytes;
+        conn->send(message);
+    }
+
+    void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+    {
+        ClientStatePtr state = std::any_cast<ClientStatePtr>(conn->getContext());
+        const char* data = buf->peek();
+        for(size_t i = 0; i < buf->readableBytes(); i++)
+        {
+            if(static_cast<unsigned char>(data[i]) != (state->received + i) % 251)
+            {
+                ++errors_;
+                break;
+            }
+        }
+        state->received += buf->readableBytes();
+        echoedBytes_ += buf->readableBytes();
+        buf->retrieveAll();
+        // 一条消息全部回来之后再发下一条
+        if(state->received == state->sent)
+        {
+            sendMessage(conn);
+        }
+    }
+
+    TcpServer server_;
+    int64_t errors_;
+    int64_t echoedBytes_;
+    std::vector<std::unique_ptr<TcpClient>> clients_;
+};
+
+int main(int argc, char** argv)
+{
+    int connections = argc > 1 ? atoi(argv[1]) : 8;
+    double seconds = argc > 2 ? atof(argv[2]) : 5.0;
+    bool rebalance = argc > 3 ? atoi(argv[3]) != 0 : true;
+
+    EventLoop loop;
+    RebalanceDemo demo(&loop, InetAddress(8800), connections, rebalance);
+    demo.start();
+    loop.runAfter(seconds, [&]() {
+        printf("rebalance=%d migrations=%ld echoed MiB/s=%.1f errors=%ld\n", rebalance,
+                demo.migrations(), demo.echoedBytes() / seconds / 1024 / 1024, demo.errors());
+        fflush(stdout);
+        loop.quit();
+    });
+    loop.loop();
+    return 0;
+}
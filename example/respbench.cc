@@ -0,0 +1,159 @@
+#include <mymuduo/RespServer.h>
+#include <mymuduo/RespCommand.h>
+#include <mymuduo/RespReply.h>
+#include <mymuduo/TcpClient.h>
+#include <mymuduo/Buffer.h>
+#include <mymuduo/Logger.h>
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// redis协议压测，发的命令和redis-benchmark -t set,get -d 3 一样：SET key:__rand_int__ xxx / GET key:__rand_int__
+// 同一个进程里起RespServer（serverThreads个subLoop），主loop上用connections条长连接压测，
+// 每条连接同时有pipeline条命令在路上，对应redis-benchmark的-P
+// 用法：respbench [connections] [pipeline] [seconds] [serverThreads]
+
+static const char kSet[] = "*3\r\n$3\r\nSET\r\n$16\r\nkey:000000000001\r\n$3\r\nxxx\r\n";
+static const char kGet[] = "*2\r\n$3\r\nGET\r\n$16\r\nkey:000000000001\r\n";
+
+// 服务端只存一个值，测的是协议解析和收发，不是kv
+void onSet(const TcpConnectionPtr&, const RespCommand&, Buffer* output)
+{
+    output->append(RespReply::kOk.data(), RespReply::kOk.size());
+}
+
+void onGet(const TcpConnectionPtr&, const RespCommand&, Buffer* output)
+{
+    RespReply::appendBulkString(output, "xxx");
+}
+
+class LoadGenerator
+{
+public:
+    LoadGenerator(EventLoop* loop, const InetAddress& addr, int connections, int pipeline)
+        :loop_(loop),
+        pipeline_(pipeline),
+        replies_(0)
+    {
+        for(int i = 0; i < connections; i++)
+        {
+            char name[32];
+            snprintf(name, sizeof name, "client%d", i);
+            TcpClient* client = new TcpClient(loop, addr, name);
+            client->setConnectionCallback(std::bind(&LoadGenerator::onConnection, this, std::placeholders::_1));
+            client->setMessageCallback(std::bind(&LoadGenerator::onMessage, this,
+                                        std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+            clients_.emplace_back(client);
+        }
+    }
+
+    void start()
+    {
+        for(auto& client : clients_)
+        {
+            client->connect();
+        }
+    }
+
+    int64_t replies() const { return replies_; }
+
+private:
+    void appendCommands(std::string* commands, int count)
+    {
+        for(int i = 0; i < count; i++)
+        {
+            // SET和GET各一半
+            if(i % 2 == 0)
+            {
+                commands->append(kSet, sizeof kSet - 1);
+            }
+            else
+            {
+                commands->append(kGet, sizeof kGet - 1);
+            }
+        }
+    }
+
+    void onConnection(const TcpConnectionPtr& conn)
+    {
+        if(conn->connected())
+        {
+            std::string commands;
+            appendCommands(&commands, pipeline_);
+            conn->send(commands);
+        }
+    }
+
+    // 只需要认出+OK和$3\r\nxxx这两种回复
+    void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+    {
+        int completed = 0;
+        while(true)
+        {
+            const char* crlf = buf->findCRLF();
+            if(crlf == nullptr)
+            {
+                break;
+            }
+            size_t total = crlf + 2 - buf->peek();
+            if(buf->peek()[0] == '$')
+            {
+                total += strtol(buf->peek() + 1, nullptr, 10) + 2;
+            }
+            if(buf->readableBytes() < total)
+            {
+                break;
+            }
+            buf->retrieve(total);
+            ++completed;
+        }
+        replies_ += completed;
+
+        std::string commands;
+        appendCommands(&commands, completed);
+        if(!commands.empty())
+        {
+            conn->send(commands);
+        }
+    }
+
+    EventLoop* loop_;
+    int pipeline_;
+    int64_t replies_;
+    std::vector<std::unique_ptr<TcpClient>> clients_;
+};
+
+int main(int argc, char** argv)
+{
+    int connections = argc > 1 ? atoi(argv[1]) : 50;
+    int pipeline = argc > 2 ? atoi(argv[2]) : 16;
+    double seconds = argc > 3 ? atof(argv[3]) : 5.0;
+    int serverThreads = argc > 4 ? atoi(argv[4]) : 2;
+
+    EventLoop loop;
+    InetAddress addr(6381);
+    RespServer server(&loop, addr, "RespBench");
+    server.registerCommand("set", onSet);
+    server.registerCommand("get", onGet);
+    server.setThreadNum(serverThreads);
+    server.start();
+
+    LoadGenerator generator(&loop, addr, connections, pipeline);
+    generator.start();
+
+    Timestamp start(Timestamp::now());
+    loop.runAfter(seconds, [&]() {
+        double elapsed = timeDifference(Timestamp::now(), start);
+        printf("connections=%d pipeline=%d serverThreads=%d requests=%ld seconds=%.2f qps=%.0f\n",
+                connections, pipeline, serverThreads, generator.replies(), elapsed,
+                generator.replies() / elapsed);
+        loop.quit();
+    });
+    loop.loop();
+
+    return 0;
+}
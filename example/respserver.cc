@@ -0,0 +1,177 @@
+#include <mymuduo/RespServer.h>
+#include <mymuduo/RespCommand.h>
+#include <mymuduo/RespReply.h>
+#include <mymuduo/Buffer.h>
+#include <mymuduo/Logger.h>
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <functional>
+#include <stdlib.h>
+
+// 内存kv服务器，支持redis-benchmark -t ping,set,get,incr,mset 用到的命令
+// 用法：respserver [threads]，然后 redis-benchmark -p 6380 -t ping,set,get -P 16
+class KvStore
+{
+public:
+    void set(std::string_view key, std::string_view value)
+    {
+        Shard& shard = shardOf(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.map[std::string(key)].assign(value.data(), value.size());
+    }
+
+    // 找到时在锁内把值写进output，不拷贝出来
+    bool get(std::string_view key, Buffer* output)
+    {
+        Shard& shard = shardOf(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.map.find(std::string(key));
+        if(it == shard.map.end())
+        {
+            return false;
+        }
+        RespReply::appendBulkString(output, it->second);
+        return true;
+    }
+
+    int del(std::string_view key)
+    {
+        Shard& shard = shardOf(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        return static_cast<int>(shard.map.erase(std::string(key)));
+    }
+
+    bool incr(std::string_view key, int64_t* value)
+    {
+        Shard& shard = shardOf(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        std::string& str = shard.map[std::string(key)];
+        char* end = nullptr;
+        long long n = str.empty() ? 0 : ::strtoll(str.c_str(), &end, 10);
+        if(!str.empty() && *end != '\0')
+        {
+            return false;
+        }
+        *value = n + 1;
+        str = std::to_string(*value);
+        return true;
+    }
+
+private:
+    static const int kShards = 64;
+    struct Shard
+    {
+        std::mutex mutex;
+        std::unordered_map<std::string, std::string> map;
+    };
+
+    Shard& shardOf(std::string_view key) { return shards_[std::hash<std::string_view>()(key) % kShards]; }
+
+    Shard shards_[kShards];
+};
+
+KvStore store;
+
+void onPing(const TcpConnectionPtr&, const RespCommand& cmd, Buffer* output)
+{
+    if(cmd.argc() > 1)
+    {
+        RespReply::appendBulkString(output, cmd.arg(1));
+    }
+    else
+    {
+        output->append(RespReply::kPong.data(), RespReply::kPong.size());
+    }
+}
+
+void onSet(const TcpConnectionPtr&, const RespCommand& cmd, Buffer* output)
+{
+    if(cmd.argc() < 3)
+    {
+        RespReply::appendError(output, "ERR wrong number of arguments for 'set' command");
+        return;
+    }
+    store.set(cmd.arg(1), cmd.arg(2));
+    output->append(RespReply::kOk.data(), RespReply::kOk.size());
+}
+
+void onGet(const TcpConnectionPtr&, const RespCommand& cmd, Buffer* output)
+{
+    if(cmd.argc() != 2)
+    {
+        RespReply::appendError(output, "ERR wrong number of arguments for 'get' command");
+        return;
+    }
+    if(!store.get(cmd.arg(1), output))
+    {
+        RespReply::appendNull(output, cmd.protocolVersion());
+    }
+}
+
+void onDel(const TcpConnectionPtr&, const RespCommand& cmd, Buffer* output)
+{
+    int deleted = 0;
+    for(size_t i = 1; i < cmd.argc(); i++)
+    {
+        deleted += store.del(cmd.arg(i));
+    }
+    RespReply::appendInteger(output, deleted);
+}
+
+void onIncr(const TcpConnectionPtr&, const RespCommand& cmd, Buffer* output)
+{
+    int64_t value;
+    if(cmd.argc() != 2)
+    {
+        RespReply::appendError(output, "ERR wrong number of arguments for 'incr' command");
+    }
+    else if(!store.incr(cmd.arg(1), &value))
+    {
+        RespReply::appendError(output, "ERR value is not an integer or out of range");
+    }
+    else
+    {
+        RespReply::appendInteger(output, value);
+    }
+}
+
+void onMset(const TcpConnectionPtr&, const RespCommand& cmd, Buffer* output)
+{
+    if(cmd.argc() < 3 || cmd.argc() % 2 == 0)
+    {
+        RespReply::appendError(output, "ERR wrong number of arguments for 'mset' command");
+        return;
+    }
+    for(size_t i = 1; i < cmd.argc(); i += 2)
+    {
+        store.set(cmd.arg(i), cmd.arg(i + 1));
+    }
+    output->append(RespReply::kOk.data(), RespReply::kOk.size());
+}
+
+// redis-benchmark启动时会发CONFIG GET save/appendonly，回一个空的结果就行
+void onConfig(const TcpConnectionPtr&, const RespCommand& cmd, Buffer* output)
+{
+    RespReply::appendMapHeader(output, 0, cmd.protocolVersion());
+}
+
+int main(int argc, char** argv)
+{
+    int numThreads = argc > 1 ? atoi(argv[1]) : 0;
+    EventLoop loop;
+    RespServer server(&loop, InetAddress(6380), "RespServer");
+    server.registerCommand("ping", onPing);
+    server.registerCommand("set", onSet);
+    server.registerCommand("get", onGet);
+    server.registerCommand("del", onDel);
+    server.registerCommand("incr", onIncr);
+    server.registerCommand("mset", onMset);
+    server.registerCommand("config", onConfig);
+    server.setThreadNum(numThreads);
+    server.start();
+    loop.loop();
+
+    return 0;
+}
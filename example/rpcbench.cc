@@ -0,0 +1,133 @@
+#include <mymuduo/RpcServer.h>
+#include <mymuduo/RpcClient.h>
+#include <mymuduo/EventLoopThread.h>
+#include <mymuduo/Logger.h>
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <stdio.h>
+#include <stdlib.h>
+
+// rpc压测：同一个进程里起RpcServer（serverThreads个subLoop），
+// 主loop上用connections个RpcClient，每个客户端的一条连接上同时有depth个请求在路上
+// 方法1是同步的echo，方法2是异步的echo（延迟到下一轮事件循环回复，响应乱序）
+// 用法：rpcbench [connections] [depth] [seconds] [serverThreads] [payloadBytes]
+
+static const uint16_t kEcho = 1;
+static const uint16_t kAsyncEcho = 2;
+
+uint16_t onEcho(const TcpConnectionPtr&, std::string_view request, Buffer* response)
+{
+    response->append(request.data(), request.size());
+    return RpcCodec::kOk;
+}
+
+void onAsyncEcho(const TcpConnectionPtr& conn, std::string_view request, const RpcResponder& responder)
+{
+    std::string copy(request);
+    conn->getLoop()->queueInLoop([responder, copy]() { responder.reply(RpcCodec::kOk, copy); });
+}
+
+class LoadGenerator
+{
+public:
+    LoadGenerator(EventLoop* loop, const InetAddress& addr, int connections, int depth, int payloadBytes)
+        :depth_(depth),
+        payload_(payloadBytes, 'x'),
+        responses_(0),
+        errors_(0)
+    {
+        for(int i = 0; i < connections; i++)
+        {
+            char name[32];
+            snprintf(name, sizeof name, "rpcclient%d", i);
+            RpcClient* client = new RpcClient(loop, addr, name);
+            client->setConnectionCallback([this, client](const TcpConnectionPtr& conn) {
+                if(conn->connected())
+                {
+                    for(int j = 0; j < depth_; j++)
+                    {
+                        issue(client, j);
+                    }
+                }
+            });
+            clients_.emplace_back(client);
+        }
+    }
+
+    void start()
+    {
+        for(auto& client : clients_)
+        {
+            client->connect();
+        }
+    }
+
+    int64_t responses() const { return responses_; }
+    int64_t errors() const { return errors_; }
+
+private:
+    void issue(RpcClient* client, int64_t seq)
+    {
+        uint16_t method = (seq % 2 == 0) ? kEcho : kAsyncEcho;
+        client->call(method, payload_, [this, client, seq](uint16_t status, std::string_view payload) {
+            if(status != RpcCodec::kOk || payload.size() != payload_.size())
+            {
+                ++errors_;
+                return;
+            }
+            ++responses_;
+            issue(client, seq + 1);
+        });
+    }
+
+    int depth_;
+    std::string payload_;
+    int64_t responses_;
+    int64_t errors_;
+    std::vector<std::unique_ptr<RpcClient>> clients_;
+};
+
+int main(int argc, char** argv)
+{
+    int connections = argc > 1 ? atoi(argv[1]) : 4;
+    int depth = argc > 2 ? atoi(argv[2]) : 64;
+    double seconds = argc > 3 ? atof(argv[3]) : 5.0;
+    int serverThreads = argc > 4 ? atoi(argv[4]) : 2;
+    int payloadBytes = argc > 5 ? atoi(argv[5]) : 64;
+
+    EventLoop loop;
+    InetAddress addr(8090);
+    RpcServer server(&loop, addr, "RpcBench");
+    server.registerMethod(kEcho, onEcho);
+    server.registerAsyncMethod(kAsyncEcho, onAsyncEcho);
+    server.setThreadNum(serverThreads);
+    server.start();
+
+    LoadGenerator generator(&loop, addr, connections, depth, payloadBytes);
+    generator.start();
+
+    // 主loop跑起来之后，在另一个线程里用future同步调用
+    EventLoopThread callerThread;
+    RpcClient syncClient(callerThread.startLoop(), addr, "syncclient");
+    syncClient.connect();
+    std::thread caller([&syncClient]() {
+        RpcClient::Result result = syncClient.call(kEcho, "hello").get();
+        printf("sync call: status=%d payload=%s\n", result.status, result.payload.c_str());
+    });
+
+    Timestamp start(Timestamp::now());
+    loop.runAfter(seconds, [&]() {
+        double elapsed = timeDifference(Timestamp::now(), start);
+        printf("connections=%d depth=%d serverThreads=%d payload=%d calls=%ld errors=%ld seconds=%.2f qps=%.0f\n",
+                connections, depth, serverThreads, payloadBytes, generator.responses(), generator.errors(),
+                elapsed, generator.responses() / elapsed);
+        loop.quit();
+    });
+    loop.loop();
+    caller.join();
+
+    return 0;
+}
@@ -0,0 +1,173 @@
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/TcpClient.h>
+#include <mymuduo/TlsContext.h>
+#include <mymuduo/Logger.h>
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// TLS echo服务器和乒乓压测
+// 先生成一个自签名证书：
+//   openssl req -x509 -newkey rsa:2048 -nodes -keyout /tmp/key.pem -out /tmp/cert.pem -days 365 -subj /CN=localhost
+// 用法：
+//   tlsecho server cert.pem key.pem [port]          echo服务器，可以用 openssl s_client -connect 127.0.0.1:8443 测试
+//   tlsecho bench cert.pem key.pem [connections] [messageBytes] [seconds] [serverThreads]
+//     依次压测明文tcp、用户态TLS、kTLS（内核没有tls模块时和用户态一样），客户端用cert.pem作为CA校验服务端
+
+class EchoBench
+{
+public:
+    EchoBench(EventLoop* loop, const InetAddress& addr, const TlsContextPtr& serverCtx, const TlsContextPtr& clientCtx,
+            int connections, int messageBytes, int serverThreads)
+        :server_(loop, addr, "TlsEchoServer"),
+        message_(messageBytes, 'x'),
+        bytes_(0),
+        messages_(0),
+        kernelTx_(0)
+    {
+        server_.setConnectionCallback([this](const TcpConnectionPtr& conn) {
+            if(conn->connected() && conn->kernelTlsTx())
+            {
+                ++kernelTx_;
+            }
+        });
+        server_.setMessageCallback([](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+            conn->send(buf);
+        });
+        server_.setThreadNum(serverThreads);
+        if(serverCtx)
+        {
+            server_.setTlsContext(serverCtx);
+        }
+        for(int i = 0; i < connections; i++)
+        {
+            char name[32];
+            snprintf(name, sizeof name, "client%d", i);
+            TcpClient* client = new TcpClient(loop, addr, name);
+            if(clientCtx)
+            {
+                client->setTlsContext(clientCtx, "localhost");
+            }
+            client->setConnectionCallback([this](const TcpConnectionPtr& conn) {
+                if(conn->connected())
+                {
+                    conn->setTcpNoDelay(true);
+                    conn->send(message_);
+                }
+            });
+            client->setMessageCallback(std::bind(&EchoBench::onMessage, this,
+                                        std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+            clients_.emplace_back(client);
+        }
+    }
+
+    void start()
+    {
+        server_.start();
+        for(auto& client : clients_)
+        {
+            client->connect();
+        }
+    }
+
+    int64_t bytes() const { return bytes_; }
+    int64_t messages() const { return messages_; }
+    int kernelTx() const { return kernelTx_; }
+
+private:
+    void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+    {
+        while(buf->readableBytes() >= message_.size())
+        {
+            buf->retrieve(message_.size());
+            bytes_ += message_.size();
+            ++messages_;
+            conn->send(message_);
+        }
+    }
+
+    TcpServer server_;
+    std::string message_;
+    int64_t bytes_;
+    int64_t messages_;
+    std::atomic_int kernelTx_;  //服务端开启了kTLS TX的连接数，在subLoop中修改
+    std::vector<std::unique_ptr<TcpClient>> clients_;
+};
+
+static void runBench(const char* label, uint16_t port, const TlsContextPtr& serverCtx, const TlsContextPtr& clientCtx,
+                    int connections, int messageBytes, double seconds, int serverThreads)
+{
+    EventLoop loop;
+    EchoBench bench(&loop, InetAddress(port), serverCtx, clientCtx, connections, messageBytes, serverThreads);
+    bench.start();
+    Timestamp start(Timestamp::now());
+    loop.runAfter(seconds, [&]() {
+        double elapsed = timeDifference(Timestamp::now(), start);
+        printf("mode=%-6s connections=%d message=%d ktls_tx=%d msgs/s=%.0f MiB/s=%.1f\n",
+                label, connections, messageBytes, bench.kernelTx(),
+                bench.messages() / elapsed, bench.bytes() / elapsed / (1024 * 1024));
+        fflush(stdout);
+        loop.quit();
+    });
+    loop.loop();
+}
+
+static void runServer(const TlsContextPtr& ctx, uint16_t port)
+{
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(port), "TlsEchoServer");
+    server.setTlsContext(ctx);
+    server.setConnectionCallback([](const TcpConnectionPtr& conn) {
+        LOG_INFO("%s %s ktls tx=%d rx=%d \n", conn->peerAddress().toIpPort().c_str(),
+                conn->connected() ? "UP" : "DOWN", conn->kernelTlsTx(), conn->kernelTlsRx());
+    });
+    server.setMessageCallback([](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+        conn->send(buf);
+    });
+    server.setThreadNum(2);
+    server.start();
+    loop.loop();
+}
+
+int main(int argc, char** argv)
+{
+    if(argc < 4)
+    {
+        fprintf(stderr, "usage: %s server|bench cert.pem key.pem [...]\n", argv[0]);
+        return 1;
+    }
+    TlsContextPtr serverCtx = TlsContext::createServer(argv[2], argv[3]);
+    if(!serverCtx)
+    {
+        return 1;
+    }
+    if(strcmp(argv[1], "server") == 0)
+    {
+        runServer(serverCtx, argc > 4 ? static_cast<uint16_t>(atoi(argv[4])) : 8443);
+        return 0;
+    }
+
+    int connections = argc > 4 ? atoi(argv[4]) : 16;
+    int messageBytes = argc > 5 ? atoi(argv[5]) : 4096;
+    double seconds = argc > 6 ? atof(argv[6]) : 3.0;
+    int serverThreads = argc > 7 ? atoi(argv[7]) : 2;
+
+    TlsContextPtr clientCtx = TlsContext::createClient(argv[2]);
+    TlsContextPtr userServerCtx = TlsContext::createServer(argv[2], argv[3]);
+    TlsContextPtr userClientCtx = TlsContext::createClient(argv[2]);
+    if(!clientCtx || !userServerCtx || !userClientCtx)
+    {
+        return 1;
+    }
+    userServerCtx->setKernelTls(false);
+    userClientCtx->setKernelTls(false);
+
+    runBench("tcp", 8443, nullptr, nullptr, connections, messageBytes, seconds, serverThreads);
+    runBench("tls", 8444, userServerCtx, userClientCtx, connections, messageBytes, seconds, serverThreads);
+    runBench("ktls", 8445, serverCtx, clientCtx, connections, messageBytes, seconds, serverThreads);
+    return 0;
+}
@@ -0,0 +1,120 @@
+#include <mymuduo/UdpServer.h>
+#include <mymuduo/UdpChannel.h>
+#include <mymuduo/EventLoop.h>
+#include <mymuduo/Logger.h>
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <stdio.h>
+#include <stdlib.h>
+
+// udp echo压测：同一个进程里起UdpServer（serverThreads个subLoop，每个一个SO_REUSEPORT socket），
+// 主loop上用sockets个客户端socket，每个socket同时有window个datagram在路上；udp会丢包，每100ms把窗口补满
+// 用法：udpbench [sockets] [window] [seconds] [serverThreads] [payloadBytes] [gso]
+
+class LoadGenerator
+{
+public:
+    LoadGenerator(EventLoop* loop, const InetAddress& serverAddr, int sockets, int window, int payloadBytes, const UdpOptions& options)
+        :loop_(loop),
+        serverAddr_(serverAddr),
+        window_(window),
+        payload_(payloadBytes, 'x'),
+        received_(0)
+    {
+        for(int i = 0; i < sockets; i++)
+        {
+            int sockfd = UdpChannel::createBound(InetAddress(0), false, options);
+            UdpChannelPtr channel = std::make_shared<UdpChannel>(loop, sockfd, options);
+            channel->setDatagramCallback(std::bind(&LoadGenerator::onDatagram, this,
+                                        std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4));
+            channels_.push_back(channel);
+        }
+    }
+
+    ~LoadGenerator()
+    {
+        for(const UdpChannelPtr& channel : channels_)
+        {
+            channel->stop();
+        }
+    }
+
+    void start()
+    {
+        for(const UdpChannelPtr& channel : channels_)
+        {
+            channel->start();
+        }
+        refill();
+        loop_->runEvery(0.1, std::bind(&LoadGenerator::refill, this));
+    }
+
+    int64_t received() const { return received_; }
+
+private:
+    void refill()
+    {
+        // 丢包之后窗口不会自己恢复，直接当作全丢了重新补满
+        for(size_t i = 0; i < channels_.size(); i++)
+        {
+            for(int j = 0; j < window_; j++)
+            {
+                channels_[i]->send(serverAddr_, payload_);
+            }
+        }
+    }
+
+    void onDatagram(UdpChannel* channel, const InetAddress&, std::string_view, Timestamp)
+    {
+        ++received_;
+        channel->send(serverAddr_, payload_);
+    }
+
+    EventLoop* loop_;
+    InetAddress serverAddr_;
+    int window_;
+    std::string payload_;
+    int64_t received_;
+    std::vector<UdpChannelPtr> channels_;
+};
+
+int main(int argc, char** argv)
+{
+    int sockets = argc > 1 ? atoi(argv[1]) : 8;
+    int window = argc > 2 ? atoi(argv[2]) : 64;
+    double seconds = argc > 3 ? atof(argv[3]) : 5.0;
+    int serverThreads = argc > 4 ? atoi(argv[4]) : 2;
+    int payloadBytes = argc > 5 ? atoi(argv[5]) : 64;
+    bool gso = argc > 6 ? atoi(argv[6]) != 0 : false;
+
+    UdpOptions options;
+    options.gso = gso;
+    options.recvBufferSize = 4 * 1024 * 1024;
+
+    EventLoop loop;
+    InetAddress addr(9000);
+    UdpServer server(&loop, addr, "UdpBench");
+    server.setOptions(options);
+    server.setThreadNum(serverThreads);
+    server.setDatagramCallback([](UdpChannel* channel, const InetAddress& peer, std::string_view data, Timestamp) {
+        channel->send(peer, data);
+    });
+    server.start();
+
+    LoadGenerator generator(&loop, addr, sockets, window, payloadBytes, options);
+    generator.start();
+
+    Timestamp start(Timestamp::now());
+    loop.runAfter(seconds, [&]() {
+        double elapsed = timeDifference(Timestamp::now(), start);
+        printf("sockets=%d window=%d serverThreads=%d payload=%d gso=%d echoes=%ld seconds=%.2f pps=%.0f\n",
+                sockets, window, serverThreads, payloadBytes, gso ? 1 : 0, generator.received(), elapsed,
+                generator.received() / elapsed);
+        loop.quit();
+    });
+    loop.loop();
+
+    return 0;
+}
@@ -0,0 +1,74 @@
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/UpstreamPool.h>
+#include <mymuduo/Logger.h>
+
+#include <string>
+#include <functional>
+
+// 在本机回环地址上起一个echo服务器，再用UpstreamPool建几条长连接去访问它
+// 每个请求借一条连接，收到回复后归还，整个过程都在同一个loop里，不跨线程也不重新握手
+class PoolDemo
+{
+public:
+    PoolDemo(EventLoop* loop, const InetAddress& addr, int poolSize, int requests)
+        :loop_(loop),
+        server_(loop, addr, "EchoServer"),
+        pool_(loop, addr, "Upstream", poolSize),
+        remaining_(requests)
+    {
+        server_.setMessageCallback([](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+            conn->send(buf->retrieveAllAsString());
+        });
+        pool_.setMessageCallback(std::bind(&PoolDemo::onUpstreamMessage, this,
+                                std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+    }
+
+    void start()
+    {
+        server_.start();
+        pool_.start();
+        for(int i = 0; i < 4; i++)
+        {
+            sendRequest();
+        }
+    }
+
+private:
+    void sendRequest()
+    {
+        pool_.acquire([](const TcpConnectionPtr& conn) {
+            conn->send("ping");
+        });
+    }
+
+    void onUpstreamMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp time)
+    {
+        buf->retrieveAll();
+        pool_.release(conn);
+        if(--remaining_ == 0)
+        {
+            LOG_INFO("all requests done, idle connections:%lu \n", pool_.idleConnections());
+            loop_->quit();
+        }
+        else if(remaining_ >= 4)
+        {
+            sendRequest();
+        }
+    }
+
+    EventLoop* loop_;
+    TcpServer server_;
+    UpstreamPool pool_;
+    int remaining_;
+};
+
+int main(int argc, char** argv)
+{
+    EventLoop loop;
+    InetAddress addr(8001);
+    PoolDemo demo(&loop, addr, 4, 1000);
+    demo.start();
+    loop.loop();
+
+    return 0;
+}
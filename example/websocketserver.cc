@@ -0,0 +1,69 @@
+#include <mymuduo/WebSocketServer.h>
+#include <mymuduo/Logger.h>
+
+#include <mutex>
+#include <set>
+#include <string>
+#include <stdlib.h>
+
+// websocket聊天室：收到的文本消息广播给所有连接，"/echo xxx" 只回给发送者
+// 广播时帧只编码一次，所有连接共用
+class ChatServer
+{
+public:
+    ChatServer(EventLoop* loop, const InetAddress& addr, int numThreads)
+        : server_(loop, addr, "ChatServer")
+    {
+        server_.setConnectionCallback(std::bind(&ChatServer::onConnection, this, std::placeholders::_1));
+        server_.setMessageCallback(std::bind(&ChatServer::onMessage, this,
+                                    std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4));
+        server_.setPingInterval(10.0);
+        server_.setThreadNum(numThreads);
+    }
+
+    void start() { server_.start(); }
+
+private:
+    void onConnection(const TcpConnectionPtr& conn)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if(conn->connected())
+        {
+            connections_.insert(conn);
+        }
+        else
+        {
+            connections_.erase(conn);
+        }
+    }
+
+    void onMessage(const TcpConnectionPtr& conn, std::string_view message, bool binary, Timestamp)
+    {
+        if(message.substr(0, 6) == "/echo ")
+        {
+            WebSocketServer::send(conn, message.substr(6), binary);
+            return;
+        }
+        WebSocketFrame::FramePtr frame = WebSocketFrame::makeFrame(binary ? WebSocketFrame::kBinary : WebSocketFrame::kText, message);
+        std::lock_guard<std::mutex> lock(mutex_);
+        for(const TcpConnectionPtr& c : connections_)
+        {
+            WebSocketServer::sendFrame(c, frame);
+        }
+    }
+
+    WebSocketServer server_;
+    std::mutex mutex_;
+    std::set<TcpConnectionPtr> connections_;
+};
+
+int main(int argc, char** argv)
+{
+    int numThreads = argc > 1 ? atoi(argv[1]) : 0;
+    EventLoop loop;
+    ChatServer server(&loop, InetAddress(8001), numThreads);
+    server.start();
+    loop.loop();
+
+    return 0;
+}
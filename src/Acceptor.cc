@@ -4,43 +4,114 @@
 #include "Logger.h"
 #include <unistd.h>
 #include "InetAddress.h"
+#include <fcntl.h>
+#include <errno.h>
 
-static int createNonblocking()
+static int createNonblocking(int family)
 {
-    int sockfd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int sockfd = ::socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
     if(sockfd<0)
     {
         LOG_FATAL("%s:%s:%d  listen socket create error:%d \n", __FILE__, __FUNCTION__, __LINE__, errno);
     }
+    return sockfd;
 }
 
 Acceptor::Acceptor(EventLoop* loop, const InetAddress& listenAddr, bool reuseport)
     :loop_(loop),
-    acceptSocket_(createNonblocking()),//创建非阻塞的socket
+    acceptSocket_(createNonblocking(listenAddr.family())),//创建非阻塞的socket
     acceptChannel_(loop,acceptSocket_.fd()),//打包acceptChannel
-    listenning_(false)
+    listenning_(false),
+    paused_(false),
+    idleFd_(::open("/dev/null", O_RDONLY | O_CLOEXEC)),
+    suppressedErrors_(0)
 {
-    acceptSocket_.setReuseAddr(true);
-    acceptSocket_.setReusePort(true);
+    if(listenAddr.isUnix())
+    {
+        // 上次进程退出时留下的socket文件会让bind失败，先删掉；抽象命名空间没有文件
+        if(listenAddr.isUnixPath())
+        {
+            ::unlink(listenAddr.toIp().c_str());
+        }
+    }
+    else
+    {
+        acceptSocket_.setReuseAddr(true);
+        acceptSocket_.setReusePort(reuseport);
+    }
     acceptSocket_.bindAddress(listenAddr);// 绑定socket
     // TcpServer::start()  Acceptor.listen 有新用户连接，需要执行一个回调来（connfd >> Channel >> subLoop） 
     // baseLoop 监听到 acceptChannel有事件发生时会调用handleRead
     acceptChannel_.setReadCallback(std::bind(&Acceptor::handleRead, this));//只关心新用户连接的读事件
 }
 
+Acceptor::Acceptor(EventLoop* loop, int listenfd)
+    :loop_(loop),
+    acceptSocket_(listenfd),
+    acceptChannel_(loop,acceptSocket_.fd()),
+    listenning_(false),
+    paused_(false),
+    idleFd_(::open("/dev/null", O_RDONLY | O_CLOEXEC)),
+    suppressedErrors_(0)
+{
+    // O_NONBLOCK属于文件表项，继承来的fd一般已经是非阻塞的，这里保险起见再设置一次
+    int flags = ::fcntl(listenfd, F_GETFL, 0);
+    ::fcntl(listenfd, F_SETFL, flags | O_NONBLOCK);
+    acceptChannel_.setReadCallback(std::bind(&Acceptor::handleRead, this));
+}
+
 Acceptor::~Acceptor()
 {
-    acceptChannel_.disableAll();
-    acceptChannel_.remove();
+    if(acceptSocket_.fd() >= 0)   //stopListen时已经从poller上删除了
+    {
+        acceptChannel_.disableAll();
+        acceptChannel_.remove();
+    }
+    ::close(idleFd_);
 }
 
 void Acceptor::listen()
 {
     listenning_ = true;
-    acceptSocket_.listen();
+    acceptSocket_.applyListenOptions(options_);
+    acceptSocket_.listen(options_.backlog);
     acceptChannel_.enableReading(); //acceptChannel >> Poller 
 }
 
+void Acceptor::stopListen()
+{
+    if(acceptSocket_.fd() < 0)
+    {
+        return;
+    }
+    listenning_ = false;
+    paused_ = false;
+    // 只是不关注读事件的话，内核还会继续完成三次握手，把连接放进没人accept的全连接队列，
+    // 这些客户端要等到进程退出才收到RST。直接关掉listen socket：队列里的连接马上被RST，新的SYN被拒绝，
+    // 客户端立即去重试其他实例。handoff时新进程持有同一个socket，队列不受影响
+    acceptChannel_.disableAll();
+    acceptChannel_.remove();
+    acceptSocket_.close();
+}
+
+void Acceptor::pauseAccepting()
+{
+    if(listenning_ && !paused_)
+    {
+        paused_ = true;
+        acceptChannel_.disableReading();
+    }
+}
+
+void Acceptor::resumeAccepting()
+{
+    if(listenning_ && paused_)
+    {
+        paused_ = false;
+        acceptChannel_.enableReading();
+    }
+}
+
 // listenfd有事件发生，有新用户连接
 void Acceptor::handleRead()
 {
@@ -59,10 +130,33 @@ void Acceptor::handleRead()
     }
     else
     {
-        LOG_ERROR("%s:%s:%d  accept error:%d \n", __FILE__, __FUNCTION__, __LINE__, errno);
-        if(errno==EMFILE)
+        int savedErrno = errno;
+        if(savedErrno==EMFILE)
+        {
+            // fd用完了，新连接一直留在全连接队列里，LT模式下listenfd会一直可读，loop空转
+            // 先关掉预留的fd，用它accept这个连接再马上关闭，让对端尽快知道被拒绝了
+            ::close(idleFd_);
+            idleFd_ = ::accept(acceptSocket_.fd(), nullptr, nullptr);
+            ::close(idleFd_);
+            idleFd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+        }
+
+        // 日志限流，防止过载时每次loop都打日志
+        Timestamp now(Timestamp::now());
+        if(timeDifference(now, lastErrorLog_) >= 1.0)
+        {
+            LOG_ERROR("%s:%s:%d  accept error:%d (%d more suppressed) \n",
+                        __FILE__, __FUNCTION__, __LINE__, savedErrno, suppressedErrors_);
+            if(savedErrno==EMFILE)
+            {
+                LOG_ERROR("%s:%s:%d  sockfd reached limit \n", __FILE__, __FUNCTION__, __LINE__);
+            }
+            lastErrorLog_ = now;
+            suppressedErrors_ = 0;
+        }
+        else
         {
-            LOG_ERROR("%s:%s:%d  sockfd reached limit \n", __FILE__, __FUNCTION__, __LINE__);
+            ++suppressedErrors_;
         }
     }
 }
\ No newline at end of file
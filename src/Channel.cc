@@ -38,6 +38,20 @@ void Channel::remove()
     loop_->removeChannel(this);
 }
 
+void Channel::detach(EventLoop* newLoop)
+{
+    loop_->removeChannel(this);     //之后index_是kNew，attach时重新EPOLL_CTL_ADD
+    loop_ = newLoop;
+}
+
+void Channel::attach()
+{
+    if(!isNoneEvent())
+    {
+        update();
+    }
+}
+
 //fd得到poller通知以后，处理事件的函数，调用相应的回调函数
 void Channel::handleEvent(Timestamp receiveTime)
 {
@@ -59,7 +73,7 @@ void Channel::handleEvent(Timestamp receiveTime)
 // 这些回调函数都是TcpConnection传进来的
 void Channel::handleEventWithGuard(Timestamp receiveTime)
 {
-    LOG_INFO("channel handleEvent revents:%d\n",revents_);
+    LOG_DEBUG("channel handleEvent revents:%d\n",revents_);
 
     if((revents_&EPOLLHUP)&&!(revents_&EPOLLIN))//  sockfd会自动在poller中注册EPOLLHUP事件（sockfd关闭的事件）
     {
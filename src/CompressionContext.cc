@@ -0,0 +1,201 @@
+#include "CompressionContext.h"
+#include "Logger.h"
+
+#ifdef MYMUDUO_WITH_ZLIB
+
+#include <zlib.h>
+
+CompressionContextPtr CompressionContext::create(const CompressionOptions& options)
+{
+    if(options.level < 0 || options.level > 9
+        || options.windowBits < 9 || options.windowBits > 15
+        || options.memLevel < 1 || options.memLevel > 9)
+    {
+        LOG_ERROR("CompressionContext::create - bad options level=%d windowBits=%d memLevel=%d \n",
+                options.level, options.windowBits, options.memLevel);
+        return nullptr;
+    }
+    return CompressionContextPtr(new CompressionContext(options));
+}
+
+CompressionContext::CompressionContext(const CompressionOptions& options)
+    :options_(options),
+    dictionaryId_(0)
+{
+    if(!options_.dictionary.empty())
+    {
+        dictionaryId_ = static_cast<uint32_t>(::adler32(::adler32(0L, Z_NULL, 0),
+                reinterpret_cast<const Bytef*>(options_.dictionary.data()),
+                static_cast<uInt>(options_.dictionary.size())));
+    }
+}
+
+CompressionContext::~CompressionContext()
+{
+    // 所有连接都已经释放了ctx，池子不会再有人访问
+    for(auto& item : pools_)
+    {
+        for(z_stream_s* stream : item.second->deflaters)
+        {
+            destroyDeflater(stream);
+        }
+        for(z_stream_s* stream : item.second->inflaters)
+        {
+            destroyInflater(stream);
+        }
+    }
+}
+
+CompressionContext::StreamPool* CompressionContext::poolOf(EventLoop* loop)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::unique_ptr<StreamPool>& pool = pools_[loop];
+    if(!pool)
+    {
+        pool.reset(new StreamPool);
+    }
+    return pool.get();
+}
+
+z_stream_s* CompressionContext::acquireDeflater(EventLoop* loop, int level, bool useDictionary)
+{
+    StreamPool* pool = poolOf(loop);
+    z_stream_s* stream = nullptr;
+    if(!pool->deflaters.empty())
+    {
+        stream = pool->deflaters.back();
+        pool->deflaters.pop_back();
+        // 放回池子时已经reset过，还没有输入，这里改级别不会产生输出
+        ::deflateParams(stream, level, Z_DEFAULT_STRATEGY);
+    }
+    else
+    {
+        stream = new z_stream_s();
+        if(::deflateInit2(stream, level, Z_DEFLATED, options_.windowBits, options_.memLevel, Z_DEFAULT_STRATEGY) != Z_OK)
+        {
+            LOG_ERROR("CompressionContext - deflateInit2 failed \n");
+            delete stream;
+            return nullptr;
+        }
+    }
+    // reset会清掉字典，每次都要重新设置
+    if(useDictionary)
+    {
+        ::deflateSetDictionary(stream, reinterpret_cast<const Bytef*>(options_.dictionary.data()),
+                            static_cast<uInt>(options_.dictionary.size()));
+    }
+    return stream;
+}
+
+z_stream_s* CompressionContext::acquireInflater(EventLoop* loop)
+{
+    StreamPool* pool = poolOf(loop);
+    if(!pool->inflaters.empty())
+    {
+        z_stream_s* stream = pool->inflaters.back();
+        pool->inflaters.pop_back();
+        return stream;
+    }
+    z_stream_s* stream = new z_stream_s();
+    // 解压的窗口只有32K，直接用最大的，对端用多大的窗口都能解
+    if(::inflateInit2(stream, 15) != Z_OK)
+    {
+        LOG_ERROR("CompressionContext - inflateInit2 failed \n");
+        delete stream;
+        return nullptr;
+    }
+    return stream;
+}
+
+void CompressionContext::releaseDeflater(EventLoop* loop, z_stream_s* stream)
+{
+    StreamPool* pool = poolOf(loop);
+    if(pool->deflaters.size() < options_.maxPooledStreams && ::deflateReset(stream) == Z_OK)
+    {
+        pool->deflaters.push_back(stream);
+    }
+    else
+    {
+        destroyDeflater(stream);
+    }
+}
+
+void CompressionContext::releaseInflater(EventLoop* loop, z_stream_s* stream)
+{
+    StreamPool* pool = poolOf(loop);
+    if(pool->inflaters.size() < options_.maxPooledStreams && ::inflateReset(stream) == Z_OK)
+    {
+        pool->inflaters.push_back(stream);
+    }
+    else
+    {
+        destroyInflater(stream);
+    }
+}
+
+void CompressionContext::destroyDeflater(z_stream_s* stream)
+{
+    ::deflateEnd(stream);
+    delete stream;
+}
+
+void CompressionContext::destroyInflater(z_stream_s* stream)
+{
+    ::inflateEnd(stream);
+    delete stream;
+}
+
+size_t CompressionContext::pooledStreams(EventLoop* loop)
+{
+    StreamPool* pool = poolOf(loop);
+    return pool->deflaters.size() + pool->inflaters.size();
+}
+
+void CompressionContext::removeLoop(EventLoop* loop)
+{
+    std::unique_ptr<StreamPool> pool;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = pools_.find(loop);
+        if(it == pools_.end())
+        {
+            return;
+        }
+        pool = std::move(it->second);
+        pools_.erase(it);
+    }
+    for(z_stream_s* stream : pool->deflaters)
+    {
+        destroyDeflater(stream);
+    }
+    for(z_stream_s* stream : pool->inflaters)
+    {
+        destroyInflater(stream);
+    }
+}
+
+#else   // MYMUDUO_WITH_ZLIB
+
+CompressionContextPtr CompressionContext::create(const CompressionOptions& options)
+{
+    LOG_ERROR("CompressionContext::create - mymuduo is built without zlib \n");
+    return nullptr;
+}
+
+CompressionContext::CompressionContext(const CompressionOptions& options)
+    :options_(options),
+    dictionaryId_(0)
+{
+}
+
+CompressionContext::~CompressionContext() {}
+CompressionContext::StreamPool* CompressionContext::poolOf(EventLoop* loop) { return nullptr; }
+z_stream_s* CompressionContext::acquireDeflater(EventLoop* loop, int level, bool useDictionary) { return nullptr; }
+z_stream_s* CompressionContext::acquireInflater(EventLoop* loop) { return nullptr; }
+void CompressionContext::releaseDeflater(EventLoop* loop, z_stream_s* stream) {}
+void CompressionContext::releaseInflater(EventLoop* loop, z_stream_s* stream) {}
+void CompressionContext::destroyDeflater(z_stream_s* stream) {}
+void CompressionContext::destroyInflater(z_stream_s* stream) {}
+size_t CompressionContext::pooledStreams(EventLoop* loop) { return 0; }
+
+#endif  // MYMUDUO_WITH_ZLIB
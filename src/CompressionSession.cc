@@ -0,0 +1,214 @@
+#include "CompressionSession.h"
+#include "Logger.h"
+
+#ifdef MYMUDUO_WITH_ZLIB
+
+#include <zlib.h>
+
+#include <algorithm>
+
+namespace
+{
+
+const size_t kPreambleSize = 8;
+const char kMagic0 = 'M';
+const char kMagic1 = 'Z';
+const char kVersion = 1;
+const size_t kMinOutputChunk = 4096;
+
+}
+
+CompressionSession::CompressionSession(const CompressionContextPtr& ctx, EventLoop* loop, int level)
+    :ctx_(ctx),
+    loop_(loop),
+    level_(level < 0 ? ctx->options().level : std::min(level, 9)),
+    useDictionary_(false),
+    preambleSent_(false),
+    ready_(false),
+    deflater_(nullptr),
+    inflater_(nullptr)
+{
+}
+
+CompressionSession::~CompressionSession()
+{
+    // 正常情况下connectDistory已经release了，到这里还有说明连接没走完整的关闭流程，可能不在loop线程，直接释放
+    if(deflater_)
+    {
+        CompressionContext::destroyDeflater(deflater_);
+    }
+    if(inflater_)
+    {
+        CompressionContext::destroyInflater(inflater_);
+    }
+}
+
+void CompressionSession::appendPreamble(Buffer* out)
+{
+    if(preambleSent_)
+    {
+        return;
+    }
+    preambleSent_ = true;
+    uint32_t dictId = ctx_->dictionaryId();
+    char preamble[kPreambleSize] = {
+        kMagic0, kMagic1, kVersion, static_cast<char>(level_),
+        static_cast<char>(dictId >> 24), static_cast<char>(dictId >> 16),
+        static_cast<char>(dictId >> 8), static_cast<char>(dictId),
+    };
+    out->append(preamble, sizeof preamble);
+}
+
+CompressionSession::Result CompressionSession::handleInput(Buffer* plaintext)
+{
+    Result result = kOk;
+    if(!ready_)
+    {
+        if(input_.readableBytes() < kPreambleSize)
+        {
+            return kOk;
+        }
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(input_.peek());
+        if(p[0] != kMagic0 || p[1] != kMagic1 || p[2] != kVersion || p[3] > 9)
+        {
+            LOG_ERROR("CompressionSession - bad preamble \n");
+            return kError;
+        }
+        uint32_t peerDictId = (static_cast<uint32_t>(p[4]) << 24) | (p[5] << 16) | (p[6] << 8) | p[7];
+        input_.retrieve(kPreambleSize);
+        level_ = std::min(level_, static_cast<int>(p[3]));
+        useDictionary_ = peerDictId != 0 && peerDictId == ctx_->dictionaryId();
+        deflater_ = ctx_->acquireDeflater(loop_, level_, useDictionary_);
+        inflater_ = ctx_->acquireInflater(loop_);
+        if(deflater_ == nullptr || inflater_ == nullptr)
+        {
+            return kError;
+        }
+        ready_ = true;
+        result = kNegotiated;
+    }
+    if(input_.readableBytes() > 0 && !inflateInto(plaintext))
+    {
+        return kError;
+    }
+    return result;
+}
+
+bool CompressionSession::inflateInto(Buffer* plaintext)
+{
+    size_t before = plaintext->readableBytes();
+    const size_t inputBytes = input_.readableBytes();
+    for(;;)
+    {
+        plaintext->ensureWritableBytes(std::max(input_.readableBytes() * 4, kMinOutputChunk));
+        size_t avail = plaintext->writableBytes();
+        inflater_->next_in = reinterpret_cast<Bytef*>(input_.beginRead());
+        inflater_->avail_in = static_cast<uInt>(std::min(input_.readableBytes(), static_cast<size_t>(UINT32_MAX)));
+        inflater_->next_out = reinterpret_cast<Bytef*>(plaintext->beginWrite());
+        inflater_->avail_out = static_cast<uInt>(std::min(avail, static_cast<size_t>(UINT32_MAX)));
+        uInt availIn = inflater_->avail_in;
+        uInt availOut = inflater_->avail_out;
+        int ret = ::inflate(inflater_, Z_SYNC_FLUSH);
+        input_.retrieve(availIn - inflater_->avail_in);
+        plaintext->hasWritten(availOut - inflater_->avail_out);
+
+        if(ret == Z_NEED_DICT)
+        {
+            // 对端用了字典，协商时已经确认过双方的字典一样
+            if(!useDictionary_ || ::inflateSetDictionary(inflater_,
+                    reinterpret_cast<const Bytef*>(ctx_->options().dictionary.data()),
+                    static_cast<uInt>(ctx_->options().dictionary.size())) != Z_OK)
+            {
+                LOG_ERROR("CompressionSession - peer needs a dictionary we don't have \n");
+                return false;
+            }
+            continue;
+        }
+        if(ret != Z_OK && ret != Z_BUF_ERROR)
+        {
+            // Z_STREAM_END也算错误，两边的流都不会结束
+            LOG_ERROR("CompressionSession - inflate error %d: %s \n", ret, inflater_->msg ? inflater_->msg : "");
+            return false;
+        }
+        if(plaintext->readableBytes() > ctx_->options().maxInputBufferBytes)
+        {
+            LOG_ERROR("CompressionSession - inflated input exceeds %zu bytes \n", ctx_->options().maxInputBufferBytes);
+            return false;
+        }
+        // 输出区没写满说明能解的都解完了，剩下的输入是不完整的块，等下次
+        if(inflater_->avail_out != 0)
+        {
+            break;
+        }
+    }
+    stats_.compressedBytesReceived += inputBytes - input_.readableBytes();
+    stats_.plainBytesReceived += plaintext->readableBytes() - before;
+    return true;
+}
+
+bool CompressionSession::compress(const void* data, size_t len, Buffer* out)
+{
+    if(deflater_ == nullptr)
+    {
+        return false;   //已经release，连接已经销毁
+    }
+    size_t before = out->readableBytes();
+    deflater_->next_in = reinterpret_cast<Bytef*>(const_cast<void*>(data));
+    deflater_->avail_in = static_cast<uInt>(len);
+    do
+    {
+        // 一次sync flush的输出一般比输入小，不够就再来一轮
+        out->ensureWritableBytes(std::max(len / 2 + 64, kMinOutputChunk));
+        size_t avail = std::min(out->writableBytes(), static_cast<size_t>(UINT32_MAX));
+        deflater_->next_out = reinterpret_cast<Bytef*>(out->beginWrite());
+        deflater_->avail_out = static_cast<uInt>(avail);
+        int ret = ::deflate(deflater_, Z_SYNC_FLUSH);
+        if(ret != Z_OK && ret != Z_BUF_ERROR)
+        {
+            LOG_ERROR("CompressionSession - deflate error %d \n", ret);
+            return false;
+        }
+        out->hasWritten(avail - deflater_->avail_out);
+    } while(deflater_->avail_out == 0);
+    stats_.plainBytesSent += len;
+    stats_.compressedBytesSent += out->readableBytes() - before;
+    return true;
+}
+
+void CompressionSession::release()
+{
+    if(deflater_)
+    {
+        ctx_->releaseDeflater(loop_, deflater_);
+        deflater_ = nullptr;
+    }
+    if(inflater_)
+    {
+        ctx_->releaseInflater(loop_, inflater_);
+        inflater_ = nullptr;
+    }
+}
+
+#else   // MYMUDUO_WITH_ZLIB
+
+// 没有zlib时CompressionContext创建不出来，也就不会有CompressionSession，这里只是为了能链接
+CompressionSession::CompressionSession(const CompressionContextPtr& ctx, EventLoop* loop, int level)
+    :ctx_(ctx),
+    loop_(loop),
+    level_(level),
+    useDictionary_(false),
+    preambleSent_(false),
+    ready_(false),
+    deflater_(nullptr),
+    inflater_(nullptr)
+{
+}
+
+CompressionSession::~CompressionSession() {}
+void CompressionSession::appendPreamble(Buffer* out) {}
+CompressionSession::Result CompressionSession::handleInput(Buffer* plaintext) { return kError; }
+bool CompressionSession::inflateInto(Buffer* plaintext) { return false; }
+bool CompressionSession::compress(const void* data, size_t len, Buffer* out) { return false; }
+void CompressionSession::release() {}
+
+#endif  // MYMUDUO_WITH_ZLIB
@@ -0,0 +1,231 @@
+#include "Connector.h"
+#include "Channel.h"
+#include "EventLoop.h"
+#include "Logger.h"
+#include "Socket.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <algorithm>
+
+static int createNonblockingSocket(int family)
+{
+    int sockfd = ::socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(sockfd < 0)
+    {
+        LOG_FATAL("%s:%s:%d  connect socket create error:%d \n", __FILE__, __FUNCTION__, __LINE__, errno);
+    }
+    return sockfd;
+}
+
+static int getSocketError(int sockfd)
+{
+    int optval;
+    socklen_t optlen = sizeof optval;
+    if(::getsockopt(sockfd, SOL_SOCKET, SO_ERROR, &optval, &optlen) < 0)
+    {
+        return errno;
+    }
+    return optval;
+}
+
+// 端口耗尽时内核可能把socket连到自己身上（源地址==目的地址），这种连接要丢掉
+// unix domain socket不会出现这种情况
+static bool isSelfConnect(int sockfd)
+{
+    InetAddress localaddr = Socket::getLocalAddr(sockfd);
+    if(localaddr.isUnix())
+    {
+        return false;
+    }
+    InetAddress peeraddr = Socket::getPeerAddr(sockfd);
+    return localaddr.getSockaddrLen() == peeraddr.getSockaddrLen()
+        && ::memcmp(localaddr.getSockaddr(), peeraddr.getSockaddr(), localaddr.getSockaddrLen()) == 0;
+}
+
+Connector::Connector(EventLoop* loop, const InetAddress& serverAddr)
+    :loop_(loop),
+    serverAddr_(serverAddr),
+    connect_(false),
+    state_(kDisconnected),
+    initRetryDelayMs_(kInitRetryDelayMs),
+    maxRetryDelayMs_(kMaxRetryDelayMs),
+    retryDelayMs_(kInitRetryDelayMs)
+{
+    LOG_DEBUG("Connector ctor[%p] \n", this);
+}
+
+Connector::~Connector()
+{
+    LOG_DEBUG("Connector dtor[%p] \n", this);
+}
+
+void Connector::start()
+{
+    connect_ = true;
+    loop_->runInLoop(std::bind(&Connector::startInLoop, shared_from_this()));
+}
+
+void Connector::startInLoop()
+{
+    if(connect_)
+    {
+        connect();
+    }
+    else
+    {
+        LOG_DEBUG("Connector::startInLoop do not connect \n");
+    }
+}
+
+void Connector::stop()
+{
+    connect_ = false;
+    loop_->queueInLoop(std::bind(&Connector::stopInLoop, shared_from_this()));
+}
+
+void Connector::stopInLoop()
+{
+    loop_->cancel(retryTimer_);
+    if(state_ == kConnecting)
+    {
+        setState(kDisconnected);
+        int sockfd = removeAndResetChannel();
+        ::close(sockfd);
+    }
+}
+
+void Connector::connect()
+{
+    int sockfd = createNonblockingSocket(serverAddr_.family());
+    int ret = ::connect(sockfd, serverAddr_.getSockaddr(), serverAddr_.getSockaddrLen());
+    int savedErrno = (ret == 0) ? 0 : errno;
+    switch(savedErrno)
+    {
+        case 0:
+        case EINPROGRESS:   //非阻塞connect正常情况下返回这个，等待可写
+        case EINTR:
+        case EISCONN:
+            connecting(sockfd);
+            break;
+
+        case EAGAIN:        //本地临时端口用完了，稍后再试
+        case EADDRINUSE:
+        case EADDRNOTAVAIL:
+        case ECONNREFUSED:
+        case ENETUNREACH:
+            retry(sockfd);
+            break;
+
+        default:            //EACCES EPERM EBADF等，重试也没用
+            LOG_ERROR("Connector::connect error:%d \n", savedErrno);
+            ::close(sockfd);
+            break;
+    }
+}
+
+void Connector::restart()
+{
+    setState(kDisconnected);
+    retryDelayMs_ = initRetryDelayMs_;
+    connect_ = true;
+    startInLoop();
+}
+
+void Connector::connecting(int sockfd)
+{
+    setState(kConnecting);
+    channel_.reset(new Channel(loop_, sockfd));
+    channel_->setWriteCallback(std::bind(&Connector::handleWrite, this));
+    channel_->setErrorCallback(std::bind(&Connector::handleError, this));
+    // connect的结果通过可写事件通知
+    channel_->enableWritting();
+}
+
+int Connector::removeAndResetChannel()
+{
+    channel_->disableAll();
+    channel_->remove();
+    int sockfd = channel_->fd();
+    // 当前还在Channel::handleEvent里面，不能直接析构channel
+    loop_->queueInLoop(std::bind(&Connector::resetChannel, shared_from_this()));
+    return sockfd;
+}
+
+void Connector::resetChannel()
+{
+    channel_.reset();
+}
+
+void Connector::handleWrite()
+{
+    LOG_DEBUG("Connector::handleWrite state=%d \n", (int)state_);
+    if(state_ == kConnecting)
+    {
+        int sockfd = removeAndResetChannel();
+        int err = getSocketError(sockfd);
+        if(err)
+        {
+            LOG_ERROR("Connector::handleWrite - SO_ERROR = %d %s \n", err, strerror(err));
+            retry(sockfd);
+        }
+        else if(isSelfConnect(sockfd))
+        {
+            LOG_ERROR("Connector::handleWrite - Self connect \n");
+            retry(sockfd);
+        }
+        else
+        {
+            setState(kConnected);
+            retryDelayMs_ = initRetryDelayMs_;  //连接成功，退避时间复位
+            if(connect_)
+            {
+                newConnectionCallback_(sockfd);
+            }
+            else
+            {
+                ::close(sockfd);
+            }
+        }
+    }
+}
+
+void Connector::handleError()
+{
+    LOG_ERROR("Connector::handleError state=%d \n", (int)state_);
+    if(state_ == kConnecting)
+    {
+        int sockfd = removeAndResetChannel();
+        int err = getSocketError(sockfd);
+        LOG_ERROR("Connector::handleError SO_ERROR = %d %s \n", err, strerror(err));
+        retry(sockfd);
+    }
+}
+
+// 关闭当前失败的sockfd，retryDelayMs_之后重新connect，每失败一次退避时间翻倍，直到maxRetryDelayMs_
+void Connector::retry(int sockfd)
+{
+    ::close(sockfd);
+    setState(kDisconnected);
+    if(connect_)
+    {
+        LOG_INFO("Connector::retry - Retry connecting to %s in %d milliseconds. \n",
+                serverAddr_.toIpPort().c_str(), retryDelayMs_);
+        // 定时器里只持有weak_ptr，Connector析构之后定时器到期什么也不做
+        std::weak_ptr<Connector> weakSelf(shared_from_this());
+        retryTimer_ = loop_->runAfter(retryDelayMs_ / 1000.0, [weakSelf]() {
+            ConnectorPtr connector = weakSelf.lock();
+            if(connector)
+            {
+                connector->startInLoop();
+            }
+        });
+        retryDelayMs_ = std::min(retryDelayMs_ * 2, maxRetryDelayMs_);
+    }
+    else
+    {
+        LOG_DEBUG("Connector::retry do not connect \n");
+    }
+}
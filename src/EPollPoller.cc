@@ -32,14 +32,14 @@ EPollPoller::~EPollPoller()
 //重写基类Poller的方法 epoll_wait
 Timestamp EPollPoller::poll(int timeoutMs, ChannelList* activeChannels)
 {
-    //实际上应该用LOG_DEBUG
-    LOG_INFO("func=%s >> fd total count:%d \n",__FUNCTION__, channels_.size());
+    // 每次poll都会执行，只在调试时打印
+    LOG_DEBUG("func=%s >> fd total count:%lu \n",__FUNCTION__, channels_.size());
     int numEvents = ::epoll_wait(epollfd_, &(*events_.begin()), static_cast<int>(events_.size()),timeoutMs);// &*(events_.begin()) events_是vector，begin（）返回首元素的迭代器，对迭代器解引用*得到首元素，然后对首元素取地址&得到数组的首元素地址
     int saveErrno = errno;
     Timestamp now(Timestamp::now());
     if(numEvents > 0)
     {
-        LOG_INFO("%d events happened \n",numEvents);
+        LOG_DEBUG("%d events happened \n",numEvents);
         fillActiveChannels(numEvents,activeChannels);
         if(numEvents==events_.size())//如果当前触发的事件数量已经等于EventList的大小，说明需要扩容了
         {
@@ -66,7 +66,7 @@ Timestamp EPollPoller::poll(int timeoutMs, ChannelList* activeChannels)
 void EPollPoller::updateChannel(Channel* channel)
 {
     const int index = channel->index();
-    LOG_INFO("func=%s, fd = %d, events = %d, index = %d \n",__FUNCTION__, channel->fd(),channel->events(),index);
+    LOG_DEBUG("func=%s, fd = %d, events = %d, index = %d \n",__FUNCTION__, channel->fd(),channel->events(),index);
 
     if(index==kNew||index==kDeleted)
     {
@@ -99,7 +99,7 @@ void EPollPoller::removeChannel(Channel* channel)
     
     int fd = channel->fd();
     channels_.erase(fd);
-    LOG_INFO("func=%s, fd = %d,\n",__FUNCTION__, fd);
+    LOG_DEBUG("func=%s, fd = %d,\n",__FUNCTION__, fd);
     int index = channel->index();
     if(index==kAdded)
     {
@@ -2,6 +2,7 @@
 #include "Logger.h"
 #include "Poller.h"
 #include "Channel.h"
+#include "TimerQueue.h"
 #include <sys/eventfd.h>
 #include <unistd.h>
 #include <fcntl.h>
@@ -34,7 +35,16 @@ EventLoop::EventLoop()
     poller_(Poller::newDefaultPoller(this)),
     wakeupFd_(createEventfd()),
     wakeupChannel_(new Channel(this,wakeupFd_)),
-    currentActiveChannel_(nullptr)
+    timerQueue_(new TimerQueue(this)),
+    currentActiveChannel_(nullptr),
+    backlogHead_(0),
+    backlogSize_(0),
+    maxFunctorsPerLoop_(0),
+    maxFunctorUsPerLoop_(0),
+    executedFunctors_(0),
+    budgetYields_(0),
+    totalWaitUs_(0),
+    maxWaitUs_(0)
 {
     LOG_DEBUG("EventLoop created %p in thread %d \n",this, threadId_);
     if(t_loopInThisThread)
@@ -45,6 +55,7 @@ EventLoop::EventLoop()
     {
         t_loopInThisThread = this;
     }
+    MetricsRegistry::instance().addLoop(this);
 
     //设置wakeupfd的事件类型以及发生事件后的回调操作
     wakeupChannel_->setReadCallback(std::bind(&EventLoop::handleRead,this));
@@ -55,6 +66,7 @@ EventLoop::EventLoop()
 
 EventLoop::~EventLoop()
 {
+    MetricsRegistry::instance().removeLoop(this);
     wakeupChannel_->disableAll();
     wakeupChannel_->remove();
     ::close(wakeupFd_);
@@ -69,6 +81,10 @@ void EventLoop::handleRead()    //单纯用来唤醒EventLoop的，为了将新
     {
         LOG_ERROR("EventLoop::handleRead() reads %d bytes instead of 8",n);
     }
+    else
+    {
+        LoopMetrics::add(&metrics_.wakeups, one);  //eventfd的计数就是上次读之后wakeup的次数
+    }
 }
 
 
@@ -79,13 +95,20 @@ void EventLoop::loop()
     quit_ = false;
 
     LOG_INFO("EventLoop %p start looping \n", this);
+    Timestamp iterationEnd = Timestamp::now();
     while(!quit_)
     {
         activeChannels_.clear();
         //poller监听两类fd，一种是client的fd，一种是wakeupfd（mainLoop唤醒subLoop的fd（eventfd））
-        pollReturnTime_ = poller_->poll(kPollTimeMs,&activeChannels_);
+        //上一轮预算用完还有剩下的回调，这一轮poll不阻塞，处理完就绪的IO接着执行
+        int timeoutMs = backlogHead_ < backlog_.size() ? 0 : kPollTimeMs;
+        pollReturnTime_ = poller_->poll(timeoutMs,&activeChannels_);
+        LoopMetrics::add(&metrics_.iterations, uint64_t(1));
+        LoopMetrics::add(&metrics_.events, static_cast<uint64_t>(activeChannels_.size()));
+        LoopMetrics::add(&metrics_.pollWaitUs, pollReturnTime_.microSecondsSinceEpoch() - iterationEnd.microSecondsSinceEpoch());
         for(Channel* channel : activeChannels_)
         {
+            metrics_.dispatchLag.record(Timestamp::now().microSecondsSinceEpoch() - pollReturnTime_.microSecondsSinceEpoch());
             //poller监听哪些channel发生事件了，然后上报给EventLoop，通知channel处理相应的事件
             channel->handleEvent(pollReturnTime_);
         }
@@ -98,6 +121,9 @@ void EventLoop::loop()
          * （std::vector<Functor> pendingFunctors_里面的回调）
         */
         doPendingFunctors();
+
+        iterationEnd = Timestamp::now();
+        LoopMetrics::add(&metrics_.busyUs, iterationEnd.microSecondsSinceEpoch() - pollReturnTime_.microSecondsSinceEpoch());
     }
 
     LOG_INFO("EventLoop %p stop looping!", this);
@@ -113,23 +139,31 @@ void EventLoop::quit()
 }
 
 
-void EventLoop::runInLoop(Functor cb)
+void EventLoop::runInLoop(Functor cb, Priority priority)
 {
     // 在当前loop中执行callback，判断是否处于当前IO线程，是则执行这个函数，如果不是则将函数加入队列
     if(isInLoopThread())
         cb();
     else
     {
-        queueInLoop(cb);//在非当前线程执行cb，就需要唤醒loop所在线程执行cb
+        queueInLoop(std::move(cb), priority);//在非当前线程执行cb，就需要唤醒loop所在线程执行cb
     }
 }
 
 // cb放入队列中，唤醒loop所在的线程，执行callback
-void EventLoop::queueInLoop(Functor cb)
+void EventLoop::queueInLoop(Functor cb, Priority priority)
 {
+    int64_t now = Timestamp::now().microSecondsSinceEpoch();
     {
         std::lock_guard<std::mutex> lock(mutex_);
-        pendingFunctors_.emplace_back(cb);
+        if(priority == kUrgent)
+        {
+            urgentFunctors_.push_back(PendingFunctor{std::move(cb), now});
+        }
+        else
+        {
+            pendingFunctors_.push_back(PendingFunctor{std::move(cb), now});
+        }
     }
 
     // 唤醒相应的，需要执行上面回调操作的loop线程
@@ -154,6 +188,51 @@ void EventLoop::wakeup()
     }
 }
 
+size_t EventLoop::queueSize() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return pendingFunctors_.size() + urgentFunctors_.size() + backlogSize_.load(std::memory_order_relaxed);
+}
+
+void EventLoop::setPendingFunctorBudget(size_t maxFunctors, double maxSeconds)
+{
+    maxFunctorsPerLoop_ = maxFunctors;
+    maxFunctorUsPerLoop_ = static_cast<int64_t>(maxSeconds * Timestamp::kMicroSecondsPerSecond);
+}
+
+PendingFunctorStats EventLoop::pendingFunctorStats() const
+{
+    PendingFunctorStats stats;
+    stats.executed = executedFunctors_.load(std::memory_order_relaxed);
+    stats.budgetYields = budgetYields_.load(std::memory_order_relaxed);
+    stats.queued = queueSize();
+    stats.totalWaitUs = totalWaitUs_.load(std::memory_order_relaxed);
+    stats.maxWaitUs = maxWaitUs_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+TimerId EventLoop::runAt(Timestamp time, TimerCallback cb)
+{
+    return timerQueue_->addTimer(std::move(cb), time, 0.0);
+}
+
+TimerId EventLoop::runAfter(double delay, TimerCallback cb)
+{
+    Timestamp time(addTime(Timestamp::now(), delay));
+    return runAt(time, std::move(cb));
+}
+
+TimerId EventLoop::runEvery(double interval, TimerCallback cb)
+{
+    Timestamp time(addTime(Timestamp::now(), interval));
+    return timerQueue_->addTimer(std::move(cb), time, interval);
+}
+
+void EventLoop::cancel(TimerId timerId)
+{
+    timerQueue_->cancel(timerId);
+}
+
 // EventLoop方法就是去调用Poller的方法来修改Channel
 void EventLoop::updateChannel(Channel* channel)
 {
@@ -169,22 +248,90 @@ void EventLoop::hasChannel(Channel* channel)
 }
 
 
+// 统计只有loop线程写，不需要原子的读改写
+void EventLoop::runPendingFunctor(const PendingFunctor& functor, int64_t nowUs)
+{
+    int64_t wait = nowUs - functor.enqueueUs;
+    metrics_.functorWait.record(wait);
+    totalWaitUs_.store(totalWaitUs_.load(std::memory_order_relaxed) + wait, std::memory_order_relaxed);
+    if(wait > maxWaitUs_.load(std::memory_order_relaxed))
+    {
+        maxWaitUs_.store(wait, std::memory_order_relaxed);
+    }
+    functor.cb();//执行当前loop需要执行的回调操作
+}
+
 // 执行回调  
 void EventLoop::doPendingFunctors()
 {
-    std::vector<Functor> functors;
+    std::vector<PendingFunctor> urgent;
+    std::vector<PendingFunctor> functors;
     callingPendingFunctors_ = true;
 
     {
         std::lock_guard<std::mutex> lock(mutex_);
+        urgent.swap(urgentFunctors_);
         functors.swap(pendingFunctors_);//先把pendingFunctors里面的回调拿出来，防止一直占用锁，导致queueInLoop中添加cb时阻塞
     }//释放锁，使锁的粒度最小
-    
-    //拿出来回调函数之后，然后去调用回调，
-    for(const Functor& functor : functors)
+
+    //拿出来回调函数之后，然后去调用回调，kUrgent的全部执行
+    int64_t start = Timestamp::now().microSecondsSinceEpoch();
+    for(const PendingFunctor& functor : urgent)
+    {
+        runPendingFunctor(functor, start);
+    }
+    size_t executed = urgent.size();
+
+    if(maxFunctorsPerLoop_ == 0 && maxFunctorUsPerLoop_ == 0 && backlogHead_ == backlog_.size())
     {
-        functor();//执行当前loop需要执行的回调操作
+        // 没有预算限制
+        for(const PendingFunctor& functor : functors)
+        {
+            runPendingFunctor(functor, start);
+        }
+        executed += functors.size();
+    }
+    else
+    {
+        // 新来的排在上一轮剩下的后面
+        if(backlogHead_ == backlog_.size())
+        {
+            backlog_.clear();
+            backlogHead_ = 0;
+            backlog_.swap(functors);
+        }
+        else
+        {
+            backlog_.insert(backlog_.end(), std::make_move_iterator(functors.begin()), std::make_move_iterator(functors.end()));
+        }
+        int64_t now = Timestamp::now().microSecondsSinceEpoch();
+        size_t count = 0;
+        while(backlogHead_ < backlog_.size())
+        {
+            if((maxFunctorsPerLoop_ > 0 && count >= maxFunctorsPerLoop_)
+                || (maxFunctorUsPerLoop_ > 0 && now - start >= maxFunctorUsPerLoop_))
+            {
+                budgetYields_.store(budgetYields_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                break;
+            }
+            // 先移出来再执行，回调里可能再queueInLoop，也可能调setPendingFunctorBudget
+            PendingFunctor functor(std::move(backlog_[backlogHead_++]));
+            runPendingFunctor(functor, now);
+            count++;
+            if(maxFunctorUsPerLoop_ > 0)
+            {
+                now = Timestamp::now().microSecondsSinceEpoch();
+            }
+        }
+        executed += count;
+        if(backlogHead_ == backlog_.size())
+        {
+            backlog_.clear();
+            backlogHead_ = 0;
+        }
+        backlogSize_.store(backlog_.size() - backlogHead_, std::memory_order_relaxed);
     }
+    executedFunctors_.store(executedFunctors_.load(std::memory_order_relaxed) + executed, std::memory_order_relaxed);
 
     callingPendingFunctors_ = false;
 }
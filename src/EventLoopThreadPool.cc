@@ -7,7 +7,8 @@ EventLoopThreadPool::EventLoopThreadPool(EventLoop*baseLoop,const std::string&na
     name_(name),
     started_(false),
     numThreads_(0),
-    next_(0)
+    next_(0),
+    nextThreadId_(0)
 {
 
 }
@@ -21,13 +22,10 @@ EventLoopThreadPool::~EventLoopThreadPool()
 void EventLoopThreadPool::start(const ThreadInitCallBack& cb)
 {
     started_ = true;
+    threadInitCallback_ = cb;
     for(int i = 0;i<numThreads_;i++)
     {
-        char buf[name_.size() + 32] = {0};
-        snprintf(buf,sizeof buf,"%s%d",name_.c_str(),i);
-        EventLoopThread *t = new EventLoopThread(cb,buf);
-        threads_.emplace_back(std::unique_ptr<EventLoopThread>(t));
-        loops_.emplace_back(t->startLoop());
+        startThread(nextThreadId_++);
     }
     //整个服务端只有一个线程，也就是baseLoop
     if(numThreads_==0 && cb)
@@ -36,6 +34,45 @@ void EventLoopThreadPool::start(const ThreadInitCallBack& cb)
     }
 }
 
+void EventLoopThreadPool::startThread(int index)
+{
+    char buf[name_.size() + 32] = {0};
+    snprintf(buf,sizeof buf,"%s%d",name_.c_str(),index);
+    EventLoopThread *t = new EventLoopThread(threadInitCallback_,buf);
+    threads_.emplace_back(std::unique_ptr<EventLoopThread>(t));
+    loops_.emplace_back(t->startLoop());
+}
+
+EventLoop* EventLoopThreadPool::addLoop()
+{
+    startThread(nextThreadId_++);
+    return loops_.back();
+}
+
+bool EventLoopThreadPool::removeLoop(EventLoop* loop)
+{
+    for(size_t i = 0; i < loops_.size(); i++)
+    {
+        if(loops_[i] == loop)
+        {
+            retired_[loop] = std::move(threads_[i]);
+            threads_.erase(threads_.begin() + i);
+            loops_.erase(loops_.begin() + i);
+            if(next_ >= static_cast<int>(loops_.size()))
+            {
+                next_ = 0;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+void EventLoopThreadPool::stopLoop(EventLoop* loop)
+{
+    retired_.erase(loop);   //EventLoopThread析构时quit并join
+}
+
 //如果工作在多线程中，baseLoop默认以 轮询 的方式分配channel给subloop，获取下一个处理事件的loop
 EventLoop* EventLoopThreadPool::getNextLoop()
 {
@@ -0,0 +1,106 @@
+#include "Histogram.h"
+
+#include <algorithm>
+
+void HistogramSnapshot::merge(const HistogramSnapshot& other)
+{
+    if(counts.size() < other.counts.size())
+    {
+        counts.resize(other.counts.size(), 0);
+    }
+    for(size_t i = 0; i < other.counts.size(); i++)
+    {
+        counts[i] += other.counts[i];
+    }
+    count += other.count;
+    sum += other.sum;
+    max = std::max(max, other.max);
+}
+
+int64_t HistogramSnapshot::percentile(double q) const
+{
+    if(count == 0)
+    {
+        return 0;
+    }
+    // 第rank个样本（从1开始）落在哪个桶
+    uint64_t rank = static_cast<uint64_t>(q * count + 0.5);
+    rank = std::max<uint64_t>(1, std::min(rank, count));
+    uint64_t seen = 0;
+    for(size_t i = 0; i < counts.size(); i++)
+    {
+        seen += counts[i];
+        if(seen >= rank)
+        {
+            return std::min(Histogram::bucketUpperBound(static_cast<int>(i)), max);
+        }
+    }
+    return max;
+}
+
+Histogram::Histogram()
+    :sum_(0),
+    max_(0)
+{
+    for(std::atomic<uint64_t>& c : counts_)
+    {
+        c.store(0, std::memory_order_relaxed);
+    }
+}
+
+int Histogram::bucketIndex(int64_t value)
+{
+    if(value < kSubBuckets)
+    {
+        return value < 0 ? 0 : static_cast<int>(value);
+    }
+    // 最高位是第exponent位，shift之后剩下kSubBucketBits+1位，去掉最高位就是段内的下标
+    int exponent = 63 - __builtin_clzll(static_cast<uint64_t>(value));
+    if(exponent > kMaxExponent)
+    {
+        return kBuckets - 1;
+    }
+    int shift = exponent - kSubBucketBits;
+    int sub = static_cast<int>(value >> shift) - kSubBuckets;
+    return kSubBuckets + shift * kSubBuckets + sub;
+}
+
+int64_t Histogram::bucketUpperBound(int index)
+{
+    if(index < kSubBuckets)
+    {
+        return index;
+    }
+    int shift = (index - kSubBuckets) / kSubBuckets;
+    int64_t lower = static_cast<int64_t>((index - kSubBuckets) % kSubBuckets + kSubBuckets) << shift;
+    return lower + (int64_t(1) << shift) - 1;
+}
+
+void Histogram::record(int64_t value)
+{
+    if(value < 0)
+    {
+        value = 0;
+    }
+    std::atomic<uint64_t>& c = counts_[bucketIndex(value)];
+    c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    sum_.store(sum_.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    if(value > max_.load(std::memory_order_relaxed))
+    {
+        max_.store(value, std::memory_order_relaxed);
+    }
+}
+
+HistogramSnapshot Histogram::snapshot() const
+{
+    HistogramSnapshot snap;
+    snap.counts.resize(kBuckets);
+    for(int i = 0; i < kBuckets; i++)
+    {
+        snap.counts[i] = counts_[i].load(std::memory_order_relaxed);
+        snap.count += snap.counts[i];   //用桶的和做总数，和各个桶一致
+    }
+    snap.sum = sum_.load(std::memory_order_relaxed);
+    snap.max = max_.load(std::memory_order_relaxed);
+    return snap;
+}
@@ -0,0 +1,320 @@
+#include "HttpContext.h"
+#include "Buffer.h"
+
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+#include <algorithm>
+
+static bool equalsIgnoreCase(const char* data, size_t len, const char* literal)
+{
+    size_t n = strlen(literal);
+    return len == n && ::strncasecmp(data, literal, n) == 0;
+}
+
+HttpContext::HttpContext()
+{
+    reset();
+}
+
+void HttpContext::reset()
+{
+    state_ = kExpectRequestLine;
+    scanned_ = 0;
+    searchFrom_ = 0;
+    method_ = HttpRequest::kInvalid;
+    version_ = HttpRequest::kUnknown;
+    methodRange_ = pathRange_ = queryRange_ = bodyRange_ = Range{0, 0};
+    headerRanges_.clear();
+    chunked_ = false;
+    chunkRemaining_ = 0;
+    trailerStart_ = 0;
+    chunkedBody_.clear();
+}
+
+bool HttpContext::getLine(const Buffer* buf, Range* line)
+{
+    const char* base = buf->peek();
+    const char* crlf = buf->findCRLF(base + std::max(scanned_, searchFrom_));
+    if(crlf == nullptr)
+    {
+        // \r可能是最后一个字节，下次从它开始找
+        searchFrom_ = buf->readableBytes() > 0 ? buf->readableBytes() - 1 : 0;
+        return false;
+    }
+    line->offset = static_cast<uint32_t>(scanned_);
+    line->length = static_cast<uint32_t>(crlf - base - scanned_);
+    scanned_ = crlf - base + 2;
+    searchFrom_ = scanned_;
+    return true;
+}
+
+// GET /path?query HTTP/1.1
+bool HttpContext::parseRequestLine(const char* base, Range line)
+{
+    const char* start = base + line.offset;
+    const char* end = start + line.length;
+    const char* space = static_cast<const char*>(memchr(start, ' ', end - start));
+    if(space == nullptr)
+    {
+        return false;
+    }
+    size_t len = space - start;
+    if(equalsIgnoreCase(start, len, "GET")) method_ = HttpRequest::kGet;
+    else if(equalsIgnoreCase(start, len, "POST")) method_ = HttpRequest::kPost;
+    else if(equalsIgnoreCase(start, len, "HEAD")) method_ = HttpRequest::kHead;
+    else if(equalsIgnoreCase(start, len, "PUT")) method_ = HttpRequest::kPut;
+    else if(equalsIgnoreCase(start, len, "DELETE")) method_ = HttpRequest::kDelete;
+    else if(equalsIgnoreCase(start, len, "OPTIONS")) method_ = HttpRequest::kOptions;
+    else if(equalsIgnoreCase(start, len, "PATCH")) method_ = HttpRequest::kPatch;
+    else return false;
+    methodRange_ = Range{line.offset, static_cast<uint32_t>(len)};
+
+    start = space + 1;
+    space = static_cast<const char*>(memchr(start, ' ', end - start));
+    if(space == nullptr)
+    {
+        return false;
+    }
+    const char* question = static_cast<const char*>(memchr(start, '?', space - start));
+    if(question != nullptr)
+    {
+        pathRange_ = Range{static_cast<uint32_t>(start - base), static_cast<uint32_t>(question - start)};
+        queryRange_ = Range{static_cast<uint32_t>(question + 1 - base), static_cast<uint32_t>(space - question - 1)};
+    }
+    else
+    {
+        pathRange_ = Range{static_cast<uint32_t>(start - base), static_cast<uint32_t>(space - start)};
+    }
+
+    start = space + 1;
+    if(end - start != 8 || ::strncmp(start, "HTTP/1.", 7) != 0)
+    {
+        return false;
+    }
+    if(start[7] == '1') version_ = HttpRequest::kHttp11;
+    else if(start[7] == '0') version_ = HttpRequest::kHttp10;
+    else return false;
+    return true;
+}
+
+// Name: value，去掉value两边的空白
+bool HttpContext::parseHeader(const char* base, Range line)
+{
+    const char* start = base + line.offset;
+    const char* end = start + line.length;
+    const char* colon = static_cast<const char*>(memchr(start, ':', end - start));
+    if(colon == nullptr || colon == start)
+    {
+        return false;
+    }
+    const char* value = colon + 1;
+    while(value < end && (*value == ' ' || *value == '\t'))
+    {
+        ++value;
+    }
+    const char* valueEnd = end;
+    while(valueEnd > value && (valueEnd[-1] == ' ' || valueEnd[-1] == '\t'))
+    {
+        --valueEnd;
+    }
+    headerRanges_.emplace_back(Range{line.offset, static_cast<uint32_t>(colon - start)},
+                               Range{static_cast<uint32_t>(value - base), static_cast<uint32_t>(valueEnd - value)});
+    return true;
+}
+
+HttpContext::ParseResult HttpContext::headersComplete(const char* base)
+{
+    for(const auto& header : headerRanges_)
+    {
+        const char* name = base + header.first.offset;
+        const char* value = base + header.second.offset;
+        if(equalsIgnoreCase(name, header.first.length, "Transfer-Encoding"))
+        {
+            chunked_ = equalsIgnoreCase(value, header.second.length, "chunked");
+        }
+        else if(equalsIgnoreCase(name, header.first.length, "Content-Length"))
+        {
+            char* numEnd = nullptr;
+            unsigned long long length = ::strtoull(value, &numEnd, 10);
+            if(numEnd != value + header.second.length)
+            {
+                return kBadRequest;
+            }
+            if(length > kMaxBodyBytes)
+            {
+                return kTooLarge;
+            }
+            bodyRange_ = Range{static_cast<uint32_t>(scanned_), static_cast<uint32_t>(length)};
+        }
+    }
+
+    if(chunked_)
+    {
+        state_ = kExpectChunkSize;
+    }
+    else if(bodyRange_.length > 0)
+    {
+        state_ = kExpectBody;
+    }
+    else
+    {
+        state_ = kGotAll;
+    }
+    return kNeedMore;
+}
+
+HttpContext::ParseResult HttpContext::parse(Buffer* buf, Timestamp receiveTime)
+{
+    Range line;
+    while(state_ != kGotAll)
+    {
+        const char* base = buf->peek();
+        if(state_ == kExpectRequestLine)
+        {
+            if(!getLine(buf, &line))
+            {
+                return buf->readableBytes() > kMaxHeaderBytes ? kTooLarge : kNeedMore;
+            }
+            if(line.length == 0 && line.offset == 0)
+            {
+                // 请求之间多余的空行，跳过
+                buf->retrieve(2);
+                scanned_ = searchFrom_ = 0;
+                continue;
+            }
+            if(!parseRequestLine(base, line))
+            {
+                return kBadRequest;
+            }
+            receiveTime_ = receiveTime;
+            state_ = kExpectHeaders;
+        }
+        else if(state_ == kExpectHeaders)
+        {
+            if(!getLine(buf, &line))
+            {
+                return buf->readableBytes() > kMaxHeaderBytes ? kTooLarge : kNeedMore;
+            }
+            if(scanned_ > kMaxHeaderBytes)
+            {
+                return kTooLarge;
+            }
+            if(line.length == 0)
+            {
+                ParseResult result = headersComplete(base);
+                if(result != kNeedMore)
+                {
+                    return result;
+                }
+            }
+            else if(!parseHeader(base, line))
+            {
+                return kBadRequest;
+            }
+        }
+        else if(state_ == kExpectBody)
+        {
+            if(buf->readableBytes() - scanned_ < bodyRange_.length)
+            {
+                return kNeedMore;
+            }
+            scanned_ += bodyRange_.length;
+            state_ = kGotAll;
+        }
+        else if(state_ == kExpectChunkSize)
+        {
+            // chunk-size这一行和header行一样限制长度，否则对方一直不发\r\n就能让缓冲区无限增长
+            if(!getLine(buf, &line))
+            {
+                return buf->readableBytes() - scanned_ > kMaxHeaderBytes ? kTooLarge : kNeedMore;
+            }
+            if(line.length > kMaxHeaderBytes)
+            {
+                return kTooLarge;
+            }
+            // chunk-size [; chunk-ext]
+            char* numEnd = nullptr;
+            unsigned long size = ::strtoul(base + line.offset, &numEnd, 16);
+            if(numEnd == base + line.offset)
+            {
+                return kBadRequest;
+            }
+            // 不能写成chunkedBody_.size() + size，size接近ULONG_MAX时会回绕；这样检查之后chunkRemaining_ + 2也不会溢出
+            if(size > kMaxBodyBytes - chunkedBody_.size())
+            {
+                return kTooLarge;
+            }
+            chunkRemaining_ = size;
+            state_ = (size == 0) ? kExpectChunkTrailer : kExpectChunkData;
+            trailerStart_ = scanned_;
+        }
+        else if(state_ == kExpectChunkData)
+        {
+            // chunk数据后面跟着\r\n
+            if(buf->readableBytes() - scanned_ < chunkRemaining_ + 2)
+            {
+                return kNeedMore;
+            }
+            const char* data = base + scanned_;
+            if(data[chunkRemaining_] != '\r' || data[chunkRemaining_ + 1] != '\n')
+            {
+                return kBadRequest;
+            }
+            chunkedBody_.append(data, chunkRemaining_);
+            scanned_ += chunkRemaining_ + 2;
+            searchFrom_ = scanned_;
+            state_ = kExpectChunkSize;
+        }
+        else if(state_ == kExpectChunkTrailer)
+        {
+            // 忽略trailer，空行表示结束
+            if(!getLine(buf, &line))
+            {
+                return buf->readableBytes() - trailerStart_ > kMaxHeaderBytes ? kTooLarge : kNeedMore;
+            }
+            if(scanned_ - trailerStart_ > kMaxHeaderBytes)
+            {
+                return kTooLarge;
+            }
+            if(line.length == 0)
+            {
+                state_ = kGotAll;
+            }
+        }
+    }
+
+    buildRequest(buf);
+    return kGotRequest;
+}
+
+void HttpContext::buildRequest(const Buffer* buf)
+{
+    const char* base = buf->peek();
+    request_.reset();
+    request_.method_ = method_;
+    request_.version_ = version_;
+    request_.receiveTime_ = receiveTime_;
+    request_.methodString_ = std::string_view(base + methodRange_.offset, methodRange_.length);
+    request_.path_ = std::string_view(base + pathRange_.offset, pathRange_.length);
+    request_.query_ = std::string_view(base + queryRange_.offset, queryRange_.length);
+    for(const auto& header : headerRanges_)
+    {
+        request_.headers_.emplace_back(std::string_view(base + header.first.offset, header.first.length),
+                                       std::string_view(base + header.second.offset, header.second.length));
+    }
+    if(chunked_)
+    {
+        request_.body_ = chunkedBody_;
+    }
+    else
+    {
+        request_.body_ = std::string_view(base + bodyRange_.offset, bodyRange_.length);
+    }
+}
+
+void HttpContext::finishRequest(Buffer* buf)
+{
+    buf->retrieve(scanned_);
+    reset();
+}
@@ -0,0 +1,38 @@
+#include "HttpResponse.h"
+#include "Buffer.h"
+
+#include <stdio.h>
+
+void HttpResponse::appendToBuffer(Buffer* output, bool headOnly) const
+{
+    char buf[64];
+    int n = snprintf(buf, sizeof buf, "HTTP/1.1 %d ", statusCode_);
+    output->append(buf, n);
+    output->append(statusMessage_);
+    output->append("\r\n", 2);
+
+    if(closeConnection_)
+    {
+        output->append("Connection: close\r\n", 19);
+    }
+    else
+    {
+        output->append("Connection: Keep-Alive\r\n", 24);
+    }
+    n = snprintf(buf, sizeof buf, "Content-Length: %zu\r\n", body_.size());
+    output->append(buf, n);
+
+    for(const auto& header : headers_)
+    {
+        output->append(header.first);
+        output->append(": ", 2);
+        output->append(header.second);
+        output->append("\r\n", 2);
+    }
+
+    output->append("\r\n", 2);
+    if(!headOnly)
+    {
+        output->append(body_);
+    }
+}
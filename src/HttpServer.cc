@@ -0,0 +1,95 @@
+#include "HttpServer.h"
+#include "HttpContext.h"
+#include "HttpRequest.h"
+#include "HttpResponse.h"
+#include "Logger.h"
+
+static void defaultHttpCallback(const HttpRequest&, HttpResponse* resp)
+{
+    resp->setStatusCode(HttpResponse::k404NotFound);
+    resp->setStatusMessage("Not Found");
+    resp->setCloseConnection(true);
+}
+
+// 解析出错时的响应，发完就关闭连接
+static void appendErrorResponse(Buffer* output, HttpResponse::HttpStatusCode code, const char* message)
+{
+    HttpResponse resp(true);
+    resp.setStatusCode(code);
+    resp.setStatusMessage(message);
+    resp.appendToBuffer(output);
+}
+
+HttpServer::HttpServer(EventLoop* loop,
+                        const InetAddress& listenAddr,
+                        const std::string& name,
+                        TcpServer::Option option)
+    :loop_(loop),
+    httpCallback_(defaultHttpCallback),
+    server_(loop, listenAddr, name, option)
+{
+    server_.setConnectionCallback(std::bind(&HttpServer::onConnection, this, std::placeholders::_1));
+    server_.setMessageCallback(std::bind(&HttpServer::onMessage, this,
+                                std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+}
+
+void HttpServer::start()
+{
+    LOG_INFO("HttpServer[%s] starts listening \n", server_.name().c_str());
+    server_.start();
+}
+
+void HttpServer::onConnection(const TcpConnectionPtr& conn)
+{
+    if(conn->connected())
+    {
+        conn->setContext(HttpContext());
+    }
+}
+
+void HttpServer::onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp receiveTime)
+{
+    HttpContext* context = std::any_cast<HttpContext>(conn->getMutableContext());
+    // 流水线上的多个响应攒在loop线程共用的回复缓冲区里，只send一次
+    Buffer* output = TcpConnection::replyBuffer();
+    bool close = false;
+
+    while(!close)
+    {
+        HttpContext::ParseResult result = context->parse(buf, receiveTime);
+        if(result == HttpContext::kNeedMore)
+        {
+            break;
+        }
+        conn->countReadMessages(1);
+        if(result == HttpContext::kBadRequest)
+        {
+            appendErrorResponse(output, HttpResponse::k400BadRequest, "Bad Request");
+            close = true;
+            break;
+        }
+        if(result == HttpContext::kTooLarge)
+        {
+            appendErrorResponse(output, HttpResponse::k413PayloadTooLarge, "Payload Too Large");
+            close = true;
+            break;
+        }
+
+        const HttpRequest& req = context->request();
+        HttpResponse response(!req.keepAlive());
+        httpCallback_(req, &response);
+        response.appendToBuffer(output, req.method() == HttpRequest::kHead);
+        close = response.closeConnection();
+        context->finishRequest(buf);
+    }
+
+    if(output->readableBytes() > 0)
+    {
+        conn->send(output);
+    }
+    if(close)
+    {
+        buf->retrieveAll();
+        conn->shutdown();
+    }
+}
@@ -1,32 +1,131 @@
 #include "InetAddress.h"
 #include <strings.h>
 #include <string.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <algorithm>
 
 InetAddress::InetAddress(uint16_t port, std::string ip)
 {
     bzero(&addr_, sizeof addr_);
-    addr_.sin_family = AF_INET;
-    addr_.sin_port = htons(port);
-    addr_.sin_addr.s_addr = inet_addr(ip.c_str());
+    if(ip.find(':') != std::string::npos)
+    {
+        sockaddr_in6* addr6 = reinterpret_cast<sockaddr_in6*>(&addr_);
+        addr6->sin6_family = AF_INET6;
+        addr6->sin6_port = htons(port);
+        ::inet_pton(AF_INET6, ip.c_str(), &addr6->sin6_addr);
+        len_ = sizeof(sockaddr_in6);
+    }
+    else
+    {
+        sockaddr_in* addr4 = reinterpret_cast<sockaddr_in*>(&addr_);
+        addr4->sin_family = AF_INET;
+        addr4->sin_port = htons(port);
+        addr4->sin_addr.s_addr = inet_addr(ip.c_str());
+        len_ = sizeof(sockaddr_in);
+    }
 }
-    
+
+InetAddress::InetAddress(const sockaddr_in& addr)
+{
+    setSockaddr(reinterpret_cast<const sockaddr*>(&addr), sizeof addr);
+}
+
+InetAddress::InetAddress(const sockaddr_in6& addr)
+{
+    setSockaddr(reinterpret_cast<const sockaddr*>(&addr), sizeof addr);
+}
+
+InetAddress::InetAddress(const sockaddr* addr, socklen_t len)
+{
+    setSockaddr(addr, len);
+}
+
+InetAddress InetAddress::fromUnixPath(const std::string& path)
+{
+    sockaddr_un addr;
+    bzero(&addr, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    size_t len = std::min(path.size(), sizeof(addr.sun_path) - 1);
+    ::memcpy(addr.sun_path, path.data(), len);
+    if(len > 0 && path[0] == '@')
+    {
+        addr.sun_path[0] = '\0';    //抽象命名空间，长度按实际的名字算，不带结尾的'\0'
+    }
+    else
+    {
+        ++len;
+    }
+    return InetAddress(reinterpret_cast<const sockaddr*>(&addr),
+                       static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + len));
+}
+
+void InetAddress::setSockaddr(const sockaddr* addr, socklen_t len)
+{
+    bzero(&addr_, sizeof addr_);
+    len_ = std::min<socklen_t>(len, sizeof addr_);
+    ::memcpy(&addr_, addr, len_);
+}
+
+bool InetAddress::isUnixPath() const
+{
+    const sockaddr_un* addr = reinterpret_cast<const sockaddr_un*>(&addr_);
+    return isUnix() && len_ > offsetof(sockaddr_un, sun_path) && addr->sun_path[0] != '\0';
+}
+
 std::string InetAddress::toIp() const
 {
     char buf[64] = {0};
-    ::inet_ntop(AF_INET, &addr_.sin_addr, buf, sizeof buf);
+    if(family() == AF_INET6)
+    {
+        ::inet_ntop(AF_INET6, &reinterpret_cast<const sockaddr_in6*>(&addr_)->sin6_addr, buf, sizeof buf);
+        return buf;
+    }
+    if(family() == AF_UNIX)
+    {
+        const sockaddr_un* addr = reinterpret_cast<const sockaddr_un*>(&addr_);
+        if(len_ <= offsetof(sockaddr_un, sun_path))
+        {
+            return std::string();   //未命名的unix socket，比如客户端那一端
+        }
+        size_t pathLen = len_ - offsetof(sockaddr_un, sun_path);
+        if(addr->sun_path[0] == '\0')
+        {
+            return "@" + std::string(addr->sun_path + 1, pathLen - 1);
+        }
+        return std::string(addr->sun_path, strnlen(addr->sun_path, pathLen));
+    }
+    ::inet_ntop(AF_INET, &reinterpret_cast<const sockaddr_in*>(&addr_)->sin_addr, buf, sizeof buf);
     return buf;
 }
+
 std::string InetAddress::toIpPort() const
 {
-    char buf[64] = {0};
-    ::inet_ntop(AF_INET, &addr_.sin_addr, buf, sizeof buf);
-    size_t end = strlen(buf);
-    uint16_t port = ntohs(addr_.sin_port);
-    sprintf(buf+end, ":%u",port);
+    if(family() == AF_UNIX)
+    {
+        return toIp();
+    }
+    char buf[80] = {0};
+    if(family() == AF_INET6)
+    {
+        snprintf(buf, sizeof buf, "[%s]:%u", toIp().c_str(), toPort());
+    }
+    else
+    {
+        snprintf(buf, sizeof buf, "%s:%u", toIp().c_str(), toPort());
+    }
     return buf;
 }
+
 uint16_t InetAddress::toPort() const
 {
-    return ntohs(addr_.sin_port);
+    if(family() == AF_INET6)
+    {
+        return ntohs(reinterpret_cast<const sockaddr_in6*>(&addr_)->sin6_port);
+    }
+    if(family() == AF_INET)
+    {
+        return ntohs(reinterpret_cast<const sockaddr_in*>(&addr_)->sin_port);
+    }
+    return 0;
 }
-
@@ -0,0 +1,240 @@
+#include "Metrics.h"
+#include "EventLoop.h"
+#include "TcpServer.h"
+
+#include <algorithm>
+#include <stdio.h>
+
+namespace
+{
+// 一个loop的一次采样
+struct LoopSample
+{
+    std::string loop;
+    double values[12];
+    HistogramSnapshot histograms[3];
+};
+
+// 按这个顺序输出，LoopSample::values的下标和这里一一对应
+struct Family
+{
+    const char* name;
+    const char* type;
+    const char* help;
+};
+
+const Family kLoopFamilies[] = {
+    {"mymuduo_loop_iterations_total", "counter", "Number of poll calls."},
+    {"mymuduo_loop_events_total", "counter", "Ready events returned by poll."},
+    {"mymuduo_loop_poll_wait_seconds_total", "counter", "Time spent blocked in epoll_wait."},
+    {"mymuduo_loop_busy_seconds_total", "counter", "Time spent in event handlers and pending functors."},
+    {"mymuduo_loop_wakeups_total", "counter", "Wakeups through the loop's eventfd."},
+    {"mymuduo_loop_functors_executed_total", "counter", "Pending functors executed."},
+    {"mymuduo_loop_functor_budget_yields_total", "counter", "Iterations that left functors for the next round because the budget ran out."},
+    {"mymuduo_loop_pending_functors", "gauge", "Functors waiting to run."},
+    {"mymuduo_loop_read_bytes_total", "counter", "Bytes read from sockets of connections on this loop."},
+    {"mymuduo_loop_written_bytes_total", "counter", "Bytes written to sockets of connections on this loop."},
+    {"mymuduo_loop_connections", "gauge", "Connections owned by this loop."},
+    {"mymuduo_loop_output_buffer_bytes", "gauge", "Bytes queued in output buffers of connections on this loop."},
+};
+
+static_assert(sizeof kLoopFamilies / sizeof kLoopFamilies[0] == sizeof LoopSample::values / sizeof(double),
+                "kLoopFamilies and LoopSample::values must match");
+
+// 直方图按summary输出
+struct HistogramFamily
+{
+    const char* name;
+    const char* help;
+    Histogram LoopMetrics::* member;
+};
+
+const HistogramFamily kHistogramFamilies[] = {
+    {"mymuduo_loop_dispatch_lag_seconds", "Time from epoll_wait return to handling a ready channel.", &LoopMetrics::dispatchLag},
+    {"mymuduo_loop_message_callback_seconds", "Duration of MessageCallback invocations.", &LoopMetrics::messageCallback},
+    {"mymuduo_loop_functor_wait_seconds", "Time from queueInLoop to execution of a functor.", &LoopMetrics::functorWait},
+};
+
+static_assert(sizeof kHistogramFamilies / sizeof kHistogramFamilies[0] == sizeof LoopSample::histograms / sizeof(HistogramSnapshot),
+                "kHistogramFamilies and LoopSample::histograms must match");
+
+const double kQuantiles[] = {0.5, 0.9, 0.99, 0.999, 1.0};
+
+struct ServerSample
+{
+    std::string server;
+    double values[4];
+};
+
+const Family kServerFamilies[] = {
+    {"mymuduo_server_accepted_total", "counter", "Connections accepted."},
+    {"mymuduo_server_rejected_total", "counter", "Connections closed right after accept by admission control."},
+    {"mymuduo_server_connections", "gauge", "Open connections."},
+    {"mymuduo_server_migrations_total", "counter", "Connections migrated between loops."},
+};
+
+static_assert(sizeof kServerFamilies / sizeof kServerFamilies[0] == sizeof ServerSample::values / sizeof(double),
+                "kServerFamilies and ServerSample::values must match");
+
+// 标签值里的反斜杠、双引号和换行要转义
+std::string escapeLabel(const std::string& value)
+{
+    std::string escaped;
+    for(char ch : value)
+    {
+        if(ch == '\\' || ch == '"')
+        {
+            escaped += '\\';
+            escaped += ch;
+        }
+        else if(ch == '\n')
+        {
+            escaped += "\\n";
+        }
+        else
+        {
+            escaped += ch;
+        }
+    }
+    return escaped;
+}
+
+void appendSample(std::string* out, const char* name, const char* label, const std::string& labelValue, double value)
+{
+    char line[256];
+    snprintf(line, sizeof line, "%s{%s=\"%s\"} %.15g\n", name, label, escapeLabel(labelValue).c_str(), value);
+    out->append(line);
+}
+
+void appendHeader(std::string* out, const Family& family)
+{
+    out->append("# HELP ").append(family.name).append(" ").append(family.help).append("\n");
+    out->append("# TYPE ").append(family.name).append(" ").append(family.type).append("\n");
+}
+}
+
+MetricsRegistry& MetricsRegistry::instance()
+{
+    // 故意不析构，全局的EventLoop/TcpServer析构时还要注销
+    static MetricsRegistry* registry = new MetricsRegistry;
+    return *registry;
+}
+
+void MetricsRegistry::addLoop(EventLoop* loop)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    loops_.push_back(loop);
+}
+
+void MetricsRegistry::removeLoop(EventLoop* loop)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    loops_.erase(std::remove(loops_.begin(), loops_.end(), loop), loops_.end());
+}
+
+void MetricsRegistry::addServer(TcpServer* server)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    servers_.push_back(server);
+}
+
+void MetricsRegistry::removeServer(TcpServer* server)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    servers_.erase(std::remove(servers_.begin(), servers_.end(), server), servers_.end());
+}
+
+std::string MetricsRegistry::prometheusText()
+{
+    std::vector<LoopSample> loopSamples;
+    std::vector<ServerSample> serverSamples;
+    {
+        // 持有锁期间登记的对象不会析构，只读计数器，很快
+        std::lock_guard<std::mutex> lock(mutex_);
+        for(EventLoop* loop : loops_)
+        {
+            const LoopMetrics& m = *loop->metrics();
+            PendingFunctorStats functors = loop->pendingFunctorStats();
+            LoopSample sample;
+            sample.loop = std::to_string(loop->threadId());
+            double* v = sample.values;
+            v[0] = m.iterations.load(std::memory_order_relaxed);
+            v[1] = m.events.load(std::memory_order_relaxed);
+            v[2] = m.pollWaitUs.load(std::memory_order_relaxed) / 1e6;
+            v[3] = m.busyUs.load(std::memory_order_relaxed) / 1e6;
+            v[4] = m.wakeups.load(std::memory_order_relaxed);
+            v[5] = functors.executed;
+            v[6] = functors.budgetYields;
+            v[7] = functors.queued;
+            v[8] = m.bytesRead.load(std::memory_order_relaxed);
+            v[9] = m.bytesWritten.load(std::memory_order_relaxed);
+            v[10] = m.connections.load(std::memory_order_relaxed);
+            v[11] = m.outputBytes.load(std::memory_order_relaxed);
+            for(size_t i = 0; i < sizeof kHistogramFamilies / sizeof kHistogramFamilies[0]; i++)
+            {
+                sample.histograms[i] = (m.*kHistogramFamilies[i].member).snapshot();
+            }
+            loopSamples.push_back(std::move(sample));
+        }
+        for(TcpServer* server : servers_)
+        {
+            ServerSample sample;
+            sample.server = server->name();
+            sample.values[0] = server->numAccepted();
+            sample.values[1] = server->numRejected();
+            sample.values[2] = server->numConnections();
+            sample.values[3] = server->numMigrations();
+            serverSamples.push_back(std::move(sample));
+        }
+    }
+
+    std::string out;
+    for(size_t i = 0; i < sizeof kLoopFamilies / sizeof kLoopFamilies[0]; i++)
+    {
+        appendHeader(&out, kLoopFamilies[i]);
+        for(const LoopSample& sample : loopSamples)
+        {
+            appendSample(&out, kLoopFamilies[i].name, "loop", sample.loop, sample.values[i]);
+        }
+    }
+    for(size_t i = 0; i < sizeof kHistogramFamilies / sizeof kHistogramFamilies[0]; i++)
+    {
+        const HistogramFamily& family = kHistogramFamilies[i];
+        appendHeader(&out, Family{family.name, "summary", family.help});
+        std::string sumName = std::string(family.name) + "_sum";
+        std::string countName = std::string(family.name) + "_count";
+        for(const LoopSample& sample : loopSamples)
+        {
+            const HistogramSnapshot& snap = sample.histograms[i];
+            for(double q : kQuantiles)
+            {
+                char line[256];
+                snprintf(line, sizeof line, "%s{loop=\"%s\",quantile=\"%g\"} %.15g\n",
+                        family.name, escapeLabel(sample.loop).c_str(), q, snap.percentile(q) / 1e6);
+                out.append(line);
+            }
+            appendSample(&out, sumName.c_str(), "loop", sample.loop, snap.sum / 1e6);
+            appendSample(&out, countName.c_str(), "loop", sample.loop, static_cast<double>(snap.count));
+        }
+    }
+    for(size_t i = 0; i < sizeof kServerFamilies / sizeof kServerFamilies[0]; i++)
+    {
+        appendHeader(&out, kServerFamilies[i]);
+        for(const ServerSample& sample : serverSamples)
+        {
+            appendSample(&out, kServerFamilies[i].name, "server", sample.server, sample.values[i]);
+        }
+    }
+    return out;
+}
+
+HistogramSnapshot MetricsRegistry::mergedHistogram(Histogram LoopMetrics::* which)
+{
+    HistogramSnapshot merged;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for(EventLoop* loop : loops_)
+    {
+        merged.merge((loop->metrics()->*which).snapshot());
+    }
+    return merged;
+}
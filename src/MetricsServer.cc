@@ -0,0 +1,27 @@
+#include "MetricsServer.h"
+#include "Metrics.h"
+#include "HttpRequest.h"
+#include "HttpResponse.h"
+
+MetricsServer::MetricsServer(EventLoop* loop, const InetAddress& listenAddr, const std::string& name)
+    :server_(loop, listenAddr, name)
+{
+    server_.setHttpCallback(std::bind(&MetricsServer::onRequest, this, std::placeholders::_1, std::placeholders::_2));
+}
+
+void MetricsServer::onRequest(const HttpRequest& req, HttpResponse* resp)
+{
+    if(req.path() == "/metrics")
+    {
+        resp->setStatusCode(HttpResponse::k200Ok);
+        resp->setStatusMessage("OK");
+        resp->setContentType("text/plain; version=0.0.4");
+        resp->setBody(MetricsRegistry::instance().prometheusText());
+    }
+    else
+    {
+        resp->setStatusCode(HttpResponse::k404NotFound);
+        resp->setStatusMessage("Not Found");
+        resp->setCloseConnection(true);
+    }
+}
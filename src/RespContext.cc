@@ -0,0 +1,195 @@
+#include "RespContext.h"
+#include "Buffer.h"
+
+#include <string.h>
+#include <algorithm>
+
+// 解析"123"、"-1"这样的整数，整行都必须是数字。最多18位，result * 10 + d不会溢出int64_t
+static bool parseInteger(const char* start, size_t len, int64_t* value)
+{
+    if(len == 0)
+    {
+        return false;
+    }
+    bool negative = false;
+    size_t i = 0;
+    if(start[0] == '-')
+    {
+        negative = true;
+        i = 1;
+        if(len == 1)
+        {
+            return false;
+        }
+    }
+    if(len - i > 18)
+    {
+        return false;
+    }
+    int64_t result = 0;
+    for(; i < len; i++)
+    {
+        if(start[i] < '0' || start[i] > '9')
+        {
+            return false;
+        }
+        result = result * 10 + (start[i] - '0');
+    }
+    *value = negative ? -result : result;
+    return true;
+}
+
+RespContext::RespContext()
+{
+    reset();
+}
+
+void RespContext::reset()
+{
+    state_ = kExpectStart;
+    scanned_ = 0;
+    searchFrom_ = 0;
+    argsRemaining_ = 0;
+    bulkLength_ = 0;
+    argRanges_.clear();
+}
+
+bool RespContext::getLine(const Buffer* buf, Range* line)
+{
+    const char* base = buf->peek();
+    const char* crlf = buf->findCRLF(base + std::max(scanned_, searchFrom_));
+    if(crlf == nullptr)
+    {
+        searchFrom_ = buf->readableBytes() > 0 ? buf->readableBytes() - 1 : 0;
+        return false;
+    }
+    line->offset = static_cast<uint32_t>(scanned_);
+    line->length = static_cast<uint32_t>(crlf - base - scanned_);
+    scanned_ = crlf - base + 2;
+    searchFrom_ = scanned_;
+    return true;
+}
+
+// inline命令：按空白分隔参数，不处理引号
+bool RespContext::parseInline(const char* base, Range line)
+{
+    const char* p = base + line.offset;
+    const char* end = p + line.length;
+    while(p < end)
+    {
+        while(p < end && (*p == ' ' || *p == '\t'))
+        {
+            ++p;
+        }
+        const char* start = p;
+        while(p < end && *p != ' ' && *p != '\t')
+        {
+            ++p;
+        }
+        if(p > start)
+        {
+            argRanges_.push_back(Range{static_cast<uint32_t>(start - base), static_cast<uint32_t>(p - start)});
+        }
+    }
+    return !argRanges_.empty();
+}
+
+RespContext::ParseResult RespContext::parse(Buffer* buf)
+{
+    Range line;
+    while(state_ != kGotAll)
+    {
+        const char* base = buf->peek();
+        if(state_ == kExpectStart)
+        {
+            if(!getLine(buf, &line))
+            {
+                return buf->readableBytes() > kMaxInlineBytes ? kTooLarge : kNeedMore;
+            }
+            if(base[line.offset] != '*')
+            {
+                if(!parseInline(base, line))
+                {
+                    // 空行，跳过
+                    buf->retrieve(scanned_);
+                    reset();
+                    continue;
+                }
+                state_ = kGotAll;
+                break;
+            }
+            int64_t argc;
+            if(!parseInteger(base + line.offset + 1, line.length - 1, &argc))
+            {
+                return kProtocolError;
+            }
+            if(argc > kMaxArgs)
+            {
+                return kTooLarge;
+            }
+            if(argc <= 0)
+            {
+                // *0和*-1，redis也是直接忽略
+                buf->retrieve(scanned_);
+                reset();
+                continue;
+            }
+            argsRemaining_ = argc;
+            argRanges_.reserve(static_cast<size_t>(std::min<int64_t>(argc, 1024)));
+            state_ = kExpectBulkLength;
+        }
+        else if(state_ == kExpectBulkLength)
+        {
+            if(!getLine(buf, &line))
+            {
+                return buf->readableBytes() - scanned_ > kMaxInlineBytes ? kTooLarge : kNeedMore;
+            }
+            if(line.length < 2 || base[line.offset] != '$'
+                || !parseInteger(base + line.offset + 1, line.length - 1, &bulkLength_) || bulkLength_ < 0)
+            {
+                return kProtocolError;
+            }
+            if(bulkLength_ > kMaxBulkBytes)
+            {
+                return kTooLarge;
+            }
+            state_ = kExpectBulkData;
+        }
+        else if(state_ == kExpectBulkData)
+        {
+            // 参数后面跟着\r\n，长度已知，不需要扫描
+            if(buf->readableBytes() - scanned_ < static_cast<size_t>(bulkLength_) + 2)
+            {
+                return kNeedMore;
+            }
+            const char* data = base + scanned_;
+            if(data[bulkLength_] != '\r' || data[bulkLength_ + 1] != '\n')
+            {
+                return kProtocolError;
+            }
+            argRanges_.push_back(Range{static_cast<uint32_t>(scanned_), static_cast<uint32_t>(bulkLength_)});
+            scanned_ += bulkLength_ + 2;
+            searchFrom_ = scanned_;
+            state_ = (--argsRemaining_ == 0) ? kGotAll : kExpectBulkLength;
+        }
+    }
+
+    buildCommand(buf);
+    return kGotCommand;
+}
+
+void RespContext::buildCommand(const Buffer* buf)
+{
+    const char* base = buf->peek();
+    command_.args_.clear();    //保留容量，下一条命令不用再分配
+    for(const Range& range : argRanges_)
+    {
+        command_.args_.emplace_back(base + range.offset, range.length);
+    }
+}
+
+void RespContext::finishCommand(Buffer* buf)
+{
+    buf->retrieve(scanned_);
+    reset();
+}
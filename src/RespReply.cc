@@ -0,0 +1,112 @@
+#include "RespReply.h"
+#include "Buffer.h"
+
+#include <stdio.h>
+
+const std::string_view RespReply::kOk("+OK\r\n");
+const std::string_view RespReply::kPong("+PONG\r\n");
+
+// 类型前缀加上十进制整数，比snprintf快
+static void appendPrefixedInteger(Buffer* output, char prefix, int64_t value)
+{
+    char buf[24];
+    char* end = buf + sizeof buf;
+    char* p = end;
+    uint64_t n = value < 0 ? -static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+    *--p = '\n';
+    *--p = '\r';
+    do
+    {
+        *--p = static_cast<char>('0' + n % 10);
+        n /= 10;
+    } while(n != 0);
+    if(value < 0)
+    {
+        *--p = '-';
+    }
+    *--p = prefix;
+    output->append(p, end - p);
+}
+
+void RespReply::appendSimpleString(Buffer* output, std::string_view str)
+{
+    output->append("+", 1);
+    output->append(str.data(), str.size());
+    output->append("\r\n", 2);
+}
+
+void RespReply::appendError(Buffer* output, std::string_view message)
+{
+    output->append("-", 1);
+    output->append(message.data(), message.size());
+    output->append("\r\n", 2);
+}
+
+void RespReply::appendInteger(Buffer* output, int64_t value)
+{
+    appendPrefixedInteger(output, ':', value);
+}
+
+void RespReply::appendBulkString(Buffer* output, std::string_view str)
+{
+    appendPrefixedInteger(output, '$', static_cast<int64_t>(str.size()));
+    output->append(str.data(), str.size());
+    output->append("\r\n", 2);
+}
+
+void RespReply::appendArrayHeader(Buffer* output, size_t count)
+{
+    appendPrefixedInteger(output, '*', static_cast<int64_t>(count));
+}
+
+void RespReply::appendNull(Buffer* output, int protocolVersion)
+{
+    if(protocolVersion >= 3)
+    {
+        output->append("_\r\n", 3);
+    }
+    else
+    {
+        output->append("$-1\r\n", 5);
+    }
+}
+
+void RespReply::appendMapHeader(Buffer* output, size_t count, int protocolVersion)
+{
+    if(protocolVersion >= 3)
+    {
+        appendPrefixedInteger(output, '%', static_cast<int64_t>(count));
+    }
+    else
+    {
+        appendPrefixedInteger(output, '*', static_cast<int64_t>(count * 2));
+    }
+}
+
+void RespReply::appendDouble(Buffer* output, double value, int protocolVersion)
+{
+    char buf[32];
+    int len = snprintf(buf, sizeof buf, "%.17g", value);
+    if(protocolVersion >= 3)
+    {
+        output->append(",", 1);
+        output->append(buf, len);
+        output->append("\r\n", 2);
+    }
+    else
+    {
+        appendBulkString(output, std::string_view(buf, len));
+    }
+}
+
+void RespReply::appendBoolean(Buffer* output, bool value, int protocolVersion)
+{
+    if(protocolVersion >= 3)
+    {
+        output->append(value ? "#t\r\n" : "#f\r\n", 4);
+    }
+    else
+    {
+        output->append(value ? ":1\r\n" : ":0\r\n", 4);
+    }
+}
@@ -0,0 +1,148 @@
+#include "RespServer.h"
+#include "RespContext.h"
+#include "RespCommand.h"
+#include "RespReply.h"
+#include "Logger.h"
+
+#include <ctype.h>
+
+static void defaultCommandHandler(const TcpConnectionPtr&, const RespCommand& command, Buffer* output)
+{
+    std::string message("ERR unknown command '");
+    message.append(command.name().data(), command.name().size());
+    message.append("'");
+    RespReply::appendError(output, message);
+}
+
+// 命令名一般不超过15个字节，std::string的小字符串优化保证这里不分配内存
+static void toLower(std::string_view name, std::string* lower)
+{
+    lower->resize(name.size());
+    for(size_t i = 0; i < name.size(); i++)
+    {
+        (*lower)[i] = static_cast<char>(::tolower(static_cast<unsigned char>(name[i])));
+    }
+}
+
+RespServer::RespServer(EventLoop* loop,
+                        const InetAddress& listenAddr,
+                        const std::string& name,
+                        TcpServer::Option option)
+    :loop_(loop),
+    defaultHandler_(defaultCommandHandler),
+    server_(loop, listenAddr, name, option)
+{
+    server_.setConnectionCallback(std::bind(&RespServer::onConnection, this, std::placeholders::_1));
+    server_.setMessageCallback(std::bind(&RespServer::onMessage, this,
+                                std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+}
+
+void RespServer::registerCommand(const std::string& name, const CommandHandler& handler)
+{
+    std::string lower;
+    toLower(name, &lower);
+    handlers_[lower] = handler;
+}
+
+void RespServer::start()
+{
+    LOG_INFO("RespServer[%s] starts listening \n", server_.name().c_str());
+    server_.start();
+}
+
+void RespServer::onConnection(const TcpConnectionPtr& conn)
+{
+    if(conn->connected())
+    {
+        conn->setContext(RespContext());
+    }
+}
+
+void RespServer::onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+{
+    RespContext* context = std::any_cast<RespContext>(conn->getMutableContext());
+    // 流水线上的多条回复攒在loop线程共用的回复缓冲区里，只send一次
+    Buffer* output = TcpConnection::replyBuffer();
+    bool close = false;
+
+    while(!close)
+    {
+        RespContext::ParseResult result = context->parse(buf);
+        if(result == RespContext::kNeedMore)
+        {
+            break;
+        }
+        conn->countReadMessages(1);
+        if(result != RespContext::kGotCommand)
+        {
+            RespReply::appendError(output, result == RespContext::kTooLarge
+                                            ? "ERR Protocol error: too big request"
+                                            : "ERR Protocol error");
+            close = true;
+            break;
+        }
+
+        const RespCommand& command = context->command();
+        if(command.nameEquals("HELLO"))
+        {
+            // HELLO [protover]，只支持2和3，不处理AUTH和SETNAME
+            int version = context->protocolVersion();
+            if(command.argc() >= 2)
+            {
+                std::string_view arg = command.arg(1);
+                version = (arg == "2") ? 2 : (arg == "3") ? 3 : 0;
+            }
+            if(version == 0)
+            {
+                RespReply::appendError(output, "NOPROTO unsupported protocol version");
+            }
+            else
+            {
+                context->setProtocolVersion(version);
+                RespReply::appendMapHeader(output, 3, version);
+                RespReply::appendBulkString(output, "server");
+                RespReply::appendBulkString(output, "mymuduo");
+                RespReply::appendBulkString(output, "version");
+                RespReply::appendBulkString(output, "1.0.0");
+                RespReply::appendBulkString(output, "proto");
+                RespReply::appendInteger(output, version);
+            }
+        }
+        else
+        {
+            close = !dispatch(conn, command, output);
+        }
+        context->finishCommand(buf);
+    }
+
+    if(output->readableBytes() > 0)
+    {
+        conn->send(output);
+    }
+    if(close)
+    {
+        buf->retrieveAll();
+        conn->shutdown();
+    }
+}
+
+bool RespServer::dispatch(const TcpConnectionPtr& conn, const RespCommand& command, Buffer* output)
+{
+    if(command.nameEquals("QUIT"))
+    {
+        output->append(RespReply::kOk.data(), RespReply::kOk.size());
+        return false;
+    }
+    thread_local std::string lower;
+    toLower(command.name(), &lower);
+    auto it = handlers_.find(lower);
+    if(it != handlers_.end())
+    {
+        it->second(conn, command, output);
+    }
+    else
+    {
+        defaultHandler_(conn, command, output);
+    }
+    return true;
+}
@@ -0,0 +1,187 @@
+#include "RpcClient.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+#include <memory>
+
+RpcClient::RpcClient(EventLoop* loop, const InetAddress& serverAddr, const std::string& name)
+    :loop_(loop),
+    timeoutSeconds_(0),
+    nextId_(1),
+    flushQueued_(false),
+    client_(loop, serverAddr, name)
+{
+    client_.setConnectionCallback(std::bind(&RpcClient::onConnection, this, std::placeholders::_1));
+    client_.setMessageCallback(std::bind(&RpcClient::onMessage, this,
+                                std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+}
+
+RpcClient::~RpcClient()
+{
+    for(auto& item : pending_)
+    {
+        if(item.second.timer.valid())
+        {
+            loop_->cancel(item.second.timer);
+        }
+    }
+}
+
+void RpcClient::call(uint16_t methodId, std::string_view request, ResponseCallback cb)
+{
+    if(loop_->isInLoopThread())
+    {
+        callInLoop(methodId, request, std::move(cb));
+    }
+    else
+    {
+        std::string copy(request);
+        loop_->runInLoop([this, methodId, copy, cb]() { callInLoop(methodId, copy, cb); });
+    }
+}
+
+void RpcClient::call(uint16_t methodId, const RpcCodec::PayloadWriter& writer, ResponseCallback cb)
+{
+    if(loop_->isInLoopThread())
+    {
+        uint64_t id = addPending(std::move(cb));
+        size_t offset = RpcCodec::beginMessage(&outbox_, RpcCodec::kRequest, methodId, id);
+        writer(&outbox_);
+        RpcCodec::endMessage(&outbox_, offset);
+        scheduleFlush();
+    }
+    else
+    {
+        // 其他线程不能碰outbox_，先写进一个临时缓冲区
+        Buffer payload;
+        writer(&payload);
+        call(methodId, payload.retrieveAllAsString(), std::move(cb));
+    }
+}
+
+std::future<RpcClient::Result> RpcClient::call(uint16_t methodId, std::string_view request)
+{
+    auto promise = std::make_shared<std::promise<Result>>();
+    std::future<Result> future = promise->get_future();
+    call(methodId, request, [promise](uint16_t status, std::string_view payload) {
+        promise->set_value(Result{status, std::string(payload)});
+    });
+    return future;
+}
+
+void RpcClient::callInLoop(uint16_t methodId, std::string_view request, ResponseCallback cb)
+{
+    uint64_t id = addPending(std::move(cb));
+    RpcCodec::appendMessage(&outbox_, RpcCodec::kRequest, methodId, id, request);
+    scheduleFlush();
+}
+
+uint64_t RpcClient::addPending(ResponseCallback cb)
+{
+    uint64_t id = nextId_++;
+    PendingCall& call = pending_[id];
+    call.callback = std::move(cb);
+    if(timeoutSeconds_ > 0)
+    {
+        call.timer = loop_->runAfter(timeoutSeconds_, std::bind(&RpcClient::onTimeout, this, id));
+    }
+    return id;
+}
+
+void RpcClient::scheduleFlush()
+{
+    // 没有连接时先攒着，连接建立时再发
+    if(!flushQueued_ && conn_)
+    {
+        flushQueued_ = true;
+        loop_->queueInLoop(std::bind(&RpcClient::flush, this));
+    }
+}
+
+void RpcClient::flush()
+{
+    flushQueued_ = false;
+    if(conn_ && outbox_.readableBytes() > 0)
+    {
+        conn_->send(&outbox_);
+    }
+}
+
+void RpcClient::onTimeout(uint64_t id)
+{
+    auto it = pending_.find(id);
+    if(it != pending_.end())
+    {
+        ResponseCallback cb = std::move(it->second.callback);
+        pending_.erase(it);
+        cb(RpcCodec::kTimeout, std::string_view());
+    }
+}
+
+void RpcClient::failAll(uint16_t status)
+{
+    // 回调里可能发起新的请求，先把pending_换出来
+    std::unordered_map<uint64_t, PendingCall> pending;
+    pending.swap(pending_);
+    outbox_.retrieveAll();
+    for(auto& item : pending)
+    {
+        if(item.second.timer.valid())
+        {
+            loop_->cancel(item.second.timer);
+        }
+        item.second.callback(status, std::string_view());
+    }
+}
+
+void RpcClient::onConnection(const TcpConnectionPtr& conn)
+{
+    if(conn->connected())
+    {
+        conn->setTcpNoDelay(true);
+        conn_ = conn;
+        scheduleFlush();
+    }
+    else
+    {
+        conn_.reset();
+        failAll(RpcCodec::kConnectionLost);
+    }
+    if(connectionCallback_)
+    {
+        connectionCallback_(conn);
+    }
+}
+
+void RpcClient::onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+{
+    while(true)
+    {
+        RpcCodec::Header header;
+        RpcCodec::ParseResult result = RpcCodec::parse(buf, &header);
+        if(result == RpcCodec::kNeedMore)
+        {
+            break;
+        }
+        if(result != RpcCodec::kGotMessage || header.type != RpcCodec::kResponse)
+        {
+            LOG_ERROR("RpcClient - bad message from [%s], closing \n", conn->name().c_str());
+            buf->retrieveAll();
+            conn->shutdown();
+            break;
+        }
+
+        auto it = pending_.find(header.id);
+        if(it != pending_.end())    //找不到说明已经超时了
+        {
+            ResponseCallback cb = std::move(it->second.callback);
+            if(it->second.timer.valid())
+            {
+                loop_->cancel(it->second.timer);
+            }
+            pending_.erase(it);
+            cb(header.code, std::string_view(buf->peek() + RpcCodec::kHeaderLength, header.payloadLength));
+        }
+        buf->retrieve(RpcCodec::kHeaderLength + header.payloadLength);
+    }
+}
@@ -0,0 +1,72 @@
+#include "RpcCodec.h"
+#include "Buffer.h"
+
+#include <endian.h>
+#include <string.h>
+
+RpcCodec::ParseResult RpcCodec::parse(const Buffer* buf, Header* header)
+{
+    if(buf->readableBytes() < kHeaderLength)
+    {
+        return kNeedMore;
+    }
+    const char* data = buf->peek();
+    uint32_t length;
+    uint16_t code;
+    uint64_t id;
+    ::memcpy(&length, data, 4);
+    ::memcpy(&code, data + 6, 2);
+    ::memcpy(&id, data + 8, 8);
+    length = be32toh(length);
+    uint8_t type = static_cast<uint8_t>(data[4]);
+    if(type > kResponse)
+    {
+        return kBadMessage;
+    }
+    if(length > kMaxPayloadLength)
+    {
+        return kTooLarge;
+    }
+    if(buf->readableBytes() < kHeaderLength + length)
+    {
+        return kNeedMore;
+    }
+    header->payloadLength = length;
+    header->type = static_cast<Type>(type);
+    header->code = be16toh(code);
+    header->id = be64toh(id);
+    return kGotMessage;
+}
+
+size_t RpcCodec::beginMessage(Buffer* output, Type type, uint16_t code, uint64_t id)
+{
+    size_t offset = output->readableBytes();
+    char header[kHeaderLength] = { 0 };
+    header[4] = static_cast<char>(type);
+    code = htobe16(code);
+    id = htobe64(id);
+    ::memcpy(header + 6, &code, 2);
+    ::memcpy(header + 8, &id, 8);
+    output->append(header, kHeaderLength);
+    return offset;
+}
+
+void RpcCodec::endMessage(Buffer* output, size_t headerOffset)
+{
+    uint32_t length = htobe32(static_cast<uint32_t>(output->readableBytes() - headerOffset - kHeaderLength));
+    ::memcpy(output->beginRead() + headerOffset, &length, 4);
+}
+
+void RpcCodec::endMessage(Buffer* output, size_t headerOffset, uint16_t code)
+{
+    endMessage(output, headerOffset);
+    code = htobe16(code);
+    ::memcpy(output->beginRead() + headerOffset + 6, &code, 2);
+}
+
+void RpcCodec::appendMessage(Buffer* output, Type type, uint16_t code, uint64_t id, std::string_view payload)
+{
+    size_t offset = beginMessage(output, type, code, id);
+    output->append(payload.data(), payload.size());
+    endMessage(output, offset);
+}
@@ -0,0 +1,105 @@
+#include "RpcServer.h"
+#include "Logger.h"
+
+void RpcResponder::reply(uint16_t status, std::string_view payload) const
+{
+    TcpConnectionPtr conn = conn_.lock();
+    if(conn)
+    {
+        Buffer output(RpcCodec::kHeaderLength + payload.size());
+        RpcCodec::appendMessage(&output, RpcCodec::kResponse, status, id_, payload);
+        conn->send(&output);
+    }
+}
+
+void RpcResponder::reply(uint16_t status, const RpcCodec::PayloadWriter& writer) const
+{
+    TcpConnectionPtr conn = conn_.lock();
+    if(conn)
+    {
+        Buffer output;
+        size_t offset = RpcCodec::beginMessage(&output, RpcCodec::kResponse, status, id_);
+        writer(&output);
+        RpcCodec::endMessage(&output, offset);
+        conn->send(&output);
+    }
+}
+
+RpcServer::RpcServer(EventLoop* loop,
+                        const InetAddress& listenAddr,
+                        const std::string& name,
+                        TcpServer::Option option)
+    :loop_(loop),
+    server_(loop, listenAddr, name, option)
+{
+    server_.setMessageCallback(std::bind(&RpcServer::onMessage, this,
+                                std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+}
+
+void RpcServer::registerMethod(uint16_t methodId, const MethodHandler& handler)
+{
+    methods_[methodId] = Method{handler, AsyncMethodHandler()};
+}
+
+void RpcServer::registerAsyncMethod(uint16_t methodId, const AsyncMethodHandler& handler)
+{
+    methods_[methodId] = Method{MethodHandler(), handler};
+}
+
+void RpcServer::start()
+{
+    LOG_INFO("RpcServer[%s] starts listening \n", server_.name().c_str());
+    server_.start();
+}
+
+void RpcServer::onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+{
+    // 同步handler的响应攒在loop线程共用的回复缓冲区里，只send一次
+    Buffer* output = TcpConnection::replyBuffer();
+    bool close = false;
+
+    while(true)
+    {
+        RpcCodec::Header header;
+        RpcCodec::ParseResult result = RpcCodec::parse(buf, &header);
+        if(result == RpcCodec::kNeedMore)
+        {
+            break;
+        }
+        conn->countReadMessages(1);
+        if(result != RpcCodec::kGotMessage || header.type != RpcCodec::kRequest)
+        {
+            LOG_ERROR("RpcServer - bad message from [%s], closing \n", conn->name().c_str());
+            close = true;
+            break;
+        }
+
+        std::string_view request(buf->peek() + RpcCodec::kHeaderLength, header.payloadLength);
+        auto it = methods_.find(header.code);
+        if(it == methods_.end())
+        {
+            RpcCodec::appendMessage(output, RpcCodec::kResponse, RpcCodec::kNoSuchMethod, header.id, std::string_view());
+        }
+        else if(it->second.handler)
+        {
+            size_t offset = RpcCodec::beginMessage(output, RpcCodec::kResponse, RpcCodec::kOk, header.id);
+            uint16_t status = it->second.handler(conn, request, output);
+            RpcCodec::endMessage(output, offset, status);
+        }
+        else
+        {
+            it->second.asyncHandler(conn, request, RpcResponder(conn, header.id));
+        }
+        buf->retrieve(RpcCodec::kHeaderLength + header.payloadLength);
+    }
+
+    if(output->readableBytes() > 0)
+    {
+        conn->send(output);
+    }
+    if(close)
+    {
+        buf->retrieveAll();
+        conn->shutdown();
+    }
+}
@@ -6,22 +6,35 @@
 #include "InetAddress.h"
 #include <strings.h>
 #include <netinet/tcp.h>
+#include <errno.h>
 
 Socket::~Socket()
 {
-    close(sockfd_);
+    if(sockfd_ >= 0)
+    {
+        ::close(sockfd_);
+    }
+}
+
+void Socket::close()
+{
+    if(sockfd_ >= 0)
+    {
+        ::close(sockfd_);
+        sockfd_ = -1;
+    }
 }
 
 void Socket::bindAddress(const InetAddress& localaddr)
 {
-    if(0 != bind(sockfd_,(sockaddr*)localaddr.getSockaddr(),sizeof(sockaddr_in)))
+    if(0 != bind(sockfd_,localaddr.getSockaddr(),localaddr.getSockaddrLen()))
     {
         LOG_FATAL("Bind sockfd:%d fail \n",sockfd_);
     }
 }
-void Socket::listen()
+void Socket::listen(int backlog)
 {
-    if(0!=::listen(sockfd_,1024))
+    if(0!=::listen(sockfd_,backlog))
     {
         LOG_FATAL("Listen sockfd:%d fail \n",sockfd_);
     }
@@ -31,13 +44,13 @@ int Socket::accept(InetAddress* peeraddr)
     // 1.accept函数参数不合法
     // 2.对返回的connfd没有设置非阻塞
     // Reactor模型（poller+non-blocking IO）
-    sockaddr_in addr;
+    sockaddr_storage addr;
     socklen_t len = sizeof addr;//1
     bzero(&addr,sizeof addr);
     int connfd = ::accept4(sockfd_, (sockaddr*)&addr, &len, SOCK_NONBLOCK|SOCK_CLOEXEC);
     if(connfd>=0)
     {
-        peeraddr->setSockaddr(addr);
+        peeraddr->setSockaddr((sockaddr*)&addr, len);
     }
 
     return connfd;
@@ -70,4 +83,95 @@ void Socket::setKeepAlive(bool on)
 {
     int optval = on? 1 : 0;
     ::setsockopt(sockfd_, SOL_SOCKET, SO_KEEPALIVE, &optval, sizeof optval);
-}
\ No newline at end of file
+}
+
+// 下面这些选项设置失败不影响使用，只打日志
+static void setIntOption(int sockfd, int level, int optname, int optval, const char* name)
+{
+    if(::setsockopt(sockfd, level, optname, &optval, sizeof optval) < 0)
+    {
+        LOG_ERROR("setsockopt %s=%d on sockfd:%d fail, errno:%d \n", name, optval, sockfd, errno);
+    }
+}
+
+void Socket::setSendBufferSize(int bytes)
+{
+    setIntOption(sockfd_, SOL_SOCKET, SO_SNDBUF, bytes, "SO_SNDBUF");
+}
+void Socket::setRecvBufferSize(int bytes)
+{
+    setIntOption(sockfd_, SOL_SOCKET, SO_RCVBUF, bytes, "SO_RCVBUF");
+}
+void Socket::setDeferAccept(int seconds)
+{
+    setIntOption(sockfd_, IPPROTO_TCP, TCP_DEFER_ACCEPT, seconds, "TCP_DEFER_ACCEPT");
+}
+void Socket::setFastOpen(int queueLen)
+{
+    setIntOption(sockfd_, IPPROTO_TCP, TCP_FASTOPEN, queueLen, "TCP_FASTOPEN");
+}
+void Socket::setQuickAck(bool on)
+{
+    setIntOption(sockfd_, IPPROTO_TCP, TCP_QUICKACK, on ? 1 : 0, "TCP_QUICKACK");
+}
+void Socket::setBusyPoll(int micros)
+{
+    setIntOption(sockfd_, SOL_SOCKET, SO_BUSY_POLL, micros, "SO_BUSY_POLL");
+}
+void Socket::setNotSentLowat(int bytes)
+{
+    setIntOption(sockfd_, IPPROTO_TCP, TCP_NOTSENT_LOWAT, bytes, "TCP_NOTSENT_LOWAT");
+}
+
+void Socket::applyListenOptions(const SocketOptions& options)
+{
+    bool tcp = family() != AF_UNIX;
+    if(options.sendBufferSize >= 0) setSendBufferSize(options.sendBufferSize);
+    if(options.recvBufferSize >= 0) setRecvBufferSize(options.recvBufferSize);
+    if(tcp && options.deferAcceptSeconds >= 0) setDeferAccept(options.deferAcceptSeconds);
+    if(tcp && options.fastOpenQueueLen >= 0) setFastOpen(options.fastOpenQueueLen);
+    if(tcp && options.busyPollMicros >= 0) setBusyPoll(options.busyPollMicros);
+}
+
+void Socket::applyConnectionOptions(const SocketOptions& options)
+{
+    bool tcp = family() != AF_UNIX;
+    if(tcp && options.tcpNoDelay >= 0) setTcpNoDelay(options.tcpNoDelay != 0);
+    if(options.sendBufferSize >= 0) setSendBufferSize(options.sendBufferSize);
+    if(options.recvBufferSize >= 0) setRecvBufferSize(options.recvBufferSize);
+    if(tcp && options.quickAck >= 0) setQuickAck(options.quickAck != 0);
+    if(tcp && options.busyPollMicros >= 0) setBusyPoll(options.busyPollMicros);
+    if(tcp && options.notSentLowat >= 0) setNotSentLowat(options.notSentLowat);
+}
+
+int Socket::family() const
+{
+    int domain = AF_UNSPEC;
+    socklen_t len = sizeof domain;
+    ::getsockopt(sockfd_, SOL_SOCKET, SO_DOMAIN, &domain, &len);
+    return domain;
+}
+
+InetAddress Socket::getLocalAddr(int sockfd)
+{
+    sockaddr_storage addr;
+    ::bzero(&addr, sizeof addr);
+    socklen_t addrlen = sizeof addr;
+    if(::getsockname(sockfd, (sockaddr*)&addr, &addrlen) < 0)
+    {
+        LOG_ERROR("sockets::getLocalAddr \n");
+    }
+    return InetAddress((sockaddr*)&addr, addrlen);
+}
+
+InetAddress Socket::getPeerAddr(int sockfd)
+{
+    sockaddr_storage addr;
+    ::bzero(&addr, sizeof addr);
+    socklen_t addrlen = sizeof addr;
+    if(::getpeername(sockfd, (sockaddr*)&addr, &addrlen) < 0)
+    {
+        LOG_ERROR("sockets::getPeerAddr \n");
+    }
+    return InetAddress((sockaddr*)&addr, addrlen);
+}
@@ -0,0 +1,182 @@
+#include "SocketHandoff.h"
+#include "Logger.h"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <algorithm>
+
+static bool fillUnixAddr(const std::string& unixPath, sockaddr_un* addr)
+{
+    ::memset(addr, 0, sizeof *addr);
+    addr->sun_family = AF_UNIX;
+    if(unixPath.size() >= sizeof addr->sun_path)
+    {
+        LOG_ERROR("SocketHandoff unix path too long:%s \n", unixPath.c_str());
+        return false;
+    }
+    ::memcpy(addr->sun_path, unixPath.c_str(), unixPath.size());
+    return true;
+}
+
+int SocketHandoff::connectUnix(const std::string& unixPath)
+{
+    sockaddr_un addr;
+    if(!fillUnixAddr(unixPath, &addr))
+    {
+        return -1;
+    }
+    int sockfd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(sockfd < 0)
+    {
+        LOG_ERROR("SocketHandoff::connectUnix socket error:%d \n", errno);
+        return -1;
+    }
+    if(::connect(sockfd, (sockaddr*)&addr, sizeof addr) < 0)
+    {
+        LOG_ERROR("SocketHandoff::connectUnix %s error:%d \n", unixPath.c_str(), errno);
+        ::close(sockfd);
+        return -1;
+    }
+    return sockfd;
+}
+
+// 一条消息：1字节tag作为数据，fd放在控制消息里
+static bool sendOneMessage(int unixfd, char tag, const int* fds, int nfds)
+{
+    char control[CMSG_SPACE(sizeof(int) * SocketHandoff::kMaxFdsPerMessage)];
+    ::memset(control, 0, sizeof control);
+
+    struct iovec iov;
+    iov.iov_base = &tag;
+    iov.iov_len = 1;
+
+    struct msghdr msg;
+    ::memset(&msg, 0, sizeof msg);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = CMSG_SPACE(sizeof(int) * nfds);
+
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * nfds);
+    ::memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * nfds);
+
+    ssize_t n;
+    do
+    {
+        n = ::sendmsg(unixfd, &msg, MSG_NOSIGNAL);
+    } while(n < 0 && errno == EINTR);
+
+    if(n != 1)
+    {
+        LOG_ERROR("SocketHandoff::sendFds sendmsg error:%d \n", errno);
+        return false;
+    }
+    return true;
+}
+
+bool SocketHandoff::sendFds(int unixfd, char tag, const std::vector<int>& fds)
+{
+    for(size_t i = 0; i < fds.size(); i += kMaxFdsPerMessage)
+    {
+        int nfds = static_cast<int>(std::min(fds.size() - i, static_cast<size_t>(kMaxFdsPerMessage)));
+        if(!sendOneMessage(unixfd, tag, &fds[i], nfds))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SocketHandoff::receive(const std::string& unixPath, int* listenfd, std::vector<int>* connfds)
+{
+    *listenfd = -1;
+    sockaddr_un addr;
+    if(!fillUnixAddr(unixPath, &addr))
+    {
+        return false;
+    }
+    int acceptfd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(acceptfd < 0)
+    {
+        LOG_ERROR("SocketHandoff::receive socket error:%d \n", errno);
+        return false;
+    }
+    ::unlink(unixPath.c_str());
+    if(::bind(acceptfd, (sockaddr*)&addr, sizeof addr) < 0 || ::listen(acceptfd, 1) < 0)
+    {
+        LOG_ERROR("SocketHandoff::receive bind/listen %s error:%d \n", unixPath.c_str(), errno);
+        ::close(acceptfd);
+        return false;
+    }
+
+    int connfd;
+    do
+    {
+        connfd = ::accept4(acceptfd, nullptr, nullptr, SOCK_CLOEXEC);
+    } while(connfd < 0 && errno == EINTR);
+    ::close(acceptfd);
+    ::unlink(unixPath.c_str());
+    if(connfd < 0)
+    {
+        LOG_ERROR("SocketHandoff::receive accept error:%d \n", errno);
+        return false;
+    }
+
+    bool ok = true;
+    while(true)
+    {
+        char tag = 0;
+        char control[CMSG_SPACE(sizeof(int) * kMaxFdsPerMessage)];
+        struct iovec iov;
+        iov.iov_base = &tag;
+        iov.iov_len = 1;
+        struct msghdr msg;
+        ::memset(&msg, 0, sizeof msg);
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof control;
+
+        // MSG_CMSG_CLOEXEC：收到的fd也设置close-on-exec
+        ssize_t n = ::recvmsg(connfd, &msg, MSG_CMSG_CLOEXEC);
+        if(n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if(n <= 0)
+        {
+            ok = (n == 0);  //旧进程发送完毕后关闭连接
+            break;
+        }
+
+        for(struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg))
+        {
+            if(cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+            {
+                continue;
+            }
+            int nfds = static_cast<int>((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+            const int* fds = reinterpret_cast<const int*>(CMSG_DATA(cmsg));
+            for(int i = 0; i < nfds; i++)
+            {
+                if(tag == kListenTag && *listenfd < 0)
+                {
+                    *listenfd = fds[i];
+                }
+                else
+                {
+                    connfds->push_back(fds[i]);
+                }
+            }
+        }
+    }
+    ::close(connfd);
+    LOG_INFO("SocketHandoff::receive listenfd:%d, %lu connections \n", *listenfd, connfds->size());
+    return ok && *listenfd >= 0;
+}
@@ -0,0 +1,135 @@
+#include "TcpClient.h"
+#include "Logger.h"
+
+#include <strings.h>
+#include <sys/socket.h>
+
+static EventLoop* CheckLoopNotNull(EventLoop* loop)
+{
+    if(!loop)
+    {
+        LOG_FATAL("%s:%s:%d TcpClient Loop is null! \n",__FILE__, __FUNCTION__, __LINE__);
+    }
+    return loop;
+}
+
+// TcpClient析构以后连接才关闭时用的closeCallback，不能再回调到已经析构的TcpClient上
+static void removeConnectionAfterClient(EventLoop* loop, const TcpConnectionPtr& conn)
+{
+    loop->queueInLoop(std::bind(&TcpConnection::connectDistory, conn), EventLoop::kUrgent);
+}
+
+TcpClient::TcpClient(EventLoop* loop, const InetAddress& serverAddr, const std::string& nameArg)
+    :loop_(CheckLoopNotNull(loop)),
+    connector_(new Connector(loop, serverAddr)),
+    name_(nameArg),
+    connectionCallback_(defaultConnectionCallback),
+    messageCallback_(defaultMessageCallback),
+    retry_(false),
+    connect_(true),
+    nextConnId_(1)
+{
+    connector_->setNewConnectionCallback(std::bind(&TcpClient::newConnection, this, std::placeholders::_1));
+    LOG_INFO("TcpClient::TcpClient[%s] - connector %p \n", name_.c_str(), connector_.get());
+}
+
+TcpClient::~TcpClient()
+{
+    LOG_INFO("TcpClient::~TcpClient[%s] - connector %p \n", name_.c_str(), connector_.get());
+    TcpConnectionPtr conn;
+    bool unique = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        unique = connection_.use_count() == 1;
+        conn = connection_;
+    }
+    if(conn)
+    {
+        // 连接的生命周期可能比TcpClient长，把closeCallback换掉
+        EventLoop* loop = loop_;
+        CloseCallback cb = std::bind(&removeConnectionAfterClient, loop, std::placeholders::_1);
+        loop_->runInLoop([conn, cb]() { conn->setCloseCallback(cb); });
+        if(unique)
+        {
+            // 只有TcpClient持有这条连接，直接关掉
+            conn->forceClose();
+        }
+    }
+    else
+    {
+        connector_->stop();
+    }
+}
+
+void TcpClient::connect()
+{
+    LOG_INFO("TcpClient::connect[%s] - connecting to %s \n",
+            name_.c_str(), connector_->serverAddress().toIpPort().c_str());
+    connect_ = true;
+    connector_->start();
+}
+
+void TcpClient::disconnect()
+{
+    connect_ = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if(connection_)
+        {
+            connection_->shutdown();
+        }
+    }
+}
+
+void TcpClient::stop()
+{
+    connect_ = false;
+    connector_->stop();
+}
+
+// Connector连接成功以后执行这个回调，和TcpServer::newConnection对应
+void TcpClient::newConnection(int sockfd)
+{
+    InetAddress peerAddr = Socket::getPeerAddr(sockfd);
+    InetAddress loaclAddr = Socket::getLocalAddr(sockfd);
+
+    char buf[64] = {0};
+    snprintf(buf, sizeof buf, ":%s#%d", peerAddr.toIpPort().c_str(), nextConnId_);
+    ++nextConnId_;
+    std::string connName = name_ + buf;
+
+    TcpConnectionPtr conn(new TcpConnection(loop_, connName, sockfd, loaclAddr, peerAddr));
+    conn->setConnectionCallback(connectionCallback_);
+    conn->setMessageCallback(messageCallback_);
+    conn->setWriteCompleteCallback(writeCompleteCallback_);
+    conn->setCloseCallback(std::bind(&TcpClient::removeConnection, this, std::placeholders::_1));
+    if(tlsContext_)
+    {
+        conn->startTls(tlsContext_, tlsServerName_);
+    }
+    if(compressionContext_)
+    {
+        conn->startCompression(compressionContext_);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        connection_ = conn;
+    }
+    conn->connectEstablished();
+}
+
+void TcpClient::removeConnection(const TcpConnectionPtr& conn)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        connection_.reset();
+    }
+
+    loop_->queueInLoop(std::bind(&TcpConnection::connectDistory, conn), EventLoop::kUrgent);
+    if(retry_ && connect_)
+    {
+        LOG_INFO("TcpClient::connect[%s] - Reconnecting to %s \n",
+                name_.c_str(), connector_->serverAddress().toIpPort().c_str());
+        connector_->restart();
+    }
+}
@@ -3,8 +3,23 @@
 #include "Channel.h"
 #include "EventLoop.h"
 #include "Logger.h"
+#include "TlsSession.h"
+#include "CompressionSession.h"
 #include <functional>
+#include <algorithm>
 #include <errno.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+void defaultConnectionCallback(const TcpConnectionPtr&)
+{
+    // 用户不关心连接状态时什么都不做
+}
+
+void defaultMessageCallback(const TcpConnectionPtr&, Buffer* buf, Timestamp)
+{
+    buf->retrieveAll();
+}
 
 static EventLoop* CheckLoopNotNull(EventLoop*loop)
 {
@@ -29,7 +44,13 @@ TcpConnection::TcpConnection(EventLoop* loop,
     channel_(new Channel(loop, sockfd)),
     loaclAddr_(loaclAddr),
     peerAddr_(peerAddr),
-    highWaterMark_(64*1024*1024)    //64M
+    highWaterMark_(64*1024*1024),    //64M
+    chunkBytes_(0),
+    bytesReceived_(0),
+    bytesSent_(0),
+    readThrottled_(false),
+    writeThrottled_(false),
+    migratable_(true)
 {
     // 下面给Channel设置相应的回调函数，Poller给Channel通知感兴趣的事件发生了，Channel会回调相应的函数
     channel_->setReadCallback(std::bind(&TcpConnection::handleRead,this,std::placeholders::_1));
@@ -48,17 +69,38 @@ TcpConnection::~TcpConnection()
 
 void TcpConnection::handleRead(Timestamp receiveTime)
 {
+    if(tls_ && !tls_->kernelRx())
+    {
+        handleTlsRead(receiveTime);
+        return;
+    }
     int saveErrno = 0;
-    ssize_t n = inputeBuffer_.readFd(channel_->fd(),&saveErrno);
+    size_t before = inputeBuffer_.readableBytes();
+    ssize_t n = streamInput()->readFd(channel_->fd(),&saveErrno);
     if(n>0)
     {
+        countRead(n);
+        if(readLimit_.unit == RateLimit::kBytes)
+        {
+            consumeReadQuota(n);
+        }
+        if(compression_ && (!decompressInput() || inputeBuffer_.readableBytes() == before))
+        {
+            return; //出错时已经关闭了连接，或者还没有解出新的数据
+        }
         // 已建立连接的用户，有可读事件发生了，调用用户传入的回调操作onMessage
-        messageCallback_(shared_from_this(),&inputeBuffer_,receiveTime);
+        deliverMessage(receiveTime);
     }
     else if(n==0)
     {
         handleClose();
     }
+    else if(tls_ && saveErrno == EIO)
+    {
+        // kTLS RX收到了解密失败或者不是应用数据的记录（比如对端的key update），内核不会再往下解，只能关闭
+        LOG_ERROR("TcpConnection::handleRead [%s] - kTLS record error \n", name_.c_str());
+        handleClose();
+    }
     else
     {
         errno = saveErrno;
@@ -67,22 +109,157 @@ void TcpConnection::handleRead(Timestamp receiveTime)
     }
 }
 
+// 用户态TLS：密文读到session的缓冲区，解密后的明文追加到streamInput()，上层看到的和普通连接一样
+void TcpConnection::handleTlsRead(Timestamp receiveTime)
+{
+    int saveErrno = 0;
+    ssize_t n = tls_->cipherBuffer()->readFd(channel_->fd(), &saveErrno);
+    if(n>0)
+    {
+        countRead(n);
+        if(readLimit_.unit == RateLimit::kBytes)
+        {
+            consumeReadQuota(n);
+        }
+        size_t before = inputeBuffer_.readableBytes();
+        static thread_local Buffer output;
+        TlsSession::Result result = tls_->handleInput(streamInput(), &output);
+        if(!writeTlsOutput(&output))
+        {
+            handleClose();
+            return;
+        }
+        if(result == TlsSession::kError)
+        {
+            LOG_ERROR("TcpConnection::handleTlsRead [%s] - tls error, close \n", name_.c_str());
+            handleClose();
+            return;
+        }
+        if(result == TlsSession::kHandshakeDone)
+        {
+            tlsEstablished(receiveTime);
+            return;
+        }
+        if(compression_ && !decompressInput())
+        {
+            return;
+        }
+        if(inputeBuffer_.readableBytes() > before)
+        {
+            deliverMessage(receiveTime);
+        }
+    }
+    else if(n==0)
+    {
+        handleClose();
+    }
+    else
+    {
+        errno = saveErrno;
+        LOG_ERROR("TcpConnection::handleTlsRead \n");
+        handleError();
+    }
+}
+
+void TcpConnection::tlsEstablished(Timestamp receiveTime)
+{
+    // 还有没写完的握手数据时不能开启kTLS，否则这些密文会被内核当作明文再加密一次
+    if(outputBytes() == 0)
+    {
+        tls_->enableKernelTls(channel_->fd());
+    }
+    else
+    {
+        LOG_DEBUG("TcpConnection [%s] - handshake output pending, stay in user space tls \n", name_.c_str());
+    }
+    // 握手期间上层要发送的数据
+    Buffer* pending = tls_->pendingWrites();
+    if(pending->readableBytes() > 0)
+    {
+        sendTransportInLoop(pending->peek(), pending->readableBytes());
+        pending->retrieveAll();
+    }
+    if(compression_)
+    {
+        sendCompressionPreamble();
+    }
+    TcpConnectionPtr self(shared_from_this());
+    connectionCallback_(self);
+
+    // 和握手最后一个消息一起到达的应用数据还在SSL里，kTLS RX开启时这里一定是空的
+    if(!tls_->kernelRx())
+    {
+        static thread_local Buffer output;
+        TlsSession::Result result = tls_->handleInput(streamInput(), &output);
+        if(!writeTlsOutput(&output))
+        {
+            handleClose();
+            return;
+        }
+        if(result == TlsSession::kError)
+        {
+            LOG_ERROR("TcpConnection::tlsEstablished [%s] - tls error, close \n", name_.c_str());
+            handleClose();
+            return;
+        }
+    }
+    if(compression_ && !decompressInput())
+    {
+        return;
+    }
+    if(state_ == kDisconnecting)
+    {
+        shutdownInLoop();   //握手期间调用了shutdown
+    }
+    if(inputeBuffer_.readableBytes() > 0)
+    {
+        deliverMessage(receiveTime);
+    }
+}
+
+bool TcpConnection::writeTlsOutput(Buffer* output)
+{
+    if(output->readableBytes() == 0)
+    {
+        return true;
+    }
+    if(tls_->kernelTx())
+    {
+        // 用户态加密好的记录（key update的回复、alert）再经过kTLS会被当作应用数据加密一次，对端没法解，
+        // 而且key update之后用户态的发送密钥已经和内核里的不一样了，连接只能关闭
+        output->retrieveAll();
+        LOG_ERROR("TcpConnection [%s] - tls record generated in user space after kTLS TX, close \n", name_.c_str());
+        return false;
+    }
+    writeInLoop(output->peek(), output->readableBytes(), false);
+    output->retrieveAll();
+    return true;
+}
+
 void TcpConnection::handleWrite()
 {
     if(channel_->isWritting())
     {
+        size_t allowance = writeAllowance();
+        if(allowance == 0)
+        {
+            throttleWriting();  //令牌用完了，等补回来再写
+            return;
+        }
         int saveErrno = 0;
-        ssize_t n = outPutBuffer_.writeFd(channel_->fd(),&saveErrno);
+        ssize_t n = writeOutput(&saveErrno, allowance);
         if(n>0)
         {
-            outPutBuffer_.retrieve(n);
-            if(outPutBuffer_.readableBytes()==0)//发送完成
+            countWritten(n);
+            countOutput(-n);
+            writeBucket_.consume(n);
+            if(outputBytes()==0)//发送完成
             {
                 channel_->disableWritting();
-                if(writeCompleteCallback_)
+                if(writeCompleteCallback_ && (!tls_ || tls_->handshakeDone()))
                 {
                     //唤醒loop_对应的线程，执行回调
-                    loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+                    queueInOwnerLoop(std::bind(writeCompleteCallback_, shared_from_this()));
                 }
                 
                 if(state_==kDisconnecting)
@@ -111,7 +288,10 @@ void TcpConnection::handleClose()
     channel_->disableAll();
 
     TcpConnectionPtr connPtr(shared_from_this());
-    connectionCallback_(connPtr);   //执行连接关闭的回调
+    if(!tls_ || tls_->handshakeDone())  //tls握手没完成的连接上层没见过，不通知
+    {
+        connectionCallback_(connPtr);   //执行连接关闭的回调
+    }
     closeCallback_(connPtr);    //关闭连接的回调 ,执行的是TcpServer::removeConnection回调
 }
 
@@ -136,19 +316,132 @@ void TcpConnection::send(const std::string&buf)
 {
     if(state_==kConnected)
     {
-        if(loop_->isInLoopThread())
+        if(getLoop()->isInLoopThread())
         {
             sendInLoop(buf.c_str(),buf.size());
         }
         else
         {
-            loop_->runInLoop(std::bind(&TcpConnection::sendInLoop,this,buf.c_str(),buf.size()));
+            // 跨线程发送时buf可能在回调执行前就被释放了，拷贝一份跟着回调走，queueInOwnerLoop持有conn防止提前析构
+            TcpConnection* self = this;
+            queueInOwnerLoop([self, buf]() { self->sendInLoop(buf.c_str(), buf.size()); });
         }
     }
 }
 
-//发送数据，应用写的快，而内核发送数据慢，需要把待发送数据写入缓冲区，而且设置了水位回调
+void TcpConnection::send(Buffer* buf)
+{
+    if(state_==kConnected)
+    {
+        if(getLoop()->isInLoopThread())
+        {
+            sendInLoop(buf->peek(),buf->readableBytes());
+            buf->retrieveAll();
+        }
+        else
+        {
+            std::string message = buf->retrieveAllAsString();
+            TcpConnection* self = this;
+            queueInOwnerLoop([self, message]() { self->sendInLoop(message.c_str(), message.size()); });
+        }
+    }
+    else
+    {
+        buf->retrieveAll();     //连接已经断开，数据直接丢弃
+    }
+}
+
+Buffer* TcpConnection::replyBuffer()
+{
+    static thread_local Buffer buffer;
+    return &buffer;
+}
+
+void TcpConnection::send(const SharedPayload& payload)
+{
+    if(state_==kConnected)
+    {
+        if(getLoop()->isInLoopThread())
+        {
+            sendSharedInLoop(payload);
+        }
+        else
+        {
+            TcpConnection* self = this;
+            queueInOwnerLoop([self, payload]() { self->sendSharedInLoop(payload); });
+        }
+    }
+}
+
+void TcpConnection::sendSharedInLoop(const SharedPayload& payload)
+{
+    if(compression_ || (tls_ && !tls_->kernelTx()))
+    {
+        sendInLoop(payload->data(), payload->size());   //每条连接的密文/压缩数据都不一样，没法共享
+        return;
+    }
+    writeInLoop(payload->data(), payload->size(), true, &payload);
+}
+
+// 开启了压缩时先压缩，协商完成之前先暂存
 void TcpConnection::sendInLoop(const void* data, size_t len)
+{
+    // 其他线程在connectDistory之前通过了send里kConnected的检查，排进来的任务在这之后才执行，
+    // 这时z_stream已经放回池子了，数据也不可能再发出去
+    if(state_ == kDisconnected)
+    {
+        LOG_ERROR("disconnected, give up writing \n");
+        return;
+    }
+    if(compression_)
+    {
+        if(!compression_->ready())
+        {
+            compression_->pendingWrites()->append(static_cast<const char*>(data), len);
+            return;
+        }
+        static thread_local Buffer compressed;
+        if(compression_->compress(data, len, &compressed))
+        {
+            sendTransportInLoop(compressed.peek(), compressed.readableBytes());
+        }
+        else
+        {
+            LOG_ERROR("TcpConnection::sendInLoop [%s] - compress failed \n", name_.c_str());
+        }
+        compressed.retrieveAll();
+        return;
+    }
+    sendTransportInLoop(data, len);
+}
+
+// tls连接先加密（开启了kTLS时由内核加密），握手没完成时先暂存
+void TcpConnection::sendTransportInLoop(const void* data, size_t len)
+{
+    if(tls_ && !tls_->kernelTx())
+    {
+        if(!tls_->handshakeDone())
+        {
+            tls_->pendingWrites()->append(static_cast<const char*>(data), len);
+            return;
+        }
+        static thread_local Buffer cipher;
+        if(tls_->encrypt(data, len, &cipher))
+        {
+            writeInLoop(cipher.peek(), cipher.readableBytes(), true);
+        }
+        else
+        {
+            LOG_ERROR("TcpConnection::sendInLoop [%s] - tls encrypt failed \n", name_.c_str());
+        }
+        cipher.retrieveAll();
+        return;
+    }
+    writeInLoop(data, len, true);
+}
+
+//发送数据，应用写的快，而内核发送数据慢，需要把待发送数据写入缓冲区，而且设置了水位回调
+void TcpConnection::writeInLoop(const void* data, size_t len, bool notify, const SharedPayload* payload)
 {
     ssize_t nwrote = 0;
     size_t remaining = len;
@@ -162,16 +455,19 @@ void TcpConnection::sendInLoop(const void* data, size_t len)
     }
 
     //channel第一次开始写数据，而且缓冲区没有待发送数据
-    if(!channel_->isWritting() && outPutBuffer_.readableBytes()==0)
+    if(!channel_->isWritting() && !writeThrottled_ && outputBytes()==0)
     {
-        nwrote = ::write(channel_->fd(), data, len);
+        size_t allowance = std::min(len, writeAllowance());
+        nwrote = allowance > 0 ? ::write(channel_->fd(), data, allowance) : 0;
         if(nwrote>=0)
         {
+            countWritten(nwrote);
+            writeBucket_.consume(nwrote);
             remaining = len - nwrote;
-            if(remaining==0 && writeCompleteCallback_)
+            if(remaining==0 && notify && writeCompleteCallback_)
             {
                 //既然在这里数据一次性全部发送完成，就不用再给channel设置EPOLLOUT事件了
-                loop_->queueInLoop(std::bind(writeCompleteCallback_,shared_from_this()));
+                queueInOwnerLoop(std::bind(writeCompleteCallback_,shared_from_this()));
 
             }
         }
@@ -195,28 +491,126 @@ void TcpConnection::sendInLoop(const void* data, size_t len)
     if(!faultError && remaining>0)      
     {
         // 目前发送缓冲区剩余的待发送数据的长度
-        size_t oldLen = outPutBuffer_.readableBytes();
+        size_t oldLen = outputBytes();
 
         if( oldLen < highWaterMark_
             && oldLen + remaining >= highWaterMark_
             && highWaterMarkCallback_)
         {
-            loop_->queueInLoop(std::bind(highWaterMarkCallback_,shared_from_this(),oldLen+remaining));
+            queueInOwnerLoop(std::bind(highWaterMarkCallback_,shared_from_this(),oldLen+remaining));
         }
-        outPutBuffer_.append((char*)data + nwrote, remaining);
-        if(!channel_->isWritting())
+        if(payload)
+        {
+            outputChunks_.push_back(OutputChunk{*payload, static_cast<size_t>(nwrote)});
+            chunkBytes_ += remaining;
+        }
+        else if(!outputChunks_.empty())
+        {
+            // 前面还有共享数据没写完，拷贝一份排在它们后面
+            outputChunks_.push_back(OutputChunk{std::make_shared<std::string>((char*)data + nwrote, remaining), 0});
+            chunkBytes_ += remaining;
+        }
+        else
+        {
+            outPutBuffer_.append((char*)data + nwrote, remaining);
+        }
+        countOutput(remaining);
+        if(!channel_->isWritting() && !writeThrottled_)    //限速暂停时等令牌补回来再注册
         {
             channel_->enableWritting();//这里一定要注册channel的写事件，否则poller不会给channel通知EPOLLOUT
         }
     }
 }
 
+ssize_t TcpConnection::writeOutput(int* saveErrno, size_t maxBytes)
+{
+    if(outputChunks_.empty())
+    {
+        if(maxBytes >= outPutBuffer_.readableBytes())
+        {
+            ssize_t n = outPutBuffer_.writeFd(channel_->fd(), saveErrno);
+            if(n > 0)
+            {
+                outPutBuffer_.retrieve(n);
+            }
+            return n;
+        }
+        ssize_t n = ::write(channel_->fd(), outPutBuffer_.peek(), maxBytes);
+        if(n < 0)
+        {
+            *saveErrno = errno;
+            return n;
+        }
+        outPutBuffer_.retrieve(n);
+        return n;
+    }
+    // 先是outPutBuffer_，再是各个共享块，一次writev写出去
+    struct iovec vec[kMaxIovecs];
+    int count = 0;
+    size_t total = 0;
+    if(outPutBuffer_.readableBytes() > 0)
+    {
+        vec[count].iov_base = const_cast<char*>(outPutBuffer_.peek());
+        vec[count].iov_len = std::min(outPutBuffer_.readableBytes(), maxBytes);
+        total += vec[count].iov_len;
+        count++;
+    }
+    for(auto it = outputChunks_.begin(); it != outputChunks_.end() && count < kMaxIovecs && total < maxBytes; ++it)
+    {
+        vec[count].iov_base = const_cast<char*>(it->data->data() + it->offset);
+        vec[count].iov_len = std::min(it->data->size() - it->offset, maxBytes - total);
+        total += vec[count].iov_len;
+        count++;
+    }
+    ssize_t n = ::writev(channel_->fd(), vec, count);
+    if(n < 0)
+    {
+        *saveErrno = errno;
+        return n;
+    }
+    size_t left = std::min(static_cast<size_t>(n), outPutBuffer_.readableBytes());
+    outPutBuffer_.retrieve(left);
+    left = n - left;
+    while(left > 0)
+    {
+        OutputChunk& chunk = outputChunks_.front();
+        size_t avail = chunk.data->size() - chunk.offset;
+        if(left < avail)
+        {
+            chunk.offset += left;
+            chunkBytes_ -= left;
+            break;
+        }
+        left -= avail;
+        chunkBytes_ -= avail;
+        outputChunks_.pop_front();
+    }
+    return n;
+}
+
 // 连接建立
 void TcpConnection::connectEstablished()
 {
     setState(kConnected);
+    LoopMetrics::add(&getLoop()->metrics()->connections, int64_t(1));
     channel_->tie(shared_from_this());// 将当前connection绑定到channel中，拿weakptr指向conn，防止conn被remove了channel还能执行conn给channel的回调函数
     channel_->enableReading();//向Poller中注册channel的epollin事件
+    if(tls_)
+    {
+        // 客户端发出ClientHello，服务端没有输入时什么也不会产生，等握手完成再执行回调
+        static thread_local Buffer output;
+        tls_->startHandshake(&output);
+        if(output.readableBytes() > 0)
+        {
+            writeInLoop(output.peek(), output.readableBytes(), false);
+            output.retrieveAll();
+        }
+        return;
+    }
+    if(compression_)
+    {
+        sendCompressionPreamble();
+    }
     //新连接建立，执行回调
     connectionCallback_(shared_from_this());
 }
@@ -227,9 +621,18 @@ void TcpConnection::connectDistory()
     {
         setState(kDisconnected);
         channel_->disableAll(); //把Channel的所有感兴趣的事件，从poller中del掉
-        connectionCallback_(shared_from_this());
+        if(!tls_ || tls_->handshakeDone())
+        {
+            connectionCallback_(shared_from_this());
+        }
     }
+    LoopMetrics::add(&getLoop()->metrics()->connections, int64_t(-1));
+    countOutput(-static_cast<int64_t>(outputBytes()));     //没发出去的数据随连接一起丢掉
     channel_->remove();     //把channel从poller中删除掉
+    if(compression_)
+    {
+        compression_->release();    //z_stream放回loop的池子给后面的连接用
+    }
 }
 
 //关闭连接
@@ -238,14 +641,371 @@ void TcpConnection::shutdown()
     if(state_==kConnected)
     {
         setState(kDisconnecting);
-        loop_->runInLoop(std::bind(&TcpConnection::shutdownInLoop,this));
+        runInOwnerLoop(std::bind(&TcpConnection::shutdownInLoop,this));
     }
 }
 
 void TcpConnection::shutdownInLoop()
 {
-    if(!channel_->isWritting())//说明outPutBuffer中数据已经全部发送完成
+    if(!channel_->isWritting() && outputBytes() == 0)//说明outPutBuffer中数据已经全部发送完成（限速暂停时不注册写事件，要看缓冲区）
     {
+        if((tls_ && !tls_->handshakeDone()) || (compression_ && !compression_->ready()))
+        {
+            return;     //握手/协商完成之前暂存的数据还没发出去，完成之后再进来
+        }
+        if(tls_ && tls_->kernelTx())
+        {
+            tls_->sendKernelCloseNotify(channel_->fd());    //输出缓冲区已经写完了，alert不会插到数据前面
+        }
+        else if(tls_)
+        {
+            // 先发close_notify，没能一次写完的话等handleWrite写完再进来
+            static thread_local Buffer output;
+            tls_->shutdown(&output);
+            if(output.readableBytes() > 0)
+            {
+                writeInLoop(output.peek(), output.readableBytes(), false);
+                output.retrieveAll();
+                if(outputBytes() > 0)
+                {
+                    return;
+                }
+            }
+        }
         socket_->shutdownWrite();// 该函数内部会调用sockfd的shutdown，会触发EpollHup事件，然后调用channel的回调
     }
 }
+
+int TcpConnection::fd() const
+{
+    return socket_->fd();
+}
+
+int TcpConnection::handoffInLoop()
+{
+    // tls连接的状态在本进程的SSL对象里，没法交出去
+    if(state_ != kConnected || tls_ || compression_ || inputeBuffer_.readableBytes() > 0 || outputBytes() > 0)
+    {
+        return -1;
+    }
+    int fd = ::dup(socket_->fd());
+    if(fd < 0)
+    {
+        LOG_ERROR("TcpConnection::handoffInLoop dup error:%d \n", errno);
+        return -1;
+    }
+    // 同步关闭，保证之后不会再从这个socket上读走属于新进程的数据
+    handleClose();
+    return fd;
+}
+
+void TcpConnection::startTls(const TlsContextPtr& ctx, const std::string& serverName)
+{
+    tls_.reset(new TlsSession(ctx, serverName));
+}
+
+void TcpConnection::startCompression(const CompressionContextPtr& ctx, int level)
+{
+    compression_.reset(new CompressionSession(ctx, getLoop(), level));
+    if(state_ == kConnected && (!tls_ || tls_->handshakeDone()))
+    {
+        sendCompressionPreamble();
+    }
+}
+
+const CompressionStats* TcpConnection::compressionStats() const
+{
+    return compression_ ? &compression_->stats() : nullptr;
+}
+
+Buffer* TcpConnection::streamInput()
+{
+    return compression_ ? compression_->input() : &inputeBuffer_;
+}
+
+void TcpConnection::sendCompressionPreamble()
+{
+    static thread_local Buffer preamble;
+    compression_->appendPreamble(&preamble);
+    if(preamble.readableBytes() > 0)
+    {
+        sendTransportInLoop(preamble.peek(), preamble.readableBytes());
+        preamble.retrieveAll();
+    }
+}
+
+bool TcpConnection::decompressInput()
+{
+    CompressionSession::Result result = compression_->handleInput(&inputeBuffer_);
+    if(result == CompressionSession::kError)
+    {
+        LOG_ERROR("TcpConnection::decompressInput [%s] - compression error, close \n", name_.c_str());
+        handleClose();
+        return false;
+    }
+    if(result == CompressionSession::kNegotiated)
+    {
+        Buffer* pending = compression_->pendingWrites();
+        if(pending->readableBytes() > 0)
+        {
+            sendInLoop(pending->peek(), pending->readableBytes());
+            pending->retrieveAll();
+        }
+        if(state_ == kDisconnecting)
+        {
+            shutdownInLoop();   //协商期间调用了shutdown
+        }
+    }
+    return true;
+}
+
+bool TcpConnection::kernelTlsTx() const
+{
+    return tls_ && tls_->kernelTx();
+}
+
+bool TcpConnection::kernelTlsRx() const
+{
+    return tls_ && tls_->kernelRx();
+}
+
+void TcpConnection::setTcpNoDelay(bool on)
+{
+    socket_->setTcpNoDelay(on);
+}
+
+void TcpConnection::setSocketOptions(const SocketOptions& options)
+{
+    socket_->applyConnectionOptions(options);
+}
+
+void TcpConnection::forceClose()
+{
+    if(state_==kConnected || state_==kDisconnecting)
+    {
+        setState(kDisconnecting);
+        queueInOwnerLoop(std::bind(&TcpConnection::forceCloseInLoop,this));
+    }
+}
+
+void TcpConnection::forceCloseInLoop()
+{
+    if(state_==kConnected || state_==kDisconnecting)
+    {
+        handleClose();  //和对端关闭一样走handleClose，最终由TcpServer/TcpClient的removeConnection回收
+    }
+}
+
+void TcpConnection::runInOwnerLoop(const std::function<void()>& cb)
+{
+    if(getLoop()->isInLoopThread())
+    {
+        cb();
+    }
+    else
+    {
+        queueInOwnerLoop(cb);
+    }
+}
+
+void TcpConnection::queueInOwnerLoop(const std::function<void()>& cb)
+{
+    TcpConnectionPtr self(shared_from_this());
+    getLoop()->queueInLoop([self, cb]() { self->runInOwnerLoop(cb); }, EventLoop::kUrgent);
+}
+
+void TcpConnection::migrate(EventLoop* newLoop, const MigrateCallback& cb)
+{
+    // 总是排到队列里，等这一轮的事件处理完，这时没有在执行这条连接的回调
+    queueInOwnerLoop(std::bind(&TcpConnection::migrateInLoop, this, newLoop, cb));
+}
+
+void TcpConnection::migrateInLoop(EventLoop* newLoop, const MigrateCallback& cb)
+{
+    EventLoop* oldLoop = getLoop();
+    if(state_ != kConnected || newLoop == oldLoop || !migratable_)
+    {
+        if(cb)
+        {
+            cb(shared_from_this(), false);
+        }
+        return;
+    }
+    LOG_DEBUG("TcpConnection::migrate [%s] - fd=%d loop %p -> %p \n", name_.c_str(), channel_->fd(), oldLoop, newLoop);
+    // 限速恢复的定时器在旧loop上，到新loop上重新注册
+    if(readThrottled_)
+    {
+        oldLoop->cancel(readResumeTimer_);
+    }
+    if(writeThrottled_)
+    {
+        oldLoop->cancel(writeResumeTimer_);
+    }
+    LoopMetrics::add(&oldLoop->metrics()->connections, int64_t(-1));
+    countOutput(-static_cast<int64_t>(outputBytes()));
+    channel_->detach(newLoop);
+    if(compression_)
+    {
+        compression_->setLoop(newLoop);     //z_stream断开时放回新loop的池子
+    }
+    // 先把attach排进新loop，再切换loop_，之后其他线程投递的回调都排在attach后面
+    TcpConnectionPtr self(shared_from_this());
+    newLoop->queueInLoop([self, newLoop, cb]() {
+        // 旧loop线程可能还没执行到下面的store，这里先切过来，保证getLoop()已经是newLoop
+        self->loop_.store(newLoop, std::memory_order_release);
+        self->channel_->attach();
+        LoopMetrics::add(&self->getLoop()->metrics()->connections, int64_t(1));
+        self->countOutput(static_cast<int64_t>(self->outputBytes()));
+        if(self->readThrottled_)
+        {
+            self->scheduleReadResume();
+        }
+        if(self->writeThrottled_)
+        {
+            self->scheduleWriteResume();
+        }
+        if(cb)
+        {
+            cb(self, true);
+        }
+    }, EventLoop::kUrgent);
+    loop_.store(newLoop, std::memory_order_release);
+}
+
+// 限速暂停之后至少等这么久再恢复，避免令牌刚补回一点就被定时器唤醒
+const double kMinThrottleSeconds = 0.01;
+
+void TcpConnection::setReadRateLimit(const RateLimit& limit)
+{
+    readLimit_ = limit;
+    readBucket_.reset(limit, Timestamp::now());
+    if(readThrottled_)
+    {
+        getLoop()->cancel(readResumeTimer_);
+        resumeReading();    //桶是满的，先恢复
+    }
+}
+
+void TcpConnection::setWriteRateLimit(const RateLimit& limit)
+{
+    writeBucket_.reset(limit, Timestamp::now());
+    if(writeThrottled_)
+    {
+        getLoop()->cancel(writeResumeTimer_);
+        resumeWriting();
+    }
+}
+
+void TcpConnection::consumeReadQuota(double units)
+{
+    if(!readBucket_.limited())
+    {
+        return;
+    }
+    readBucket_.refill(Timestamp::now());
+    readBucket_.consume(units);
+    // 电平触发的epoll只要接收缓冲区有数据就每一轮都报告，透支了就先不监听EPOLLIN
+    if(readBucket_.tokens() < 0 && !readThrottled_ && (state_ == kConnected || state_ == kDisconnecting))
+    {
+        readThrottled_ = true;
+        channel_->disableReading();
+        scheduleReadResume();
+    }
+}
+
+void TcpConnection::countReadMessages(size_t n)
+{
+    if(readLimit_.unit == RateLimit::kMessages)
+    {
+        consumeReadQuota(static_cast<double>(n));
+    }
+}
+
+void TcpConnection::scheduleReadResume()
+{
+    std::weak_ptr<TcpConnection> weakConn(shared_from_this());
+    double delay = std::max(readBucket_.secondsUntil(0.0), kMinThrottleSeconds);
+    readResumeTimer_ = getLoop()->runAfter(delay, [weakConn]() {
+        TcpConnectionPtr conn = weakConn.lock();
+        if(conn)
+        {
+            conn->resumeReading();
+        }
+    });
+}
+
+void TcpConnection::resumeReading()
+{
+    readThrottled_ = false;
+    if(state_ == kConnected || state_ == kDisconnecting)
+    {
+        channel_->enableReading();
+    }
+}
+
+size_t TcpConnection::writeAllowance()
+{
+    if(!writeBucket_.limited())
+    {
+        return SIZE_MAX;
+    }
+    writeBucket_.refill(Timestamp::now());
+    return writeBucket_.tokens() >= 1.0 ? static_cast<size_t>(writeBucket_.tokens()) : 0;
+}
+
+void TcpConnection::throttleWriting()
+{
+    writeThrottled_ = true;
+    channel_->disableWritting();
+    scheduleWriteResume();
+}
+
+void TcpConnection::scheduleWriteResume()
+{
+    std::weak_ptr<TcpConnection> weakConn(shared_from_this());
+    double delay = std::max(writeBucket_.secondsUntil(1.0), kMinThrottleSeconds);
+    writeResumeTimer_ = getLoop()->runAfter(delay, [weakConn]() {
+        TcpConnectionPtr conn = weakConn.lock();
+        if(conn)
+        {
+            conn->resumeWriting();
+        }
+    });
+}
+
+void TcpConnection::resumeWriting()
+{
+    writeThrottled_ = false;
+    if((state_ == kConnected || state_ == kDisconnecting) && outputBytes() > 0 && !channel_->isWritting())
+    {
+        channel_->enableWritting();     //剩下的数据由handleWrite按令牌继续写
+    }
+}
+
+void TcpConnection::countRead(size_t n)
+{
+    addBytes(&bytesReceived_, n);
+    LoopMetrics::add(&getLoop()->metrics()->bytesRead, static_cast<uint64_t>(n));
+}
+
+void TcpConnection::countWritten(size_t n)
+{
+    addBytes(&bytesSent_, n);
+    LoopMetrics::add(&getLoop()->metrics()->bytesWritten, static_cast<uint64_t>(n));
+}
+
+void TcpConnection::countOutput(int64_t delta)
+{
+    if(delta != 0)
+    {
+        LoopMetrics::add(&getLoop()->metrics()->outputBytes, delta);
+    }
+}
+
+void TcpConnection::deliverMessage(Timestamp receiveTime)
+{
+    EventLoop* loop = getLoop();    //回调里发起的迁移排在后面，执行期间loop不会变
+    int64_t start = Timestamp::now().microSecondsSinceEpoch();
+    messageCallback_(shared_from_this(), &inputeBuffer_, receiveTime);
+    loop->metrics()->messageCallback.record(Timestamp::now().microSecondsSinceEpoch() - start);
+}
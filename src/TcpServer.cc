@@ -2,6 +2,20 @@
 #include "TcpConnection.h"
 #include "Logger.h"
 #include <strings.h>
+#include <unistd.h>
+#include <algorithm>
+#include <fcntl.h>
+#include "SocketHandoff.h"
+
+// subLoop延迟探测的间隔，秒
+static const double kLagProbeInterval = 0.05;
+// 迁移过的连接多少个均衡周期内不再迁移
+static const int kMigrationCooldown = 5;
+// 检查退休的loop上还有没有连接的间隔，秒
+static const double kRetireCheckInterval = 0.1;
+// 自动扩缩容：连续几次满足条件才动手，缩容时剩下的连接最多等多久
+static const int kScaleVotes = 3;
+static const double kAutoRetireTimeout = 30.0;
 
 EventLoop* CheckLoopNotNull(EventLoop*loop)
 {
@@ -13,36 +27,102 @@ EventLoop* CheckLoopNotNull(EventLoop*loop)
 }
 
 TcpServer::TcpServer(EventLoop*loop,const InetAddress& listenaddr,const std::string& nameArg,Option option)
+    :TcpServer(loop, new Acceptor(loop, listenaddr, option==kReusePort), listenaddr.toIpPort(), nameArg)
+{
+}
+
+static std::string listenIpPort(int listenfd)
+{
+    return Socket::getLocalAddr(listenfd).toIpPort();
+}
+
+TcpServer::TcpServer(EventLoop*loop,int listenfd,const std::string& nameArg)
+    :TcpServer(loop, new Acceptor(loop, listenfd), listenIpPort(listenfd), nameArg)
+{
+}
+
+TcpServer::TcpServer(EventLoop*loop,Acceptor* acceptor,const std::string& ipPort,const std::string& nameArg)
     :loop_(CheckLoopNotNull(loop)), 
-    ipPort_(listenaddr.toIpPort()),
+    ipPort_(ipPort),
     name_(nameArg),
-    acceptor_(new Acceptor(loop, listenaddr, option==kNoReusePort)),//重要
+    acceptor_(acceptor),//重要
     threadPool_(new EventLoopThreadPool(loop,name_)),//重要
-    connectionCallback_(),
-    messageCallback_(),
+    connectionCallback_(defaultConnectionCallback),
+    messageCallback_(defaultMessageCallback),
     nextConnId_(1),
-    started_(0)
+    started_(0),
+    draining_(false),
+    maxConnections_(0),
+    maxLoopLagSeconds_(0.0),
+    maxPendingFunctors_(0),
+    overloadAction_(kRejectConnection),
+    overloadPauseSeconds_(0.1),
+    numConnections_(0),
+    numAccepted_(0),
+    numRejected_(0),
+    acceptPaused_(false),
+    shedCount_(0),
+    rebalanceInterval_(0.0),
+    rebalanceImbalance_(0.25),
+    migrating_(false),
+    numMigrations_(0),
+    minLoops_(1),
+    maxLoops_(1),
+    autoScaleInterval_(0.0),
+    scaleUpBusy_(0.75),
+    scaleDownBusy_(0.3),
+    scaleUpVotes_(0),
+    scaleDownVotes_(0),
+    broadcastGroupsMigrations_(0)
 {
     //当有新用户，Acceptor::handleRead()会执行下面的回调函数
     using namespace std::placeholders;
     acceptor_->setNewConnectionCallback(std::bind(&TcpServer::newConnection,this, _1, _2));
+    MetricsRegistry::instance().addServer(this);
 }
 
 TcpServer::~TcpServer()
 {
+    MetricsRegistry::instance().removeServer(this);
+    loop_->cancel(lagProbeTimer_);
+    loop_->cancel(resumeTimer_);
+    loop_->cancel(drainTimer_);
+    loop_->cancel(rebalanceTimer_);
+    loop_->cancel(autoScaleTimer_);
+    for(const RetirementPtr& retirement : retirements_)
+    {
+        loop_->cancel(retirement->timer);
+    }
     for(auto& item : connections_)
     {
         TcpConnectionPtr conn(item.second); //这个局部的sharedptr，出右括号，可以自动释放TcpConnection的对象资源
         item.second.reset(); //不能直接reset，否则无法执行下面这条函数
-        conn->getLoop()->runInLoop(std::bind(&TcpConnection::connectDistory,conn));
+        conn->getLoop()->runInLoop(std::bind(&TcpConnection::connectDistory,conn), EventLoop::kUrgent);
     }
 }
 
 // 有一个新的客户端连接时，acceptor会执行这个回调
 void TcpServer::newConnection(int sockfd, const InetAddress& peerAddr)
 {
-    // 轮询算法，选择一个subloop来管理channel
-    EventLoop* ioLoop = threadPool_->getNextLoop();
+    ++numAccepted_;
+    if(draining_)
+    {
+        ++numRejected_;
+        ::close(sockfd);    //正在drain，不再接受新连接
+        return;
+    }
+    if(maxConnections_ > 0 && connections_.size() >= maxConnections_)
+    {
+        shedConnection(sockfd, "too many connections");
+        return;
+    }
+    // 轮询算法，选择一个subloop来管理channel，跳过过载的subloop
+    EventLoop* ioLoop = selectLoop();
+    if(ioLoop == nullptr)
+    {
+        shedConnection(sockfd, "all loops overloaded");
+        return;
+    }
     //组装连接的名字
     char buf[64] = {0};
     snprintf(buf,sizeof buf , "-%s#%d",ipPort_.c_str(),nextConnId_);
@@ -52,18 +132,39 @@ void TcpServer::newConnection(int sockfd, const InetAddress& peerAddr)
                 name_.c_str(),connName.c_str(),peerAddr.toIpPort().c_str());
 
     // 通过sockfd获取其绑定的本机的ip和port
-    sockaddr_in loacl;
-    ::bzero(&loacl,sizeof loacl);
-    socklen_t addrlen = sizeof loacl;
-    if(::getsockname(sockfd,(sockaddr*)&loacl,&addrlen) < 0)
-    {
-        LOG_ERROR("sockets::getLoaclAddr \n");
-    }
-    InetAddress loaclAddr(loacl);
+    InetAddress loaclAddr = Socket::getLocalAddr(sockfd);
 
     //根据成功连接的sockfd，创建TcpConnection对象
     TcpConnectionPtr conn(new TcpConnection(ioLoop,connName,sockfd,loaclAddr,peerAddr));
+    if(socketOptionsCallback_)
+    {
+        SocketOptions options = socketOptions_;
+        socketOptionsCallback_(peerAddr, &options);
+        conn->setSocketOptions(options);
+    }
+    else
+    {
+        conn->setSocketOptions(socketOptions_);
+    }
+    if(tlsContext_)
+    {
+        conn->startTls(tlsContext_);
+    }
+    if(compressionContext_)
+    {
+        conn->startCompression(compressionContext_);
+    }
+    if(readRateLimit_.rate > 0)
+    {
+        conn->setReadRateLimit(readRateLimit_);
+    }
+    if(writeRateLimit_.rate > 0)
+    {
+        conn->setWriteRateLimit(writeRateLimit_);
+    }
     connections_[connName] = conn;
+    numConnections_ = connections_.size();
+    broadcastGroups_.reset();
     // 下面的回调都是用户设置给TcpServer>>TcpConnection>>Channel>>Poller>>notify Channel调用回调
     conn->setConnectionCallback(connectionCallback_);
     conn->setMessageCallback(messageCallback_);
@@ -74,7 +175,7 @@ void TcpServer::newConnection(int sockfd, const InetAddress& peerAddr)
     conn->setCloseCallback(std::bind(&TcpServer::removeConnection,this,std::placeholders::_1));
 
     // 直接调用TcpConnection::connectEstablished
-    ioLoop->runInLoop(std::bind(&TcpConnection::connectEstablished,conn));
+    ioLoop->runInLoop(std::bind(&TcpConnection::connectEstablished,conn), EventLoop::kUrgent);
 }
 
 //设置底层subloop的个数
@@ -83,11 +184,41 @@ void TcpServer::setThreadNum(int numThreads)
     threadPool_->setThreadNum(numThreads);
 }
 
+void TcpServer::setSocketOptions(const SocketOptions& options)
+{
+    socketOptions_ = options;
+    acceptor_->setSocketOptions(options);
+}
+
 void TcpServer::start()
 {
     if(started_++==0)//防止一个TcpServer对象被start多次
     {
         threadPool_->start(threadInitCallback_);//启动底层Loop线程池，把subLoop全都开启，并loop.loop()
+        while(autoScaleInterval_ > 0 && static_cast<int>(threadPool_->numLoops()) < minLoops_)
+        {
+            threadPool_->addLoop();
+        }
+        for(EventLoop* ioLoop : threadPool_->getAllLoops())
+        {
+            loopLoads_[ioLoop] = std::make_shared<LoopLoad>();
+        }
+        if(maxLoopLagSeconds_ > 0)
+        {
+            lagProbeTimer_ = loop_->runEvery(kLagProbeInterval, std::bind(&TcpServer::probeLoopLag, this));
+        }
+        if(rebalanceInterval_ > 0)
+        {
+            lastRebalance_ = Timestamp::now();
+            sampleLoopBusy(&loopBusyUs_, 0);
+            rebalanceTimer_ = loop_->runEvery(rebalanceInterval_, std::bind(&TcpServer::rebalance, this));
+        }
+        if(autoScaleInterval_ > 0)
+        {
+            lastAutoScale_ = Timestamp::now();
+            sampleLoopBusy(&scaleBusyUs_, 0);
+            autoScaleTimer_ = loop_->runEvery(autoScaleInterval_, std::bind(&TcpServer::autoScale, this));
+        }
         loop_->runInLoop(std::bind(&Acceptor::listen,acceptor_.get()));
     }
 }
@@ -100,6 +231,670 @@ void TcpServer::removeConnectionInLoop(const TcpConnectionPtr& conn)
 {
     LOG_INFO("TcpServer::removeConnectionInLoop [%s] - connection%s \n",name_.c_str(),conn->name().c_str());
     connections_.erase(conn->name());
+    numConnections_ = connections_.size();
+    broadcastGroups_.reset();   //不能让分组继续持有已经关闭的连接
     EventLoop* ioLoop = conn->getLoop();
-    ioLoop->queueInLoop(std::bind(&TcpConnection::connectDistory,conn));
-}
\ No newline at end of file
+    ioLoop->queueInLoop(std::bind(&TcpConnection::connectDistory,conn), EventLoop::kUrgent);
+
+    if(draining_ && connections_.empty())
+    {
+        finishDrain();
+    }
+}
+
+void TcpServer::drain(double timeoutSeconds, const DrainCompleteCallback& cb)
+{
+    loop_->runInLoop(std::bind(&TcpServer::drainInLoop, this, timeoutSeconds, cb));
+}
+
+void TcpServer::drainInLoop(double timeoutSeconds, const DrainCompleteCallback& cb)
+{
+    if(draining_)
+    {
+        return;
+    }
+    LOG_INFO("TcpServer::drain [%s] - %lu connections, timeout %.1fs \n",
+                name_.c_str(), connections_.size(), timeoutSeconds);
+    draining_ = true;
+    drainCompleteCallback_ = cb;
+    acceptor_->stopListen();
+
+    if(connections_.empty())
+    {
+        finishDrain();
+        return;
+    }
+
+    // shutdown只关闭写端：输出缓冲区为空的连接立即shutdownWrite，
+    // 还有数据没发完的连接状态变成kDisconnecting，由handleWrite发送完之后再shutdownWrite
+    // 对端收到FIN后关闭连接，handleClose >> removeConnection
+    for(auto& item : connections_)
+    {
+        item.second->shutdown();
+    }
+    drainTimer_ = loop_->runAfter(timeoutSeconds, std::bind(&TcpServer::forceCloseAll, this));
+}
+
+// drain超时，剩下的连接不再等待
+void TcpServer::forceCloseAll()
+{
+    LOG_INFO("TcpServer::drain [%s] - timeout, force close %lu connections \n",
+                name_.c_str(), connections_.size());
+    for(auto& item : connections_)
+    {
+        item.second->forceClose();
+    }
+}
+
+void TcpServer::finishDrain()
+{
+    LOG_INFO("TcpServer::drain [%s] - all connections closed \n", name_.c_str());
+    loop_->cancel(drainTimer_);
+    if(drainCompleteCallback_)
+    {
+        DrainCompleteCallback cb;
+        cb.swap(drainCompleteCallback_);
+        cb();
+    }
+}
+
+// 在baseLoop中定时执行，给每个loop投递一个探测回调，上一个探测还没执行完的loop不重复投递
+void TcpServer::probeLoopLag()
+{
+    int64_t now = Timestamp::now().microSecondsSinceEpoch();
+    for(auto& item : loopLoads_)
+    {
+        LoopLoadPtr load = item.second;
+        if(load->probeSentUs != 0)
+        {
+            continue;
+        }
+        load->probeSentUs = now;
+        item.first->queueInLoop([load, now]() {
+            load->lagUs = Timestamp::now().microSecondsSinceEpoch() - now;
+            load->probeSentUs = 0;
+        });
+    }
+}
+
+bool TcpServer::loopOverloaded(EventLoop* loop, Timestamp now)
+{
+    if(maxLoopLagSeconds_ > 0)
+    {
+        auto it = loopLoads_.find(loop);
+        if(it != loopLoads_.end())
+        {
+            int64_t lag = it->second->lagUs;
+            int64_t sent = it->second->probeSentUs;
+            if(sent > 0)
+            {
+                // loop卡住的时候探测回调一直不执行，用等待的时间作为延迟
+                lag = std::max(lag, now.microSecondsSinceEpoch() - sent);
+            }
+            if(lag > static_cast<int64_t>(maxLoopLagSeconds_ * Timestamp::kMicroSecondsPerSecond))
+            {
+                return true;
+            }
+        }
+    }
+    if(maxPendingFunctors_ > 0 && loop->queueSize() > maxPendingFunctors_)
+    {
+        return true;
+    }
+    return false;
+}
+
+EventLoop* TcpServer::selectLoop()
+{
+    if(maxLoopLagSeconds_ <= 0 && maxPendingFunctors_ == 0)
+    {
+        return threadPool_->getNextLoop();
+    }
+
+    Timestamp now(Timestamp::now());
+    size_t numLoops = std::max<size_t>(loopLoads_.size(), 1);
+    for(size_t i = 0; i < numLoops; i++)
+    {
+        EventLoop* ioLoop = threadPool_->getNextLoop();
+        if(!loopOverloaded(ioLoop, now))
+        {
+            return ioLoop;
+        }
+    }
+    return nullptr;
+}
+
+void TcpServer::shedConnection(int sockfd, const char* reason)
+{
+    ::close(sockfd);
+    ++shedCount_;
+    ++numRejected_;
+
+    // 日志限流，过载时最多每秒一条
+    Timestamp now(Timestamp::now());
+    if(timeDifference(now, lastShedLog_) >= 1.0)
+    {
+        LOG_ERROR("TcpServer::newConnection [%s] - %s, %ld connections shed \n",
+                    name_.c_str(), reason, shedCount_);
+        lastShedLog_ = now;
+        shedCount_ = 0;
+    }
+
+    if(overloadAction_ == kPauseAccept && !acceptPaused_)
+    {
+        acceptPaused_ = true;
+        acceptor_->pauseAccepting();
+        resumeTimer_ = loop_->runAfter(overloadPauseSeconds_, std::bind(&TcpServer::resumeAccepting, this));
+    }
+}
+
+void TcpServer::resumeAccepting()
+{
+    acceptPaused_ = false;
+    acceptor_->resumeAccepting();
+}
+
+// 在baseLoop中定时执行：根据这段时间各个loop的繁忙程度和各条连接的流量，决定要不要迁移一条连接
+void TcpServer::rebalance()
+{
+    Timestamp now(Timestamp::now());
+    double elapsedUs = timeDifference(now, lastRebalance_) * Timestamp::kMicroSecondsPerSecond;
+    lastRebalance_ = now;
+    if(elapsedUs <= 0)
+    {
+        return;
+    }
+
+    // 各个loop这段时间的繁忙程度，0~1
+    std::unordered_map<EventLoop*, double> utilization = sampleLoopBusy(&loopBusyUs_, elapsedUs);
+    EventLoop* hot = nullptr;
+    EventLoop* cold = nullptr;
+    for(auto& item : utilization)
+    {
+        if(hot == nullptr || item.second > utilization[hot])
+        {
+            hot = item.first;
+        }
+        if(cold == nullptr || item.second < utilization[cold])
+        {
+            cold = item.first;
+        }
+    }
+    if(hot == nullptr)
+    {
+        return;
+    }
+
+    // 各条连接这段时间的流量，顺便去掉已经关闭的连接
+    std::unordered_map<std::string, TrafficSample> traffic;
+    traffic.reserve(connections_.size());
+    std::vector<std::pair<TcpConnectionPtr, uint64_t>> candidates;
+    uint64_t hotBytes = 0;
+    for(auto& item : connections_)
+    {
+        const TcpConnectionPtr& conn = item.second;
+        TrafficSample& sample = traffic[item.first];
+        sample.bytes = conn->bytesReceived() + conn->bytesSent();
+        uint64_t delta = sample.bytes;
+        auto it = traffic_.find(item.first);
+        if(it != traffic_.end())
+        {
+            delta = sample.bytes - it->second.bytes;
+            sample.cooldown = std::max(it->second.cooldown - 1, 0);
+        }
+        if(conn->getLoop() == hot)
+        {
+            hotBytes += delta;
+            if(sample.cooldown == 0 && delta > 0)
+            {
+                candidates.emplace_back(conn, delta);
+            }
+        }
+    }
+    traffic_.swap(traffic);
+
+    double hotUtil = utilization[hot];
+    double coldUtil = utilization[cold];
+    if(migrating_ || draining_ || !retirements_.empty() || hot == cold || hotBytes == 0 || hotUtil - coldUtil < rebalanceImbalance_)
+    {
+        return;
+    }
+
+    // 假设loop的繁忙程度和流量成正比，挑迁移之后两个loop中较忙的那个最闲的连接，
+    // 迁移之后改善不明显（比如热loop上只有一条重连接，搬过去只是换个loop忙）就不动
+    TcpConnectionPtr best;
+    double bestPeak = hotUtil - rebalanceImbalance_ / 2;
+    for(auto& candidate : candidates)
+    {
+        double moved = hotUtil * candidate.second / hotBytes;
+        double peak = std::max(hotUtil - moved, coldUtil + moved);
+        if(peak < bestPeak && candidate.first->migratable() && (!migrationFilter_ || migrationFilter_(candidate.first)))
+        {
+            best = candidate.first;
+            bestPeak = peak;
+        }
+    }
+    if(!best)
+    {
+        return;
+    }
+    LOG_INFO("TcpServer::rebalance [%s] - loop busy %.0f%% / %.0f%%, migrate [%s] \n",
+                name_.c_str(), hotUtil * 100, coldUtil * 100, best->name().c_str());
+    migrating_ = true;
+    traffic_[best->name()].cooldown = kMigrationCooldown;
+    migrateConnection(best, cold, std::bind(&TcpServer::migrationDone, this, std::placeholders::_1, std::placeholders::_2));
+}
+
+void TcpServer::broadcast(const SharedPayload& payload, const BroadcastFilter& filter)
+{
+    loop_->runInLoop(std::bind(&TcpServer::broadcastInLoop, this, payload, filter), EventLoop::kUrgent);
+}
+
+void TcpServer::broadcastInLoop(const SharedPayload& payload, const BroadcastFilter& filter)
+{
+    if(!broadcastGroups_ || broadcastGroupsMigrations_ != numMigrations_)
+    {
+        std::unordered_map<EventLoop*, size_t> index;
+        auto groups = std::make_shared<ConnectionGroups>();
+        for(auto& item : connections_)
+        {
+            EventLoop* ioLoop = item.second->getLoop();
+            auto it = index.find(ioLoop);
+            if(it == index.end())
+            {
+                it = index.emplace(ioLoop, groups->size()).first;
+                groups->emplace_back(ioLoop, std::vector<TcpConnectionPtr>());
+            }
+            (*groups)[it->second].second.push_back(item.second);
+        }
+        broadcastGroups_ = groups;
+        broadcastGroupsMigrations_ = numMigrations_;
+    }
+    // 任务里持有整个分组，之后连接增删重建分组不影响已经投递出去的任务
+    ConnectionGroupsPtr groups = broadcastGroups_;
+    for(size_t i = 0; i < groups->size(); i++)
+    {
+        // 分组之后才迁移走的连接，send会转发到它现在的loop
+        (*groups)[i].first->runInLoop([groups, i, payload, filter]() {
+            for(const TcpConnectionPtr& conn : (*groups)[i].second)
+            {
+                if(!filter || filter(conn))
+                {
+                    conn->send(payload);
+                }
+            }
+        }, EventLoop::kUrgent);
+    }
+}
+
+std::unordered_map<EventLoop*, double> TcpServer::sampleLoopBusy(std::unordered_map<EventLoop*, int64_t>* last, double elapsedUs)
+{
+    std::unordered_map<EventLoop*, int64_t> current;
+    std::unordered_map<EventLoop*, double> utilization;
+    if(threadPool_->numLoops() == 0)
+    {
+        return utilization;     //只有baseLoop
+    }
+    for(EventLoop* ioLoop : threadPool_->getAllLoops())
+    {
+        int64_t busy = ioLoop->busyMicroseconds();
+        current[ioLoop] = busy;
+        auto it = last->find(ioLoop);
+        if(it != last->end() && elapsedUs > 0)
+        {
+            utilization[ioLoop] = (busy - it->second) / elapsedUs;
+        }
+    }
+    last->swap(current);    //新加的loop从这次开始统计，退休的loop不再统计
+    return utilization;
+}
+
+// 在连接所在的loop中执行
+void TcpServer::migrationDone(const TcpConnectionPtr& conn, bool migrated)
+{
+    if(migrated)
+    {
+        ++numMigrations_;
+        if(connectionMigratedCallback_)
+        {
+            connectionMigratedCallback_(conn);
+        }
+    }
+    loop_->runInLoop([this]() { migrating_ = false; });
+}
+
+void TcpServer::migrateConnection(const TcpConnectionPtr& conn, EventLoop* ioLoop, const MigrateCallback& cb)
+{
+    ++migrationsTo_[ioLoop];
+    conn->migrate(ioLoop, [this, ioLoop, cb](const TcpConnectionPtr& c, bool migrated) {
+        if(cb)
+        {
+            cb(c, migrated);
+        }
+        loop_->runInLoop(std::bind(&TcpServer::migrationFinished, this, c, ioLoop, migrated, cb));
+    });
+}
+
+void TcpServer::migrationFinished(const TcpConnectionPtr& conn, EventLoop* ioLoop, bool migrated, const MigrateCallback& cb)
+{
+    if(--migrationsTo_[ioLoop] == 0)
+    {
+        migrationsTo_.erase(ioLoop);
+    }
+    if(!migrated)
+    {
+        return;
+    }
+    // 迁移途中目标loop开始退休了，退休时连接还报告旧loop，没有被迁走，这里再迁移一次
+    std::vector<EventLoop*> loops = threadPool_->getAllLoops();
+    if(std::find(loops.begin(), loops.end(), ioLoop) == loops.end())
+    {
+        LOG_INFO("TcpServer::migrate [%s] - loop %p retired while [%s] was moving in \n",
+                    name_.c_str(), ioLoop, conn->name().c_str());
+        migrateConnection(conn, threadPool_->getNextLoop(), cb);
+    }
+}
+
+void TcpServer::handoff(const std::string& unixPath, bool passIdleConnections,
+                        double drainTimeoutSeconds, const DrainCompleteCallback& cb)
+{
+    loop_->runInLoop(std::bind(&TcpServer::handoffInLoop, this, unixPath, passIdleConnections, drainTimeoutSeconds, cb));
+}
+
+void TcpServer::handoffInLoop(const std::string& unixPath, bool passIdleConnections,
+                            double drainTimeoutSeconds, const DrainCompleteCallback& cb)
+{
+    int unixfd = SocketHandoff::connectUnix(unixPath);
+    if(unixfd < 0)
+    {
+        LOG_ERROR("TcpServer::handoff [%s] - connect %s fail, keep serving \n", name_.c_str(), unixPath.c_str());
+        return;
+    }
+    std::vector<int> listenfds{acceptor_->fd()};
+    if(!SocketHandoff::sendFds(unixfd, SocketHandoff::kListenTag, listenfds))
+    {
+        LOG_ERROR("TcpServer::handoff [%s] - send listen fd fail, keep serving \n", name_.c_str());
+        ::close(unixfd);
+        return;
+    }
+    // 新进程已经拿到listen fd，全连接队列里的连接由新进程accept
+    acceptor_->stopListen();
+    LOG_INFO("TcpServer::handoff [%s] - listen fd passed to %s \n", name_.c_str(), unixPath.c_str());
+
+    if(!passIdleConnections || connections_.empty())
+    {
+        ::close(unixfd);
+        drainInLoop(drainTimeoutSeconds, cb);
+        return;
+    }
+
+    HandoffStatePtr state = std::make_shared<HandoffState>();
+    state->unixfd = unixfd;
+    state->pending = connections_.size();
+    state->drainTimeoutSeconds = drainTimeoutSeconds;
+    state->cb = cb;
+
+    // 连接属于各个subLoop，到它自己的loop里判断是否空闲并摘下来，结果再交回baseLoop
+    // 单线程时handoffInLoop会同步删除connections_里的元素，所以先拷贝一份
+    std::vector<TcpConnectionPtr> conns;
+    for(auto& item : connections_)
+    {
+        conns.push_back(item.second);
+    }
+    for(const TcpConnectionPtr& conn : conns)
+    {
+        conn->getLoop()->runInLoop([this, conn, state]() {
+            int fd = conn->handoffInLoop();
+            loop_->runInLoop(std::bind(&TcpServer::collectHandoffFd, this, state, fd));
+        });
+    }
+}
+
+void TcpServer::collectHandoffFd(const HandoffStatePtr& state, int fd)
+{
+    if(fd >= 0)
+    {
+        state->fds.push_back(fd);
+    }
+    if(--state->pending > 0)
+    {
+        return;
+    }
+
+    if(!SocketHandoff::sendFds(state->unixfd, SocketHandoff::kConnectionTag, state->fds))
+    {
+        LOG_ERROR("TcpServer::handoff [%s] - send %lu connections fail \n", name_.c_str(), state->fds.size());
+    }
+    for(int connfd : state->fds)
+    {
+        ::close(connfd);    //新进程已经有自己的一份了
+    }
+    ::close(state->unixfd);
+    LOG_INFO("TcpServer::handoff [%s] - %lu idle connections passed \n", name_.c_str(), state->fds.size());
+
+    drainInLoop(state->drainTimeoutSeconds, state->cb);
+}
+
+void TcpServer::adoptConnection(int sockfd)
+{
+    loop_->runInLoop(std::bind(&TcpServer::adoptConnectionInLoop, this, sockfd));
+}
+
+void TcpServer::adoptConnectionInLoop(int sockfd)
+{
+    sockaddr_storage peer;
+    ::bzero(&peer,sizeof peer);
+    socklen_t addrlen = sizeof peer;
+    if(::getpeername(sockfd,(sockaddr*)&peer,&addrlen) < 0)
+    {
+        LOG_ERROR("TcpServer::adoptConnection [%s] - fd %d is not connected \n", name_.c_str(), sockfd);
+        ::close(sockfd);
+        return;
+    }
+    int flags = ::fcntl(sockfd, F_GETFL, 0);
+    ::fcntl(sockfd, F_SETFL, flags | O_NONBLOCK);
+    newConnection(sockfd, InetAddress((sockaddr*)&peer, addrlen));
+}
+
+void TcpServer::setAutoScale(int minLoops, int maxLoops, double intervalSeconds,
+                            double scaleUpBusy, double scaleDownBusy)
+{
+    minLoops_ = std::max(minLoops, 1);
+    maxLoops_ = std::max(maxLoops, minLoops_);
+    autoScaleInterval_ = intervalSeconds;
+    scaleUpBusy_ = scaleUpBusy;
+    scaleDownBusy_ = scaleDownBusy;
+}
+
+void TcpServer::addLoop()
+{
+    loop_->runInLoop(std::bind(&TcpServer::addLoopInLoop, this));
+}
+
+void TcpServer::addLoopInLoop()
+{
+    EventLoop* ioLoop = threadPool_->addLoop();
+    loopLoads_[ioLoop] = std::make_shared<LoopLoad>();
+    LOG_INFO("TcpServer::addLoop [%s] - loop %p, %lu loops \n", name_.c_str(), ioLoop, threadPool_->numLoops());
+}
+
+void TcpServer::retireLoop(EventLoop* loop, bool migrateConnections, double timeoutSeconds, const DrainCompleteCallback& cb)
+{
+    loop_->runInLoop(std::bind(&TcpServer::retireLoopInLoop, this, loop, migrateConnections, timeoutSeconds, cb));
+}
+
+void TcpServer::retireLoopInLoop(EventLoop* ioLoop, bool migrateConnections, double timeoutSeconds, const DrainCompleteCallback& cb)
+{
+    if(ioLoop == nullptr && threadPool_->numLoops() > 0)
+    {
+        // 选连接最少的subLoop
+        std::unordered_map<EventLoop*, size_t> counts;
+        for(EventLoop* l : threadPool_->getAllLoops())
+        {
+            counts[l] = 0;
+        }
+        for(auto& item : connections_)
+        {
+            auto it = counts.find(item.second->getLoop());
+            if(it != counts.end())
+            {
+                ++it->second;
+            }
+        }
+        for(auto& item : counts)
+        {
+            if(ioLoop == nullptr || item.second < counts[ioLoop])
+            {
+                ioLoop = item.first;
+            }
+        }
+    }
+    if(ioLoop == nullptr || !threadPool_->removeLoop(ioLoop))
+    {
+        LOG_ERROR("TcpServer::retireLoop [%s] - loop %p is not an active sub loop \n", name_.c_str(), ioLoop);
+        return;
+    }
+    loopLoads_.erase(ioLoop);
+    LOG_INFO("TcpServer::retireLoop [%s] - loop %p, %lu loops left \n", name_.c_str(), ioLoop, threadPool_->numLoops());
+
+    RetirementPtr retirement = std::make_shared<Retirement>();
+    retirement->loop = ioLoop;
+    retirement->deadline = addTime(Timestamp::now(), timeoutSeconds);
+    retirement->cb = cb;
+    retirements_.push_back(retirement);
+
+    // 已经不在轮询里了，getNextLoop只会返回其他loop（没有subLoop了就是baseLoop）
+    for(auto& item : connections_)
+    {
+        const TcpConnectionPtr& conn = item.second;
+        if(conn->getLoop() != ioLoop)
+        {
+            continue;
+        }
+        if(migrateConnections && conn->migratable() && (!migrationFilter_ || migrationFilter_(conn)))
+        {
+            migrateConnection(conn, threadPool_->getNextLoop(), [this](const TcpConnectionPtr& c, bool migrated) {
+                if(!migrated)
+                {
+                    c->shutdown();
+                    return;
+                }
+                ++numMigrations_;
+                if(connectionMigratedCallback_)
+                {
+                    connectionMigratedCallback_(c);
+                }
+            });
+        }
+        else
+        {
+            conn->shutdown();
+        }
+    }
+    checkRetirement(retirement);
+}
+
+void TcpServer::checkRetirement(const RetirementPtr& retirement)
+{
+    std::vector<TcpConnectionPtr> remaining;
+    for(auto& item : connections_)
+    {
+        if(item.second->getLoop() == retirement->loop)
+        {
+            remaining.push_back(item.second);
+        }
+    }
+    // 迁移到这个loop的连接还没attach时也不能结束，否则attach会在已经销毁的loop上执行
+    if(remaining.empty() && migrationsTo_.count(retirement->loop) == 0)
+    {
+        // 已经排进这个loop的connectDistory等回调执行完之后，再回到baseLoop结束线程
+        retirement->loop->queueInLoop([this, retirement]() {
+            loop_->queueInLoop(std::bind(&TcpServer::finishRetirement, this, retirement));
+        });
+        return;
+    }
+    if(!retirement->forced && retirement->deadline < Timestamp::now())
+    {
+        LOG_INFO("TcpServer::retireLoop [%s] - timeout, force close %lu connections \n", name_.c_str(), remaining.size());
+        for(const TcpConnectionPtr& conn : remaining)
+        {
+            conn->forceClose();
+        }
+        retirement->forced = true;
+    }
+    retirement->timer = loop_->runAfter(kRetireCheckInterval, std::bind(&TcpServer::checkRetirement, this, retirement));
+}
+
+void TcpServer::finishRetirement(const RetirementPtr& retirement)
+{
+    // 先清理以这个loop为key的状态，loop线程结束之后EventLoop就析构了
+    if(compressionContext_)
+    {
+        compressionContext_->removeLoop(retirement->loop);
+    }
+    if(loopRetiredCallback_)
+    {
+        loopRetiredCallback_(retirement->loop);
+    }
+    threadPool_->stopLoop(retirement->loop);
+    retirements_.erase(std::find(retirements_.begin(), retirements_.end(), retirement));
+    LOG_INFO("TcpServer::retireLoop [%s] - loop %p stopped \n", name_.c_str(), retirement->loop);
+    if(retirement->cb)
+    {
+        retirement->cb();
+    }
+}
+
+// 在baseLoop中定时执行
+void TcpServer::autoScale()
+{
+    Timestamp now(Timestamp::now());
+    double elapsedUs = timeDifference(now, lastAutoScale_) * Timestamp::kMicroSecondsPerSecond;
+    lastAutoScale_ = now;
+    std::unordered_map<EventLoop*, double> utilization = sampleLoopBusy(&scaleBusyUs_, elapsedUs);
+    size_t numLoops = threadPool_->numLoops();
+    // 刚加的loop还没有统计，或者正在退休、迁移、drain的时候不动
+    if(utilization.empty() || utilization.size() != numLoops || !retirements_.empty() || migrating_
+        || !migrationsTo_.empty() || draining_)
+    {
+        scaleUpVotes_ = 0;
+        scaleDownVotes_ = 0;
+        return;
+    }
+    double total = 0;
+    EventLoop* idlest = nullptr;
+    for(auto& item : utilization)
+    {
+        total += item.second;
+        if(idlest == nullptr || item.second < utilization[idlest])
+        {
+            idlest = item.first;
+        }
+    }
+    double average = total / numLoops;
+    if(average > scaleUpBusy_ && static_cast<int>(numLoops) < maxLoops_)
+    {
+        scaleDownVotes_ = 0;
+        if(++scaleUpVotes_ >= kScaleVotes)
+        {
+            scaleUpVotes_ = 0;
+            LOG_INFO("TcpServer::autoScale [%s] - average busy %.0f%%, add a loop \n", name_.c_str(), average * 100);
+            addLoopInLoop();
+        }
+    }
+    else if(static_cast<int>(numLoops) > minLoops_ && total / (numLoops - 1) < scaleDownBusy_)
+    {
+        scaleUpVotes_ = 0;
+        if(++scaleDownVotes_ >= kScaleVotes)
+        {
+            scaleDownVotes_ = 0;
+            LOG_INFO("TcpServer::autoScale [%s] - average busy %.0f%%, retire a loop \n", name_.c_str(), average * 100);
+            retireLoopInLoop(idlest, true, kAutoRetireTimeout, DrainCompleteCallback());
+        }
+    }
+    else
+    {
+        scaleUpVotes_ = 0;
+        scaleDownVotes_ = 0;
+    }
+}
@@ -0,0 +1,291 @@
+#include "ThreadPool.h"
+#include "EventLoop.h"
+#include "Thread.h"
+#include "TcpConnection.h"
+
+namespace
+{
+// 当前线程是哪个线程池的第几个工作线程，工作线程自己提交的任务放进自己的队列
+thread_local ThreadPool* t_pool = nullptr;
+thread_local size_t t_workerIndex = 0;
+}
+
+void CompletionQueue::post(Functor cb)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if(closed_)
+    {
+        return;
+    }
+    pending_.push_back(std::move(cb));
+    if(!scheduled_)
+    {
+        scheduled_ = true;
+        // 持有锁时投递，close之后不会再有线程访问loop_
+        CompletionQueuePtr self(shared_from_this());
+        loop_->queueInLoop([self]() { self->drain(); });
+    }
+}
+
+void CompletionQueue::close()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    closed_ = true;
+    pending_.clear();
+}
+
+void CompletionQueue::drain()
+{
+    std::vector<Functor> functors;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        functors.swap(pending_);
+        scheduled_ = false;
+    }
+    for(const Functor& functor : functors)
+    {
+        functor();
+    }
+}
+
+ThreadPool::ThreadPool(const std::string& name)
+    :name_(name),
+    numThreads_(static_cast<int>(std::thread::hardware_concurrency())),
+    running_(false),
+    next_(0),
+    pending_(0),
+    idle_(0)
+{
+}
+
+ThreadPool::~ThreadPool()
+{
+    if(running_)
+    {
+        stop();
+    }
+}
+
+void ThreadPool::start(const ThreadInitCallback& cb)
+{
+    if(numThreads_ <= 0)
+    {
+        numThreads_ = 1;
+    }
+    running_ = true;
+    for(int i = 0; i < numThreads_; i++)
+    {
+        workers_.emplace_back(new Worker);
+    }
+    // 先把start之前提交的任务分下去，再启动线程
+    for(Task& task : beforeStart_)
+    {
+        push(next_++ % workers_.size(), std::move(task));
+    }
+    beforeStart_.clear();
+    for(int i = 0; i < numThreads_; i++)
+    {
+        workers_[i]->thread.reset(new Thread(std::bind(&ThreadPool::runInThread, this, i, cb), name_ + std::to_string(i)));
+        workers_[i]->thread->start();
+    }
+}
+
+void ThreadPool::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(idleMutex_);
+        running_ = false;
+    }
+    idleCond_.notify_all();
+    for(auto& worker : workers_)
+    {
+        worker->thread->join();
+    }
+}
+
+void ThreadPool::run(Task task)
+{
+    if(workers_.empty())
+    {
+        beforeStart_.push_back(std::move(task));
+    }
+    else if(t_pool == this)
+    {
+        push(t_workerIndex, std::move(task));
+    }
+    else
+    {
+        push(next_.fetch_add(1, std::memory_order_relaxed) % workers_.size(), std::move(task));
+    }
+}
+
+CompletionQueuePtr ThreadPool::completionQueue(EventLoop* loop)
+{
+    std::lock_guard<std::mutex> lock(completionMutex_);
+    CompletionQueuePtr& queue = completions_[loop];
+    if(!queue)
+    {
+        queue = std::make_shared<CompletionQueue>(loop);
+    }
+    return queue;
+}
+
+void ThreadPool::removeLoop(EventLoop* loop)
+{
+    CompletionQueuePtr queue;
+    {
+        std::lock_guard<std::mutex> lock(completionMutex_);
+        auto it = completions_.find(loop);
+        if(it == completions_.end())
+        {
+            return;
+        }
+        queue = std::move(it->second);
+        completions_.erase(it);
+    }
+    queue->close();
+}
+
+void ThreadPool::push(size_t index, Task task)
+{
+    Worker* worker = workers_[index].get();
+    {
+        std::lock_guard<std::mutex> lock(worker->mutex);
+        worker->tasks.push_back(std::move(task));
+    }
+    // 和runInThread里先idle_++再检查pending_配对，两边至少有一边能看到对方，不会丢唤醒
+    pending_.fetch_add(1);
+    if(idle_.load() > 0)
+    {
+        std::lock_guard<std::mutex> lock(idleMutex_);
+        idleCond_.notify_one();
+    }
+}
+
+bool ThreadPool::take(size_t index, Task* task)
+{
+    {
+        Worker* self = workers_[index].get();
+        std::lock_guard<std::mutex> lock(self->mutex);
+        if(!self->tasks.empty())
+        {
+            *task = std::move(self->tasks.front());
+            self->tasks.pop_front();
+            pending_.fetch_sub(1);
+            return true;
+        }
+    }
+    size_t n = workers_.size();
+    for(size_t i = 1; i < n; i++)
+    {
+        Worker* victim = workers_[(index + i) % n].get();
+        std::unique_lock<std::mutex> lock(victim->mutex, std::try_to_lock);
+        if(lock.owns_lock() && !victim->tasks.empty())
+        {
+            *task = std::move(victim->tasks.back());
+            victim->tasks.pop_back();
+            pending_.fetch_sub(1);
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::runInThread(size_t index, const ThreadInitCallback& cb)
+{
+    t_pool = this;
+    t_workerIndex = index;
+    if(cb)
+    {
+        cb();
+    }
+    Task task;
+    for(;;)
+    {
+        if(take(index, &task))
+        {
+            task();
+            task = nullptr;     //尽早释放任务捕获的对象
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(idleMutex_);
+        idle_.fetch_add(1);
+        // try_lock偷任务可能漏掉正在被加锁的队列，pending_不为0时回去再扫一遍
+        while(pending_.load() == 0 && running_)
+        {
+            idleCond_.wait(lock);
+        }
+        idle_.fetch_sub(1);
+        if(pending_.load() == 0 && !running_)
+        {
+            break;
+        }
+    }
+    t_pool = nullptr;
+}
+
+SerialExecutor::SerialExecutor(ThreadPool* pool, EventLoop* loop)
+    :pool_(pool),
+    completion_(pool->completionQueue(loop)),
+    scheduled_(false)
+{
+}
+
+SerialExecutor::SerialExecutor(ThreadPool* pool, const std::shared_ptr<TcpConnection>& conn)
+    :SerialExecutor(pool, conn->getLoop())
+{
+    conn->setMigratable(false);
+}
+
+void SerialExecutor::run(Task task)
+{
+    bool schedule = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.push_back(std::move(task));
+        if(!scheduled_)
+        {
+            scheduled_ = true;
+            schedule = true;
+        }
+    }
+    if(schedule)
+    {
+        SerialExecutorPtr self(shared_from_this());
+        pool_->run([self]() { self->drain(); });
+    }
+}
+
+size_t SerialExecutor::queueSize()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return tasks_.size();
+}
+
+void SerialExecutor::drain()
+{
+    for(int i = 0; i < kMaxBatch; i++)
+    {
+        Task task;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if(tasks_.empty())
+            {
+                scheduled_ = false;
+                return;
+            }
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+        task();
+    }
+    // 还有任务，排到线程池队列的最后面，让其他连接的任务先执行
+    std::lock_guard<std::mutex> lock(mutex_);
+    if(tasks_.empty())
+    {
+        scheduled_ = false;
+        return;
+    }
+    SerialExecutorPtr self(shared_from_this());
+    pool_->run([self]() { self->drain(); });
+}
@@ -1,9 +1,11 @@
 
 #include "Timestamp.h"
 #include <time.h>
+#include <sys/time.h>
 
 
 Timestamp::Timestamp()
+    :microSecondsSinceEpoch_(0)
 {
 
 }
@@ -11,15 +13,19 @@ Timestamp::Timestamp(int64_t microSecondsSinceEpoch)
     :microSecondsSinceEpoch_(microSecondsSinceEpoch)
 {}
 
+// 定时器需要微秒精度，用gettimeofday而不是time()
 Timestamp Timestamp::now()
 {
-    return Timestamp(time(nullptr));
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    return Timestamp(static_cast<int64_t>(tv.tv_sec) * kMicroSecondsPerSecond + tv.tv_usec);
 }
 
 std::string Timestamp::toString() const
 {
     char buf[128] = {0};
-    tm* tm_time = localtime(&microSecondsSinceEpoch_);
+    time_t seconds = static_cast<time_t>(microSecondsSinceEpoch_ / kMicroSecondsPerSecond);
+    tm* tm_time = localtime(&seconds);
     snprintf(buf,128,"%4d/%02d/%02d %02d:%02d:%02d",
             tm_time->tm_year+1900,
             tm_time->tm_mon+1,
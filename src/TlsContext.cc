@@ -0,0 +1,147 @@
+#include "TlsContext.h"
+#include "TlsSession.h"
+#include "Logger.h"
+
+#ifdef MYMUDUO_WITH_OPENSSL
+
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+
+static void logSslErrors(const char* what)
+{
+    unsigned long err;
+    while((err = ::ERR_get_error()) != 0)
+    {
+        char errbuf[256];   //LOG_ERROR里面也有一个buf
+        ::ERR_error_string_n(err, errbuf, sizeof errbuf);
+        LOG_ERROR("%s - %s \n", what, errbuf);
+    }
+}
+
+// 握手过程中OpenSSL每派生出一个密钥就回调一次，格式和SSLKEYLOGFILE一样
+static void keylogCallback(const SSL* ssl, const char* line)
+{
+    TlsSession* session = static_cast<TlsSession*>(SSL_get_app_data(ssl));
+    if(session)
+    {
+        session->saveTrafficSecret(line);
+    }
+}
+
+static SSL_CTX* newContext(bool isServer)
+{
+    SSL_CTX* ctx = ::SSL_CTX_new(isServer ? ::TLS_server_method() : ::TLS_client_method());
+    if(ctx == nullptr)
+    {
+        logSslErrors("TlsContext - SSL_CTX_new");
+        return nullptr;
+    }
+    SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION);
+    // 内存BIO上SSL_write可能只写了一部分，允许上层换一个buffer重试
+    SSL_CTX_set_mode(ctx, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER | SSL_MODE_RELEASE_BUFFERS);
+    return ctx;
+}
+
+TlsContextPtr TlsContext::createServer(const std::string& certFile, const std::string& keyFile)
+{
+    SSL_CTX* ctx = newContext(true);
+    if(ctx == nullptr)
+    {
+        return nullptr;
+    }
+    if(::SSL_CTX_use_certificate_chain_file(ctx, certFile.c_str()) != 1
+        || ::SSL_CTX_use_PrivateKey_file(ctx, keyFile.c_str(), SSL_FILETYPE_PEM) != 1
+        || ::SSL_CTX_check_private_key(ctx) != 1)
+    {
+        logSslErrors("TlsContext::createServer");
+        LOG_ERROR("TlsContext::createServer - load %s / %s failed \n", certFile.c_str(), keyFile.c_str());
+        ::SSL_CTX_free(ctx);
+        return nullptr;
+    }
+    TlsContextPtr context(new TlsContext(ctx, true, false));
+    context->setKernelTls(true);
+    return context;
+}
+
+TlsContextPtr TlsContext::createClient(const std::string& caFile, bool verifyPeer)
+{
+    SSL_CTX* ctx = newContext(false);
+    if(ctx == nullptr)
+    {
+        return nullptr;
+    }
+    if(verifyPeer)
+    {
+        int ok = caFile.empty() ? ::SSL_CTX_set_default_verify_paths(ctx)
+                                : ::SSL_CTX_load_verify_locations(ctx, caFile.c_str(), nullptr);
+        if(ok != 1)
+        {
+            logSslErrors("TlsContext::createClient");
+            LOG_ERROR("TlsContext::createClient - load CA %s failed \n", caFile.c_str());
+            ::SSL_CTX_free(ctx);
+            return nullptr;
+        }
+        ::SSL_CTX_set_verify(ctx, SSL_VERIFY_PEER, nullptr);
+    }
+    TlsContextPtr context(new TlsContext(ctx, false, verifyPeer));
+    context->setKernelTls(true);
+    return context;
+}
+
+TlsContext::TlsContext(ssl_ctx_st* ctx, bool isServer, bool verifyPeer)
+    :ctx_(ctx),
+    isServer_(isServer),
+    verifyPeer_(verifyPeer),
+    kernelTls_(false)
+{
+}
+
+TlsContext::~TlsContext()
+{
+    ::SSL_CTX_free(ctx_);
+}
+
+void TlsContext::setKernelTls(bool on)
+{
+    kernelTls_ = on;
+    // 只有开启kTLS时才需要拿到流量密钥
+    ::SSL_CTX_set_keylog_callback(ctx_, on ? keylogCallback : nullptr);
+    if(isServer_)
+    {
+        // session ticket是握手之后用应用流量密钥加密发出的，会占用记录序号，kTLS的序号就对不上了
+        ::SSL_CTX_set_num_tickets(ctx_, on ? 0 : 2);
+    }
+}
+
+#else   // MYMUDUO_WITH_OPENSSL
+
+TlsContextPtr TlsContext::createServer(const std::string& certFile, const std::string& keyFile)
+{
+    LOG_ERROR("TlsContext::createServer - mymuduo is built without OpenSSL \n");
+    return nullptr;
+}
+
+TlsContextPtr TlsContext::createClient(const std::string& caFile, bool verifyPeer)
+{
+    LOG_ERROR("TlsContext::createClient - mymuduo is built without OpenSSL \n");
+    return nullptr;
+}
+
+TlsContext::TlsContext(ssl_ctx_st* ctx, bool isServer, bool verifyPeer)
+    :ctx_(ctx),
+    isServer_(isServer),
+    verifyPeer_(verifyPeer),
+    kernelTls_(false)
+{
+}
+
+TlsContext::~TlsContext()
+{
+}
+
+void TlsContext::setKernelTls(bool on)
+{
+    kernelTls_ = on;
+}
+
+#endif  // MYMUDUO_WITH_OPENSSL
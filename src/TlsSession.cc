@@ -0,0 +1,427 @@
+#include "TlsSession.h"
+#include "Logger.h"
+
+#ifdef MYMUDUO_WITH_OPENSSL
+
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/kdf.h>
+#include <openssl/crypto.h>
+
+#include <algorithm>
+#include <climits>
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <netinet/tcp.h>
+#include <linux/tls.h>
+
+#ifndef SOL_TLS
+#define SOL_TLS 282
+#endif
+
+#ifndef TLS_SET_RECORD_TYPE
+#define TLS_SET_RECORD_TYPE 1
+#endif
+
+namespace
+{
+
+const size_t kReadChunk = 16 * 1024;    //一个TLS记录最大16K明文
+
+void logSslErrors(const char* what)
+{
+    unsigned long err;
+    while((err = ::ERR_get_error()) != 0)
+    {
+        char errbuf[256];   //LOG_ERROR里面也有一个buf
+        ::ERR_error_string_n(err, errbuf, sizeof errbuf);
+        LOG_ERROR("%s - %s \n", what, errbuf);
+    }
+}
+
+std::string unhex(const char* p, size_t len)
+{
+    std::string out;
+    out.reserve(len / 2);
+    for(size_t i = 0; i + 1 < len; i += 2)
+    {
+        auto nibble = [](char c) { return c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10; };
+        out.push_back(static_cast<char>((nibble(p[i]) << 4) | nibble(p[i + 1])));
+    }
+    return out;
+}
+
+// RFC 8446 7.1 HKDF-Expand-Label(secret, label, "", len)
+bool hkdfExpandLabel(const EVP_MD* md, const std::string& secret, const char* label,
+                    unsigned char* out, size_t len)
+{
+    unsigned char info[2 + 1 + 255 + 1];
+    size_t labelLen = ::strlen(label);
+    size_t n = 0;
+    info[n++] = static_cast<unsigned char>(len >> 8);
+    info[n++] = static_cast<unsigned char>(len);
+    info[n++] = static_cast<unsigned char>(6 + labelLen);
+    ::memcpy(info + n, "tls13 ", 6);
+    n += 6;
+    ::memcpy(info + n, label, labelLen);
+    n += labelLen;
+    info[n++] = 0;      //context为空
+
+    EVP_PKEY_CTX* pctx = ::EVP_PKEY_CTX_new_id(EVP_PKEY_HKDF, nullptr);
+    bool ok = pctx != nullptr
+        && ::EVP_PKEY_derive_init(pctx) > 0
+        && EVP_PKEY_CTX_set_hkdf_mode(pctx, EVP_PKEY_HKDEF_MODE_EXPAND_ONLY) > 0
+        && EVP_PKEY_CTX_set_hkdf_md(pctx, md) > 0
+        && EVP_PKEY_CTX_set1_hkdf_key(pctx, reinterpret_cast<const unsigned char*>(secret.data()),
+                                        static_cast<int>(secret.size())) > 0
+        && EVP_PKEY_CTX_add1_hkdf_info(pctx, info, static_cast<int>(n)) > 0
+        && ::EVP_PKEY_derive(pctx, out, &len) > 0;
+    ::EVP_PKEY_CTX_free(pctx);
+    return ok;
+}
+
+// 从流量密钥派生出key和iv，配置到socket的一个方向上，记录序号从0开始
+bool installKey(int fd, int direction, const EVP_MD* md, size_t keyLen, const std::string& secret)
+{
+    unsigned char key[32];
+    unsigned char iv[12];
+    if(!hkdfExpandLabel(md, secret, "key", key, keyLen) || !hkdfExpandLabel(md, secret, "iv", iv, sizeof iv))
+    {
+        logSslErrors("TlsSession - HKDF-Expand-Label");
+        return false;
+    }
+    // TLS1.3的nonce = iv ^ seq，内核里salt是前4字节，iv是后8字节
+    int ret;
+    if(keyLen == 16)
+    {
+        tls12_crypto_info_aes_gcm_128 info;
+        ::memset(&info, 0, sizeof info);
+        info.info.version = TLS_1_3_VERSION;
+        info.info.cipher_type = TLS_CIPHER_AES_GCM_128;
+        ::memcpy(info.key, key, sizeof info.key);
+        ::memcpy(info.salt, iv, sizeof info.salt);
+        ::memcpy(info.iv, iv + sizeof info.salt, sizeof info.iv);
+        ret = ::setsockopt(fd, SOL_TLS, direction, &info, sizeof info);
+        OPENSSL_cleanse(&info, sizeof info);
+    }
+    else
+    {
+        tls12_crypto_info_aes_gcm_256 info;
+        ::memset(&info, 0, sizeof info);
+        info.info.version = TLS_1_3_VERSION;
+        info.info.cipher_type = TLS_CIPHER_AES_GCM_256;
+        ::memcpy(info.key, key, sizeof info.key);
+        ::memcpy(info.salt, iv, sizeof info.salt);
+        ::memcpy(info.iv, iv + sizeof info.salt, sizeof info.iv);
+        ret = ::setsockopt(fd, SOL_TLS, direction, &info, sizeof info);
+        OPENSSL_cleanse(&info, sizeof info);
+    }
+    OPENSSL_cleanse(key, sizeof key);
+    OPENSSL_cleanse(iv, sizeof iv);
+    if(ret < 0)
+    {
+        LOG_ERROR("TlsSession - setsockopt SOL_TLS %s on fd %d failed: %d \n",
+                direction == TLS_TX ? "TLS_TX" : "TLS_RX", fd, errno);
+        return false;
+    }
+    return true;
+}
+
+}
+
+TlsSession::TlsSession(const TlsContextPtr& ctx, const std::string& serverName)
+    :ctx_(ctx),
+    ssl_(::SSL_new(ctx->native())),
+    rbio_(::BIO_new(::BIO_s_mem())),
+    wbio_(::BIO_new(::BIO_s_mem())),
+    handshakeDone_(false),
+    kernelTx_(false),
+    kernelRx_(false),
+    closeNotifySent_(false)
+{
+    // rbio读空时返回重试而不是EOF，SSL_read才会报WANT_READ
+    BIO_set_mem_eof_return(rbio_, -1);
+    ::SSL_set_bio(ssl_, rbio_, wbio_);
+    SSL_set_app_data(ssl_, this);
+    if(ctx->isServer())
+    {
+        ::SSL_set_accept_state(ssl_);
+    }
+    else
+    {
+        ::SSL_set_connect_state(ssl_);
+        if(!serverName.empty())
+        {
+            SSL_set_tlsext_host_name(ssl_, serverName.c_str());
+            if(ctx->verifyPeer())
+            {
+                ::SSL_set1_host(ssl_, serverName.c_str());
+            }
+        }
+    }
+}
+
+TlsSession::~TlsSession()
+{
+    ::SSL_free(ssl_);   //同时释放两个BIO
+    OPENSSL_cleanse(&clientSecret_[0], clientSecret_.size());
+    OPENSSL_cleanse(&serverSecret_[0], serverSecret_.size());
+}
+
+void TlsSession::startHandshake(Buffer* out)
+{
+    continueHandshake(out);
+}
+
+bool TlsSession::continueHandshake(Buffer* out)
+{
+    int ret = ::SSL_do_handshake(ssl_);
+    drainOutput(out);   //失败时也可能有alert要发
+    if(ret == 1)
+    {
+        handshakeDone_ = true;
+        return true;
+    }
+    int err = ::SSL_get_error(ssl_, ret);
+    if(err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE)
+    {
+        return true;
+    }
+    logSslErrors("TlsSession - handshake");
+    return false;
+}
+
+TlsSession::Result TlsSession::handleInput(Buffer* plaintext, Buffer* out)
+{
+    // 内存BIO会一直扩容，密文一次全部交给SSL
+    if(cipher_.readableBytes() > 0)
+    {
+        int n = ::BIO_write(rbio_, cipher_.peek(), static_cast<int>(cipher_.readableBytes()));
+        if(n <= 0)
+        {
+            return kError;
+        }
+        cipher_.retrieve(n);
+    }
+
+    if(!handshakeDone_)
+    {
+        if(!continueHandshake(out))
+        {
+            return kError;
+        }
+        // 握手完成时先不读后面的应用数据，上层要在这之前决定是否开启kTLS（RX的记录序号要从0开始）
+        return handshakeDone_ ? kHandshakeDone : kOk;
+    }
+
+    for(;;)
+    {
+        plaintext->ensureWritableBytes(kReadChunk);
+        int n = ::SSL_read(ssl_, plaintext->beginWrite(),
+                        static_cast<int>(std::min(plaintext->writableBytes(), static_cast<size_t>(INT_MAX))));
+        if(n > 0)
+        {
+            plaintext->hasWritten(n);
+            continue;
+        }
+        int err = ::SSL_get_error(ssl_, n);
+        if(err == SSL_ERROR_WANT_READ)
+        {
+            break;
+        }
+        if(err == SSL_ERROR_ZERO_RETURN)
+        {
+            // 对端发了close_notify，回一个close_notify，之后等对端关闭tcp连接
+            shutdown(out);
+            break;
+        }
+        logSslErrors("TlsSession - SSL_read");
+        drainOutput(out);
+        return kError;
+    }
+    // key update之类的握手后消息可能需要回复
+    drainOutput(out);
+    return kOk;
+}
+
+bool TlsSession::encrypt(const void* data, size_t len, Buffer* out)
+{
+    const char* p = static_cast<const char*>(data);
+    while(len > 0)
+    {
+        int n = ::SSL_write(ssl_, p, static_cast<int>(std::min(len, static_cast<size_t>(INT_MAX))));
+        if(n <= 0)
+        {
+            logSslErrors("TlsSession - SSL_write");
+            return false;
+        }
+        p += n;
+        len -= n;
+    }
+    drainOutput(out);
+    return true;
+}
+
+void TlsSession::shutdown(Buffer* out)
+{
+    if(!handshakeDone_ || kernelTx_ || closeNotifySent_)
+    {
+        return;
+    }
+    closeNotifySent_ = true;
+    ::SSL_shutdown(ssl_);
+    drainOutput(out);
+}
+
+bool TlsSession::sendKernelCloseNotify(int fd)
+{
+    if(!kernelTx_ || closeNotifySent_)
+    {
+        return true;
+    }
+    closeNotifySent_ = true;
+    // alert(warning, close_notify)，记录类型放在cmsg里，内核加密成一个alert记录而不是应用数据
+    unsigned char alert[2] = { 1, 0 };
+    char control[CMSG_SPACE(sizeof(unsigned char))];
+    ::memset(control, 0, sizeof control);
+    struct iovec iov;
+    iov.iov_base = alert;
+    iov.iov_len = sizeof alert;
+    struct msghdr msg;
+    ::memset(&msg, 0, sizeof msg);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof control;
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_TLS;
+    cmsg->cmsg_type = TLS_SET_RECORD_TYPE;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(unsigned char));
+    *CMSG_DATA(cmsg) = 21;  //alert
+    ssize_t n = ::sendmsg(fd, &msg, MSG_NOSIGNAL);
+    if(n != static_cast<ssize_t>(sizeof alert))
+    {
+        LOG_ERROR("TlsSession - fd %d send kTLS close_notify failed: %d \n", fd, errno);
+        return false;
+    }
+    return true;
+}
+
+void TlsSession::drainOutput(Buffer* out)
+{
+    size_t pending;
+    while((pending = BIO_ctrl_pending(wbio_)) > 0)
+    {
+        out->ensureWritableBytes(pending);
+        int n = ::BIO_read(wbio_, out->beginWrite(), static_cast<int>(pending));
+        if(n <= 0)
+        {
+            break;
+        }
+        out->hasWritten(n);
+    }
+}
+
+void TlsSession::saveTrafficSecret(const char* line)
+{
+    // LABEL <client_random> <secret>
+    const char* space = ::strchr(line, ' ');
+    const char* secret = space ? ::strchr(space + 1, ' ') : nullptr;
+    if(secret == nullptr)
+    {
+        return;
+    }
+    std::string label(line, space);
+    if(label == "CLIENT_TRAFFIC_SECRET_0")
+    {
+        clientSecret_ = unhex(secret + 1, ::strlen(secret + 1));
+    }
+    else if(label == "SERVER_TRAFFIC_SECRET_0")
+    {
+        serverSecret_ = unhex(secret + 1, ::strlen(secret + 1));
+    }
+}
+
+void TlsSession::enableKernelTls(int fd)
+{
+    if(!ctx_->kernelTls() || !handshakeDone_ || kernelTx_)
+    {
+        return;
+    }
+    const EVP_MD* md = nullptr;
+    size_t keyLen = 0;
+    if(::SSL_version(ssl_) == TLS1_3_VERSION)
+    {
+        // TLS_AES_128_GCM_SHA256 / TLS_AES_256_GCM_SHA384，chacha20和TLS1.2的套件都留在用户态
+        switch(::SSL_CIPHER_get_protocol_id(::SSL_get_current_cipher(ssl_)))
+        {
+        case 0x1301: md = ::EVP_sha256(); keyLen = 16; break;
+        case 0x1302: md = ::EVP_sha384(); keyLen = 32; break;
+        default: break;
+        }
+    }
+    if(md == nullptr || clientSecret_.empty() || serverSecret_.empty())
+    {
+        LOG_DEBUG("TlsSession - fd %d %s, kTLS not supported, stay in user space \n", fd, description().c_str());
+        return;
+    }
+
+    const bool isServer = ctx_->isServer();
+    if(::setsockopt(fd, SOL_TCP, TCP_ULP, "tls", sizeof "tls") < 0)
+    {
+        // ENOENT: 内核没有加载tls模块
+        LOG_DEBUG("TlsSession - fd %d TCP_ULP tls failed: %d, stay in user space \n", fd, errno);
+    }
+    else if(installKey(fd, TLS_TX, md, keyLen, isServer ? serverSecret_ : clientSecret_))
+    {
+        kernelTx_ = true;
+        // 客户端可能还会收到session ticket等握手消息，内核RX遇到非应用数据的记录会报错，所以只在服务端开启
+        // rbio或者SSL内部还有没处理的密文时，这些记录的序号已经不是0了，也不开启
+        if(isServer && BIO_ctrl_pending(rbio_) == 0 && !::SSL_has_pending(ssl_) && cipher_.readableBytes() == 0)
+        {
+            kernelRx_ = installKey(fd, TLS_RX, md, keyLen, clientSecret_);
+        }
+    }
+    // 之后不会再用到，尽早清掉
+    OPENSSL_cleanse(&clientSecret_[0], clientSecret_.size());
+    OPENSSL_cleanse(&serverSecret_[0], serverSecret_.size());
+    clientSecret_.clear();
+    serverSecret_.clear();
+    LOG_INFO("TlsSession - fd %d %s kTLS tx=%d rx=%d \n", fd, description().c_str(), kernelTx_, kernelRx_);
+}
+
+std::string TlsSession::description() const
+{
+    return std::string(::SSL_get_version(ssl_)) + " " + SSL_get_cipher_name(ssl_);
+}
+
+#else   // MYMUDUO_WITH_OPENSSL
+
+// 没有openssl时TlsContext创建不出来，也就不会有TlsSession，这里只是为了能链接
+TlsSession::TlsSession(const TlsContextPtr& ctx, const std::string& serverName)
+    :ctx_(ctx),
+    ssl_(nullptr),
+    rbio_(nullptr),
+    wbio_(nullptr),
+    handshakeDone_(false),
+    kernelTx_(false),
+    kernelRx_(false),
+    closeNotifySent_(false)
+{
+}
+
+TlsSession::~TlsSession() {}
+void TlsSession::startHandshake(Buffer* out) {}
+bool TlsSession::continueHandshake(Buffer* out) { return false; }
+TlsSession::Result TlsSession::handleInput(Buffer* plaintext, Buffer* out) { return kError; }
+bool TlsSession::encrypt(const void* data, size_t len, Buffer* out) { return false; }
+void TlsSession::shutdown(Buffer* out) {}
+bool TlsSession::sendKernelCloseNotify(int fd) { return false; }
+void TlsSession::drainOutput(Buffer* out) {}
+void TlsSession::saveTrafficSecret(const char* line) {}
+void TlsSession::enableKernelTls(int fd) {}
+std::string TlsSession::description() const { return std::string(); }
+
+#endif  // MYMUDUO_WITH_OPENSSL
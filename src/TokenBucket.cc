@@ -0,0 +1,30 @@
+#include "TokenBucket.h"
+
+#include <algorithm>
+
+void TokenBucket::reset(const RateLimit& limit, Timestamp now)
+{
+    rate_ = limit.rate;
+    burst_ = limit.burst > 0.0 ? limit.burst : limit.rate;
+    tokens_ = burst_;
+    last_ = now;
+}
+
+void TokenBucket::refill(Timestamp now)
+{
+    double elapsed = timeDifference(now, last_);
+    if(elapsed > 0.0)
+    {
+        tokens_ = std::min(burst_, tokens_ + elapsed * rate_);
+        last_ = now;
+    }
+}
+
+double TokenBucket::secondsUntil(double need) const
+{
+    if(tokens_ >= need || rate_ <= 0.0)
+    {
+        return 0.0;
+    }
+    return (need - tokens_) / rate_;
+}
@@ -0,0 +1,343 @@
+#include "UdpChannel.h"
+#include "Channel.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+
+static const size_t kMaxGroSlotSize = 65536;
+static const int kMaxGsoSegments = 64;              //内核的UDP_MAX_SEGMENTS
+static const size_t kMaxGsoBytes = 65507;           //一个udp包payload的上限
+static const int kMaxReadBatchesPerEvent = 8;       //一次读事件最多调用几次recvmmsg，避免一个socket占住loop
+
+static void setIntOption(int fd, int level, int option, int value, const char* name)
+{
+    if(::setsockopt(fd, level, option, &value, sizeof value) < 0)
+    {
+        LOG_ERROR("UdpChannel - setsockopt %s=%d on fd %d failed: %d \n", name, value, fd, errno);
+    }
+}
+
+int UdpChannel::createBound(const InetAddress& addr, bool reusePort, const UdpOptions& options)
+{
+    int sockfd = ::socket(addr.family(), SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_UDP);
+    if(sockfd < 0)
+    {
+        LOG_ERROR("UdpChannel::createBound - socket error: %d \n", errno);
+        return -1;
+    }
+    setIntOption(sockfd, SOL_SOCKET, SO_REUSEADDR, 1, "SO_REUSEADDR");
+    if(reusePort)
+    {
+        setIntOption(sockfd, SOL_SOCKET, SO_REUSEPORT, 1, "SO_REUSEPORT");
+    }
+    if(options.sendBufferSize > 0)
+    {
+        setIntOption(sockfd, SOL_SOCKET, SO_SNDBUF, options.sendBufferSize, "SO_SNDBUF");
+    }
+    if(options.recvBufferSize > 0)
+    {
+        setIntOption(sockfd, SOL_SOCKET, SO_RCVBUF, options.recvBufferSize, "SO_RCVBUF");
+    }
+    if(options.gro)
+    {
+        setIntOption(sockfd, IPPROTO_UDP, UDP_GRO, 1, "UDP_GRO");
+    }
+    if(::bind(sockfd, addr.getSockaddr(), addr.getSockaddrLen()) < 0)
+    {
+        LOG_ERROR("UdpChannel::createBound - bind %s error: %d \n", addr.toIpPort().c_str(), errno);
+        ::close(sockfd);
+        return -1;
+    }
+    return sockfd;
+}
+
+UdpChannel::UdpChannel(EventLoop* loop, int sockfd, const UdpOptions& options)
+    :loop_(loop),
+    sockfd_(sockfd),
+    options_(options),
+    channel_(new Channel(loop, sockfd)),
+    slotSize_(options.gro ? kMaxGroSlotSize : static_cast<size_t>(options.maxDatagramSize)),
+    sendHead_(0),
+    flushQueued_(false),
+    datagramsReceived_(0),
+    datagramsSent_(0),
+    datagramsDropped_(0)
+{
+    const size_t batch = static_cast<size_t>(options_.batchSize);
+    const size_t controlSize = CMSG_SPACE(sizeof(int));
+    recvArena_.resize(batch * slotSize_);
+    recvMsgs_.resize(batch);
+    recvIovecs_.resize(batch);
+    recvAddrs_.resize(batch);
+    recvControl_.resize(batch * controlSize);
+    sendMsgs_.resize(batch);
+    sendIovecs_.resize(batch);
+    sendControl_.resize(batch * CMSG_SPACE(sizeof(uint16_t)));
+    sendSegments_.resize(batch);
+
+    channel_->setReadCallback(std::bind(&UdpChannel::handleRead, this, std::placeholders::_1));
+    channel_->setWriteCallback(std::bind(&UdpChannel::handleWrite, this));
+    channel_->setErrorCallback(std::bind(&UdpChannel::handleError, this));
+}
+
+UdpChannel::~UdpChannel()
+{
+    ::close(sockfd_);
+}
+
+void UdpChannel::start()
+{
+    channel_->tie(shared_from_this());
+    channel_->enableReading();
+}
+
+void UdpChannel::stop()
+{
+    channel_->disableAll();
+    channel_->remove();
+}
+
+void UdpChannel::handleRead(Timestamp receiveTime)
+{
+    const size_t batch = recvMsgs_.size();
+    const size_t controlSize = CMSG_SPACE(sizeof(int));
+    for(int round = 0; round < kMaxReadBatchesPerEvent; round++)
+    {
+        // recvmmsg会改写msg_len、msg_namelen和msg_controllen，每次都重新填
+        for(size_t i = 0; i < batch; i++)
+        {
+            recvIovecs_[i].iov_base = &recvArena_[i * slotSize_];
+            recvIovecs_[i].iov_len = slotSize_;
+            msghdr& hdr = recvMsgs_[i].msg_hdr;
+            hdr.msg_name = &recvAddrs_[i];
+            hdr.msg_namelen = sizeof(sockaddr_storage);
+            hdr.msg_iov = &recvIovecs_[i];
+            hdr.msg_iovlen = 1;
+            hdr.msg_control = options_.gro ? &recvControl_[i * controlSize] : nullptr;
+            hdr.msg_controllen = options_.gro ? controlSize : 0;
+            hdr.msg_flags = 0;
+        }
+
+        int n = ::recvmmsg(sockfd_, recvMsgs_.data(), static_cast<unsigned int>(batch), MSG_DONTWAIT, nullptr);
+        if(n < 0)
+        {
+            if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            {
+                LOG_ERROR("UdpChannel::handleRead - recvmmsg error: %d \n", errno);
+            }
+            return;
+        }
+
+        for(int i = 0; i < n; i++)
+        {
+            const msghdr& hdr = recvMsgs_[i].msg_hdr;
+            if(hdr.msg_flags & MSG_TRUNC)
+            {
+                ++datagramsDropped_;
+                continue;
+            }
+            const char* data = &recvArena_[i * slotSize_];
+            size_t len = recvMsgs_[i].msg_len;
+            // GRO合并过的数据按gso_size切回原来的datagram
+            size_t segmentSize = len;
+            if(options_.gro)
+            {
+                for(cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr); cmsg != nullptr; cmsg = CMSG_NXTHDR(const_cast<msghdr*>(&hdr), cmsg))
+                {
+                    if(cmsg->cmsg_level == IPPROTO_UDP && cmsg->cmsg_type == UDP_GRO)
+                    {
+                        int gsoSize;
+                        ::memcpy(&gsoSize, CMSG_DATA(cmsg), sizeof gsoSize);
+                        if(gsoSize > 0)
+                        {
+                            segmentSize = static_cast<size_t>(gsoSize);
+                        }
+                    }
+                }
+            }
+            InetAddress peer(reinterpret_cast<const sockaddr*>(&recvAddrs_[i]), hdr.msg_namelen);
+            for(size_t offset = 0; offset < len || len == 0; offset += segmentSize)
+            {
+                size_t segmentLen = std::min(segmentSize, len - offset);
+                ++datagramsReceived_;
+                if(datagramCallback_)
+                {
+                    datagramCallback_(this, peer, std::string_view(data + offset, segmentLen), receiveTime);
+                }
+                if(len == 0)
+                {
+                    break;
+                }
+            }
+        }
+
+        if(static_cast<size_t>(n) < batch)
+        {
+            return;
+        }
+    }
+}
+
+void UdpChannel::send(const InetAddress& peer, std::string_view data)
+{
+    if(loop_->isInLoopThread())
+    {
+        sendInLoop(peer, data.data(), data.size());
+    }
+    else
+    {
+        std::string copy(data);
+        UdpChannelPtr self(shared_from_this());
+        loop_->runInLoop([self, peer, copy]() { self->sendInLoop(peer, copy.data(), copy.size()); });
+    }
+}
+
+void UdpChannel::sendInLoop(const InetAddress& peer, const char* data, size_t len)
+{
+    if(sendData_.size() + len > options_.maxPendingSendBytes)
+    {
+        ++datagramsDropped_;
+        return;
+    }
+    sendQueue_.push_back(PendingDatagram{peer, sendData_.size(), len});
+    sendData_.append(data, len);
+    // 这一轮事件循环里的所有send攒在一起，最后一次sendmmsg发出去
+    if(!flushQueued_ && !channel_->isWritting())
+    {
+        flushQueued_ = true;
+        loop_->queueInLoop(std::bind(&UdpChannel::flush, shared_from_this()));
+    }
+}
+
+static bool samePeer(const InetAddress& a, const InetAddress& b)
+{
+    return a.getSockaddrLen() == b.getSockaddrLen()
+        && ::memcmp(a.getSockaddr(), b.getSockaddr(), a.getSockaddrLen()) == 0;
+}
+
+int UdpChannel::fillSendBatch(size_t index)
+{
+    const size_t batch = sendMsgs_.size();
+    const size_t controlSize = CMSG_SPACE(sizeof(uint16_t));
+    int count = 0;
+    while(index < sendQueue_.size() && static_cast<size_t>(count) < batch)
+    {
+        PendingDatagram& first = sendQueue_[index];
+        size_t segments = 1;
+        size_t total = first.length;
+        if(options_.gso && first.length > 0)
+        {
+            // 发给同一个peer的连续datagram在sendData_里也是连续的，等长的可以合成一个GSO包，只有最后一个可以短一些
+            while(index + segments < sendQueue_.size() && segments < static_cast<size_t>(kMaxGsoSegments))
+            {
+                const PendingDatagram& next = sendQueue_[index + segments];
+                if(!samePeer(next.peer, first.peer) || next.length > first.length || next.length == 0
+                    || total + next.length > kMaxGsoBytes
+                    || sendQueue_[index + segments - 1].length != first.length)
+                {
+                    break;
+                }
+                total += next.length;
+                ++segments;
+            }
+        }
+
+        sendIovecs_[count].iov_base = &sendData_[first.offset];
+        sendIovecs_[count].iov_len = total;
+        msghdr& hdr = sendMsgs_[count].msg_hdr;
+        ::memset(&hdr, 0, sizeof hdr);
+        hdr.msg_name = const_cast<sockaddr*>(first.peer.getSockaddr());
+        hdr.msg_namelen = first.peer.getSockaddrLen();
+        hdr.msg_iov = &sendIovecs_[count];
+        hdr.msg_iovlen = 1;
+        if(segments > 1)
+        {
+            hdr.msg_control = &sendControl_[count * controlSize];
+            hdr.msg_controllen = controlSize;
+            cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr);
+            cmsg->cmsg_level = IPPROTO_UDP;
+            cmsg->cmsg_type = UDP_SEGMENT;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+            uint16_t gsoSize = static_cast<uint16_t>(first.length);
+            ::memcpy(CMSG_DATA(cmsg), &gsoSize, sizeof gsoSize);
+        }
+        sendSegments_[count] = segments;
+        index += segments;
+        ++count;
+    }
+    return count;
+}
+
+void UdpChannel::flush()
+{
+    flushQueued_ = false;
+    while(sendHead_ < sendQueue_.size())
+    {
+        int count = fillSendBatch(sendHead_);
+
+        int n = ::sendmmsg(sockfd_, sendMsgs_.data(), static_cast<unsigned int>(count), MSG_DONTWAIT);
+        if(n < 0)
+        {
+            if(errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS)
+            {
+                // 等socket可写再发
+                if(!channel_->isWritting())
+                {
+                    channel_->enableWritting();
+                }
+                return;
+            }
+            // 第一个消息发送失败（比如对端不可达、GSO不支持），丢掉它继续发后面的
+            LOG_ERROR("UdpChannel::flush - sendmmsg error: %d \n", errno);
+            datagramsDropped_ += sendSegments_[0];
+            n = 1;
+        }
+        else
+        {
+            for(int i = 0; i < n; i++)
+            {
+                datagramsSent_ += sendSegments_[i];
+            }
+        }
+        for(int i = 0; i < n; i++)
+        {
+            sendHead_ += sendSegments_[i];
+        }
+    }
+
+    // 全部发完，复用内存
+    sendQueue_.clear();
+    sendData_.clear();
+    sendHead_ = 0;
+    if(channel_->isWritting())
+    {
+        channel_->disableWritting();
+    }
+}
+
+void UdpChannel::handleWrite()
+{
+    flush();
+}
+
+// 之前发出去的datagram收到ICMP不可达之类的错误，读出来清掉，不然水平触发会一直报EPOLLERR
+void UdpChannel::handleError()
+{
+    int err = 0;
+    socklen_t len = sizeof err;
+    ::getsockopt(sockfd_, SOL_SOCKET, SO_ERROR, &err, &len);
+    LOG_DEBUG("UdpChannel::handleError - fd %d SO_ERROR=%d \n", sockfd_, err);
+}
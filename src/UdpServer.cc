@@ -0,0 +1,47 @@
+#include "UdpServer.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+UdpServer::UdpServer(EventLoop* loop, const InetAddress& listenAddr, const std::string& name)
+    :loop_(loop),
+    listenAddr_(listenAddr),
+    name_(name),
+    threadPool_(new EventLoopThreadPool(loop, name)),
+    started_(false)
+{
+}
+
+UdpServer::~UdpServer()
+{
+    // UdpChannel要在自己的loop线程里注销Channel，回调持有shared_ptr，执行完才释放
+    for(UdpChannelPtr& channel : channels_)
+    {
+        channel->getLoop()->runInLoop(std::bind(&UdpChannel::stop, channel));
+    }
+}
+
+void UdpServer::start()
+{
+    if(started_)
+    {
+        return;
+    }
+    started_ = true;
+    threadPool_->start(threadInitCallback_);
+    std::vector<EventLoop*> loops = threadPool_->getAllLoops();
+    bool reusePort = loops.size() > 1;
+    for(EventLoop* ioLoop : loops)
+    {
+        int sockfd = UdpChannel::createBound(listenAddr_, reusePort, options_);
+        if(sockfd < 0)
+        {
+            LOG_FATAL("UdpServer[%s] - cannot bind %s \n", name_.c_str(), listenAddr_.toIpPort().c_str());
+        }
+        UdpChannelPtr channel = std::make_shared<UdpChannel>(ioLoop, sockfd, options_);
+        channel->setDatagramCallback(datagramCallback_);
+        channels_.push_back(channel);
+        ioLoop->runInLoop(std::bind(&UdpChannel::start, channel));
+    }
+    LOG_INFO("UdpServer[%s] listening on %s with %zu sockets \n",
+            name_.c_str(), listenAddr_.toIpPort().c_str(), channels_.size());
+}
@@ -0,0 +1,120 @@
+#include "UpstreamPool.h"
+#include "TcpClient.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+#include <algorithm>
+
+UpstreamPool::UpstreamPool(EventLoop* loop, const InetAddress& serverAddr, const std::string& name, int size)
+    :loop_(loop),
+    serverAddr_(serverAddr),
+    name_(name),
+    size_(size),
+    initRetryDelayMs_(500),
+    maxRetryDelayMs_(30 * 1000),
+    connectionCallback_(defaultConnectionCallback),
+    messageCallback_(defaultMessageCallback)
+{
+}
+
+UpstreamPool::~UpstreamPool()
+{
+    // 先释放池里持有的连接，TcpClient析构时发现自己是唯一持有者就会直接关闭连接
+    idle_.clear();
+    clients_.clear();
+}
+
+void UpstreamPool::start()
+{
+    for(int i = 0; i < size_; i++)
+    {
+        std::string name = name_ + std::to_string(i);
+        TcpClient* client = new TcpClient(loop_, serverAddr_, name);
+        client->setConnectionCallback(std::bind(&UpstreamPool::onConnection, this, std::placeholders::_1));
+        client->setMessageCallback(messageCallback_);
+        client->setRetryDelay(initRetryDelayMs_, maxRetryDelayMs_);
+        client->enableRetry();
+        clients_.emplace_back(std::unique_ptr<TcpClient>(client));
+        client->connect();
+    }
+}
+
+void UpstreamPool::stop()
+{
+    for(auto& client : clients_)
+    {
+        client->stop();
+        client->disconnect();
+    }
+}
+
+void UpstreamPool::acquire(AcquireCallback cb)
+{
+    if(!loop_->isInLoopThread())
+    {
+        loop_->queueInLoop(std::bind(&UpstreamPool::acquire, this, std::move(cb)));
+        return;
+    }
+
+    while(!idle_.empty())
+    {
+        TcpConnectionPtr conn = idle_.back();
+        idle_.pop_back();
+        if(conn->connected())
+        {
+            cb(conn);
+            return;
+        }
+    }
+    waiters_.push_back(std::move(cb));
+}
+
+void UpstreamPool::release(const TcpConnectionPtr& conn)
+{
+    if(!loop_->isInLoopThread())
+    {
+        loop_->queueInLoop(std::bind(&UpstreamPool::release, this, conn));
+        return;
+    }
+
+    if(conn->connected())
+    {
+        putIdle(conn);
+    }
+}
+
+void UpstreamPool::onConnection(const TcpConnectionPtr& conn)
+{
+    if(conn->connected())
+    {
+        LOG_INFO("UpstreamPool[%s] - connection %s up \n", name_.c_str(), conn->name().c_str());
+        connectionCallback_(conn);
+        putIdle(conn);
+    }
+    else
+    {
+        LOG_INFO("UpstreamPool[%s] - connection %s down \n", name_.c_str(), conn->name().c_str());
+        removeIdle(conn);
+        connectionCallback_(conn);
+    }
+}
+
+// 有人在排队就直接交给排队的请求，否则放回空闲栈
+void UpstreamPool::putIdle(const TcpConnectionPtr& conn)
+{
+    if(!waiters_.empty())
+    {
+        AcquireCallback cb = std::move(waiters_.front());
+        waiters_.pop_front();
+        cb(conn);
+    }
+    else
+    {
+        idle_.push_back(conn);
+    }
+}
+
+void UpstreamPool::removeIdle(const TcpConnectionPtr& conn)
+{
+    idle_.erase(std::remove(idle_.begin(), idle_.end(), conn), idle_.end());
+}
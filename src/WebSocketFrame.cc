@@ -0,0 +1,143 @@
+#include "WebSocketFrame.h"
+#include "Buffer.h"
+
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+void WebSocketFrame::unmask(char* data, size_t len, const unsigned char mask[4])
+{
+    uint32_t mask32;
+    ::memcpy(&mask32, mask, 4);
+    size_t i = 0;
+    // 每次处理的长度都是4的倍数，mask的字节顺序和内存中的顺序一致，不需要考虑大小端
+#if defined(__SSE2__)
+    const __m128i mask128 = _mm_set1_epi32(static_cast<int>(mask32));
+    for(; i + 16 <= len; i += 16)
+    {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(data + i), _mm_xor_si128(block, mask128));
+    }
+#endif
+    const uint64_t mask64 = (static_cast<uint64_t>(mask32) << 32) | mask32;
+    for(; i + 8 <= len; i += 8)
+    {
+        uint64_t block;
+        ::memcpy(&block, data + i, 8);
+        block ^= mask64;
+        ::memcpy(data + i, &block, 8);
+    }
+    for(; i < len; ++i)
+    {
+        data[i] ^= mask[i & 3];
+    }
+}
+
+WebSocketFrame::ParseResult WebSocketFrame::parse(Buffer* buf, size_t maxPayloadLength, Header* header)
+{
+    size_t readable = buf->readableBytes();
+    if(readable < 2)
+    {
+        return kNeedMore;
+    }
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(buf->peek());
+    bool fin = (data[0] & 0x80) != 0;
+    if((data[0] & 0x70) != 0)   //没有协商扩展，RSV必须是0
+    {
+        return kProtocolError;
+    }
+    Opcode opcode = static_cast<Opcode>(data[0] & 0x0F);
+    bool masked = (data[1] & 0x80) != 0;
+    if(!masked)     //客户端发来的帧必须加mask
+    {
+        return kProtocolError;
+    }
+
+    size_t headerLength = 2;
+    uint64_t payloadLength = data[1] & 0x7F;
+    if(payloadLength == 126)
+    {
+        headerLength += 2;
+        if(readable < headerLength)
+        {
+            return kNeedMore;
+        }
+        payloadLength = (static_cast<uint64_t>(data[2]) << 8) | data[3];
+    }
+    else if(payloadLength == 127)
+    {
+        headerLength += 8;
+        if(readable < headerLength)
+        {
+            return kNeedMore;
+        }
+        payloadLength = 0;
+        for(int i = 2; i < 10; i++)
+        {
+            payloadLength = (payloadLength << 8) | data[i];
+        }
+    }
+
+    if(opcode >= kClose && (!fin || payloadLength > 125))   //控制帧不能分片，最多125字节
+    {
+        return kProtocolError;
+    }
+    if(payloadLength > maxPayloadLength)
+    {
+        return kTooLarge;
+    }
+
+    const size_t maskOffset = headerLength;
+    headerLength += 4;
+    if(readable < headerLength + payloadLength)
+    {
+        return kNeedMore;
+    }
+
+    unsigned char mask[4];
+    ::memcpy(mask, data + maskOffset, 4);
+    unmask(buf->beginRead() + headerLength, payloadLength, mask);
+
+    header->fin = fin;
+    header->opcode = opcode;
+    header->headerLength = headerLength;
+    header->payloadLength = payloadLength;
+    return kGotFrame;
+}
+
+void WebSocketFrame::appendFrame(Buffer* output, Opcode opcode, const char* payload, size_t len, bool fin)
+{
+    unsigned char header[10];
+    size_t headerLength = 2;
+    header[0] = static_cast<unsigned char>((fin ? 0x80 : 0x00) | opcode);
+    if(len < 126)
+    {
+        header[1] = static_cast<unsigned char>(len);
+    }
+    else if(len <= 0xFFFF)
+    {
+        header[1] = 126;
+        header[2] = static_cast<unsigned char>(len >> 8);
+        header[3] = static_cast<unsigned char>(len);
+        headerLength = 4;
+    }
+    else
+    {
+        header[1] = 127;
+        for(int i = 0; i < 8; i++)
+        {
+            header[9 - i] = static_cast<unsigned char>(static_cast<uint64_t>(len) >> (8 * i));
+        }
+        headerLength = 10;
+    }
+    output->append(reinterpret_cast<const char*>(header), headerLength);
+    output->append(payload, len);
+}
+
+WebSocketFrame::FramePtr WebSocketFrame::makeFrame(Opcode opcode, std::string_view payload)
+{
+    Buffer buf(payload.size() + 10);
+    appendFrame(&buf, opcode, payload.data(), payload.size());
+    return std::make_shared<const std::string>(buf.retrieveAllAsString());
+}
@@ -0,0 +1,460 @@
+#include "WebSocketServer.h"
+#include "HttpContext.h"
+#include "HttpRequest.h"
+#include "Logger.h"
+
+#include <strings.h>
+#include <string.h>
+
+namespace
+{
+
+const char* const kWebSocketGuid = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+// 每个连接的状态，保存在TcpConnection的context里
+struct WebSocketContext
+{
+    std::shared_ptr<HttpContext> handshake;     //握手完成之后释放
+    std::shared_ptr<void> loopState;            //所在loop的LoopState，断开时从里面删除
+    std::string fragments;                      //分片消息拼接到这里
+    bool fragmentBinary = false;
+    bool inFragments = false;
+    bool closing = false;
+    Timestamp lastActive;
+    bool pingSent = false;
+};
+
+// 握手只需要对一个很短的字符串做一次sha1，这里直接实现，不依赖额外的库
+void sha1(const std::string& input, unsigned char digest[20])
+{
+    uint32_t h[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+    std::string msg = input;
+    uint64_t bitLength = static_cast<uint64_t>(input.size()) * 8;
+    msg.push_back(static_cast<char>(0x80));
+    while(msg.size() % 64 != 56)
+    {
+        msg.push_back('\0');
+    }
+    for(int i = 7; i >= 0; i--)
+    {
+        msg.push_back(static_cast<char>(bitLength >> (8 * i)));
+    }
+
+    auto rotl = [](uint32_t x, int n) { return (x << n) | (x >> (32 - n)); };
+    for(size_t chunk = 0; chunk < msg.size(); chunk += 64)
+    {
+        uint32_t w[80];
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(msg.data() + chunk);
+        for(int i = 0; i < 16; i++)
+        {
+            w[i] = (static_cast<uint32_t>(p[4 * i]) << 24) | (static_cast<uint32_t>(p[4 * i + 1]) << 16)
+                | (static_cast<uint32_t>(p[4 * i + 2]) << 8) | p[4 * i + 3];
+        }
+        for(int i = 16; i < 80; i++)
+        {
+            w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        }
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for(int i = 0; i < 80; i++)
+        {
+            uint32_t f, k;
+            if(i < 20) { f = (b & c) | (~b & d); k = 0x5A827999; }
+            else if(i < 40) { f = b ^ c ^ d; k = 0x6ED9EBA1; }
+            else if(i < 60) { f = (b & c) | (b & d) | (c & d); k = 0x8F1BBCDC; }
+            else { f = b ^ c ^ d; k = 0xCA62C1D6; }
+            uint32_t temp = rotl(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = rotl(b, 30);
+            b = a;
+            a = temp;
+        }
+        h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+    }
+    for(int i = 0; i < 5; i++)
+    {
+        digest[4 * i] = static_cast<unsigned char>(h[i] >> 24);
+        digest[4 * i + 1] = static_cast<unsigned char>(h[i] >> 16);
+        digest[4 * i + 2] = static_cast<unsigned char>(h[i] >> 8);
+        digest[4 * i + 3] = static_cast<unsigned char>(h[i]);
+    }
+}
+
+std::string base64Encode(const unsigned char* data, size_t len)
+{
+    static const char kTable[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    out.reserve((len + 2) / 3 * 4);
+    size_t i = 0;
+    for(; i + 3 <= len; i += 3)
+    {
+        uint32_t n = (data[i] << 16) | (data[i + 1] << 8) | data[i + 2];
+        out.push_back(kTable[(n >> 18) & 0x3F]);
+        out.push_back(kTable[(n >> 12) & 0x3F]);
+        out.push_back(kTable[(n >> 6) & 0x3F]);
+        out.push_back(kTable[n & 0x3F]);
+    }
+    if(i < len)
+    {
+        uint32_t n = data[i] << 16;
+        if(i + 1 < len)
+        {
+            n |= data[i + 1] << 8;
+        }
+        out.push_back(kTable[(n >> 18) & 0x3F]);
+        out.push_back(kTable[(n >> 12) & 0x3F]);
+        out.push_back(i + 1 < len ? kTable[(n >> 6) & 0x3F] : '=');
+        out.push_back('=');
+    }
+    return out;
+}
+
+// header的值是逗号分隔的列表时（比如Connection: keep-alive, Upgrade），判断里面有没有token
+bool headerContainsToken(std::string_view value, std::string_view token)
+{
+    while(!value.empty())
+    {
+        size_t comma = value.find(',');
+        std::string_view item = value.substr(0, comma);
+        while(!item.empty() && (item.front() == ' ' || item.front() == '\t')) item.remove_prefix(1);
+        while(!item.empty() && (item.back() == ' ' || item.back() == '\t')) item.remove_suffix(1);
+        if(item.size() == token.size() && ::strncasecmp(item.data(), token.data(), token.size()) == 0)
+        {
+            return true;
+        }
+        if(comma == std::string_view::npos)
+        {
+            break;
+        }
+        value.remove_prefix(comma + 1);
+    }
+    return false;
+}
+
+void appendBadRequest(Buffer* output)
+{
+    output->append("HTTP/1.1 400 Bad Request\r\nConnection: close\r\nContent-Length: 0\r\n\r\n");
+}
+
+void appendCloseFrame(Buffer* output, uint16_t code)
+{
+    char payload[2] = { static_cast<char>(code >> 8), static_cast<char>(code & 0xFF) };
+    WebSocketFrame::appendFrame(output, WebSocketFrame::kClose, payload, sizeof payload);
+}
+
+}
+
+WebSocketServer::WebSocketServer(EventLoop* loop,
+                                const InetAddress& listenAddr,
+                                const std::string& name,
+                                TcpServer::Option option)
+    :loop_(loop),
+    pingIntervalSeconds_(30.0),
+    maxMessageSize_(16 * 1024 * 1024),
+    server_(loop, listenAddr, name, option)
+{
+    server_.setConnectionCallback(std::bind(&WebSocketServer::onConnection, this, std::placeholders::_1));
+    server_.setMessageCallback(std::bind(&WebSocketServer::onMessage, this,
+                                std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+    server_.setThreadInitCallback(std::bind(&WebSocketServer::onThreadInit, this, std::placeholders::_1));
+    server_.setLoopRetiredCallback(std::bind(&WebSocketServer::onLoopRetired, this, std::placeholders::_1));
+}
+
+void WebSocketServer::start()
+{
+    LOG_INFO("WebSocketServer[%s] starts listening \n", server_.name().c_str());
+    server_.start();
+}
+
+void WebSocketServer::onThreadInit(EventLoop* loop)
+{
+    LoopStatePtr state = std::make_shared<LoopState>();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        loopStates_[loop] = state;
+    }
+    if(pingIntervalSeconds_ > 0)
+    {
+        // 定时器只持有LoopState，不访问WebSocketServer。每半个周期检查一次，ping最多晚半个周期发出
+        double interval = pingIntervalSeconds_;
+        loop->runEvery(interval / 2, [state, interval]() { checkIdleConnections(state, interval); });
+    }
+    if(threadInitCallback_)
+    {
+        threadInitCallback_(loop);
+    }
+}
+
+void WebSocketServer::onLoopRetired(EventLoop* loop)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        loopStates_.erase(loop);
+    }
+    if(loopRetiredCallback_)
+    {
+        loopRetiredCallback_(loop);
+    }
+}
+
+void WebSocketServer::onConnection(const TcpConnectionPtr& conn)
+{
+    if(conn->connected())
+    {
+        // loopState和空闲检查都在当前loop上，连接不能被TcpServer迁移走
+        conn->setMigratable(false);
+        WebSocketContext context;
+        context.handshake = std::make_shared<HttpContext>();
+        context.lastActive = Timestamp::now();
+        conn->setContext(std::move(context));
+    }
+    else
+    {
+        WebSocketContext* context = std::any_cast<WebSocketContext>(conn->getMutableContext());
+        if(context && !context->handshake)   //握手完成过才通知用户
+        {
+            std::static_pointer_cast<LoopState>(context->loopState)->connections.erase(conn.get());
+            if(connectionCallback_)
+            {
+                connectionCallback_(conn);
+            }
+        }
+    }
+}
+
+void WebSocketServer::onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp receiveTime)
+{
+    WebSocketContext* context = std::any_cast<WebSocketContext>(conn->getMutableContext());
+    context->lastActive = receiveTime;
+    context->pingSent = false;
+    if(context->handshake && !handleHandshake(conn, buf, receiveTime))
+    {
+        return;
+    }
+    if(!context->handshake)
+    {
+        handleFrames(conn, buf, receiveTime);
+    }
+}
+
+bool WebSocketServer::handleHandshake(const TcpConnectionPtr& conn, Buffer* buf, Timestamp receiveTime)
+{
+    WebSocketContext* context = std::any_cast<WebSocketContext>(conn->getMutableContext());
+    HttpContext::ParseResult result = context->handshake->parse(buf, receiveTime);
+    if(result == HttpContext::kNeedMore)
+    {
+        return false;
+    }
+
+    Buffer output;
+    std::string_view key;
+    bool ok = false;
+    if(result == HttpContext::kGotRequest)
+    {
+        const HttpRequest& req = context->handshake->request();
+        key = req.getHeader("Sec-WebSocket-Key");
+        std::string_view version = req.getHeader("Sec-WebSocket-Version");
+        ok = req.method() == HttpRequest::kGet
+            && headerContainsToken(req.getHeader("Upgrade"), "websocket")
+            && headerContainsToken(req.getHeader("Connection"), "upgrade")
+            && !key.empty()
+            && version == "13";
+    }
+    if(!ok)
+    {
+        appendBadRequest(&output);
+        conn->send(&output);
+        buf->retrieveAll();
+        conn->shutdown();
+        return false;
+    }
+
+    unsigned char digest[20];
+    sha1(std::string(key) + kWebSocketGuid, digest);
+    // 101响应不能带Content-Length，这里不用HttpResponse
+    output.append("HTTP/1.1 101 Switching Protocols\r\n"
+                    "Upgrade: websocket\r\n"
+                    "Connection: Upgrade\r\n"
+                    "Sec-WebSocket-Accept: ");
+    output.append(base64Encode(digest, sizeof digest));
+    output.append("\r\n\r\n");
+    conn->send(&output);
+
+    // 握手请求之后可能紧跟着客户端的第一个帧，留在buf里
+    context->handshake->finishRequest(buf);
+    context->handshake.reset();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        LoopStatePtr state = loopStates_[conn->getLoop()];
+        state->connections[conn.get()] = conn;
+        context->loopState = state;
+    }
+    if(connectionCallback_)
+    {
+        connectionCallback_(conn);
+    }
+    return true;
+}
+
+void WebSocketServer::handleFrames(const TcpConnectionPtr& conn, Buffer* buf, Timestamp receiveTime)
+{
+    WebSocketContext* context = std::any_cast<WebSocketContext>(conn->getMutableContext());
+    // pong、close等控制帧攒在一起，处理完这一批数据之后只send一次
+    Buffer* output = TcpConnection::replyBuffer();
+    bool close = context->closing;
+
+    while(!close)
+    {
+        WebSocketFrame::Header header;
+        WebSocketFrame::ParseResult result = WebSocketFrame::parse(buf, maxMessageSize_, &header);
+        if(result == WebSocketFrame::kNeedMore)
+        {
+            break;
+        }
+        conn->countReadMessages(1);     //控制帧也算，ping也不能无限制地发
+        if(result != WebSocketFrame::kGotFrame)
+        {
+            appendCloseFrame(output, result == WebSocketFrame::kTooLarge ? 1009 : 1002);
+            close = true;
+            break;
+        }
+
+        const char* payload = buf->peek() + header.headerLength;
+        size_t length = header.payloadLength;
+        switch(header.opcode)
+        {
+        case WebSocketFrame::kText:
+        case WebSocketFrame::kBinary:
+            if(context->inFragments)
+            {
+                appendCloseFrame(output, 1002);
+                close = true;
+            }
+            else if(header.fin)
+            {
+                // 不分片的消息直接指向输入缓冲区，不拷贝
+                if(messageCallback_)
+                {
+                    messageCallback_(conn, std::string_view(payload, length), header.opcode == WebSocketFrame::kBinary, receiveTime);
+                }
+            }
+            else
+            {
+                context->inFragments = true;
+                context->fragmentBinary = header.opcode == WebSocketFrame::kBinary;
+                context->fragments.assign(payload, length);
+            }
+            break;
+        case WebSocketFrame::kContinuation:
+            if(!context->inFragments || context->fragments.size() + length > maxMessageSize_)
+            {
+                appendCloseFrame(output, context->inFragments ? 1009 : 1002);
+                close = true;
+                break;
+            }
+            context->fragments.append(payload, length);
+            if(header.fin)
+            {
+                if(messageCallback_)
+                {
+                    messageCallback_(conn, context->fragments, context->fragmentBinary, receiveTime);
+                }
+                context->inFragments = false;
+                context->fragments.clear();
+                context->fragments.shrink_to_fit();
+            }
+            break;
+        case WebSocketFrame::kPing:
+            WebSocketFrame::appendFrame(output, WebSocketFrame::kPong, payload, length);
+            break;
+        case WebSocketFrame::kPong:
+            break;
+        case WebSocketFrame::kClose:
+            // 原样回复对方的状态码
+            WebSocketFrame::appendFrame(output, WebSocketFrame::kClose, payload, length >= 2 ? 2 : 0);
+            close = true;
+            break;
+        default:
+            appendCloseFrame(output, 1002);
+            close = true;
+            break;
+        }
+        buf->retrieve(header.headerLength + header.payloadLength);
+    }
+
+    if(output->readableBytes() > 0)
+    {
+        conn->send(output);
+    }
+    if(close)
+    {
+        context->closing = true;
+        buf->retrieveAll();
+        conn->shutdown();
+    }
+}
+
+void WebSocketServer::checkIdleConnections(const LoopStatePtr& state, double pingIntervalSeconds)
+{
+    static const WebSocketFrame::FramePtr kPingFrame = WebSocketFrame::makeFrame(WebSocketFrame::kPing, std::string_view());
+    Timestamp now = Timestamp::now();
+    for(auto it = state->connections.begin(); it != state->connections.end(); )
+    {
+        TcpConnectionPtr conn = it->second.lock();
+        ++it;
+        if(!conn || !conn->connected())
+        {
+            continue;
+        }
+        WebSocketContext* context = std::any_cast<WebSocketContext>(conn->getMutableContext());
+        double idle = timeDifference(now, context->lastActive);
+        if(context->pingSent && idle >= 2 * pingIntervalSeconds)
+        {
+            LOG_INFO("WebSocketServer - connection [%s] ping timeout \n", conn->name().c_str());
+            conn->forceClose();
+        }
+        else if(!context->pingSent && idle >= pingIntervalSeconds)
+        {
+            context->pingSent = true;
+            conn->send(*kPingFrame);
+        }
+    }
+}
+
+void WebSocketServer::send(const TcpConnectionPtr& conn, std::string_view message, bool binary)
+{
+    Buffer output(message.size() + 10);
+    WebSocketFrame::appendFrame(&output, binary ? WebSocketFrame::kBinary : WebSocketFrame::kText, message.data(), message.size());
+    conn->send(&output);
+}
+
+void WebSocketServer::sendFrame(const TcpConnectionPtr& conn, const WebSocketFrame::FramePtr& frame)
+{
+    // 在loop线程里send(const std::string&)直接写socket或者追加到outputBuffer，不拷贝frame
+    conn->getLoop()->runInLoop([conn, frame]() {
+        if(conn->connected())
+        {
+            conn->send(*frame);
+        }
+    });
+}
+
+void WebSocketServer::close(const TcpConnectionPtr& conn, uint16_t code)
+{
+    // 在loop线程中标记closing，对方回复的close帧不再回显，之后收到的数据也直接丢弃
+    conn->getLoop()->runInLoop([conn, code]() {
+        WebSocketContext* context = std::any_cast<WebSocketContext>(conn->getMutableContext());
+        if(context != nullptr)
+        {
+            if(context->closing)
+            {
+                return;
+            }
+            context->closing = true;
+        }
+        Buffer output;
+        appendCloseFrame(&output, code);
+        conn->send(&output);
+        conn->shutdown();
+    });
+}
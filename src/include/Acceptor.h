@@ -2,6 +2,7 @@
 #include "noncopyable.h"
 #include "Socket.h"
 #include "Channel.h"
+#include "Timestamp.h"
 #include <functional>
 
 class EventLoop;
@@ -13,6 +14,8 @@ class Acceptor : noncopyable
 public:
     using NewConnectionCallback = std::function<void(int, const InetAddress&)>;
     Acceptor(EventLoop* loop, const InetAddress& listenAddr, bool reuseport);
+    // 接管已经bind好的listen fd（比如从旧进程继承来的），不再bind
+    Acceptor(EventLoop* loop, int listenfd);
     ~Acceptor();
     void setNewConnectionCallback(const NewConnectionCallback& cb)
     {
@@ -21,7 +24,18 @@ public:
 
     bool listenning() const { return listenning_; }
 
+    // 在listen之前设置，listen时应用到listen socket上
+    void setSocketOptions(const SocketOptions& options) { options_ = options; }
+
     void listen();
+    // 停止接受新连接并关闭listen socket，已经建立的连接不受影响
+    void stopListen();
+    // 过载时暂停/恢复accept，暂停期间新连接留在内核的全连接队列里
+    void pauseAccepting();
+    void resumeAccepting();
+    bool paused() const { return paused_; }
+
+    int fd() const { return acceptSocket_.fd(); }
 private:
     void handleRead();
 
@@ -29,5 +43,10 @@ private:
     Socket acceptSocket_;
     Channel acceptChannel_;
     NewConnectionCallback newConnectionCallback_;
+    SocketOptions options_;
     bool listenning_;
+    bool paused_;
+    int idleFd_;    //预留的fd，进程fd用完(EMFILE)时腾出来accept新连接然后立即关闭
+    Timestamp lastErrorLog_;    //accept出错的日志限流，最多每秒一条
+    int suppressedErrors_;
 };
\ No newline at end of file
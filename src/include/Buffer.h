@@ -3,6 +3,7 @@
 #include <vector>
 #include <string>
 #include <algorithm>
+#include <string.h>
 
 
 /// A buffer class modeled after org.jboss.netty.buffer.ChannelBuffer
@@ -51,6 +52,37 @@ public:
         return begin() + readerIndex_;
     }
 
+    // 可读数据的可写指针，给需要原地修改数据的解码器用（比如websocket的unmask）
+    char* beginRead()
+    {
+        return begin() + readerIndex_;
+    }
+
+    // 在可读数据中查找\r\n，没找到返回nullptr
+    const char* findCRLF() const
+    {
+        return findCRLF(peek());
+    }
+
+    const char* findCRLF(const char* start) const
+    {
+        const char* end = beginWrite();
+        while(start < end)
+        {
+            const char* cr = static_cast<const char*>(memchr(start, '\r', end - start));
+            if(cr == nullptr || cr + 1 >= end)
+            {
+                return nullptr;
+            }
+            if(cr[1] == '\n')
+            {
+                return cr;
+            }
+            start = cr + 1;
+        }
+        return nullptr;
+    }
+
     // onMessage string <- Buffer
     void retrieve(size_t len)
     {
@@ -99,11 +131,22 @@ public:
         writerIndex_+=len;
     }
     
+    void append(const std::string& str)
+    {
+        append(str.data(), str.size());
+    }
+
     char* beginWrite()
     {
         return begin()+writerIndex_;
     }
 
+    // 直接往beginWrite()写了len字节之后调用，比如SSL_read解出的明文
+    void hasWritten(size_t len)
+    {
+        writerIndex_ += len;
+    }
+
     const char* beginWrite() const 
     {
         return begin()+writerIndex_;
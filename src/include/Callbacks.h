@@ -13,4 +13,15 @@ using WriteCompleteCallback = std::function<void(const TcpConnectionPtr&)>;
 
 using MessageCallback = std::function<void(const TcpConnectionPtr&,Buffer*,Timestamp)>;
 
-using HighWaterMarkCallback = std::function<void(const TcpConnectionPtr&, size_t)>;
\ No newline at end of file
+using HighWaterMarkCallback = std::function<void(const TcpConnectionPtr&, size_t)>;
+
+using TimerCallback = std::function<void()>;
+using DrainCompleteCallback = std::function<void()>;
+// 广播时选择接收的连接，返回true的连接才发送
+using BroadcastFilter = std::function<bool(const TcpConnectionPtr&)>;
+// 连接迁移结束，在连接所在的loop中调用，migrated为false表示没有迁移（连接已经断开或者已经在目标loop上）
+using MigrateCallback = std::function<void(const TcpConnectionPtr&, bool migrated)>;
+
+// 用户没有设置回调时使用的默认回调
+void defaultConnectionCallback(const TcpConnectionPtr& conn);
+void defaultMessageCallback(const TcpConnectionPtr& conn, Buffer* buffer, Timestamp receiveTime);
\ No newline at end of file
@@ -41,7 +41,7 @@ public:
 
     int fd() const { return fd_; }
     int events() const { return events_; }
-    int set_revents(int revt) { revents_ = revt; } //给poller用，poller监听到事件之后通过接口修改revent
+    void set_revents(int revt) { revents_ = revt; } //给poller用，poller监听到事件之后通过接口修改revent
 
     //设置fd相应的事件状态
     void enableReading() { events_ |= kReadEvent; update(); }
@@ -52,8 +52,8 @@ public:
 
     //返回fd当前事件状态
     bool isNoneEvent() const { return events_ == kNoneEvent; }
-    bool isWritting() const { return events_ == kWriteEvent; }
-    bool isReading() const { return events_ == kReadEvent; }
+    bool isWritting() const { return events_ & kWriteEvent; }  //读写事件可能同时注册，只能按位判断
+    bool isReading() const { return events_ & kReadEvent; }
 
     int index() { return index_; }
     void set_index(int idx) { index_ = idx; }
@@ -62,6 +62,11 @@ public:
     EventLoop* ownerLoop() { return loop_; }
     void remove();
 
+    // 把channel交给另一个loop：在旧loop线程中detach，从poller上删除但保留关注的事件，
+    // 然后在新loop线程中attach，重新注册到新loop的poller上
+    void detach(EventLoop* newLoop);
+    void attach();
+
 private:
 
     void update();
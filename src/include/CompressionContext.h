@@ -0,0 +1,83 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <stdint.h>
+
+// zlib的类型只做前向声明，没有zlib时库也能编译（create返回nullptr）
+struct z_stream_s;
+
+class EventLoop;
+class CompressionContext;
+using CompressionContextPtr = std::shared_ptr<CompressionContext>;
+
+// 一条连接上压缩层的统计，只在loop线程中访问
+struct CompressionStats
+{
+    uint64_t plainBytesSent = 0;        //上层send的字节数
+    uint64_t compressedBytesSent = 0;   //压缩之后的字节数
+    uint64_t compressedBytesReceived = 0;
+    uint64_t plainBytesReceived = 0;
+};
+
+// 压缩层的参数
+struct CompressionOptions
+{
+    int level = 6;                      //默认的压缩级别0-9，连接上实际使用双方里较小的那个
+    int windowBits = 15;                //窗口大小2^windowBits，9-15，越小占内存越少压缩率越低
+    int memLevel = 8;                   //1-9，deflate哈希表的大小
+    std::string dictionary;             //预置字典，双方字典相同时才使用，对很小的消息效果明显
+    size_t maxPooledStreams = 64;       //每个loop最多缓存多少个deflate/inflate
+    size_t maxInputBufferBytes = 64 * 1024 * 1024;  //解压后的数据上层一直不取走时的上限，防止压缩炸弹
+};
+
+// 连接上的流式压缩（deflate）配置，一个TcpServer/TcpClient持有一个，见TcpConnection::startCompression
+// deflate的窗口和哈希表加起来有几百K，每条连接都新建一份代价很大，这里按EventLoop缓存用完的z_stream，
+// 连接断开时reset之后放回所在loop的池子，新连接直接拿来用
+class CompressionContext : noncopyable
+{
+public:
+    // 没有zlib或者参数不对时返回nullptr
+    static CompressionContextPtr create(const CompressionOptions& options = CompressionOptions());
+    ~CompressionContext();
+
+    const CompressionOptions& options() const { return options_; }
+    // 字典的adler32，没有字典时为0，握手时告诉对端
+    uint32_t dictionaryId() const { return dictionaryId_; }
+
+    // 在loop线程中调用，从loop的池子里取一个reset好的z_stream（deflate已经设置好字典），池子空了就新建，失败返回nullptr
+    z_stream_s* acquireDeflater(EventLoop* loop, int level, bool useDictionary);
+    z_stream_s* acquireInflater(EventLoop* loop);
+    // 在loop线程中调用，放回loop的池子，池子满了直接释放
+    void releaseDeflater(EventLoop* loop, z_stream_s* stream);
+    void releaseInflater(EventLoop* loop, z_stream_s* stream);
+    // 不在loop线程时（比如连接在别的线程析构）直接释放
+    static void destroyDeflater(z_stream_s* stream);
+    static void destroyInflater(z_stream_s* stream);
+
+    // 某个loop的池子里现在缓存了多少个z_stream
+    size_t pooledStreams(EventLoop* loop);
+    // loop已经没有连接、要销毁了，释放它的池子（TcpServer退休loop时自动调用）
+    void removeLoop(EventLoop* loop);
+
+private:
+    struct StreamPool
+    {
+        std::vector<z_stream_s*> deflaters;
+        std::vector<z_stream_s*> inflaters;
+    };
+
+    explicit CompressionContext(const CompressionOptions& options);
+    // 取loop对应的池子，不存在就创建，池子本身只被对应的loop线程访问
+    StreamPool* poolOf(EventLoop* loop);
+
+    const CompressionOptions options_;
+    uint32_t dictionaryId_;
+    std::mutex mutex_;  //只保护pools_这个map
+    std::unordered_map<EventLoop*, std::unique_ptr<StreamPool>> pools_;
+};
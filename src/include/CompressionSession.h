@@ -0,0 +1,65 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "CompressionContext.h"
+#include "Buffer.h"
+
+class EventLoop;
+
+// 一条连接上的压缩状态，由TcpConnection持有，只在loop线程中访问
+// 双方开始时各发一个8字节的握手：'M' 'Z' 版本 压缩级别 字典id(4字节大端)
+// 收到对端的握手之后协商：压缩级别取双方较小的，字典id相同（且不为0）时才使用字典，在这之前上层要发送的数据先暂存
+// 之后两个方向各是一条连续的zlib流，每次send做一次Z_SYNC_FLUSH，对端收到就能完整解出来
+class CompressionSession : noncopyable
+{
+public:
+    enum Result
+    {
+        kOk,
+        kNegotiated,    //这次输入里收到了对端的握手，暂存的数据可以发送了
+        kError,         //握手不对或者数据损坏，连接应该关闭
+    };
+
+    // level小于0时使用ctx的默认级别
+    CompressionSession(const CompressionContextPtr& ctx, EventLoop* loop, int level);
+    ~CompressionSession();
+
+    // 本端的握手追加到out，只追加一次
+    void appendPreamble(Buffer* out);
+    bool preambleSent() const { return preambleSent_; }
+
+    // 处理input()中所有的压缩数据，解压后追加到plaintext
+    Result handleInput(Buffer* plaintext);
+    // 压缩len字节追加到out，只能在ready之后调用，release之后返回false
+    bool compress(const void* data, size_t len, Buffer* out);
+
+    // 收到了对端的握手
+    bool ready() const { return ready_; }
+    Buffer* input() { return &input_; }
+    // 协商完成之前上层要发送的明文
+    Buffer* pendingWrites() { return &pendingWrites_; }
+
+    // 连接断开时在loop线程调用，把z_stream放回loop的池子
+    void release();
+    // 连接迁移到另一个loop，之后从新loop的池子里取、放回新loop的池子
+    void setLoop(EventLoop* loop) { loop_ = loop; }
+
+    int level() const { return level_; }
+    bool dictionaryUsed() const { return useDictionary_; }
+    const CompressionStats& stats() const { return stats_; }
+
+private:
+    bool inflateInto(Buffer* plaintext);
+
+    CompressionContextPtr ctx_;
+    EventLoop* loop_;
+    int level_;             //协商之前是本端要求的级别，之后是实际使用的级别
+    bool useDictionary_;
+    bool preambleSent_;
+    bool ready_;
+    z_stream_s* deflater_;  //协商完成时取
+    z_stream_s* inflater_;
+    Buffer input_;
+    Buffer pendingWrites_;
+    CompressionStats stats_;
+};
@@ -0,0 +1,65 @@
+#pragma once
+#include "noncopyable.h"
+#include "InetAddress.h"
+#include "TimerId.h"
+
+#include <functional>
+#include <memory>
+#include <atomic>
+
+class Channel;
+class EventLoop;
+
+// 主动发起连接，和Acceptor对应
+// 非阻塞connect返回EINPROGRESS之后，把sockfd打包成Channel关注EPOLLOUT，可写时说明连接已经有结果了
+// 连接失败时按指数退避重连，连接成功后把sockfd交给newConnectionCallback_（TcpClient打包成TcpConnection）
+class Connector : noncopyable, public std::enable_shared_from_this<Connector>
+{
+public:
+    using NewConnectionCallback = std::function<void(int sockfd)>;
+
+    Connector(EventLoop* loop, const InetAddress& serverAddr);
+    ~Connector();
+
+    void setNewConnectionCallback(const NewConnectionCallback& cb)
+    { newConnectionCallback_ = cb; }
+
+    // 重连的退避时间，单位毫秒
+    void setRetryDelay(int initDelayMs, int maxDelayMs)
+    { initRetryDelayMs_ = initDelayMs; maxRetryDelayMs_ = maxDelayMs; retryDelayMs_ = initDelayMs; }
+
+    const InetAddress& serverAddress() const { return serverAddr_; }
+
+    void start();   //可以在任意线程调用
+    void restart(); //只能在loop线程调用
+    void stop();    //可以在任意线程调用
+
+private:
+    enum States { kDisconnected, kConnecting, kConnected };
+    static const int kInitRetryDelayMs = 500;
+    static const int kMaxRetryDelayMs = 30 * 1000;
+
+    void setState(States s) { state_ = s; }
+    void startInLoop();
+    void stopInLoop();
+    void connect();
+    void connecting(int sockfd);
+    void handleWrite();
+    void handleError();
+    void retry(int sockfd);
+    int removeAndResetChannel();
+    void resetChannel();
+
+    EventLoop* loop_;
+    InetAddress serverAddr_;
+    std::atomic_bool connect_;      //用户是否希望连接，stop之后不再重连
+    std::atomic_int state_;
+    std::unique_ptr<Channel> channel_;  //只在connecting期间存在，连接建立后sockfd交给TcpConnection
+    NewConnectionCallback newConnectionCallback_;
+    int initRetryDelayMs_;
+    int maxRetryDelayMs_;
+    int retryDelayMs_;
+    TimerId retryTimer_;
+};
+
+using ConnectorPtr = std::shared_ptr<Connector>;
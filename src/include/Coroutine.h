@@ -0,0 +1,617 @@
+#pragma once
+
+// C++20协程接口，只有头文件，库本身仍然按C++17编译，用到协程的代码用-std=c++20编译
+#if __cplusplus < 202002L || !__has_include(<coroutine>)
+#error "Coroutine.h requires C++20 coroutines (-std=c++20)"
+#endif
+
+#include "noncopyable.h"
+#include "TcpConnection.h"
+#include "EventLoop.h"
+#include "Buffer.h"
+#include "Logger.h"
+
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <utility>
+
+/**
+ * 协程帧的分配器，按64字节分档的空闲链表，thread_local的，也就是每个EventLoop线程一个池子
+ * 连接上的协程总是在所在loop线程里创建和销毁，帧的内存在这个线程里反复复用，不走全局的malloc
+ */
+class CoroutineFramePool
+{
+public:
+    static void* allocate(size_t size)
+    {
+        size_t index = (size + kAlign - 1) / kAlign;
+        if(index >= kClasses)
+        {
+            return ::operator new(size);
+        }
+        FreeLists& lists = freeLists();
+        Node* node = lists.heads[index];
+        if(node)
+        {
+            lists.heads[index] = node->next;
+            --lists.counts[index];
+            return node;
+        }
+        return ::operator new(index * kAlign);
+    }
+
+    static void deallocate(void* p, size_t size)
+    {
+        size_t index = (size + kAlign - 1) / kAlign;
+        FreeLists& lists = freeLists();
+        if(index >= kClasses || lists.counts[index] >= kMaxCached)
+        {
+            ::operator delete(p);
+            return;
+        }
+        Node* node = static_cast<Node*>(p);
+        node->next = lists.heads[index];
+        lists.heads[index] = node;
+        ++lists.counts[index];
+    }
+
+private:
+    static constexpr size_t kAlign = 64;
+    static constexpr size_t kClasses = 64;      //4K以上的帧直接走operator new
+    static constexpr size_t kMaxCached = 1024;  //每一档最多缓存多少个
+
+    struct Node
+    {
+        Node* next;
+    };
+
+    struct FreeLists
+    {
+        Node* heads[kClasses] = {};
+        size_t counts[kClasses] = {};
+
+        ~FreeLists()
+        {
+            for(Node* head : heads)
+            {
+                while(head)
+                {
+                    Node* next = head->next;
+                    ::operator delete(head);
+                    head = next;
+                }
+            }
+        }
+    };
+
+    static FreeLists& freeLists()
+    {
+        static thread_local FreeLists lists;
+        return lists;
+    }
+};
+
+template<typename T = void>
+class Task;
+
+namespace detail
+{
+
+struct TaskPromiseBase
+{
+    std::coroutine_handle<> continuation;   //co_await这个Task的协程，结束时直接切换过去
+    std::exception_ptr exception;
+    bool detached = false;                  //start之后自己管理生命周期，结束时销毁自己
+
+    static void* operator new(size_t size) { return CoroutineFramePool::allocate(size); }
+    static void operator delete(void* p, size_t size) { CoroutineFramePool::deallocate(p, size); }
+
+    // 惰性启动，co_await或者start的时候才开始执行
+    std::suspend_always initial_suspend() noexcept { return {}; }
+
+    struct FinalAwaiter
+    {
+        bool await_ready() noexcept { return false; }
+
+        template<typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+        {
+            TaskPromiseBase& promise = handle.promise();
+            if(promise.continuation)
+            {
+                return promise.continuation;    //对称转移，不会加深调用栈
+            }
+            if(promise.detached)
+            {
+                if(promise.exception)
+                {
+                    try
+                    {
+                        std::rethrow_exception(promise.exception);
+                    }
+                    catch(const std::exception& e)
+                    {
+                        LOG_ERROR("coroutine exited with exception: %s \n", e.what());
+                    }
+                    catch(...)
+                    {
+                        LOG_ERROR("coroutine exited with unknown exception \n");
+                    }
+                }
+                handle.destroy();
+            }
+            return std::noop_coroutine();
+        }
+
+        void await_resume() noexcept {}
+    };
+
+    FinalAwaiter final_suspend() noexcept { return {}; }
+    void unhandled_exception() { exception = std::current_exception(); }
+};
+
+template<typename T>
+struct TaskPromise : TaskPromiseBase
+{
+    std::optional<T> value;
+
+    Task<T> get_return_object() noexcept;
+    template<typename U>
+    void return_value(U&& v) { value.emplace(std::forward<U>(v)); }
+
+    T result()
+    {
+        if(exception)
+        {
+            std::rethrow_exception(exception);
+        }
+        return std::move(*value);
+    }
+};
+
+template<>
+struct TaskPromise<void> : TaskPromiseBase
+{
+    Task<void> get_return_object() noexcept;
+    void return_void() noexcept {}
+
+    void result()
+    {
+        if(exception)
+        {
+            std::rethrow_exception(exception);
+        }
+    }
+};
+
+}
+
+/**
+ * 协程的返回类型，惰性执行：
+ *   在另一个协程里 co_await task 执行它并拿到结果，结束时直接切回等待者
+ *   最外层的协程调用 start() 开始执行，之后生命周期由协程自己管理，结束时自动释放
+ * 所有的恢复都发生在loop线程里，不需要加锁
+ */
+template<typename T>
+class Task
+{
+public:
+    using promise_type = detail::TaskPromise<T>;
+    using Handle = std::coroutine_handle<promise_type>;
+
+    Task() noexcept : handle_(nullptr) {}
+    explicit Task(Handle handle) noexcept : handle_(handle) {}
+    Task(Task&& other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {}
+    Task& operator=(Task&& other) noexcept
+    {
+        if(this != &other)
+        {
+            reset();
+            handle_ = std::exchange(other.handle_, nullptr);
+        }
+        return *this;
+    }
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+    ~Task() { reset(); }
+
+    bool valid() const { return static_cast<bool>(handle_); }
+
+    // 开始执行并放手，执行到第一个挂起点返回
+    void start()
+    {
+        Handle handle = std::exchange(handle_, nullptr);
+        handle.promise().detached = true;
+        handle.resume();
+    }
+
+    auto operator co_await() && noexcept
+    {
+        struct Awaiter
+        {
+            Handle handle;
+            bool await_ready() noexcept { return !handle || handle.done(); }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+            {
+                handle.promise().continuation = awaiting;
+                return handle;
+            }
+            T await_resume() { return handle.promise().result(); }
+        };
+        return Awaiter{ handle_ };
+    }
+
+private:
+    void reset()
+    {
+        if(handle_)
+        {
+            handle_.destroy();
+            handle_ = nullptr;
+        }
+    }
+
+    Handle handle_;
+};
+
+namespace detail
+{
+
+template<typename T>
+inline Task<T> TaskPromise<T>::get_return_object() noexcept
+{
+    return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+}
+
+inline Task<void> TaskPromise<void>::get_return_object() noexcept
+{
+    return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+}
+
+}
+
+class CoConnection;
+using CoConnectionPtr = std::shared_ptr<CoConnection>;
+using CoHandler = std::function<Task<>(CoConnectionPtr)>;
+
+/**
+ * 用协程写连接的处理逻辑，代替MessageCallback里手写的状态机：
+ *
+ *   Task<> session(CoConnectionPtr c)
+ *   {
+ *       while(auto line = co_await c->readUntil("\r\n", 30.0))
+ *       {
+ *           co_await c->write(*line);
+ *       }
+ *   }
+ *   CoConnection::serve(&server, session);
+ *
+ * 读到的数据是指向连接输入缓冲区的string_view，不拷贝，在下一次读之前有效（下一次读的时候才从缓冲区里取走）
+ * 数据到达时TcpConnection::handleRead -> MessageCallback -> 直接resume等待的协程，不经过queueInLoop
+ * 读返回nullopt表示连接已经关闭（closed()为true）或者超时
+ * 所有的方法都只能在连接所在的loop线程（也就是协程里）调用
+ */
+class CoConnection : noncopyable, public std::enable_shared_from_this<CoConnection>
+{
+public:
+    explicit CoConnection(const TcpConnectionPtr& conn)
+        :conn_(conn),
+        input_(nullptr),
+        consumed_(0),
+        mode_(kNone),
+        want_(0),
+        scanned_(0),
+        maxBytes_(0),
+        closed_(false),
+        timedOut_(false),
+        writing_(false)
+    {
+        // 超时定时器注册在当前loop上，协程也在这个loop线程里恢复，连接不能被迁移走
+        conn_->setMigratable(false);
+    }
+
+    // 把server（TcpServer或者TcpClient）的连接回调和消息回调换成协程，每条新连接启动一个handler，
+    // handler返回之后shutdown连接。会覆盖之前设置的ConnectionCallback/MessageCallback/WriteCompleteCallback
+    template<typename Server>
+    static void serve(Server* server, CoHandler handler)
+    {
+        server->setConnectionCallback([handler](const TcpConnectionPtr& conn) {
+            if(conn->connected())
+            {
+                CoConnectionPtr c = std::make_shared<CoConnection>(conn);
+                conn->setContext(c);
+                conn->setWriteCompleteCallback([](const TcpConnectionPtr& conn) {
+                    CoConnectionPtr c = fromConnection(conn);
+                    if(c)
+                    {
+                        c->onWriteComplete();
+                    }
+                });
+                run(handler, c).start();
+            }
+            else
+            {
+                CoConnectionPtr c = fromConnection(conn);
+                if(c)
+                {
+                    conn->setContext(std::any());   //打破conn -> context -> CoConnection -> conn的循环引用
+                    c->onClose();
+                }
+            }
+        });
+        server->setMessageCallback([](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+            CoConnectionPtr c = fromConnection(conn);
+            if(c)
+            {
+                c->onMessage(buf);
+            }
+        });
+    }
+
+    const TcpConnectionPtr& connection() const { return conn_; }
+    EventLoop* getLoop() const { return conn_->getLoop(); }
+    bool closed() const { return closed_; }
+    bool timedOut() const { return timedOut_; }
+
+    // 读恰好n个字节，timeoutSeconds<=0表示不超时
+    auto readExactly(size_t n, double timeoutSeconds = 0)
+    {
+        return ReadAwaiter{ this, kExactly, n, std::string_view(), 0, timeoutSeconds };
+    }
+
+    // 读到delim为止（包括delim），超过maxBytes还没找到当作出错，返回nullopt
+    // delim必须在co_await结束之前一直有效（字符串字面量或者协程里的变量都可以）
+    auto readUntil(std::string_view delim, double timeoutSeconds = 0, size_t maxBytes = 1024 * 1024)
+    {
+        return ReadAwaiter{ this, kUntil, 0, delim, maxBytes, timeoutSeconds };
+    }
+
+    // 读当前缓冲区里所有的数据，没有数据时等下一次到达
+    auto readSome(double timeoutSeconds = 0)
+    {
+        return ReadAwaiter{ this, kSome, 0, std::string_view(), 0, timeoutSeconds };
+    }
+
+    // 发送data，写不完（输出缓冲区里还有数据）时挂起，直到全部交给内核，连接关闭时返回false
+    // data在调用时就已经拷贝或者写出，co_await期间不需要保持有效
+    auto write(std::string_view data)
+    {
+        return WriteAwaiter{ this, data };
+    }
+
+    auto sleep(double seconds)
+    {
+        return SleepAwaiter{ this, seconds };
+    }
+
+    void shutdown()
+    {
+        if(!closed_)
+        {
+            conn_->shutdown();
+        }
+    }
+
+private:
+    enum Mode { kNone, kExactly, kUntil, kSome };
+
+    struct ReadAwaiter
+    {
+        CoConnection* c;
+        Mode mode;
+        size_t n;
+        std::string_view delim;
+        size_t maxBytes;
+        double timeoutSeconds;
+
+        bool await_ready()
+        {
+            c->startRead(mode, n, delim, maxBytes);
+            return c->tryCompleteRead();
+        }
+        void await_suspend(std::coroutine_handle<> handle) { c->suspendRead(handle, timeoutSeconds); }
+        std::optional<std::string_view> await_resume() { return c->result_; }
+    };
+
+    struct WriteAwaiter
+    {
+        CoConnection* c;
+        std::string_view data;
+
+        bool await_ready()
+        {
+            if(c->closed_)
+            {
+                return true;
+            }
+            c->conn_->sendInLoop(data.data(), data.size());
+            return c->conn_->outputBytes() == 0;
+        }
+        void await_suspend(std::coroutine_handle<> handle)
+        {
+            c->writing_ = true;
+            c->writer_ = handle;
+        }
+        bool await_resume() { return !c->closed_; }
+    };
+
+    struct SleepAwaiter
+    {
+        CoConnection* c;
+        double seconds;
+
+        bool await_ready() { return seconds <= 0; }
+        void await_suspend(std::coroutine_handle<> handle)
+        {
+            // 协程挂起期间帧一直有效，持有CoConnection保证回调执行时它还在
+            CoConnectionPtr self = c->shared_from_this();
+            c->getLoop()->runAfter(seconds, [self, handle]() { handle.resume(); });
+        }
+        void await_resume() {}
+    };
+
+    static CoConnectionPtr fromConnection(const TcpConnectionPtr& conn)
+    {
+        const CoConnectionPtr* c = std::any_cast<CoConnectionPtr>(&conn->getContext());
+        return c ? *c : CoConnectionPtr();
+    }
+
+    static Task<> run(CoHandler handler, CoConnectionPtr c)
+    {
+        co_await handler(c);
+        c->shutdown();
+    }
+
+    void startRead(Mode mode, size_t n, std::string_view delim, size_t maxBytes)
+    {
+        // 上一次读到的数据到这里才取走，所以上一次返回的string_view一直有效到现在
+        if(consumed_ > 0)
+        {
+            input_->retrieve(consumed_);
+            consumed_ = 0;
+        }
+        mode_ = mode;
+        want_ = n;
+        delim_ = delim;
+        maxBytes_ = maxBytes;
+        scanned_ = 0;
+        timedOut_ = false;
+    }
+
+    // 缓冲区里的数据够了（或者连接已经关闭）就设置result_并返回true
+    bool tryCompleteRead()
+    {
+        if(input_ != nullptr)
+        {
+            std::string_view data(input_->peek(), input_->readableBytes());
+            size_t length = 0;
+            bool matched = false;
+            if(mode_ == kExactly && data.size() >= want_)
+            {
+                length = want_;
+                matched = true;
+            }
+            else if(mode_ == kSome && !data.empty())
+            {
+                length = data.size();
+                matched = true;
+            }
+            else if(mode_ == kUntil && !delim_.empty())
+            {
+                // 从上次找过的位置往后找，回退delim.size()-1防止delim被拆在两次到达的数据之间
+                size_t from = scanned_ >= delim_.size() ? scanned_ - delim_.size() + 1 : 0;
+                size_t pos = data.find(delim_, from);
+                if(pos != std::string_view::npos)
+                {
+                    length = pos + delim_.size();
+                    matched = true;
+                }
+                else if(data.size() > maxBytes_)
+                {
+                    LOG_ERROR("CoConnection::readUntil - no delimiter in %zu bytes \n", data.size());
+                    finishRead(std::nullopt);
+                    return true;
+                }
+                scanned_ = data.size();
+            }
+            if(matched)
+            {
+                consumed_ = length;
+                finishRead(data.substr(0, length));
+                return true;
+            }
+        }
+        if(closed_)
+        {
+            finishRead(std::nullopt);
+            return true;
+        }
+        return false;
+    }
+
+    void finishRead(std::optional<std::string_view> result)
+    {
+        result_ = result;
+        mode_ = kNone;
+    }
+
+    void suspendRead(std::coroutine_handle<> handle, double timeoutSeconds)
+    {
+        reader_ = handle;
+        if(timeoutSeconds > 0)
+        {
+            std::weak_ptr<CoConnection> weak(shared_from_this());
+            readTimer_ = getLoop()->runAfter(timeoutSeconds, [weak]() {
+                CoConnectionPtr c = weak.lock();
+                if(c && c->reader_)
+                {
+                    c->timedOut_ = true;
+                    c->finishRead(std::nullopt);
+                    c->resumeReader();
+                }
+            });
+        }
+    }
+
+    void resumeReader()
+    {
+        if(readTimer_.valid())
+        {
+            getLoop()->cancel(readTimer_);
+            readTimer_ = TimerId();
+        }
+        std::coroutine_handle<> handle = std::exchange(reader_, nullptr);
+        handle.resume();
+    }
+
+    void onMessage(Buffer* buf)
+    {
+        input_ = buf;
+        if(reader_ && tryCompleteRead())
+        {
+            resumeReader();     //直接在handleRead的调用栈里恢复协程
+        }
+    }
+
+    void onWriteComplete()
+    {
+        // 之前某次一下子写完的通知可能晚到，输出缓冲区真的空了才恢复
+        if(writing_ && (closed_ || conn_->outputBytes() == 0))
+        {
+            writing_ = false;
+            std::exchange(writer_, nullptr).resume();
+        }
+    }
+
+    void onClose()
+    {
+        closed_ = true;
+        // 先保活，恢复的协程可能跑完并释放最后一个引用
+        CoConnectionPtr self(shared_from_this());
+        if(reader_ && tryCompleteRead())
+        {
+            resumeReader();
+        }
+        onWriteComplete();
+    }
+
+    TcpConnectionPtr conn_;
+    Buffer* input_;             //连接的输入缓冲区，第一次收到数据时拿到
+    size_t consumed_;           //上一次读返回的字节数，下一次读的时候取走
+    Mode mode_;
+    size_t want_;
+    std::string_view delim_;
+    size_t scanned_;            //readUntil已经找过的字节数
+    size_t maxBytes_;
+    std::optional<std::string_view> result_;
+    std::coroutine_handle<> reader_;
+    std::coroutine_handle<> writer_;
+    TimerId readTimer_;
+    bool closed_;
+    bool timedOut_;
+    bool writing_;
+};
@@ -2,6 +2,9 @@
 #include "noncopyable.h"
 #include "Timestamp.h"
 #include "CurrentThread.h"
+#include "Callbacks.h"
+#include "TimerId.h"
+#include "Metrics.h"
 #include <functional>
 #include <vector>
 #include <atomic>
@@ -9,8 +12,19 @@
 #include <mutex>
 class Channel;
 class Poller;
+class TimerQueue;
 
 
+// 排队回调的统计，见EventLoop::pendingFunctorStats
+struct PendingFunctorStats
+{
+    uint64_t executed = 0;          //累计执行的回调数（两个通道）
+    uint64_t budgetYields = 0;      //预算用完、剩下的回调留到下一轮的次数
+    size_t queued = 0;              //现在排队的回调数
+    int64_t totalWaitUs = 0;        //累计等待时间（从入队到开始执行），除以executed就是平均等待
+    int64_t maxWaitUs = 0;          //最长的一次等待
+};
+
 //事件循环类，主要包含两大模块，1是channel，2是Poller（epoll的抽象）
 //相当于Reactor
 
@@ -18,6 +32,14 @@ class EventLoop : noncopyable
 {
 public:
     using Functor = std::function<void()>;
+
+    // 排队回调的优先级
+    enum Priority
+    {
+        kUrgent,    //每一轮都全部执行，先于kNormal，不受预算限制，给连接上的收发、关闭等交互相关的回调用
+        kNormal,    //受每一轮的预算限制，超出的留到下一轮，后台任务用这个
+    };
+
     EventLoop();
     ~EventLoop();
 
@@ -29,13 +51,39 @@ public:
     Timestamp pollReturnTime() const { return pollReturnTime_; }
 
     // 在当前loop中执行callback，判断是否处于当前IO线程，是则执行这个函数，如果不是则将函数加入队列
-    void runInLoop(Functor cb);
+    void runInLoop(Functor cb, Priority priority = kNormal);
     // cb放入队列中，唤醒loop所在的线程，执行callback
-    void queueInLoop(Functor cb);
+    void queueInLoop(Functor cb, Priority priority = kNormal);
+
+    // 每一轮事件循环最多执行多少个、多长时间的kNormal回调，超出的留到下一轮（下一轮poll不阻塞），
+    // 这样一大批后台任务不会让这个loop上的连接迟迟得不到处理。0表示不限制（默认）
+    // 在loop开始之前或者在loop线程中调用
+    void setPendingFunctorBudget(size_t maxFunctors, double maxSeconds);
+    // 可以在其他线程调用
+    PendingFunctorStats pendingFunctorStats() const;
 
     // 用来唤醒loop所在线程的
     void wakeup();
 
+    // 当前等待执行的回调个数（两个通道，包括预算用完留到下一轮的），可以在其他线程调用，用来判断loop是否过载
+    size_t queueSize() const;
+    // loop处理事件和回调累计花的时间（不包括阻塞在poll上的时间），微秒，可以在其他线程调用，
+    // 两次采样的差除以经过的时间就是这段时间loop线程的繁忙程度
+    int64_t busyMicroseconds() const { return metrics_.busyUs.load(std::memory_order_relaxed); }
+    // 这个loop的计数器，只能在loop线程中修改，其他线程只读（见MetricsRegistry）
+    LoopMetrics* metrics() { return &metrics_; }
+    pid_t threadId() const { return threadId_; }
+
+    // 定时器，线程安全，可以在其他线程调用
+    // 在time时刻执行cb
+    TimerId runAt(Timestamp time, TimerCallback cb);
+    // delay秒之后执行cb
+    TimerId runAfter(double delay, TimerCallback cb);
+    // 每隔interval秒执行一次cb
+    TimerId runEvery(double interval, TimerCallback cb);
+    // 取消定时器
+    void cancel(TimerId timerId);
+
     // EventLoop方法就是去调用Poller的方法来修改Channel
     void updateChannel(Channel* channel);
     void removeChannel(Channel* channel);
@@ -50,6 +98,13 @@ private:
     // 执行回调  
     void doPendingFunctors();
 
+    struct PendingFunctor
+    {
+        Functor cb;
+        int64_t enqueueUs;      //入队时间，统计等待时间用
+    };
+    void runPendingFunctor(const PendingFunctor& functor, int64_t nowUs);
+
     using ChannelList = std::vector<Channel*>;
 
     std::atomic_bool looping_;      //原子操作CAS
@@ -57,10 +112,12 @@ private:
     
     const pid_t threadId_;          //记录当前loop线程的pid
     Timestamp pollReturnTime_;      //poller返回发生事件的channels的时间点
+    LoopMetrics metrics_;           //只有loop线程写
     std::shared_ptr<Poller> poller_;    //EventLoop所管理的Poller
 
     int wakeupFd_;      //用的是系统的eventfd，用于主loop与工作loop线程之间的通信，当mainLoop获取一个新用户的channel，通过轮询算法选择一个subloop，通过该成员唤醒subloop处理channel
     std::unique_ptr<Channel> wakeupChannel_;
+    std::unique_ptr<TimerQueue> timerQueue_;    //必须在poller_之后构造，它要把timerfd注册到poller上
     void handleRead();
     // eventloop类本身就维护了一个eventfd事件，这个事件是为了唤醒pool()的。
     // 此话怎讲？pool()毕竟是一个阻塞的函数，如果pool()所监听的事件在一段时间没有一个被激活，
@@ -73,6 +130,20 @@ private:
     Channel* currentActiveChannel_;
 
     std::atomic_bool callingPendingFunctors_;    //标识当前loop是否有需要执行回调的操作
-    std::vector<Functor> pendingFunctors_;      //存储loop需要执行的所有回调操作
-    std::mutex mutex_;      //用来保护上面vector容器的线程安全操作
+    std::vector<PendingFunctor> pendingFunctors_;      //存储loop需要执行的所有回调操作（kNormal）
+    std::vector<PendingFunctor> urgentFunctors_;       //kUrgent
+    mutable std::mutex mutex_;      //用来保护上面vector容器的线程安全操作
+
+    // 预算用完之后留到下一轮的kNormal回调，只在loop线程访问，从backlogHead_开始还没执行
+    std::vector<PendingFunctor> backlog_;
+    size_t backlogHead_;
+    std::atomic<size_t> backlogSize_;
+    size_t maxFunctorsPerLoop_;
+    int64_t maxFunctorUsPerLoop_;
+
+    // 统计，只有loop线程写
+    std::atomic<uint64_t> executedFunctors_;
+    std::atomic<uint64_t> budgetYields_;
+    std::atomic<int64_t> totalWaitUs_;
+    std::atomic<int64_t> maxWaitUs_;
 };
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <unordered_map>
 
 class EventLoop;
 class EventLoopThread;
@@ -28,12 +29,28 @@ public:
 
     std::string name() const { return name_; }
 
+    // 运行时扩缩容，start之后只能在baseLoop线程中调用
+    // 新开一个subLoop线程加入轮询，返回新的loop
+    EventLoop* addLoop();
+    // 把loop从轮询中摘掉，之后getNextLoop/getAllLoops不会再返回它，线程继续运行，
+    // 上面已有的连接由调用方迁走或者关闭。loop不在轮询中时返回false
+    bool removeLoop(EventLoop* loop);
+    // 结束一个已经removeLoop的loop线程（quit并join），之后loop指针失效
+    void stopLoop(EventLoop* loop);
+    // 轮询中的subLoop个数
+    size_t numLoops() const { return loops_.size(); }
+
 private:
+    void startThread(int index);
+
     EventLoop* baseLoop_;   // main()下的用户创建的EventLoop loop；最起码有一个loop
     std::string name_;
     bool started_;
     int numThreads_;
     int next_;
-    std::vector<std::unique_ptr<EventLoopThread>> threads_;
+    int nextThreadId_;      //线程名字的编号
+    ThreadInitCallBack threadInitCallback_;
+    std::vector<std::unique_ptr<EventLoopThread>> threads_;     //和loops_一一对应
     std::vector<EventLoop*> loops_;
+    std::unordered_map<EventLoop*, std::unique_ptr<EventLoopThread>> retired_;  //removeLoop之后、stopLoop之前
 };
\ No newline at end of file
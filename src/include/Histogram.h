@@ -0,0 +1,49 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <atomic>
+#include <stdint.h>
+#include <vector>
+
+// Histogram::snapshot的结果，普通的值，可以合并多个loop的直方图
+struct HistogramSnapshot
+{
+    std::vector<uint64_t> counts;   //每个桶的样本数，下标见Histogram::bucketIndex
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    int64_t max = 0;
+
+    void merge(const HistogramSnapshot& other);
+    // q在0~1之间，返回第q分位的样本所在桶的上界（不超过max），没有样本时返回0
+    int64_t percentile(double q) const;
+    double mean() const { return count > 0 ? static_cast<double>(sum) / count : 0.0; }
+};
+
+// HDR风格的直方图：按2的幂分段，每段再线性分成kSubBuckets个桶，相对误差不超过1/kSubBuckets（约3%），
+// 小于kSubBuckets的值是精确的，最大记录到2^(kMaxExponent+1)，再大的记到最后一个桶。值一般是微秒
+// 只有一个线程record（loop线程），relaxed的load+store，不加锁也没有原子的读改写；
+// 其他线程随时可以snapshot，不用暂停记录的线程，拿到的是这一时刻前后的近似数据
+class Histogram : noncopyable
+{
+public:
+    static const int kSubBucketBits = 5;
+    static const int kSubBuckets = 1 << kSubBucketBits;
+    static const int kMaxExponent = 40;
+    static const int kBuckets = kSubBuckets * (kMaxExponent - kSubBucketBits + 2);
+
+    Histogram();
+
+    // 负数按0记录
+    void record(int64_t value);
+    HistogramSnapshot snapshot() const;
+
+    static int bucketIndex(int64_t value);
+    // 桶里最大的值
+    static int64_t bucketUpperBound(int index);
+
+private:
+    std::atomic<uint64_t> counts_[kBuckets];
+    std::atomic<uint64_t> sum_;
+    std::atomic<int64_t> max_;
+};
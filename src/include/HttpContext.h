@@ -0,0 +1,86 @@
+#pragma once
+
+#include "HttpRequest.h"
+#include "Timestamp.h"
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+class Buffer;
+
+// 每个连接一个的http增量解析器，保存在TcpConnection的context里
+// 解析时不从Buffer里retrieve，只记录已经解析到的位置（相对于peek()的偏移），
+// 所以handleRead往Buffer里追加数据甚至扩容之后，之前解析的结果依然有效，也不会重复扫描
+// 一个请求完整之后才生成HttpRequest（string_view指向Buffer），处理完再retrieve整个请求
+class HttpContext
+{
+public:
+    enum ParseResult
+    {
+        kNeedMore,      //数据不够，等下一次handleRead
+        kGotRequest,    //解析出一个完整的请求，request()有效
+        kBadRequest,    //请求格式错误
+        kTooLarge,      //header或者body超过上限
+    };
+
+    static const size_t kMaxHeaderBytes = 64 * 1024;
+    static const size_t kMaxBodyBytes = 64 * 1024 * 1024;
+
+    HttpContext();
+
+    // 从buf中继续解析，同一个buf上可能有多个流水线请求，每次最多解析出一个
+    ParseResult parse(Buffer* buf, Timestamp receiveTime);
+
+    const HttpRequest& request() const { return request_; }
+
+    // 请求处理完之后调用，从buf中取走这个请求的全部数据，准备解析下一个请求
+    void finishRequest(Buffer* buf);
+
+private:
+    enum State
+    {
+        kExpectRequestLine,
+        kExpectHeaders,
+        kExpectBody,
+        kExpectChunkSize,
+        kExpectChunkData,
+        kExpectChunkTrailer,
+        kGotAll,
+    };
+
+    // 相对于buf->peek()的偏移
+    struct Range
+    {
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    // 从scanned_开始找一行，找到返回true并设置line，scanned_移到下一行开头
+    bool getLine(const Buffer* buf, Range* line);
+    bool parseRequestLine(const char* base, Range line);
+    bool parseHeader(const char* base, Range line);
+    // header全部收到之后，根据Content-Length/Transfer-Encoding决定下一步
+    ParseResult headersComplete(const char* base);
+    void buildRequest(const Buffer* buf);
+    void reset();
+
+    State state_;
+    size_t scanned_;        //已经解析过的字节数
+    size_t searchFrom_;     //下一次找\r\n的起点，避免对不完整的行重复扫描
+    Timestamp receiveTime_;
+
+    HttpRequest::Method method_;
+    HttpRequest::Version version_;
+    Range methodRange_;
+    Range pathRange_;
+    Range queryRange_;
+    std::vector<std::pair<Range, Range>> headerRanges_;
+    bool chunked_;
+    Range bodyRange_;
+    size_t chunkRemaining_;
+    size_t trailerStart_;       //trailer的起点，trailer总长度和header一样不超过kMaxHeaderBytes
+    std::string chunkedBody_;   //chunked编码的body需要拼接，只有这种情况会拷贝
+
+    HttpRequest request_;
+};
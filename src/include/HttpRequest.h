@@ -0,0 +1,82 @@
+#pragma once
+
+#include "Timestamp.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <utility>
+#include <strings.h>
+
+// http请求，method、path、header和body都是指向连接输入缓冲区的string_view，不拷贝
+// 只在HttpCallback执行期间有效，回调返回后缓冲区里的这部分数据就被retrieve掉了
+class HttpRequest
+{
+public:
+    enum Method { kInvalid, kGet, kPost, kHead, kPut, kDelete, kOptions, kPatch };
+    enum Version { kUnknown, kHttp10, kHttp11 };
+    using Header = std::pair<std::string_view, std::string_view>;
+
+    HttpRequest()
+        : method_(kInvalid),
+        version_(kUnknown)
+    {}
+
+    Method method() const { return method_; }
+    Version version() const { return version_; }
+    std::string_view methodString() const { return methodString_; }
+    std::string_view path() const { return path_; }
+    std::string_view query() const { return query_; }
+    std::string_view body() const { return body_; }
+    Timestamp receiveTime() const { return receiveTime_; }
+    const std::vector<Header>& headers() const { return headers_; }
+
+    // header名字不区分大小写，没有返回空
+    std::string_view getHeader(std::string_view field) const
+    {
+        for(const Header& header : headers_)
+        {
+            if(header.first.size() == field.size()
+                && ::strncasecmp(header.first.data(), field.data(), field.size()) == 0)
+            {
+                return header.second;
+            }
+        }
+        return std::string_view();
+    }
+
+    // HTTP/1.1默认长连接，HTTP/1.0默认短连接，Connection头可以覆盖
+    bool keepAlive() const
+    {
+        std::string_view connection = getHeader("Connection");
+        if(connection.size() == 5 && ::strncasecmp(connection.data(), "close", 5) == 0)
+        {
+            return false;
+        }
+        if(connection.size() == 10 && ::strncasecmp(connection.data(), "keep-alive", 10) == 0)
+        {
+            return true;
+        }
+        return version_ == kHttp11;
+    }
+
+private:
+    friend class HttpContext;
+
+    void reset()
+    {
+        method_ = kInvalid;
+        version_ = kUnknown;
+        methodString_ = path_ = query_ = body_ = std::string_view();
+        headers_.clear();   //保留容量，下一个请求不用再分配
+    }
+
+    Method method_;
+    Version version_;
+    std::string_view methodString_;
+    std::string_view path_;
+    std::string_view query_;
+    std::string_view body_;
+    Timestamp receiveTime_;
+    std::vector<Header> headers_;
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <utility>
+
+class Buffer;
+
+// http响应，appendToBuffer直接把状态行、header和body写进发送缓冲区
+class HttpResponse
+{
+public:
+    enum HttpStatusCode
+    {
+        kUnknown,
+        k200Ok = 200,
+        k204NoContent = 204,
+        k301MovedPermanently = 301,
+        k400BadRequest = 400,
+        k404NotFound = 404,
+        k413PayloadTooLarge = 413,
+        k431HeaderFieldsTooLarge = 431,
+        k500InternalServerError = 500,
+    };
+
+    explicit HttpResponse(bool close)
+        : statusCode_(kUnknown),
+        closeConnection_(close)
+    {}
+
+    void setStatusCode(HttpStatusCode code) { statusCode_ = code; }
+    void setStatusMessage(const std::string& message) { statusMessage_ = message; }
+
+    void setCloseConnection(bool on) { closeConnection_ = on; }
+    bool closeConnection() const { return closeConnection_; }
+
+    void setContentType(const std::string& contentType) { addHeader("Content-Type", contentType); }
+    void addHeader(const std::string& key, const std::string& value) { headers_.emplace_back(key, value); }
+
+    void setBody(const std::string& body) { body_ = body; }
+    void setBody(std::string&& body) { body_ = std::move(body); }
+
+    // headOnly: HEAD请求只发header，Content-Length仍然是body的长度
+    void appendToBuffer(Buffer* output, bool headOnly = false) const;
+
+private:
+    HttpStatusCode statusCode_;
+    std::string statusMessage_;
+    bool closeConnection_;
+    std::vector<std::pair<std::string, std::string>> headers_;
+    std::string body_;
+};
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "TcpServer.h"
+#include "noncopyable.h"
+
+#include <functional>
+#include <string>
+
+class HttpRequest;
+class HttpResponse;
+
+// 基于TcpServer的HTTP/1.1服务器，支持长连接、流水线请求和chunked请求体
+// 一次onMessage里解析出的所有请求按顺序处理，响应都写进同一个Buffer，最后只send一次
+class HttpServer : noncopyable
+{
+public:
+    using HttpCallback = std::function<void(const HttpRequest&, HttpResponse*)>;
+
+    HttpServer(EventLoop* loop,
+                const InetAddress& listenAddr,
+                const std::string& name,
+                TcpServer::Option option = TcpServer::kNoReusePort);
+
+    EventLoop* getLoop() const { return loop_; }
+    TcpServer* server() { return &server_; }
+
+    // 在subLoop中回调，request只在回调期间有效
+    void setHttpCallback(const HttpCallback& cb) { httpCallback_ = cb; }
+
+    void setThreadNum(int numThreads) { server_.setThreadNum(numThreads); }
+
+    void start();
+
+private:
+    void onConnection(const TcpConnectionPtr& conn);
+    void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp receiveTime);
+
+    EventLoop* loop_;
+    HttpCallback httpCallback_;
+
+    // 放在最后，析构时先停掉subLoop线程，subLoop里的回调用到的成员这时还有效
+    TcpServer server_;
+};
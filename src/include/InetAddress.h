@@ -2,23 +2,40 @@
 
 #include <arpa/inet.h>
 #include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #include <string>
-//封装socket地址类型
+
+//封装socket地址类型，内部是sockaddr_storage，可以是IPv4、IPv6或者unix domain socket的地址
 class InetAddress
 {
 public:
+    // ip里有':'时按IPv6解析
     explicit InetAddress(uint16_t port = 0, std::string ip = "127.0.0.1");
-    explicit InetAddress(const sockaddr_in& addr)
-        :addr_(addr)
-        {}
+    explicit InetAddress(const sockaddr_in& addr);
+    explicit InetAddress(const sockaddr_in6& addr);
+    // accept、getsockname、recvmsg之类返回的地址
+    InetAddress(const sockaddr* addr, socklen_t len);
+
+    // unix domain socket的地址，'@'开头表示抽象命名空间（Linux特有，不在文件系统里创建文件，进程退出自动消失）
+    static InetAddress fromUnixPath(const std::string& path);
+
+    // unix地址时toIp和toIpPort返回路径（抽象命名空间用'@'开头表示），toPort返回0
     std::string toIp() const;
     std::string toIpPort() const;
     uint16_t toPort() const;
 
-    const sockaddr_in* getSockaddr() const { return &addr_; }
-    
+    sa_family_t family() const { return addr_.ss_family; }
+    bool isIpv6() const { return family() == AF_INET6; }
+    bool isUnix() const { return family() == AF_UNIX; }
+    // 文件系统里的unix socket，bind前需要删掉残留的文件
+    bool isUnixPath() const;
+
+    const sockaddr* getSockaddr() const { return reinterpret_cast<const sockaddr*>(&addr_); }
+    socklen_t getSockaddrLen() const { return len_; }
 
-    void setSockaddr(const sockaddr_in& addr) { addr_ = addr; }
+    void setSockaddr(const sockaddr* addr, socklen_t len);
 private:
-    sockaddr_in addr_;
-};
\ No newline at end of file
+    sockaddr_storage addr_;
+    socklen_t len_;     //unix地址的长度和路径有关，不能用sizeof
+};
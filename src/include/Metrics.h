@@ -0,0 +1,62 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Histogram.h"
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class EventLoop;
+class TcpServer;
+
+// 一个EventLoop的计数器，只有loop线程写：写是relaxed的load+store，编译出来就是普通的mov，没有加lock的读改写，
+// 其他线程采集时relaxed load。按cache line对齐，不同loop的计数器不会伪共享
+struct alignas(64) LoopMetrics
+{
+    std::atomic<uint64_t> iterations{0};    //poll的次数
+    std::atomic<uint64_t> events{0};        //poll返回的就绪事件数
+    std::atomic<int64_t> pollWaitUs{0};     //阻塞在epoll_wait上的时间，微秒
+    std::atomic<int64_t> busyUs{0};         //处理事件和回调的时间，微秒
+    std::atomic<uint64_t> wakeups{0};       //被wakeup的次数（eventfd的计数）
+    std::atomic<uint64_t> bytesRead{0};     //这个loop上的连接从socket读的字节数
+    std::atomic<uint64_t> bytesWritten{0};
+    std::atomic<int64_t> connections{0};    //这个loop上的连接数
+    std::atomic<int64_t> outputBytes{0};    //这个loop上所有连接输出缓冲区里还没写出去的字节数
+
+    // 分布，微秒
+    Histogram dispatchLag;      //poll返回到开始处理某个channel的事件
+    Histogram messageCallback;  //每次MessageCallback的执行时间
+    Histogram functorWait;      //queueInLoop到开始执行
+
+    template<typename T>
+    static void add(std::atomic<T>* counter, T n)
+    { counter->store(counter->load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+};
+
+// 进程内所有EventLoop和TcpServer的登记表，采集时把它们的计数器汇总成Prometheus文本格式
+// EventLoop/TcpServer在构造时登记、析构时注销，析构会等正在进行的采集结束
+class MetricsRegistry : noncopyable
+{
+public:
+    static MetricsRegistry& instance();
+
+    void addLoop(EventLoop* loop);
+    void removeLoop(EventLoop* loop);
+    void addServer(TcpServer* server);
+    void removeServer(TcpServer* server);
+
+    // 任意线程调用，https://prometheus.io/docs/instrumenting/exposition_formats/
+    // 直方图按loop输出成summary（分位数、_sum、_count）
+    std::string prometheusText();
+    // 所有loop的某个直方图合并在一起，比如mergedHistogram(&LoopMetrics::dispatchLag)
+    HistogramSnapshot mergedHistogram(Histogram LoopMetrics::* which);
+
+private:
+    MetricsRegistry() = default;
+
+    std::mutex mutex_;
+    std::vector<EventLoop*> loops_;
+    std::vector<TcpServer*> servers_;
+};
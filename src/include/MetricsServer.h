@@ -0,0 +1,24 @@
+#pragma once
+
+#include "HttpServer.h"
+#include "noncopyable.h"
+
+#include <string>
+
+class HttpRequest;
+class HttpResponse;
+
+// 指标的HTTP出口：GET /metrics 返回MetricsRegistry汇总的Prometheus文本，其他路径404
+// 一般监听127.0.0.1上的端口，不开subLoop，和业务共用baseLoop就行，采集只读计数器
+class MetricsServer : noncopyable
+{
+public:
+    MetricsServer(EventLoop* loop, const InetAddress& listenAddr, const std::string& name = std::string("MetricsServer"));
+
+    void start() { server_.start(); }
+
+private:
+    void onRequest(const HttpRequest& req, HttpResponse* resp);
+
+    HttpServer server_;
+};
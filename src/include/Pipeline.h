@@ -0,0 +1,392 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "TcpConnection.h"
+#include "Buffer.h"
+#include "Timestamp.h"
+
+#include <endian.h>
+#include <string.h>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+/**
+ * 每条连接一个处理链，阶段的顺序和消息的类型都在编译期确定，整条链没有虚函数调用：
+ *
+ *   using EchoPipeline = Pipeline<LengthFieldCodec, CommandDecoder, BusinessHandler>;
+ *   installPipeline<EchoPipeline>(&server);
+ *
+ * 入站：MessageCallback的Buffer*交给第0个阶段，每个阶段处理完调用ctx.fireRead(msg)交给下一个阶段，
+ *      可以一次调用多次（一个buffer解出多条消息），也可以不调用（数据不够，等下次）
+ * 出站：ctx.write(msg)交给前一个阶段（更靠近socket的方向），最后到达链头时必须已经编码成字节
+ *      （std::string_view / std::string / Buffer*），编码器也可以直接往ctx.outputBuffer()里写，不用中间的string
+ * 阶段是一个普通的类，按需要实现下面的函数（都是模板或者重载，没有基类）：
+ *   void onRead(Ctx& ctx, M msg)       没有能接受M的onRead时消息原样传给下一个阶段
+ *   void onWrite(Ctx& ctx, M msg)      没有能接受M的onWrite时消息原样传给前一个阶段
+ *   void onConnected(Ctx& ctx)         连接建立/断开，每个阶段都会收到，不需要转发
+ *   void onDisconnected(Ctx& ctx)
+ * 消息按值（移动）或者按视图传递，string_view指向连接的输入缓冲区时只在这次fireRead调用期间有效
+ * 一次读事件里所有阶段写出的数据攒在一起，回调结束时一次send，读事件之外的write立即发送
+ * 所有的函数都只能在连接所在的loop线程中调用
+ */
+template<typename... Stages>
+class Pipeline;
+
+namespace detail
+{
+
+template<typename S, typename C, typename M, typename = void>
+struct HasOnRead : std::false_type {};
+template<typename S, typename C, typename M>
+struct HasOnRead<S, C, M, std::void_t<decltype(std::declval<S&>().onRead(std::declval<C&>(), std::declval<M>()))>>
+    : std::true_type {};
+
+template<typename S, typename C, typename M, typename = void>
+struct HasOnWrite : std::false_type {};
+template<typename S, typename C, typename M>
+struct HasOnWrite<S, C, M, std::void_t<decltype(std::declval<S&>().onWrite(std::declval<C&>(), std::declval<M>()))>>
+    : std::true_type {};
+
+template<typename S, typename C, typename = void>
+struct HasOnConnected : std::false_type {};
+template<typename S, typename C>
+struct HasOnConnected<S, C, std::void_t<decltype(std::declval<S&>().onConnected(std::declval<C&>()))>>
+    : std::true_type {};
+
+template<typename S, typename C, typename = void>
+struct HasOnDisconnected : std::false_type {};
+template<typename S, typename C>
+struct HasOnDisconnected<S, C, std::void_t<decltype(std::declval<S&>().onDisconnected(std::declval<C&>()))>>
+    : std::true_type {};
+
+template<typename T>
+struct AlwaysFalse : std::false_type {};
+
+}
+
+// 第I个阶段看到的上下文，只是一个指向Pipeline的指针，按值传递也没有开销
+template<typename P, size_t I>
+class PipelineContext
+{
+public:
+    explicit PipelineContext(P* pipeline) : pipeline_(pipeline) {}
+
+    // 交给下一个入站阶段
+    template<typename M>
+    void fireRead(M&& msg) { pipeline_->template readAt<I + 1>(std::forward<M>(msg)); }
+
+    // 交给前一个出站阶段
+    template<typename M>
+    void write(M&& msg) { pipeline_->template writeAt<I>(std::forward<M>(msg)); }
+
+    // 链头的输出缓冲区，编码器直接往里面追加字节
+    Buffer* outputBuffer() { return pipeline_->outputBuffer(); }
+    // 立即把outputBuffer中的数据发出去，不等这次读事件结束
+    void flush() { pipeline_->flush(); }
+
+    const TcpConnectionPtr& connection() const { return pipeline_->connection(); }
+    Timestamp receiveTime() const { return pipeline_->receiveTime(); }
+    P& pipeline() { return *pipeline_; }
+
+    // 同一条链上其他阶段的状态
+    template<size_t J>
+    auto& stage() { return pipeline_->template stage<J>(); }
+
+private:
+    P* pipeline_;
+};
+
+template<typename... Stages>
+class Pipeline : noncopyable
+{
+public:
+    static constexpr size_t kSize = sizeof...(Stages);
+    static_assert(kSize > 0, "Pipeline needs at least one stage");
+
+    template<typename... Args>
+    explicit Pipeline(const TcpConnectionPtr& conn, Args&&... args)
+        :conn_(conn),
+        stages_(std::forward<Args>(args)...),
+        inRead_(false)
+    {
+    }
+
+    // 连接的MessageCallback
+    void handleRead(Buffer* buf, Timestamp receiveTime)
+    {
+        receiveTime_ = receiveTime;
+        inRead_ = true;
+        readAt<0>(buf);
+        inRead_ = false;
+        flush();
+    }
+
+    // 从链尾写出一条消息，经过所有的出站阶段
+    template<typename M>
+    void write(M&& msg)
+    {
+        writeAt<kSize>(std::forward<M>(msg));
+        if(!inRead_)
+        {
+            flush();
+        }
+    }
+
+    void connected() { notifyConnected(std::index_sequence_for<Stages...>()); }
+    void disconnected() { notifyDisconnected(std::index_sequence_for<Stages...>()); }
+
+    void flush()
+    {
+        if(output_.readableBytes() > 0)
+        {
+            conn_->send(&output_);
+            output_.retrieveAll();  //连接已经断开时send不会取走数据
+        }
+    }
+
+    Buffer* outputBuffer() { return &output_; }
+    const TcpConnectionPtr& connection() const { return conn_; }
+    Timestamp receiveTime() const { return receiveTime_; }
+
+    template<size_t I>
+    auto& stage() { return std::get<I>(stages_); }
+
+    // 交给第I个阶段的onRead，I==kSize说明最后一个阶段还在往后传
+    template<size_t I, typename M>
+    void readAt(M&& msg)
+    {
+        static_assert(I < kSize, "fireRead() called on the last inbound stage, nobody consumes this message");
+        using Stage = std::tuple_element_t<I, std::tuple<Stages...>>;
+        using Ctx = PipelineContext<Pipeline, I>;
+        if constexpr(detail::HasOnRead<Stage, Ctx, M&&>::value)
+        {
+            Ctx ctx(this);
+            std::get<I>(stages_).onRead(ctx, std::forward<M>(msg));
+        }
+        else
+        {
+            readAt<I + 1>(std::forward<M>(msg));
+        }
+    }
+
+    // 交给第I-1个阶段的onWrite，I==0说明到达链头
+    template<size_t I, typename M>
+    void writeAt(M&& msg)
+    {
+        if constexpr(I == 0)
+        {
+            writeHead(std::forward<M>(msg));
+        }
+        else
+        {
+            using Stage = std::tuple_element_t<I - 1, std::tuple<Stages...>>;
+            using Ctx = PipelineContext<Pipeline, I - 1>;
+            if constexpr(detail::HasOnWrite<Stage, Ctx, M&&>::value)
+            {
+                Ctx ctx(this);
+                std::get<I - 1>(stages_).onWrite(ctx, std::forward<M>(msg));
+            }
+            else
+            {
+                writeAt<I - 1>(std::forward<M>(msg));
+            }
+        }
+    }
+
+private:
+    template<typename M>
+    void writeHead(M&& msg)
+    {
+        using T = std::decay_t<M>;
+        if constexpr(std::is_same_v<T, Buffer*>)
+        {
+            output_.append(msg->peek(), msg->readableBytes());
+            msg->retrieveAll();
+        }
+        else if constexpr(std::is_convertible_v<const T&, std::string_view>)
+        {
+            std::string_view data(msg);
+            output_.append(data.data(), data.size());
+        }
+        else
+        {
+            static_assert(detail::AlwaysFalse<T>::value, "outbound message reached the connection without being encoded to bytes");
+        }
+    }
+
+    template<size_t... I>
+    void notifyConnected(std::index_sequence<I...>)
+    {
+        (notifyConnectedAt<I>(), ...);
+        flush();
+    }
+
+    template<size_t I>
+    void notifyConnectedAt()
+    {
+        using Stage = std::tuple_element_t<I, std::tuple<Stages...>>;
+        using Ctx = PipelineContext<Pipeline, I>;
+        if constexpr(detail::HasOnConnected<Stage, Ctx>::value)
+        {
+            Ctx ctx(this);
+            std::get<I>(stages_).onConnected(ctx);
+        }
+    }
+
+    template<size_t... I>
+    void notifyDisconnected(std::index_sequence<I...>)
+    {
+        (notifyDisconnectedAt<I>(), ...);
+    }
+
+    template<size_t I>
+    void notifyDisconnectedAt()
+    {
+        using Stage = std::tuple_element_t<I, std::tuple<Stages...>>;
+        using Ctx = PipelineContext<Pipeline, I>;
+        if constexpr(detail::HasOnDisconnected<Stage, Ctx>::value)
+        {
+            Ctx ctx(this);
+            std::get<I>(stages_).onDisconnected(ctx);
+        }
+    }
+
+    TcpConnectionPtr conn_;
+    std::tuple<Stages...> stages_;
+    Buffer output_;             //一次读事件里所有阶段写出的数据
+    Timestamp receiveTime_;
+    bool inRead_;
+};
+
+// 把server（TcpServer或者TcpClient）的回调换成每条连接一个P，P保存在连接的context里
+// makeStages用来给阶段传构造参数（比如共享的业务对象），返回值是P，默认每个阶段默认构造
+// 会覆盖之前设置的ConnectionCallback和MessageCallback
+template<typename P, typename Server, typename Factory>
+void installPipeline(Server* server, Factory makePipeline)
+{
+    using PipelinePtr = std::shared_ptr<P>;
+    server->setConnectionCallback([makePipeline](const TcpConnectionPtr& conn) {
+        if(conn->connected())
+        {
+            PipelinePtr pipeline = makePipeline(conn);
+            conn->setContext(pipeline);
+            pipeline->connected();
+        }
+        else
+        {
+            PipelinePtr* pipeline = std::any_cast<PipelinePtr>(conn->getMutableContext());
+            if(pipeline)
+            {
+                PipelinePtr p = std::move(*pipeline);
+                conn->setContext(std::any());   //打破conn -> context -> pipeline -> conn的循环引用
+                p->disconnected();
+            }
+        }
+    });
+    server->setMessageCallback([](const TcpConnectionPtr& conn, Buffer* buf, Timestamp receiveTime) {
+        PipelinePtr* pipeline = std::any_cast<PipelinePtr>(conn->getMutableContext());
+        if(pipeline)
+        {
+            (*pipeline)->handleRead(buf, receiveTime);
+        }
+    });
+}
+
+template<typename P, typename Server>
+void installPipeline(Server* server)
+{
+    installPipeline<P>(server, [](const TcpConnectionPtr& conn) { return std::make_shared<P>(conn); });
+}
+
+// 常用的编解码阶段
+
+// 4字节大端长度 + payload，入站把Buffer*切成一条条payload（string_view，指向输入缓冲区，不拷贝），
+// 出站把string_view编码进outputBuffer，payload超过maxFrameBytes时关闭连接
+class LengthFieldCodec
+{
+public:
+    explicit LengthFieldCodec(size_t maxFrameBytes = 16 * 1024 * 1024) : maxFrameBytes_(maxFrameBytes) {}
+
+    template<typename Ctx>
+    void onRead(Ctx& ctx, Buffer* buf)
+    {
+        while(buf->readableBytes() >= kHeaderBytes)
+        {
+            uint32_t be;
+            ::memcpy(&be, buf->peek(), sizeof be);
+            size_t length = be32toh(be);
+            if(length > maxFrameBytes_)
+            {
+                ctx.connection()->forceClose();
+                buf->retrieveAll();
+                return;
+            }
+            if(buf->readableBytes() < kHeaderBytes + length)
+            {
+                break;
+            }
+            ctx.connection()->countReadMessages(1);
+            ctx.fireRead(std::string_view(buf->peek() + kHeaderBytes, length));
+            buf->retrieve(kHeaderBytes + length);
+        }
+    }
+
+    template<typename Ctx>
+    void onWrite(Ctx& ctx, std::string_view payload)
+    {
+        uint32_t be = htobe32(static_cast<uint32_t>(payload.size()));
+        Buffer* out = ctx.outputBuffer();
+        out->append(reinterpret_cast<const char*>(&be), sizeof be);
+        out->append(payload.data(), payload.size());
+    }
+
+private:
+    static const size_t kHeaderBytes = 4;
+    size_t maxFrameBytes_;
+};
+
+// 按行切分（\n，去掉结尾的\r），出站给每条消息加上\r\n
+class LineCodec
+{
+public:
+    explicit LineCodec(size_t maxLineBytes = 64 * 1024) : maxLineBytes_(maxLineBytes) {}
+
+    template<typename Ctx>
+    void onRead(Ctx& ctx, Buffer* buf)
+    {
+        for(;;)
+        {
+            const char* begin = buf->peek();
+            const char* eol = static_cast<const char*>(::memchr(begin, '\n', buf->readableBytes()));
+            if(eol == nullptr)
+            {
+                if(buf->readableBytes() > maxLineBytes_)
+                {
+                    ctx.connection()->forceClose();
+                    buf->retrieveAll();
+                }
+                return;
+            }
+            size_t length = eol - begin;
+            std::string_view line(begin, length > 0 && begin[length - 1] == '\r' ? length - 1 : length);
+            ctx.connection()->countReadMessages(1);
+            ctx.fireRead(line);
+            buf->retrieve(length + 1);
+        }
+    }
+
+    template<typename Ctx>
+    void onWrite(Ctx& ctx, std::string_view line)
+    {
+        Buffer* out = ctx.outputBuffer();
+        out->append(line.data(), line.size());
+        out->append("\r\n", 2);
+    }
+
+private:
+    size_t maxLineBytes_;
+};
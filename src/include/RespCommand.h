@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string_view>
+#include <vector>
+#include <strings.h>
+
+// 一条redis命令，参数都是指向连接输入缓冲区的string_view，不拷贝
+// 只在命令回调执行期间有效，回调返回后缓冲区里的这部分数据就被retrieve掉了
+class RespCommand
+{
+public:
+    size_t argc() const { return args_.size(); }
+    std::string_view arg(size_t i) const { return args_[i]; }
+    const std::vector<std::string_view>& args() const { return args_; }
+    std::string_view name() const { return args_.empty() ? std::string_view() : args_[0]; }
+
+    // 命令名不区分大小写
+    bool nameEquals(std::string_view name) const
+    {
+        return !args_.empty() && args_[0].size() == name.size()
+            && ::strncasecmp(args_[0].data(), name.data(), name.size()) == 0;
+    }
+
+    // 连接当前协商的协议版本，2或者3（HELLO命令切换）
+    int protocolVersion() const { return protocolVersion_; }
+
+private:
+    friend class RespContext;
+
+    std::vector<std::string_view> args_;
+    int protocolVersion_ = 2;
+};
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "RespCommand.h"
+
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+
+class Buffer;
+
+// 每个连接一个的RESP增量解析器，保存在TcpConnection的context里，和HttpContext一样只记录相对于peek()的偏移
+// 支持multibulk格式（*N\r\n$len\r\narg\r\n...，RESP2和RESP3的请求格式相同）和telnet用的inline格式
+// 一条命令完整之后才生成RespCommand，处理完再retrieve整条命令
+class RespContext
+{
+public:
+    enum ParseResult
+    {
+        kNeedMore,
+        kGotCommand,    //command()有效
+        kProtocolError,
+        kTooLarge,      //参数个数、bulk长度或者inline命令超过上限
+    };
+
+    static const size_t kMaxInlineBytes = 64 * 1024;
+    static const int64_t kMaxArgs = 1024 * 1024;
+    static const int64_t kMaxBulkBytes = 512 * 1024 * 1024;
+
+    RespContext();
+
+    // 从buf中继续解析，同一个buf上可能有多个流水线命令，每次最多解析出一个
+    ParseResult parse(Buffer* buf);
+
+    const RespCommand& command() const { return command_; }
+
+    // 命令处理完之后调用，从buf中取走这条命令的数据
+    void finishCommand(Buffer* buf);
+
+    void setProtocolVersion(int version) { command_.protocolVersion_ = version; }
+    int protocolVersion() const { return command_.protocolVersion_; }
+
+private:
+    enum State
+    {
+        kExpectStart,
+        kExpectBulkLength,
+        kExpectBulkData,
+        kGotAll,
+    };
+
+    struct Range
+    {
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    // 从scanned_开始找一行，找到返回true并设置line，scanned_移到下一行开头
+    bool getLine(const Buffer* buf, Range* line);
+    bool parseInline(const char* base, Range line);
+    void buildCommand(const Buffer* buf);
+    void reset();
+
+    State state_;
+    size_t scanned_;
+    size_t searchFrom_;
+    int64_t argsRemaining_;
+    int64_t bulkLength_;
+    std::vector<Range> argRanges_;
+
+    RespCommand command_;
+};
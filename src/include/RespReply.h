@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string_view>
+#include <stdint.h>
+#include <stddef.h>
+
+class Buffer;
+
+// RESP回复的编码，直接追加到输出Buffer里
+// RESP2和RESP3类型不同的地方（null、map、double、boolean）按protocolVersion选择编码
+namespace RespReply
+{
+    void appendSimpleString(Buffer* output, std::string_view str);     // +OK
+    void appendError(Buffer* output, std::string_view message);        // -ERR message
+    void appendInteger(Buffer* output, int64_t value);                 // :123
+    void appendBulkString(Buffer* output, std::string_view str);       // $len\r\nstr
+    void appendArrayHeader(Buffer* output, size_t count);              // *count，后面跟count个元素
+
+    // RESP2: $-1   RESP3: _
+    void appendNull(Buffer* output, int protocolVersion);
+    // RESP2: 2*count个元素的数组   RESP3: %count，后面跟count对key value
+    void appendMapHeader(Buffer* output, size_t count, int protocolVersion);
+    // RESP2: bulk string   RESP3: ,value
+    void appendDouble(Buffer* output, double value, int protocolVersion);
+    // RESP2: :1/:0   RESP3: #t/#f
+    void appendBoolean(Buffer* output, bool value, int protocolVersion);
+
+    // 预先编码好的常用回复
+    extern const std::string_view kOk;
+    extern const std::string_view kPong;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "TcpServer.h"
+#include "noncopyable.h"
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+
+class RespCommand;
+
+// 基于TcpServer的redis协议服务器框架
+// 一次onMessage里解析出的所有流水线命令按顺序处理，回复都写进同一个Buffer，最后只send一次
+// 内置HELLO（切换RESP2/RESP3）和QUIT，其余命令用registerCommand注册
+class RespServer : noncopyable
+{
+public:
+    // 在subLoop中回调，command只在回调期间有效，回复用RespReply写进output
+    using CommandHandler = std::function<void(const TcpConnectionPtr&, const RespCommand&, Buffer* output)>;
+
+    RespServer(EventLoop* loop,
+                const InetAddress& listenAddr,
+                const std::string& name,
+                TcpServer::Option option = TcpServer::kNoReusePort);
+
+    EventLoop* getLoop() const { return loop_; }
+    TcpServer* server() { return &server_; }
+
+    // 命令名不区分大小写，要在start之前注册
+    void registerCommand(const std::string& name, const CommandHandler& handler);
+    // 没有注册的命令交给这个回调，默认回复unknown command错误
+    void setDefaultHandler(const CommandHandler& handler) { defaultHandler_ = handler; }
+
+    void setThreadNum(int numThreads) { server_.setThreadNum(numThreads); }
+
+    void start();
+
+private:
+    void onConnection(const TcpConnectionPtr& conn);
+    void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp receiveTime);
+    // 返回false表示处理完这条命令之后关闭连接
+    bool dispatch(const TcpConnectionPtr& conn, const RespCommand& command, Buffer* output);
+
+    EventLoop* loop_;
+    std::unordered_map<std::string, CommandHandler> handlers_;  //key是小写的命令名
+    CommandHandler defaultHandler_;
+
+    // 放在最后，析构时先停掉subLoop线程，subLoop里的回调用到的成员这时还有效
+    TcpServer server_;
+};
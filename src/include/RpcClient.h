@@ -0,0 +1,84 @@
+#pragma once
+
+#include "TcpClient.h"
+#include "RpcCodec.h"
+#include "Buffer.h"
+#include "TimerId.h"
+#include "noncopyable.h"
+
+#include <functional>
+#include <future>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// 二进制rpc客户端，所有请求复用TcpClient的一条连接，每个请求有自己的id，响应可以乱序返回
+// 同一轮事件循环里发起的请求先攒在一起，在这一轮的最后只send一次
+// 还没有连接时请求先缓存，连接建立后再发出；连接断开时所有没有响应的请求都以kConnectionLost结束
+class RpcClient : noncopyable
+{
+public:
+    // 在loop线程中回调，payload只在回调期间有效
+    using ResponseCallback = std::function<void(uint16_t status, std::string_view payload)>;
+
+    struct Result
+    {
+        uint16_t status;
+        std::string payload;
+    };
+
+    RpcClient(EventLoop* loop, const InetAddress& serverAddr, const std::string& name);
+    ~RpcClient();
+
+    void connect() { client_.connect(); }
+    void disconnect() { client_.disconnect(); }
+    void enableRetry() { client_.enableRetry(); }
+
+    void setConnectionCallback(const ConnectionCallback& cb) { connectionCallback_ = cb; }
+    // 请求超时时间，超时以kTimeout结束，0表示不超时，要在发请求之前设置
+    void setTimeout(double seconds) { timeoutSeconds_ = seconds; }
+
+    EventLoop* getLoop() const { return loop_; }
+    TcpConnectionPtr connection() const { return client_.connection(); }
+
+    // 线程安全，回调在loop线程中执行
+    void call(uint16_t methodId, std::string_view request, ResponseCallback cb);
+    // writer把请求的payload直接写进发送缓冲区，在loop线程中调用时不经过中间的string
+    void call(uint16_t methodId, const RpcCodec::PayloadWriter& writer, ResponseCallback cb);
+    // 不能在loop线程里等待这个future，否则会死锁
+    std::future<Result> call(uint16_t methodId, std::string_view request);
+
+    // 还没有收到响应的请求数，只能在loop线程中调用
+    size_t pendingCalls() const { return pending_.size(); }
+
+private:
+    struct PendingCall
+    {
+        ResponseCallback callback;
+        TimerId timer;
+    };
+
+    void callInLoop(uint16_t methodId, std::string_view request, ResponseCallback cb);
+    // 登记一个请求，返回它的id
+    uint64_t addPending(ResponseCallback cb);
+    void scheduleFlush();
+    void flush();
+    void onTimeout(uint64_t id);
+    void failAll(uint16_t status);
+    void onConnection(const TcpConnectionPtr& conn);
+    void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp receiveTime);
+
+    EventLoop* loop_;
+    ConnectionCallback connectionCallback_;
+    double timeoutSeconds_;
+
+    // 下面的成员只在loop线程中访问
+    uint64_t nextId_;
+    std::unordered_map<uint64_t, PendingCall> pending_;
+    Buffer outbox_;         //还没有发出去的请求
+    bool flushQueued_;
+    TcpConnectionPtr conn_;
+
+    // 放在最后，析构时先关闭连接
+    TcpClient client_;
+};
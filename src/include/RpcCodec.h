@@ -0,0 +1,66 @@
+#pragma once
+
+#include <functional>
+#include <string_view>
+#include <stdint.h>
+#include <stddef.h>
+
+class Buffer;
+
+// rpc消息的编解码，一条消息是16字节的头加payload，整数都是网络字节序
+//
+// +----------------+------+----------+------------------+---------------------+
+// | length (4)     | type | reserved | method/status (2)| request id (8)      |  payload (length字节)
+// +----------------+------+----------+------------------+---------------------+
+//
+// 请求的code是method id，响应的code是status；响应和请求用同一个id对应，可以乱序返回
+namespace RpcCodec
+{
+    static const size_t kHeaderLength = 16;
+    static const size_t kMaxPayloadLength = 64 * 1024 * 1024;
+
+    enum Type
+    {
+        kRequest = 0,
+        kResponse = 1,
+    };
+
+    // 框架用到的status，业务自定义的status从kUserStatus开始
+    enum Status
+    {
+        kOk = 0,
+        kNoSuchMethod = 1,
+        kTimeout = 2,
+        kConnectionLost = 3,
+        kUserStatus = 100,
+    };
+
+    struct Header
+    {
+        uint32_t payloadLength;
+        Type type;
+        uint16_t code;
+        uint64_t id;
+    };
+
+    enum ParseResult
+    {
+        kNeedMore,
+        kGotMessage,    //payload从peek()+kHeaderLength开始，调用者处理完之后retrieve(kHeaderLength+payloadLength)
+        kBadMessage,
+        kTooLarge,
+    };
+
+    ParseResult parse(const Buffer* buf, Header* header);
+
+    // 直接往output里写payload，不经过中间的string
+    using PayloadWriter = std::function<void(Buffer* output)>;
+
+    // 先写一个长度为0的头，返回它在output可读数据中的偏移，payload写完之后用endMessage回填长度
+    size_t beginMessage(Buffer* output, Type type, uint16_t code, uint64_t id);
+    void endMessage(Buffer* output, size_t headerOffset);
+    // 响应的status要等handler执行完才知道，和长度一起回填
+    void endMessage(Buffer* output, size_t headerOffset, uint16_t code);
+
+    void appendMessage(Buffer* output, Type type, uint16_t code, uint64_t id, std::string_view payload);
+}
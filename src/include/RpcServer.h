@@ -0,0 +1,73 @@
+#pragma once
+
+#include "TcpServer.h"
+#include "RpcCodec.h"
+#include "noncopyable.h"
+
+#include <functional>
+#include <string_view>
+#include <unordered_map>
+#include <memory>
+
+// 异步handler用来回复一个请求，可以拷贝到其他线程，在任意线程调用一次reply
+class RpcResponder
+{
+public:
+    RpcResponder(const TcpConnectionPtr& conn, uint64_t id)
+        : conn_(conn),
+        id_(id)
+    {}
+
+    // 连接已经断开时什么也不做
+    void reply(uint16_t status, std::string_view payload) const;
+    void reply(uint16_t status, const RpcCodec::PayloadWriter& writer) const;
+
+    uint64_t id() const { return id_; }
+
+private:
+    std::weak_ptr<TcpConnection> conn_;
+    uint64_t id_;
+};
+
+// 基于TcpServer的二进制rpc服务器，按method id分发请求
+// 一条连接上可以同时有很多请求，一次onMessage里解析出的所有请求按顺序交给handler，
+// 同步handler的响应直接写进同一个输出Buffer，最后只send一次；异步handler的响应在reply时单独发送，可以乱序
+class RpcServer : noncopyable
+{
+public:
+    // 同步handler：request只在回调期间有效，把响应的payload直接写进response，返回status
+    using MethodHandler = std::function<uint16_t(const TcpConnectionPtr&, std::string_view request, Buffer* response)>;
+    // 异步handler：request只在回调期间有效，之后在任意线程用responder回复
+    using AsyncMethodHandler = std::function<void(const TcpConnectionPtr&, std::string_view request, const RpcResponder& responder)>;
+
+    RpcServer(EventLoop* loop,
+                const InetAddress& listenAddr,
+                const std::string& name,
+                TcpServer::Option option = TcpServer::kNoReusePort);
+
+    EventLoop* getLoop() const { return loop_; }
+    TcpServer* server() { return &server_; }
+
+    // 要在start之前注册
+    void registerMethod(uint16_t methodId, const MethodHandler& handler);
+    void registerAsyncMethod(uint16_t methodId, const AsyncMethodHandler& handler);
+
+    void setThreadNum(int numThreads) { server_.setThreadNum(numThreads); }
+
+    void start();
+
+private:
+    struct Method
+    {
+        MethodHandler handler;
+        AsyncMethodHandler asyncHandler;
+    };
+
+    void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp receiveTime);
+
+    EventLoop* loop_;
+    std::unordered_map<uint16_t, Method> methods_;
+
+    // 放在最后，析构时先停掉subLoop线程，subLoop里的回调用到的成员这时还有效
+    TcpServer server_;
+};
@@ -1,7 +1,22 @@
 #pragma once
 #include "noncopyable.h"
 
-class InetAddress;
+#include "InetAddress.h"
+
+// socket选项，值为-1表示不设置，保持系统默认
+// listen socket上设置的SO_SNDBUF/SO_RCVBUF会被accept出来的连接继承，必须在listen之前设置才能影响窗口扩大因子
+struct SocketOptions
+{
+    int backlog = 1024;             //listen的全连接队列长度
+    int tcpNoDelay = -1;            //TCP_NODELAY，1关闭Nagle算法
+    int sendBufferSize = -1;        //SO_SNDBUF，字节
+    int recvBufferSize = -1;        //SO_RCVBUF，字节
+    int deferAcceptSeconds = -1;    //TCP_DEFER_ACCEPT，只对listen socket有效，收到数据之后才唤醒accept
+    int fastOpenQueueLen = -1;      //TCP_FASTOPEN，只对listen socket有效
+    int quickAck = -1;              //TCP_QUICKACK，只对连接有效，内核会自己清掉这个标志
+    int busyPollMicros = -1;        //SO_BUSY_POLL，微秒
+    int notSentLowat = -1;          //TCP_NOTSENT_LOWAT，发送队列中未发送的数据超过这个值时不再报告可写
+};
 
 // 封装socketfd
 class Socket : noncopyable
@@ -13,8 +28,10 @@ public:
     ~Socket();
 
     int fd() const { return sockfd_; }
+    // 提前关闭fd，之后fd()返回-1，析构时不再close
+    void close();
     void bindAddress(const InetAddress& localaddr);
-    void listen();
+    void listen(int backlog = 1024);
     int accept(InetAddress* peeraddr);
 
     void shutdownWrite();
@@ -23,6 +40,25 @@ public:
     void setReuseAddr(bool on);
     void setReusePort(bool on);
     void setKeepAlive(bool on);
+
+    void setSendBufferSize(int bytes);
+    void setRecvBufferSize(int bytes);
+    void setDeferAccept(int seconds);
+    void setFastOpen(int queueLen);
+    void setQuickAck(bool on);
+    void setBusyPoll(int micros);
+    void setNotSentLowat(int bytes);
+
+    // 把options里设置过的选项应用到listen socket / 已建立的连接上，unix domain socket会跳过TCP层的选项
+    void applyListenOptions(const SocketOptions& options);
+    void applyConnectionOptions(const SocketOptions& options);
+
+    // socket的地址族，AF_INET/AF_INET6/AF_UNIX
+    int family() const;
+
+    // getsockname/getpeername
+    static InetAddress getLocalAddr(int sockfd);
+    static InetAddress getPeerAddr(int sockfd);
 private:
-    const int sockfd_;
+    int sockfd_;
 };
\ No newline at end of file
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// 进程间传递socket fd（unix domain socket + SCM_RIGHTS），用于不停服重启：
+// 新进程先在unixPath上等待，旧进程把listen fd和空闲连接的fd发过去，
+// 新进程用继承来的listen fd构造TcpServer，不需要重新bind，也不会有连接被拒绝
+namespace SocketHandoff
+{
+    const char kListenTag = 'L';        //消息里带的是listen fd
+    const char kConnectionTag = 'C';    //消息里带的是已建立的连接
+    const int kMaxFdsPerMessage = 253;  //内核SCM_MAX_FD
+
+    // 旧进程：连接新进程监听的unixPath，失败返回-1
+    int connectUnix(const std::string& unixPath);
+
+    // 通过SCM_RIGHTS发送fds，超过kMaxFdsPerMessage会拆成多条消息，发送成功后调用者可以关闭自己的fd
+    bool sendFds(int unixfd, char tag, const std::vector<int>& fds);
+
+    // 新进程：在unixPath上等旧进程连接，阻塞接收所有fd直到旧进程关闭连接
+    // 应该在loop开始之前调用，listenfd为-1表示没有收到listen fd
+    bool receive(const std::string& unixPath, int* listenfd, std::vector<int>* connfds);
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "EventLoop.h"
+#include "Connector.h"
+#include "InetAddress.h"
+#include "noncopyable.h"
+#include "Callbacks.h"
+#include "TcpConnection.h"
+
+#include <string>
+#include <memory>
+#include <mutex>
+#include <atomic>
+
+// 对外的客户端编程接口类，一个TcpClient管理一条到serverAddr的连接
+// Connector负责非阻塞connect和失败重连，连接建立后打包成TcpConnection，收发逻辑和服务端完全一样
+class TcpClient : noncopyable
+{
+public:
+    TcpClient(EventLoop* loop, const InetAddress& serverAddr, const std::string& nameArg);
+    ~TcpClient();
+
+    void connect();
+    void disconnect();  //半关闭当前连接
+    void stop();        //停止正在进行的connect
+
+    TcpConnectionPtr connection() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return connection_;
+    }
+
+    EventLoop* getLoop() const { return loop_; }
+    const std::string& name() const { return name_; }
+
+    // 连接建立后又断开时是否自动重连
+    bool retry() const { return retry_; }
+    void enableRetry() { retry_ = true; }
+    // 连接失败时的退避时间，单位毫秒
+    void setRetryDelay(int initDelayMs, int maxDelayMs) { connector_->setRetryDelay(initDelayMs, maxDelayMs); }
+
+    void setConnectionCallback(const ConnectionCallback& cb) { connectionCallback_ = cb; }
+    void setMessageCallback(const MessageCallback& cb) { messageCallback_ = cb; }
+    void setWriteCompleteCallback(const WriteCompleteCallback& cb) { writeCompleteCallback_ = cb; }
+
+    // 连接建立后走TLS，在connect之前设置，serverName用于SNI和证书校验
+    void setTlsContext(const TlsContextPtr& ctx, const std::string& serverName = std::string())
+    { tlsContext_ = ctx; tlsServerName_ = serverName; }
+    // 连接建立后开启压缩，在connect之前设置，服务端也要开启
+    void setCompressionContext(const CompressionContextPtr& ctx) { compressionContext_ = ctx; }
+
+private:
+    // 在loop线程中执行
+    void newConnection(int sockfd);
+    void removeConnection(const TcpConnectionPtr& conn);
+
+    EventLoop* loop_;
+    ConnectorPtr connector_;
+    const std::string name_;
+
+    ConnectionCallback connectionCallback_;
+    MessageCallback messageCallback_;
+    WriteCompleteCallback writeCompleteCallback_;
+    TlsContextPtr tlsContext_;
+    std::string tlsServerName_;
+    CompressionContextPtr compressionContext_;
+
+    std::atomic_bool retry_;
+    std::atomic_bool connect_;
+    int nextConnId_;    //只在loop线程中访问
+    mutable std::mutex mutex_;
+    TcpConnectionPtr connection_;   //被mutex_保护
+};
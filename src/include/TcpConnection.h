@@ -4,16 +4,25 @@
 #include "Callbacks.h"
 #include "Timestamp.h"
 #include "Buffer.h"
+#include "Socket.h"
+#include "TlsContext.h"
+#include "CompressionContext.h"
+#include "TokenBucket.h"
+#include "TimerId.h"
 
 #include <memory>
 #include <string>
 #include <atomic>
+#include <any>
+#include <deque>
 
 
 class Channel;
 class EventLoop;
 class Socket;
 class Buffer;
+class TlsSession;
+class CompressionSession;
 
 /**
  * TcpServer 通过acceptor 有一个新用户连接，通过accept函数拿到connfd
@@ -23,6 +32,9 @@ class Buffer;
 */
 
 
+// 多条连接共享的只读数据（广播用），发送时只保存引用，不按连接拷贝
+using SharedPayload = std::shared_ptr<const std::string>;
+
 class TcpConnection : noncopyable, public std::enable_shared_from_this<TcpConnection>
 {
 public:
@@ -33,18 +45,75 @@ public:
                 const InetAddress& peerAddr);
     ~TcpConnection();
 
-    EventLoop* getLoop() const { return loop_; }
+    // 连接迁移之后会变，可以在其他线程调用
+    EventLoop* getLoop() const { return loop_.load(std::memory_order_acquire); }
 
     const std::string& name() const { return name_; }
     const InetAddress& loaclAddress() const { return loaclAddr_; }
     const InetAddress& peerAddress() const { return peerAddr_; }
 
     bool connected() const { return state_ == kConnected; }
+    // 输出缓冲区里还没写到socket的字节数（包括共享数据），只在loop线程中访问
+    size_t outputBytes() const { return outPutBuffer_.readableBytes() + chunkBytes_; }
+    // socket上累计收发的字节数（tls/压缩之后），可以在其他线程读，用来估计连接的负载
+    uint64_t bytesReceived() const { return bytesReceived_.load(std::memory_order_relaxed); }
+    uint64_t bytesSent() const { return bytesSent_.load(std::memory_order_relaxed); }
+    int fd() const;
     // 发送数据
     void send(const std::string&buf);
+    // 发送buf中的所有可读数据，避免先转成string再拷贝一次。返回后buf总是被清空（连接已经断开时数据直接丢弃）
+    void send(Buffer* buf);
+    // 发送共享的数据，跨线程也不拷贝。没有开启压缩、也没有开启tls（或者开启了kTLS）时，
+    // 一次没写完的部分只在输出队列里保存payload的引用；否则要逐条连接压缩/加密，和send(string)一样
+    void send(const SharedPayload& payload);
+    // 当前线程共用的回复缓冲区：协议层在MessageCallback里把一批请求的回复攒在这里，最后send(Buffer*)一次，
+    // 不用每次回调都分配。同一个loop上的所有连接共用，攒了数据就必须send，不能跨回调保存
+    static Buffer* replyBuffer();
 
     //关闭连接
     void shutdown(); 
+    //不等待输出缓冲区发送完，直接关闭连接
+    void forceClose();
+
+    // 单独调整这条连接的socket选项，覆盖TcpServer的默认设置
+    void setTcpNoDelay(bool on);
+    void setSocketOptions(const SocketOptions& options);
+
+    // 在这条连接上启用TLS，必须在connectEstablished之前调用（TcpServer/TcpClient设置了TlsContext时会自动调用）
+    // 握手完成之后才执行ConnectionCallback，之后send的数据会被加密，MessageCallback拿到的是解密后的明文
+    // 握手失败的连接直接关闭，不会触发ConnectionCallback。serverName只对客户端有效，用于SNI和证书校验
+    void startTls(const TlsContextPtr& ctx, const std::string& serverName = std::string());
+    bool isTls() const { return static_cast<bool>(tls_); }
+    // 记录层的加解密是否已经交给内核（kTLS），只在loop线程中访问
+    bool kernelTlsTx() const;
+    bool kernelTlsRx() const;
+
+    // 在这条连接上启用流式压缩（在TLS之上），双方都要启用。必须在loop线程的ConnectionCallback里或者connectEstablished之前调用
+    // （TcpServer/TcpClient设置了CompressionContext时会自动调用），level小于0时用ctx的默认级别，实际级别取双方较小的
+    // 之后send的数据被压缩，MessageCallback拿到的是解压后的数据，数据损坏时关闭连接
+    void startCompression(const CompressionContextPtr& ctx, int level = -1);
+    // 没有开启压缩时返回nullptr，只在loop线程中访问
+    const CompressionStats* compressionStats() const;
+
+    // 限速（令牌桶），rate为0表示不限制。在loop线程中或者connectEstablished之前调用（TcpServer设置了默认值时会自动调用）
+    // 读：令牌用完时暂停EPOLLIN，补回来之后再恢复，这期间数据留在内核的接收缓冲区，对端被tcp流控挡住，不会每一轮都占用loop
+    // 写：每次最多写令牌数那么多字节，用完时暂停EPOLLOUT，数据留在输出缓冲区按速率发出去；写只支持RateLimit::kBytes
+    void setReadRateLimit(const RateLimit& limit);
+    void setWriteRateLimit(const RateLimit& limit);
+    // 扣读令牌，RateLimit::kMessages时由上层在MessageCallback里按解析出的消息数调用，kBytes时库自动按字节调用
+    // 只在loop线程中调用
+    void consumeReadQuota(double units);
+    // 协议层每解析出n条消息调用一次，读限速的单位是RateLimit::kMessages时扣n个令牌，否则什么都不做
+    // HttpServer、RespServer、RpcServer、WebSocketServer和Pipeline的编解码阶段已经调用了，只在loop线程中调用
+    void countReadMessages(size_t n);
+    // 当前是否因为限速暂停了读/写，只在loop线程中访问
+    bool readThrottled() const { return readThrottled_; }
+    bool writeThrottled() const { return writeThrottled_; }
+
+    // 上层协议（http等）保存在连接上的解析状态
+    void setContext(const std::any& context) { context_ = context; }
+    const std::any& getContext() const { return context_; }
+    std::any* getMutableContext() { return &context_; }
 
     void setConnectionCallback(const ConnectionCallback& cb)
     { connectionCallback_ = cb; }
@@ -73,17 +142,72 @@ public:
     void handleError();
 
     void sendInLoop(const void* message, size_t len);
+
+    // 把连接交给其他进程：连接空闲（输入输出缓冲区都没有数据）时dup一份sockfd返回，
+    // 然后在本进程内关闭连接（只close不shutdown，对端无感知），不空闲返回-1。只能在loop线程调用
+    int handoffInLoop();
+
+    // 把连接迁移到newLoop，线程安全。迁移排在当前loop这一轮的事件处理之后，不会打断这条连接正在执行的回调
+    // 输入输出缓冲区、回调、context、tls/压缩状态原样带过去，channel从旧loop的poller上删除，再注册到newLoop的poller上
+    // 完成后在newLoop中执行cb(conn, true)；连接已经断开或者已经在newLoop上时在当前loop中执行cb(conn, false)
+    // 旧loop里还没执行的这条连接的send/shutdown等会被转发到newLoop；其他线程并发send的数据在迁移的瞬间前后可能乱序
+    // 应用自己在getLoop()上注册的定时器不会跟着迁移，需要在cb中重新注册
+    // setMigratable(false)之后migrate总是失败（cb(conn, false)），用于状态绑定在当前loop上、没法跟着迁移的连接
+    void migrate(EventLoop* newLoop, const MigrateCallback& cb = MigrateCallback());
+    // 默认可以迁移，线程安全
+    void setMigratable(bool on) { migratable_ = on; }
+    bool migratable() const { return migratable_; }
     
     
     
 private:
 
     void shutdownInLoop();
+    void forceCloseInLoop();
+    void migrateInLoop(EventLoop* newLoop, const MigrateCallback& cb);
+    // 在连接当前所在的loop中执行cb，已经在这个loop线程中时直接执行
+    void runInOwnerLoop(const std::function<void()>& cb);
+    // 排到连接当前所在loop的队列里，执行时连接已经迁移走的话再转发到新的loop
+    void queueInOwnerLoop(const std::function<void()>& cb);
+    static void addBytes(std::atomic<uint64_t>* counter, size_t n)
+    { counter->store(counter->load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+    // 收发的字节数、输出缓冲区的变化，同时记到所在loop的计数器上
+    void countRead(size_t n);
+    void countWritten(size_t n);
+    void countOutput(int64_t delta);
+    // 执行MessageCallback，执行时间记到所在loop的直方图里
+    void deliverMessage(Timestamp receiveTime);
+    void sendSharedInLoop(const SharedPayload& payload);
+    // 直接把data写到socket（或者追加到输出队列），tls连接上的data已经是密文或者交给kTLS的明文
+    // notify为false时不触发WriteCompleteCallback，用于握手数据；data是payload的内容时没写完的部分只保存引用
+    void writeInLoop(const void* data, size_t len, bool notify, const SharedPayload* payload = nullptr);
+    // 把outPutBuffer_和outputChunks_中的数据写到socket，最多写maxBytes，返回写了多少字节
+    ssize_t writeOutput(int* saveErrno, size_t maxBytes);
+    // 写令牌允许这次写多少字节，不限速时是SIZE_MAX
+    size_t writeAllowance();
+    // 令牌补回来之后恢复读/写，定时器在连接当前所在的loop上
+    void scheduleReadResume();
+    void resumeReading();
+    void throttleWriting();
+    void scheduleWriteResume();
+    void resumeWriting();
+    // 传输层：tls加密（或者交给kTLS）之后writeInLoop，握手没完成时暂存
+    void sendTransportInLoop(const void* data, size_t len);
+    // 从socket（或者tls）读出来的数据放在哪，开启压缩时是压缩层的输入缓冲区，否则直接是inputeBuffer_
+    Buffer* streamInput();
+    void sendCompressionPreamble();
+    // 解压streamInput()中的数据追加到inputeBuffer_，出错时关闭连接并返回false
+    bool decompressInput();
+    void handleTlsRead(Timestamp receiveTime);
+    // 把用户态SSL产生的数据（握手消息、alert等）写到socket，开启了kTLS TX时不能再写，返回false表示要关闭连接
+    bool writeTlsOutput(Buffer* output);
+    // 握手完成：尝试开启kTLS，执行ConnectionCallback，发送握手期间暂存的数据
+    void tlsEstablished(Timestamp receiveTime);
 
     enum State{ kDisconnected, kConnecting, kConnected, kDisconnecting };
     void setState(State state) { state_ = state; };
 
-    EventLoop* loop_;   // 多线程情况下，这里绝对不是mainLoop，因为tcpConnection都是在subLoop管理的
+    std::atomic<EventLoop*> loop_;   // 多线程情况下，这里绝对不是mainLoop，因为tcpConnection都是在subLoop管理的，迁移时会变
     const std::string name_;
     std::atomic_int state_;
     bool reading_;
@@ -103,4 +227,31 @@ private:
 
     Buffer inputeBuffer_;   //接受数据的缓冲区
     Buffer outPutBuffer_;   //发送数据的缓冲区
+
+    // 排在outPutBuffer_后面待发送的数据：共享的payload，以及在它们之后send的数据（也按块保存，保证顺序）
+    struct OutputChunk
+    {
+        SharedPayload data;
+        size_t offset;      //已经写出去的字节数
+    };
+    static const int kMaxIovecs = 64;   //一次writev最多写多少块
+    std::deque<OutputChunk> outputChunks_;
+    size_t chunkBytes_;     //outputChunks_中还没写出去的字节数
+
+    std::any context_;
+
+    std::atomic<uint64_t> bytesReceived_;   //只有loop线程写
+    std::atomic<uint64_t> bytesSent_;
+
+    RateLimit readLimit_;
+    TokenBucket readBucket_;
+    TokenBucket writeBucket_;
+    bool readThrottled_;
+    bool writeThrottled_;
+    std::atomic<bool> migratable_;
+    TimerId readResumeTimer_;
+    TimerId writeResumeTimer_;
+
+    std::unique_ptr<TlsSession> tls_;   //非tls连接为空
+    std::unique_ptr<CompressionSession> compression_;   //没有开启压缩时为空
 };
\ No newline at end of file
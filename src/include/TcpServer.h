@@ -14,12 +14,15 @@
 #include <memory>
 #include <atomic>
 #include <unordered_map>
+#include <vector>
 
 //对外的服务器编程接口类
 class TcpServer : noncopyable
 {
 public:
     using ThreadInitCallback = std::function<void(EventLoop*)>;
+    // accept之后、连接注册到subLoop之前调用，可以按对端地址修改这条连接的socket选项
+    using SocketOptionsCallback = std::function<void(const InetAddress& peerAddr, SocketOptions* options)>;
 
     enum Option
     {
@@ -27,8 +30,14 @@ public:
         kReusePort,
     };
     TcpServer(EventLoop*loop,const InetAddress& listenaddr,const std::string& nameArg,Option option = kNoReusePort);
+    // 用继承来的listen fd构造（见SocketHandoff::receive），不再bind
+    TcpServer(EventLoop*loop,int listenfd,const std::string& nameArg);
     ~TcpServer();
 
+    const std::string& ipPort() const { return ipPort_; }
+    const std::string& name() const { return name_; }
+    EventLoop* getLoop() const { return loop_; }
+
     void setThreadInitCallback(const ThreadInitCallback& cb) { threadInitCallback_ = cb; }
     void setConnectionCallback(const ConnectionCallback& cb) { connectionCallback_ = cb; }
     void setMessageCallback(const MessageCallback& cb) { messageCallback_ = cb; }
@@ -36,13 +45,171 @@ public:
     //设置底层subloop的个数
     void setThreadNum(int numThreads);
 
+    // socket选项，必须在start之前设置，listen socket在listen时应用，新连接在newConnection中应用
+    void setSocketOptions(const SocketOptions& options);
+    void setSocketOptionsCallback(const SocketOptionsCallback& cb) { socketOptionsCallback_ = cb; }
+
+    // 所有新连接都走TLS，必须在start之前设置，见TcpConnection::startTls
+    void setTlsContext(const TlsContextPtr& ctx) { tlsContext_ = ctx; }
+    // 所有新连接都开启压缩，必须在start之前设置，客户端也要开启，见TcpConnection::startCompression
+    void setCompressionContext(const CompressionContextPtr& ctx) { compressionContext_ = ctx; }
+
+    // 每条连接默认的读写限速，必须在start之前设置，见TcpConnection::setReadRateLimit
+    // 需要按连接区分时在ConnectionCallback里对conn再设置一次
+    void setReadRateLimit(const RateLimit& limit) { readRateLimit_ = limit; }
+    void setWriteRateLimit(const RateLimit& limit) { writeRateLimit_ = limit; }
+
     void start();
 
+    // 优雅关闭：停止accept，已有连接把输出缓冲区发送完后shutdown，
+    // timeoutSeconds之后还没关闭的连接强制关闭，所有连接都关闭之后在baseLoop中执行cb
+    // 线程安全，可以在其他线程调用
+    void drain(double timeoutSeconds, const DrainCompleteCallback& cb = DrainCompleteCallback());
+    bool draining() const { return draining_; }
+
+    // 不停服重启，旧进程调用：把listen fd通过unixPath交给新进程，然后停止accept
+    // passIdleConnections为true时，空闲连接（缓冲区没有数据）也一起交给新进程，本进程的ConnectionCallback会看到这些连接断开
+    // 剩下的连接按drain处理，全部关闭后执行cb。连接unixPath失败时什么也不做，继续服务
+    void handoff(const std::string& unixPath, bool passIdleConnections,
+                double drainTimeoutSeconds, const DrainCompleteCallback& cb = DrainCompleteCallback());
+    // 新进程调用：接管旧进程传过来的已建立连接，在start之后调用
+    void adoptConnection(int sockfd);
+
+    // 准入控制，都要在start之前设置
+    // 连接数上限，0表示不限制
+    void setMaxConnections(size_t maxConnections) { maxConnections_ = maxConnections; }
+    // subLoop过载的阈值：事件循环延迟超过maxLoopLagSeconds，或者等待执行的回调超过maxPendingFunctors
+    // 新连接不会分给过载的subLoop，全部过载时按OverloadAction处理，阈值为0表示不检查
+    void setLoopOverloadThreshold(double maxLoopLagSeconds, size_t maxPendingFunctors)
+    { maxLoopLagSeconds_ = maxLoopLagSeconds; maxPendingFunctors_ = maxPendingFunctors; }
+
+    enum OverloadAction
+    {
+        kRejectConnection,  //accept之后立即关闭
+        kPauseAccept,       //暂停accept pauseSeconds秒，新连接在内核的全连接队列里排队
+    };
+    void setOverloadAction(OverloadAction action, double pauseSeconds = 0.1)
+    { overloadAction_ = action; overloadPauseSeconds_ = pauseSeconds; }
+
+    size_t numConnections() const { return numConnections_; }
+    // accept到的连接数、被准入控制（drain、连接数上限、过载）直接关掉的连接数，可以在其他线程读
+    int64_t numAccepted() const { return numAccepted_.load(std::memory_order_relaxed); }
+    int64_t numRejected() const { return numRejected_.load(std::memory_order_relaxed); }
+
+    // 把同一份数据发给所有连接（filter不为空时只发给filter返回true的连接），线程安全
+    // 数据只保存一份，每个subLoop只投递一个任务，在任务里逐条连接发送（见TcpConnection::send(const SharedPayload&)），
+    // filter在连接所在的loop线程中调用。从同一个线程广播的数据在每条连接上按顺序到达
+    void broadcast(const SharedPayload& payload, const BroadcastFilter& filter = BroadcastFilter());
+    void broadcast(std::string message, const BroadcastFilter& filter = BroadcastFilter())
+    { broadcast(std::make_shared<const std::string>(std::move(message)), filter); }
+
+    // 自动负载均衡，必须在start之前设置，intervalSeconds为0表示关闭（默认）
+    // 每intervalSeconds秒比较各个subLoop的繁忙程度（处理事件的时间占比），最忙和最闲的相差超过imbalance时，
+    // 从最忙的loop上挑一条这段时间流量合适的连接迁移到最闲的loop（见TcpConnection::migrate），每次最多迁移一条
+    // 默认所有连接都可能被迁移，状态绑定在loop上的连接要setMigratable(false)或者用MigrationFilter排除，
+    // WebSocketServer、CoConnection和SerialExecutor(pool, conn)已经把自己的连接设成了不可迁移
+    void setRebalance(double intervalSeconds, double imbalance = 0.25)
+    { rebalanceInterval_ = intervalSeconds; rebalanceImbalance_ = imbalance; }
+    // 在baseLoop中调用，返回false的连接不参与自动迁移，比如在conn->getLoop()上注册了定时器的连接
+    using MigrationFilter = std::function<bool(const TcpConnectionPtr&)>;
+    void setMigrationFilter(const MigrationFilter& filter) { migrationFilter_ = filter; }
+    // 连接迁移完成后在新loop中调用
+    void setConnectionMigratedCallback(const ConnectionCallback& cb) { connectionMigratedCallback_ = cb; }
+    int64_t numMigrations() const { return numMigrations_; }
+
+    // 运行时扩缩容subLoop，线程安全，start之后调用
+    // 新开一个subLoop，之后的新连接也会分给它（已有的连接可以靠setRebalance迁移过来）
+    void addLoop();
+    // 退休一个subLoop，loop为nullptr时选连接最少的那个：先不再给它分配新连接，已有的连接迁移到其他subLoop
+    // （migrateConnections为false、不可迁移或者被MigrationFilter排除的连接shutdown），timeoutSeconds之后还没走的连接强制关闭，
+    // 最后结束这个loop线程，完成后在baseLoop中执行cb。之后不能再使用这个EventLoop指针
+    void retireLoop(EventLoop* loop = nullptr, bool migrateConnections = true, double timeoutSeconds = 30.0,
+                    const DrainCompleteCallback& cb = DrainCompleteCallback());
+    // 退休的loop销毁之前在baseLoop中调用（这时loop上已经没有连接了），之后这个EventLoop指针就失效了，
+    // 以它为key保存的状态要在这里清掉，比如ThreadPool::removeLoop。CompressionContext的池子由TcpServer自己清理
+    using LoopRetiredCallback = std::function<void(EventLoop*)>;
+    void setLoopRetiredCallback(const LoopRetiredCallback& cb) { loopRetiredCallback_ = cb; }
+    // 按负载自动扩缩容，必须在start之前设置：每intervalSeconds秒统计subLoop的平均繁忙程度，
+    // 连续3次高于scaleUpBusy并且不到maxLoops个时加一个loop；连续3次在去掉一个loop之后平均繁忙程度仍低于scaleDownBusy，
+    // 并且多于minLoops个时退休最闲的loop（连接迁移到其他loop）。同一时间只退休一个
+    void setAutoScale(int minLoops, int maxLoops, double intervalSeconds = 5.0,
+                    double scaleUpBusy = 0.75, double scaleDownBusy = 0.3);
+    // 当前参与分配的subLoop个数（不包括正在退休的），只在baseLoop中调用
+    size_t numLoops() const { return threadPool_->numLoops(); }
+
 private:
+    TcpServer(EventLoop*loop,Acceptor* acceptor,const std::string& ipPort,const std::string& nameArg);
+
+    // 一次handoff的状态，只在baseLoop中访问
+    struct HandoffState
+    {
+        int unixfd;
+        size_t pending;             //还没有返回结果的连接数
+        std::vector<int> fds;       //dup出来的空闲连接
+        double drainTimeoutSeconds;
+        DrainCompleteCallback cb;
+    };
+    using HandoffStatePtr = std::shared_ptr<HandoffState>;
+
+    void handoffInLoop(const std::string& unixPath, bool passIdleConnections,
+                    double drainTimeoutSeconds, const DrainCompleteCallback& cb);
+    void collectHandoffFd(const HandoffStatePtr& state, int fd);
+    void adoptConnectionInLoop(int sockfd);
+
+    // 每个loop的负载，baseLoop定时往subLoop投递一个探测回调，回调执行时记录从投递到执行的延迟
+    struct LoopLoad
+    {
+        std::atomic<int64_t> lagUs{0};          //最近一次测到的延迟，微秒
+        std::atomic<int64_t> probeSentUs{0};    //还没执行的探测回调的投递时间，0表示没有
+    };
+    using LoopLoadPtr = std::shared_ptr<LoopLoad>;
+
+    void probeLoopLag();
+    bool loopOverloaded(EventLoop* loop, Timestamp now);
+    // 选一个没有过载的loop，都过载时返回nullptr
+    EventLoop* selectLoop();
+    // 过载时关闭sockfd，kPauseAccept时再暂停accept一段时间
+    void shedConnection(int sockfd, const char* reason);
+    void resumeAccepting();
+    // 在baseLoop中定时执行
+    void rebalance();
+    void migrationDone(const TcpConnectionPtr& conn, bool migrated);
+    // 自动迁移和退休loop都通过这里迁移连接，在baseLoop中调用。迁移是异步的，完成之前连接还报告旧loop，
+    // 所以按目标loop记下还没完成的迁移：目标loop在这期间开始退休时，退休要等迁移完成，连接再迁移到其他loop
+    void migrateConnection(const TcpConnectionPtr& conn, EventLoop* ioLoop, const MigrateCallback& cb);
+    void migrationFinished(const TcpConnectionPtr& conn, EventLoop* ioLoop, bool migrated, const MigrateCallback& cb);
+    // 各个subLoop从上次采样到现在的繁忙程度（0~1），last保存这次的采样，新加的loop从这次开始统计
+    std::unordered_map<EventLoop*, double> sampleLoopBusy(std::unordered_map<EventLoop*, int64_t>* last, double elapsedUs);
+
+    // 一次loop退休的状态，只在baseLoop中访问
+    struct Retirement
+    {
+        EventLoop* loop;
+        Timestamp deadline;
+        bool forced = false;        //超时之后已经强制关闭了剩下的连接
+        DrainCompleteCallback cb;
+        TimerId timer;
+    };
+    using RetirementPtr = std::shared_ptr<Retirement>;
+
+    void addLoopInLoop();
+    void retireLoopInLoop(EventLoop* loop, bool migrateConnections, double timeoutSeconds, const DrainCompleteCallback& cb);
+    // 定时检查退休的loop上还有没有连接
+    void checkRetirement(const RetirementPtr& retirement);
+    void finishRetirement(const RetirementPtr& retirement);
+    void autoScale();
+
+    // 按所在loop分组的连接，广播用
+    using ConnectionGroups = std::vector<std::pair<EventLoop*, std::vector<TcpConnectionPtr>>>;
+    using ConnectionGroupsPtr = std::shared_ptr<const ConnectionGroups>;
+    void broadcastInLoop(const SharedPayload& payload, const BroadcastFilter& filter);
 
     void newConnection(int sockfd, const InetAddress& peerAddr);
     void removeConnection(const TcpConnectionPtr& conn);
     void removeConnectionInLoop(const TcpConnectionPtr& conn);
+    void drainInLoop(double timeoutSeconds, const DrainCompleteCallback& cb);
+    void forceCloseAll();
+    void finishDrain();
 
 
     using ConnectionMap = std::unordered_map<std::string,TcpConnectionPtr>;
@@ -61,7 +228,68 @@ private:
 
     ThreadInitCallback threadInitCallback_;//loop线程初始化的回调
 
+    SocketOptions socketOptions_;
+    SocketOptionsCallback socketOptionsCallback_;
+    TlsContextPtr tlsContext_;
+    CompressionContextPtr compressionContext_;
+    RateLimit readRateLimit_;
+    RateLimit writeRateLimit_;
+
     std::atomic_int started_;
     int nextConnId_;
     ConnectionMap connections_;
+
+    std::atomic_bool draining_;
+    DrainCompleteCallback drainCompleteCallback_;
+    TimerId drainTimer_;    //drain超时的定时器
+
+    size_t maxConnections_;
+    double maxLoopLagSeconds_;
+    size_t maxPendingFunctors_;
+    OverloadAction overloadAction_;
+    double overloadPauseSeconds_;
+    std::atomic<size_t> numConnections_;
+    std::atomic<int64_t> numAccepted_;      //只有baseLoop写
+    std::atomic<int64_t> numRejected_;
+    std::unordered_map<EventLoop*, LoopLoadPtr> loopLoads_;  //只在baseLoop中访问
+    TimerId lagProbeTimer_;
+    TimerId resumeTimer_;
+    bool acceptPaused_;
+    int64_t shedCount_;             //被拒绝的连接数，日志限流用
+    Timestamp lastShedLog_;
+
+    // 连接上次采样时的流量，只在baseLoop中访问
+    struct TrafficSample
+    {
+        uint64_t bytes = 0;
+        int cooldown = 0;           //刚迁移过的连接在这么多个周期内不再迁移，防止来回搬
+    };
+    double rebalanceInterval_;
+    double rebalanceImbalance_;
+    MigrationFilter migrationFilter_;
+    ConnectionCallback connectionMigratedCallback_;
+    LoopRetiredCallback loopRetiredCallback_;
+    TimerId rebalanceTimer_;
+    Timestamp lastRebalance_;
+    std::unordered_map<EventLoop*, int64_t> loopBusyUs_;    //上次采样时各个loop的busyMicroseconds
+    std::unordered_map<std::string, TrafficSample> traffic_;
+    bool migrating_;                //同一时间只有一条连接在自动迁移
+    std::unordered_map<EventLoop*, int> migrationsTo_;  //各个目标loop上还没完成的迁移数，只在baseLoop中访问
+    std::atomic<int64_t> numMigrations_;
+
+    int minLoops_;
+    int maxLoops_;
+    double autoScaleInterval_;
+    double scaleUpBusy_;
+    double scaleDownBusy_;
+    TimerId autoScaleTimer_;
+    Timestamp lastAutoScale_;
+    std::unordered_map<EventLoop*, int64_t> scaleBusyUs_;
+    int scaleUpVotes_;              //连续几次需要扩容/缩容
+    int scaleDownVotes_;
+    std::vector<RetirementPtr> retirements_;    //正在退休的loop
+
+    // 连接增删之后清空，有迁移之后重建，连接没变化时连续广播不用每次都分组，只在baseLoop中访问
+    ConnectionGroupsPtr broadcastGroups_;
+    int64_t broadcastGroupsMigrations_;         //分组时的numMigrations_
 };
\ No newline at end of file
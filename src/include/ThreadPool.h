@@ -0,0 +1,163 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+class EventLoop;
+class Thread;
+class TcpConnection;
+
+// 把结果送回某个EventLoop：结果先攒在队列里，只有队列从空变成非空时才queueInLoop一次，
+// loop醒来后一次执行完这期间所有线程、所有连接送来的结果，而不是每个结果唤醒一次
+class CompletionQueue : noncopyable, public std::enable_shared_from_this<CompletionQueue>
+{
+public:
+    using Functor = std::function<void()>;
+
+    explicit CompletionQueue(EventLoop* loop) : loop_(loop), closed_(false), scheduled_(false) {}
+
+    // 任意线程调用，cb在loop线程中执行，同一个线程post的结果按顺序执行
+    // loop退休之后post的结果直接丢弃
+    void post(Functor cb);
+    // loop销毁之前调用（见ThreadPool::removeLoop），之后不再访问loop
+    void close();
+
+    EventLoop* loop() const { return loop_; }
+
+private:
+    // 在loop线程中执行
+    void drain();
+
+    EventLoop* loop_;
+    std::mutex mutex_;
+    std::vector<Functor> pending_;
+    bool closed_;
+    bool scheduled_;    //已经queueInLoop了drain，还没执行
+};
+using CompletionQueuePtr = std::shared_ptr<CompletionQueue>;
+
+// 计算线程池，给MessageCallback里耗CPU的工作用，不要放阻塞IO
+// 每个工作线程有自己的双端队列，从头部按提交顺序取任务，自己的队列空了就从别的线程队列的尾部偷，
+// 工作线程自己提交的任务（比如SerialExecutor的后续任务）放进自己的队列，其他线程提交的任务轮询放到各个工作线程的队列里
+class ThreadPool : noncopyable
+{
+public:
+    using Task = std::function<void()>;
+    using ThreadInitCallback = std::function<void()>;
+
+    explicit ThreadPool(const std::string& name = std::string("ThreadPool"));
+    ~ThreadPool();
+
+    // start之前调用，默认是CPU核数
+    void setThreadNum(int numThreads) { numThreads_ = numThreads; }
+    void start(const ThreadInitCallback& cb = ThreadInitCallback());
+    // 等已经提交的任务执行完，再回收所有线程
+    void stop();
+
+    // 任意线程调用；start之前只能在调用start的线程中提交，这些任务在start之后执行
+    void run(Task task);
+
+    // loop对应的结果队列，同一个loop返回同一个对象
+    CompletionQueuePtr completionQueue(EventLoop* loop);
+    // loop要销毁了（比如TcpServer::retireLoop，见TcpServer::setLoopRetiredCallback），关闭并删掉它的结果队列，
+    // 之后还在这个队列上提交的结果被丢弃，不会访问已经销毁的loop
+    void removeLoop(EventLoop* loop);
+
+    const std::string& name() const { return name_; }
+    int numThreads() const { return static_cast<int>(workers_.size()); }
+    // 还没开始执行的任务数
+    size_t queueSize() const { return pending_.load(std::memory_order_relaxed); }
+
+private:
+    struct Worker
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+        std::unique_ptr<Thread> thread;
+    };
+
+    void runInThread(size_t index, const ThreadInitCallback& cb);
+    // 先取自己队列的头部，没有就从其他队列的尾部偷
+    bool take(size_t index, Task* task);
+    void push(size_t index, Task task);
+
+    std::string name_;
+    int numThreads_;
+    std::atomic_bool running_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<Task> beforeStart_;     //start之前提交的任务
+    std::atomic_size_t next_;           //外部提交轮询用
+    std::atomic_size_t pending_;        //所有队列里的任务总数
+    std::atomic_int idle_;              //正在等待的线程数，为0时提交任务不用notify
+    std::mutex idleMutex_;
+    std::condition_variable idleCond_;
+
+    std::mutex completionMutex_;        //只保护completions_这个map
+    std::unordered_map<EventLoop*, CompletionQueuePtr> completions_;
+};
+
+// 串行执行器：提交的任务按顺序、一个接一个地在ThreadPool中执行，不同执行器之间并行，
+// 通常每条连接一个（保存在context里），这样一条连接上的请求按顺序处理，不同连接并行处理
+class SerialExecutor : noncopyable, public std::enable_shared_from_this<SerialExecutor>
+{
+public:
+    using Task = std::function<void()>;
+
+    // loop是结果送回的线程，一般是conn->getLoop()
+    SerialExecutor(ThreadPool* pool, EventLoop* loop);
+    // 结果送回conn->getLoop()，同时把conn设成不可迁移（TcpConnection::setMigratable），
+    // 否则连接被TcpServer迁移走之后结果还会送回旧loop
+    SerialExecutor(ThreadPool* pool, const std::shared_ptr<TcpConnection>& conn);
+
+    // 任意线程调用，task在线程池中执行，排在之前提交的任务之后
+    void run(Task task);
+
+    // work()在线程池中按顺序执行，done(work的返回值)回到loop线程中执行（批量）
+    // work返回void时done不带参数；done按提交的顺序执行
+    template<typename Work, typename Done>
+    void submit(Work work, Done done)
+    {
+        CompletionQueuePtr completion = completion_;
+        run([work = std::move(work), done = std::move(done), completion]() mutable {
+            if constexpr(std::is_void_v<std::invoke_result_t<Work&>>)
+            {
+                work();
+                completion->post(std::move(done));
+            }
+            else
+            {
+                completion->post([result = work(), done = std::move(done)]() mutable { done(std::move(result)); });
+            }
+        });
+    }
+
+    // 把cb送回loop线程执行，一般在run的任务里调用
+    void complete(std::function<void()> cb) { completion_->post(std::move(cb)); }
+
+    EventLoop* loop() const { return completion_->loop(); }
+    // 排队中的任务数（不包括正在执行的）
+    size_t queueSize();
+
+private:
+    // 在线程池中执行，一次最多执行kMaxBatch个任务，还有剩下的就重新排到线程池里，防止一条连接占住一个线程
+    void drain();
+
+    static const int kMaxBatch = 64;
+
+    ThreadPool* pool_;
+    CompletionQueuePtr completion_;
+    std::mutex mutex_;
+    std::deque<Task> tasks_;
+    bool scheduled_;    //已经有drain在线程池里排队或者正在执行
+};
+using SerialExecutorPtr = std::shared_ptr<SerialExecutor>;
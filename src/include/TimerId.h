@@ -0,0 +1,28 @@
+#pragma once
+#include <stdint.h>
+
+class Timer;
+
+// 给用户用来取消定时器的标识，可以拷贝
+class TimerId
+{
+public:
+    TimerId()
+        : timer_(nullptr),
+        sequence_(0)
+    {}
+
+    TimerId(Timer* timer, int64_t seq)
+        : timer_(timer),
+        sequence_(seq)
+    {}
+
+    // 默认构造的TimerId不对应任何定时器
+    bool valid() const { return timer_ != nullptr; }
+
+    friend class TimerQueue;
+
+private:
+    Timer* timer_;
+    int64_t sequence_;
+};
@@ -0,0 +1,52 @@
+#pragma once
+#include "noncopyable.h"
+#include "Timestamp.h"
+#include "Callbacks.h"
+#include "Channel.h"
+
+#include <set>
+#include <vector>
+
+class EventLoop;
+class Timer;
+class TimerId;
+
+// 定时器队列，所有定时器共用一个timerfd，timerfd总是设置成最早到期的那个定时器的时间
+// timerfd可读时由loop回调handleRead，执行所有已经到期的定时器
+class TimerQueue : noncopyable
+{
+public:
+    explicit TimerQueue(EventLoop* loop);
+    ~TimerQueue();
+
+    // 线程安全，可以在其他线程调用
+    TimerId addTimer(TimerCallback cb, Timestamp when, double interval);
+
+    void cancel(TimerId timerId);
+
+private:
+    using Entry = std::pair<Timestamp, Timer*>;
+    using TimerList = std::set<Entry>;
+    using ActiveTimer = std::pair<Timer*, int64_t>;
+    using ActiveTimerSet = std::set<ActiveTimer>;
+
+    void addTimerInLoop(Timer* timer);
+    void cancelInLoop(TimerId timerId);
+    // timerfd可读
+    void handleRead();
+    // 取出所有到期的定时器
+    std::vector<Entry> getExpired(Timestamp now);
+    // 重复定时器重新插入，并重置timerfd
+    void reset(const std::vector<Entry>& expired, Timestamp now);
+    // 返回插入的定时器是否成为最早到期的定时器
+    bool insert(Timer* timer);
+
+    EventLoop* loop_;
+    const int timerfd_;
+    Channel timerfdChannel_;
+    TimerList timers_;              //按到期时间排序
+
+    ActiveTimerSet activeTimers_;   //按Timer地址排序，和timers_保存的是同一批定时器，用于cancel
+    bool callingExpiredTimers_;
+    ActiveTimerSet cancelingTimers_;    //在执行到期回调的过程中被取消的定时器
+};
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <memory>
+#include <string>
+
+// OpenSSL的类型只做前向声明，头文件不依赖openssl，没有openssl时库也能编译（TLS相关的工厂函数返回nullptr）
+struct ssl_ctx_st;
+
+class TlsContext;
+using TlsContextPtr = std::shared_ptr<TlsContext>;
+
+// 对SSL_CTX的封装，证书、校验方式这些所有连接共享的配置，一个TcpServer/TcpClient持有一个
+// 创建之后只读，可以被多个loop线程同时使用
+class TlsContext : noncopyable
+{
+public:
+    // 服务端：PEM格式的证书链和私钥，加载失败返回nullptr
+    static TlsContextPtr createServer(const std::string& certFile, const std::string& keyFile);
+    // 客户端：caFile为空时使用系统默认的CA，verifyPeer为false时不校验服务端证书（只用于测试）
+    static TlsContextPtr createClient(const std::string& caFile = std::string(), bool verifyPeer = true);
+    ~TlsContext();
+
+    bool isServer() const { return isServer_; }
+    bool verifyPeer() const { return verifyPeer_; }
+
+    // 握手完成后是否尝试把记录层的加解密交给内核（kTLS），默认开启
+    // 只支持TLS1.3 + AES-GCM，内核没有tls模块或者协商出其他套件时退回用户态SSL_read/SSL_write
+    // 开启后服务端不再发送session ticket，保证握手结束时应用数据的记录序号从0开始
+    void setKernelTls(bool on);
+    bool kernelTls() const { return kernelTls_; }
+
+    ssl_ctx_st* native() const { return ctx_; }
+
+private:
+    TlsContext(ssl_ctx_st* ctx, bool isServer, bool verifyPeer);
+
+    ssl_ctx_st* ctx_;
+    const bool isServer_;
+    const bool verifyPeer_;
+    bool kernelTls_;
+};
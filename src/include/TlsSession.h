@@ -0,0 +1,77 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "TlsContext.h"
+#include "Buffer.h"
+
+#include <string>
+
+struct ssl_st;
+struct bio_st;
+
+// 一条连接上的TLS状态，由TcpConnection持有，只在loop线程中访问
+// SSL对象不直接碰socket，读写都走两个内存BIO：
+// 从socket读到的密文放进cipherBuffer()，handleInput把它写入rbio，解出的明文追加到调用者的Buffer
+// SSL要发出去的数据（握手消息、加密后的记录、alert）从wbio取出来追加到out，由TcpConnection负责写socket
+// 握手完成后enableKernelTls把密钥交给内核，之后收发都是明文，TcpConnection的读写路径和普通连接一样
+class TlsSession : noncopyable
+{
+public:
+    enum Result
+    {
+        kOk,            //正常，可能解出了明文，也可能还在握手
+        kHandshakeDone, //这次输入让握手完成了
+        kError,         //握手失败或者收到了非法的记录，连接应该关闭
+    };
+
+    TlsSession(const TlsContextPtr& ctx, const std::string& serverName);
+    ~TlsSession();
+
+    // 客户端发起握手，ClientHello追加到out
+    void startHandshake(Buffer* out);
+
+    // 处理cipherBuffer()中所有的密文，明文追加到plaintext，需要回给对端的数据追加到out
+    Result handleInput(Buffer* plaintext, Buffer* out);
+
+    // 加密len字节追加到out，失败返回false
+    bool encrypt(const void* data, size_t len, Buffer* out);
+    // 握手完成之前上层要发送的明文先存在这里，握手完成（以及开启kTLS）之后由TcpConnection取出来发送
+    Buffer* pendingWrites() { return &pendingWrites_; }
+
+    // 生成close_notify追加到out，只发一次，kernelTx时不发（记录序号在内核里，用户态不能再写记录）
+    void shutdown(Buffer* out);
+    // kernelTx时的close_notify：通过TLS_SET_RECORD_TYPE让内核加密成alert记录直接写到fd，只发一次
+    // 调用时输出缓冲区必须已经写完，否则alert会排到还没发出去的数据前面。socket写满时失败返回false
+    bool sendKernelCloseNotify(int fd);
+
+    // 尝试开启kTLS，TX失败时整体退回用户态，RX只在服务端且没有未处理的密文时开启
+    void enableKernelTls(int fd);
+
+    Buffer* cipherBuffer() { return &cipher_; }
+    bool handshakeDone() const { return handshakeDone_; }
+    bool kernelTx() const { return kernelTx_; }
+    bool kernelRx() const { return kernelRx_; }
+    // 协商出的协议版本和套件，用于日志
+    std::string description() const;
+
+    // keylog回调记录TLS1.3的应用流量密钥，只在开启kTLS时设置
+    void saveTrafficSecret(const char* line);
+
+private:
+    // 把wbio中SSL产生的数据全部取出来追加到out
+    void drainOutput(Buffer* out);
+    bool continueHandshake(Buffer* out);
+
+    TlsContextPtr ctx_;
+    ssl_st* ssl_;
+    bio_st* rbio_;      //网络 -> SSL
+    bio_st* wbio_;      //SSL -> 网络
+    Buffer cipher_;
+    Buffer pendingWrites_;
+    bool handshakeDone_;
+    bool kernelTx_;
+    bool kernelRx_;
+    bool closeNotifySent_;
+    std::string clientSecret_;  //CLIENT_TRAFFIC_SECRET_0，二进制
+    std::string serverSecret_;  //SERVER_TRAFFIC_SECRET_0
+};
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "Timestamp.h"
+
+// 限速参数，TcpConnection/TcpServer的setReadRateLimit/setWriteRateLimit用
+struct RateLimit
+{
+    enum Unit
+    {
+        kBytes,     //按socket上收发的字节数扣（tls/压缩之后）
+        kMessages,  //只对读有效：由协议层每解析出一条消息扣一个令牌（见TcpConnection::countReadMessages）
+    };
+    double rate = 0.0;      //每秒多少个单位，0表示不限制
+    double burst = 0.0;     //桶的容量，允许的突发量，0表示等于rate（一秒的量）
+    Unit unit = kBytes;
+};
+
+// 令牌桶：按时间以rate的速度补充令牌，最多攒burst个。允许透支（一次读出来多少就扣多少），
+// 透支之后要等令牌补回到0以上才能继续
+class TokenBucket
+{
+public:
+    TokenBucket() : rate_(0.0), burst_(0.0), tokens_(0.0) {}
+
+    // 重新设置速率，桶是满的
+    void reset(const RateLimit& limit, Timestamp now);
+    bool limited() const { return rate_ > 0.0; }
+
+    // 补充上次到now之间的令牌
+    void refill(Timestamp now);
+    void consume(double n) { tokens_ -= n; }
+    double tokens() const { return tokens_; }
+    // 令牌至少补回到need还要等多少秒
+    double secondsUntil(double need) const;
+
+private:
+    double rate_;
+    double burst_;
+    double tokens_;
+    Timestamp last_;
+};
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "InetAddress.h"
+#include "Timestamp.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+class EventLoop;
+class Channel;
+class UdpChannel;
+
+// udp socket的参数，-1表示不设置
+struct UdpOptions
+{
+    int batchSize = 64;             //一次recvmmsg/sendmmsg最多处理多少个datagram
+    int maxDatagramSize = 2048;     //接收缓冲区每个槽的大小，超过的datagram会被截断丢弃
+    bool gro = false;               //UDP_GRO：内核把同一个流的多个datagram合并成一次接收，槽的大小会提高到64K
+    bool gso = false;               //UDP_SEGMENT：发给同一个peer的等长datagram合并成一次发送
+    int sendBufferSize = -1;
+    int recvBufferSize = -1;
+    size_t maxPendingSendBytes = 4 * 1024 * 1024;   //发送队列的上限，超过时丢弃（udp本来就不保证送达）
+};
+
+// data只在回调期间有效
+using DatagramCallback = std::function<void(UdpChannel*, const InetAddress& peer, std::string_view data, Timestamp)>;
+
+// 一个非阻塞的udp socket，和TcpConnection一样注册在一个EventLoop上
+// 读事件来了用recvmmsg一次收一批datagram到复用的接收区，逐个交给DatagramCallback
+// send只是把datagram追加到发送队列，这一轮事件循环的最后用sendmmsg一次发出去，EAGAIN时等可写事件再发
+// 和TcpConnection一样用shared_ptr管理，排队的回调持有它，stop之后可以安全释放
+class UdpChannel : noncopyable, public std::enable_shared_from_this<UdpChannel>
+{
+public:
+    // 接管sockfd，析构时关闭
+    UdpChannel(EventLoop* loop, int sockfd, const UdpOptions& options);
+    ~UdpChannel();
+
+    // 创建一个非阻塞的udp socket并bind，reusePort时多个socket可以绑定同一个地址，内核按四元组哈希分发，失败返回-1
+    static int createBound(const InetAddress& addr, bool reusePort, const UdpOptions& options);
+
+    void setDatagramCallback(const DatagramCallback& cb) { datagramCallback_ = cb; }
+
+    // 开始/停止接收，在loop线程中调用，start之前必须已经被shared_ptr持有
+    void start();
+    void stop();
+
+    // 线程安全，其他线程调用时拷贝data并转到loop线程
+    void send(const InetAddress& peer, std::string_view data);
+
+    EventLoop* getLoop() const { return loop_; }
+    int fd() const { return sockfd_; }
+
+    // 统计，只在loop线程中访问
+    uint64_t datagramsReceived() const { return datagramsReceived_; }
+    uint64_t datagramsSent() const { return datagramsSent_; }
+    uint64_t datagramsDropped() const { return datagramsDropped_; }
+
+private:
+    struct PendingDatagram
+    {
+        InetAddress peer;
+        size_t offset;      //在sendData_中的偏移
+        size_t length;
+    };
+
+    void sendInLoop(const InetAddress& peer, const char* data, size_t len);
+    void handleRead(Timestamp receiveTime);
+    void handleWrite();
+    void handleError();
+    void flush();
+    // 从sendQueue_的index位置开始最多填满一批mmsghdr，返回填了几个
+    int fillSendBatch(size_t index);
+
+    EventLoop* loop_;
+    const int sockfd_;
+    const UdpOptions options_;
+    std::unique_ptr<Channel> channel_;
+    DatagramCallback datagramCallback_;
+
+    // 接收区，构造时分配好，之后一直复用
+    size_t slotSize_;
+    std::vector<char> recvArena_;
+    std::vector<mmsghdr> recvMsgs_;
+    std::vector<iovec> recvIovecs_;
+    std::vector<sockaddr_storage> recvAddrs_;
+    std::vector<char> recvControl_;
+
+    // 发送队列，datagram的数据连续存放在sendData_里
+    std::vector<PendingDatagram> sendQueue_;
+    std::string sendData_;
+    size_t sendHead_;           //sendQueue_中第一个还没发出去的datagram
+    bool flushQueued_;
+    std::vector<mmsghdr> sendMsgs_;
+    std::vector<iovec> sendIovecs_;
+    std::vector<char> sendControl_;
+    std::vector<size_t> sendSegments_;     //每个mmsghdr包含几个datagram（GSO时大于1）
+
+    uint64_t datagramsReceived_;
+    uint64_t datagramsSent_;
+    uint64_t datagramsDropped_;
+};
+
+using UdpChannelPtr = std::shared_ptr<UdpChannel>;
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "UdpChannel.h"
+#include "EventLoopThreadPool.h"
+#include "InetAddress.h"
+#include "noncopyable.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+class EventLoop;
+
+// udp服务器，每个loop一个绑定在同一地址上的socket（SO_REUSEPORT），内核按四元组把datagram分给各个socket
+// 没有accept也没有连接，datagram直接在收到它的loop线程里回调，回复用回调参数里的UdpChannel发送
+class UdpServer : noncopyable
+{
+public:
+    using ThreadInitCallback = std::function<void(EventLoop*)>;
+
+    UdpServer(EventLoop* loop, const InetAddress& listenAddr, const std::string& name);
+    ~UdpServer();
+
+    // 下面的设置都要在start之前调用
+    void setThreadNum(int numThreads) { threadPool_->setThreadNum(numThreads); }
+    void setThreadInitCallback(const ThreadInitCallback& cb) { threadInitCallback_ = cb; }
+    void setDatagramCallback(const DatagramCallback& cb) { datagramCallback_ = cb; }
+    void setOptions(const UdpOptions& options) { options_ = options; }
+
+    // 开启线程池，每个loop创建并bind一个socket，socket创建失败时LOG_FATAL
+    void start();
+
+    const std::string& name() const { return name_; }
+    EventLoop* getLoop() const { return loop_; }
+    // start之后有效，每个loop一个
+    const std::vector<UdpChannelPtr>& channels() const { return channels_; }
+
+private:
+    EventLoop* loop_;
+    const InetAddress listenAddr_;
+    const std::string name_;
+    std::unique_ptr<EventLoopThreadPool> threadPool_;
+    ThreadInitCallback threadInitCallback_;
+    DatagramCallback datagramCallback_;
+    UdpOptions options_;
+    std::vector<UdpChannelPtr> channels_;
+    bool started_;
+};
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "InetAddress.h"
+#include "Callbacks.h"
+
+#include <functional>
+#include <string>
+#include <memory>
+#include <vector>
+#include <deque>
+
+class EventLoop;
+class TcpClient;
+
+// 到同一个上游服务器的长连接池，一个pool只属于一个EventLoop（一般每个subLoop在ThreadInitCallback里各建一个）
+// 池里的连接都在自己的loop上，借出和归还都不跨线程，也不需要每个请求重新握手
+// 连接断开后由TcpClient自动重连（Connector按指数退避）
+class UpstreamPool : noncopyable
+{
+public:
+    using AcquireCallback = std::function<void(const TcpConnectionPtr&)>;
+
+    UpstreamPool(EventLoop* loop, const InetAddress& serverAddr, const std::string& name, int size);
+    ~UpstreamPool();
+
+    // 必须在start之前设置，会设置给池里的每一条连接
+    void setConnectionCallback(const ConnectionCallback& cb) { connectionCallback_ = cb; }
+    void setMessageCallback(const MessageCallback& cb) { messageCallback_ = cb; }
+    void setRetryDelay(int initDelayMs, int maxDelayMs) { initRetryDelayMs_ = initDelayMs; maxRetryDelayMs_ = maxDelayMs; }
+
+    // 建立size条连接并保持
+    void start();
+    void stop();
+
+    // 借一条空闲连接，有空闲连接时cb直接执行，否则cb排队，等有连接建立或归还时再执行
+    // 应该在loop线程中调用，其他线程调用会转到loop线程执行
+    void acquire(AcquireCallback cb);
+    // 归还借出的连接，已经断开的连接会被丢弃
+    void release(const TcpConnectionPtr& conn);
+
+    EventLoop* getLoop() const { return loop_; }
+    size_t idleConnections() const { return idle_.size(); }
+    size_t pendingAcquires() const { return waiters_.size(); }
+
+private:
+    void onConnection(const TcpConnectionPtr& conn);
+    void putIdle(const TcpConnectionPtr& conn);
+    void removeIdle(const TcpConnectionPtr& conn);
+
+    EventLoop* loop_;
+    const InetAddress serverAddr_;
+    const std::string name_;
+    const int size_;
+    int initRetryDelayMs_;
+    int maxRetryDelayMs_;
+
+    ConnectionCallback connectionCallback_;
+    MessageCallback messageCallback_;
+
+    std::vector<std::unique_ptr<TcpClient>> clients_;
+    std::vector<TcpConnectionPtr> idle_;    //当栈用，后归还的先借出，连接更“热”
+    std::deque<AcquireCallback> waiters_;
+};
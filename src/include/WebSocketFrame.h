@@ -0,0 +1,53 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <memory>
+#include <stdint.h>
+#include <stddef.h>
+
+class Buffer;
+
+// websocket帧的编解码（RFC 6455）
+namespace WebSocketFrame
+{
+    enum Opcode
+    {
+        kContinuation = 0x0,
+        kText = 0x1,
+        kBinary = 0x2,
+        kClose = 0x8,
+        kPing = 0x9,
+        kPong = 0xA,
+    };
+
+    // 一个完整帧的头部信息，payload已经在Buffer里原地unmask
+    struct Header
+    {
+        bool fin;
+        Opcode opcode;
+        size_t headerLength;    //帧头长度，payload从peek()+headerLength开始
+        size_t payloadLength;
+    };
+
+    enum ParseResult
+    {
+        kNeedMore,
+        kGotFrame,
+        kProtocolError,     //客户端帧没有mask、控制帧太长或者有分片、保留位不为0
+        kTooLarge,
+    };
+
+    // 解析buf开头的一个帧，完整时把payload原地unmask，调用者处理完之后retrieve(headerLength+payloadLength)
+    ParseResult parse(Buffer* buf, size_t maxPayloadLength, Header* header);
+
+    // data ^= mask，一次处理一个SIMD寄存器宽度的数据
+    void unmask(char* data, size_t len, const unsigned char mask[4]);
+
+    // 服务端发出的帧不加mask，直接写进output
+    void appendFrame(Buffer* output, Opcode opcode, const char* payload, size_t len, bool fin = true);
+
+    // 预先编码好的帧，广播时所有连接共用同一份，不用给每个连接重新编码
+    using FramePtr = std::shared_ptr<const std::string>;
+    FramePtr makeFrame(Opcode opcode, std::string_view payload);
+}
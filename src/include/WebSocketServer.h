@@ -0,0 +1,84 @@
+#pragma once
+
+#include "TcpServer.h"
+#include "WebSocketFrame.h"
+#include "noncopyable.h"
+
+#include <functional>
+#include <string>
+#include <string_view>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+// 基于TcpServer的websocket服务器：先用HttpContext解析升级请求完成握手，之后按帧解析
+// 帧的payload在输入缓冲区里原地unmask，不分片的消息直接以string_view交给回调，不拷贝
+// 每个subLoop一个定时器检查空闲连接发ping，不需要额外的线程
+class WebSocketServer : noncopyable
+{
+public:
+    // message只在回调期间有效
+    using WebSocketMessageCallback = std::function<void(const TcpConnectionPtr&, std::string_view message, bool binary, Timestamp)>;
+    using ThreadInitCallback = TcpServer::ThreadInitCallback;
+
+    WebSocketServer(EventLoop* loop,
+                    const InetAddress& listenAddr,
+                    const std::string& name,
+                    TcpServer::Option option = TcpServer::kNoReusePort);
+
+    EventLoop* getLoop() const { return loop_; }
+    TcpServer* server() { return &server_; }
+
+    // 握手完成和连接断开时回调
+    void setConnectionCallback(const ConnectionCallback& cb) { connectionCallback_ = cb; }
+    void setMessageCallback(const WebSocketMessageCallback& cb) { messageCallback_ = cb; }
+    void setThreadInitCallback(const ThreadInitCallback& cb) { threadInitCallback_ = cb; }
+    // 见TcpServer::setLoopRetiredCallback，不要直接设置server()的这个回调
+    void setLoopRetiredCallback(const TcpServer::LoopRetiredCallback& cb) { loopRetiredCallback_ = cb; }
+
+    // 连接空闲pingIntervalSeconds秒后发ping，再过一个周期还没有任何数据就关闭，0表示不发ping
+    void setPingInterval(double pingIntervalSeconds) { pingIntervalSeconds_ = pingIntervalSeconds; }
+    // 单个消息（分片拼起来之后）的最大长度
+    void setMaxMessageSize(size_t maxMessageSize) { maxMessageSize_ = maxMessageSize; }
+    void setThreadNum(int numThreads) { server_.setThreadNum(numThreads); }
+
+    void start();
+
+    // 发送一个消息，在连接所在的loop线程中调用时直接编码进发送缓冲区
+    static void send(const TcpConnectionPtr& conn, std::string_view message, bool binary = false);
+    // 发送预先编码好的帧，跨线程时只拷贝智能指针，广播时同一个帧不用重复编码
+    static void sendFrame(const TcpConnectionPtr& conn, const WebSocketFrame::FramePtr& frame);
+    // 发送close帧然后关闭连接
+    static void close(const TcpConnectionPtr& conn, uint16_t code = 1000);
+
+private:
+    // 每个loop上的websocket连接，只在这个loop线程里访问
+    struct LoopState
+    {
+        std::unordered_map<TcpConnection*, std::weak_ptr<TcpConnection>> connections;
+    };
+    using LoopStatePtr = std::shared_ptr<LoopState>;
+
+    void onThreadInit(EventLoop* loop);
+    void onLoopRetired(EventLoop* loop);
+    void onConnection(const TcpConnectionPtr& conn);
+    void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp receiveTime);
+    // 处理握手，返回false表示握手失败连接已经关闭
+    bool handleHandshake(const TcpConnectionPtr& conn, Buffer* buf, Timestamp receiveTime);
+    void handleFrames(const TcpConnectionPtr& conn, Buffer* buf, Timestamp receiveTime);
+    static void checkIdleConnections(const LoopStatePtr& state, double pingIntervalSeconds);
+
+    EventLoop* loop_;
+    ConnectionCallback connectionCallback_;
+    WebSocketMessageCallback messageCallback_;
+    ThreadInitCallback threadInitCallback_;
+    TcpServer::LoopRetiredCallback loopRetiredCallback_;
+    double pingIntervalSeconds_;
+    size_t maxMessageSize_;
+
+    std::mutex mutex_;
+    std::unordered_map<EventLoop*, LoopStatePtr> loopStates_;   //被mutex_保护，只在线程初始化和新连接时访问
+
+    // 放在最后，析构时先停掉subLoop线程，subLoop里的回调用到的成员这时还有效
+    TcpServer server_;
+};